@@ -0,0 +1,201 @@
+/*
+ * ESP32 Multitool - Boot Stages
+ * Startup as a dependency graph, with time-to-ready per stage
+ *
+ * Each init step is a stage with a bitmask of the stages it needs. Ready
+ * stages set their bit in an event group; a stage waits for all of its
+ * dependency bits, runs, and sets its own. Stages on the setup() path run
+ * inline in graph order, slow independent ones (the OLED splash transfer)
+ * run in a short-lived task on the other core, and stages carried out by
+ * the WiFi task mark themselves with start()/ready(). A stage that fails
+ * still sets its bit - dependents check ok() rather than waiting forever.
+ *
+ * Stage         Needs                          Runs in
+ * CORE          -                              setup()
+ * CONFIG        CORE                           setup()
+ * ENCODER       CORE                           setup()
+ * DISPLAY       CORE                           own task, core 0
+ * LEDS, PWM     CONFIG                         setup()
+ * LOCAL         CONFIG ENCODER LEDS PWM        setup() returns -> loop()
+ * CREDENTIALS   CONFIG                         WiFi task
+ * NETWORK       CONFIG                         WiFi task
+ * SERVICES      NETWORK CREDENTIALS DISPLAY    WiFi task
+ *
+ * Local control does not wait for the display (loop() draws once
+ * displayAvailable is set) or for WiFi (the WiFi task runs on core 0).
+ * Times are from esp_timer, i.e. microseconds since the app started.
+ */
+
+#ifndef BOOT_STAGES_H
+#define BOOT_STAGES_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/event_groups.h>
+
+enum class BootStage : uint8_t {
+  CORE,          // Mutexes, queues, watchdog, GPIO, I2C bus
+  CONFIG,        // Settings image from NVS
+  ENCODER,
+  DISPLAY,       // OLED init and splash (own task)
+  LEDS,          // NeoPixel effects engine
+  PWM,           // 12V dimmer LEDC channel
+  LOCAL,         // setup() done: loop() owns local control
+  CREDENTIALS,   // Password records (first boot runs the KDF)
+  NETWORK,       // Radio started (station connecting and/or setup AP open)
+  SERVICES,      // Web server, mDNS, ArduinoOTA, MQTT
+  COUNT
+};
+
+#define BOOT_BIT(stage) (1u << (uint8_t)BootStage::stage)
+
+namespace BootConfig {
+  const uint16_t TASK_STACK = 3072;        // Async stage tasks
+  const uint8_t TASK_PRIORITY = 2;
+  const uint8_t TASK_CORE = 0;             // Off the setup()/loop() core
+  const uint32_t DEPENDENCY_TIMEOUT_MS = 5000;
+
+  // Indexed by BootStage
+  const uint32_t DEPENDS[] = {
+    0,                                                            // CORE
+    BOOT_BIT(CORE),                                               // CONFIG
+    BOOT_BIT(CORE),                                               // ENCODER
+    BOOT_BIT(CORE),                                               // DISPLAY
+    BOOT_BIT(CONFIG),                                             // LEDS
+    BOOT_BIT(CONFIG),                                             // PWM
+    BOOT_BIT(CONFIG) | BOOT_BIT(ENCODER) | BOOT_BIT(LEDS) | BOOT_BIT(PWM),  // LOCAL
+    BOOT_BIT(CONFIG),                                             // CREDENTIALS
+    BOOT_BIT(CONFIG),                                             // NETWORK
+    BOOT_BIT(NETWORK) | BOOT_BIT(CREDENTIALS) | BOOT_BIT(DISPLAY),  // SERVICES
+  };
+}
+
+struct BootStageTiming {
+  uint32_t startUs;      // Dependencies met, stage began
+  uint32_t readyUs;      // Stage finished (0 = not yet)
+  bool ok;
+};
+
+const char* bootStageName(BootStage stage) {
+  switch (stage) {
+    case BootStage::CORE: return "core";
+    case BootStage::CONFIG: return "config";
+    case BootStage::ENCODER: return "encoder";
+    case BootStage::DISPLAY: return "display";
+    case BootStage::LEDS: return "leds";
+    case BootStage::PWM: return "pwm";
+    case BootStage::LOCAL: return "local";
+    case BootStage::CREDENTIALS: return "credentials";
+    case BootStage::NETWORK: return "network";
+    case BootStage::SERVICES: return "services";
+    default: return "unknown";
+  }
+}
+
+class BootSequencer {
+public:
+  typedef bool (*StageFn)();
+
+  /**
+   * Create the event group; call first in setup()
+   */
+  bool begin() {
+    _events = xEventGroupCreate();
+    return _events != nullptr;
+  }
+
+  /**
+   * Run a stage on the calling task once its dependencies are ready
+   */
+  bool run(BootStage stage, StageFn init) {
+    start(stage);
+    bool ok = init();
+    ready(stage, ok);
+    return ok;
+  }
+
+  /**
+   * Run a stage in its own task; returns at once
+   */
+  bool spawn(BootStage stage, StageFn init) {
+    Job& job = _jobs[(uint8_t)stage];
+    job.owner = this;
+    job.stage = stage;
+    job.init = init;
+    BaseType_t result = xTaskCreatePinnedToCore(jobEntry, bootStageName(stage), BootConfig::TASK_STACK, &job,
+                                                BootConfig::TASK_PRIORITY, nullptr, BootConfig::TASK_CORE);
+    if (result != pdPASS) {
+      LOG_ERROR("Boot: task for stage %s failed, running inline", bootStageName(stage));
+      return run(stage, init);
+    }
+    return true;
+  }
+
+  /**
+   * Wait for the stage's dependencies and start its clock
+   * For stages carried out step by step inside a long-lived task.
+   */
+  void start(BootStage stage) {
+    uint32_t deps = BootConfig::DEPENDS[(uint8_t)stage];
+    if (deps != 0 && !waitFor(deps, BootConfig::DEPENDENCY_TIMEOUT_MS)) {
+      LOG_WARN("Boot: %s starting without all dependencies (have 0x%03x, need 0x%03x)",
+               bootStageName(stage), readyMask(), deps);
+    }
+    _timing[(uint8_t)stage].startUs = nowUs();
+  }
+
+  void ready(BootStage stage, bool ok = true) {
+    BootStageTiming& timing = _timing[(uint8_t)stage];
+    timing.readyUs = nowUs();
+    timing.ok = ok;
+    xEventGroupSetBits(_events, bit(stage));
+
+    uint32_t tookUs = timing.readyUs - timing.startUs;
+    if (ok) {
+      LOG_INFO("Boot: %s ready at %lu ms (%lu us)", bootStageName(stage),
+               (unsigned long)(timing.readyUs / 1000), (unsigned long)tookUs);
+    } else {
+      LOG_WARN("Boot: %s failed at %lu ms (%lu us)", bootStageName(stage),
+               (unsigned long)(timing.readyUs / 1000), (unsigned long)tookUs);
+    }
+  }
+
+  /**
+   * Block until every stage in mask is ready
+   * @return false on timeout
+   */
+  bool waitFor(uint32_t mask, uint32_t timeoutMs) {
+    EventBits_t bits = xEventGroupWaitBits(_events, mask, pdFALSE, pdTRUE, pdMS_TO_TICKS(timeoutMs));
+    return (bits & mask) == mask;
+  }
+
+  uint32_t readyMask() const { return _events != nullptr ? xEventGroupGetBits(_events) : 0; }
+  bool isReady(BootStage stage) const { return (readyMask() & bit(stage)) != 0; }
+  bool ok(BootStage stage) const { return isReady(stage) && _timing[(uint8_t)stage].ok; }
+  const BootStageTiming& timing(BootStage stage) const { return _timing[(uint8_t)stage]; }
+
+  static uint32_t bit(BootStage stage) { return 1u << (uint8_t)stage; }
+
+private:
+  struct Job {
+    BootSequencer* owner;
+    BootStage stage;
+    StageFn init;
+  };
+
+  static void jobEntry(void* param) {
+    Job* job = static_cast<Job*>(param);
+    job->owner->run(job->stage, job->init);
+    vTaskDelete(nullptr);
+  }
+
+  static uint32_t nowUs() { return (uint32_t)esp_timer_get_time(); }
+
+  EventGroupHandle_t _events = nullptr;
+  BootStageTiming _timing[(uint8_t)BootStage::COUNT] = {};
+  Job _jobs[(uint8_t)BootStage::COUNT] = {};
+};
+
+BootSequencer bootStages;
+
+#endif
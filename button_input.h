@@ -0,0 +1,186 @@
+/*
+ * ESP32 Multitool - Button Input
+ * Interrupt-driven encoder push button with debounce and gestures
+ *
+ * The first edge away from the stable level is taken as the transition: it
+ * triggers a one-shot esp_timer that accepts it straight away, then keeps
+ * the window closed for DEBOUNCE_MS while the contact bounces. When the
+ * window ends the pin is read again; if it has already gone back (a tap
+ * shorter than the window) the return transition is taken the same way,
+ * so brief presses are never lost. A second timer started on press reports
+ * a long press while the button is held.
+ *
+ * Events are queued for loop() and wake it through systemEvents:
+ *   PRESS         press, on its first edge (for instant actions)
+ *   RELEASE       debounced release, with the hold time; under
+ *                 LONG_PRESS_MS this is a short click
+ *   LONG_PRESS    held for LONG_PRESS_MS (before release)
+ *
+ * The state machine runs in the esp_timer task, never in the ISR, so a
+ * bouncing contact costs one interrupt per edge and nothing else.
+ */
+
+#ifndef BUTTON_INPUT_H
+#define BUTTON_INPUT_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <atomic>
+#include "logger.h"
+#include "power_manager.h"
+#include "system_events.h"
+
+namespace ButtonConfig {
+  const uint32_t DEBOUNCE_MS = 20;        // Contact settle time after an accepted edge
+  const uint32_t LONG_PRESS_MS = 600;
+  const uint8_t QUEUE_LEN = 8;
+}
+
+enum class ButtonEventType : uint8_t {
+  NONE,
+  PRESS,
+  RELEASE,
+  LONG_PRESS
+};
+
+struct ButtonEvent {
+  ButtonEventType type;
+  uint32_t heldMs;   // RELEASE / LONG_PRESS: time since the press
+};
+
+struct ButtonStats {
+  uint32_t presses;
+  uint32_t longPresses;
+  uint32_t bounces;   // Edges ignored inside a debounce window
+  uint32_t dropped;   // Events lost to a full queue
+};
+
+class ButtonInput {
+public:
+  /**
+   * Configure the pin (active low, internal pull-up) and start listening
+   * @return false if the queue or timers could not be created
+   */
+  bool begin(uint8_t pin) {
+    _pin = pin;
+    pinMode(_pin, INPUT_PULLUP);
+    _down = digitalRead(_pin) == LOW;
+
+    _queue = xQueueCreate(ButtonConfig::QUEUE_LEN, sizeof(ButtonEvent));
+    const esp_timer_create_args_t debounceArgs = {
+      .callback = debounceCallback,
+      .arg = this,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "btn_debounce",
+      .skip_unhandled_events = true
+    };
+    const esp_timer_create_args_t longArgs = {
+      .callback = longPressCallback,
+      .arg = this,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "btn_long",
+      .skip_unhandled_events = true
+    };
+    if (_queue == nullptr || esp_timer_create(&debounceArgs, &_debounceTimer) != ESP_OK ||
+        esp_timer_create(&longArgs, &_longTimer) != ESP_OK) {
+      LOG_ERROR("Button: failed to create queue/timers");
+      return false;
+    }
+
+    attachInterruptArg(digitalPinToInterrupt(_pin), edgeISR, this, CHANGE);
+    return true;
+  }
+
+  /**
+   * Take the next queued event (non-blocking)
+   */
+  bool next(ButtonEvent& event) {
+    return _queue != nullptr && xQueueReceive(_queue, &event, 0) == pdTRUE;
+  }
+
+  bool pending() const { return _queue != nullptr && uxQueueMessagesWaiting(_queue) > 0; }
+  bool isDown() const { return _down; }
+  const ButtonStats& stats() const { return _stats; }
+
+private:
+  static void IRAM_ATTR edgeISR(void* arg) {
+    ButtonInput* self = (ButtonInput*)arg;
+    powerManager.wakeEdgeFromISR();   // The pin is also a light-sleep wake source
+    if (self->_armed.exchange(true)) {
+      self->_stats.bounces++;
+      return;
+    }
+    self->arm();
+  }
+
+  static void debounceCallback(void* arg) {
+    ButtonInput* self = (ButtonInput*)arg;
+    if (!self->_settling) {
+      // Any edge away from the stable level is the transition; ignore the bounce after it
+      self->transition(!self->_down);
+      self->_settling = true;
+      esp_timer_start_once(self->_debounceTimer, ButtonConfig::DEBOUNCE_MS * 1000);
+      return;
+    }
+
+    // Window over; clear before reading so an edge after the read opens a new one
+    self->_settling = false;
+    self->_armed = false;
+    if ((digitalRead(self->_pin) == LOW) != self->_down && !self->_armed.exchange(true)) {
+      self->arm();
+    }
+  }
+
+  void IRAM_ATTR arm() {
+    _edgeUs = (uint32_t)esp_timer_get_time();
+    esp_timer_start_once(_debounceTimer, 0);
+  }
+
+  static void longPressCallback(void* arg) {
+    ButtonInput* self = (ButtonInput*)arg;
+    if (!self->_down) return;
+    self->_stats.longPresses++;
+    self->push(ButtonEventType::LONG_PRESS, ButtonConfig::LONG_PRESS_MS, false);
+  }
+
+  void transition(bool down) {
+    _down = down;
+    uint32_t now = millis();
+
+    if (down) {
+      _pressMs = now;
+      _stats.presses++;
+      push(ButtonEventType::PRESS, 0, true);
+      esp_timer_start_once(_longTimer, ButtonConfig::LONG_PRESS_MS * 1000);
+      return;
+    }
+
+    esp_timer_stop(_longTimer);
+    push(ButtonEventType::RELEASE, now - _pressMs, true);
+  }
+
+  void push(ButtonEventType type, uint32_t heldMs, bool fromEdge) {
+    ButtonEvent event = {type, heldMs};
+    if (xQueueSend(_queue, &event, 0) != pdTRUE) {
+      _stats.dropped++;
+      return;
+    }
+    if (fromEdge) systemEvents.signalInput(_edgeUs);
+    else systemEvents.signal(EventTask::LOOP, EVENT_INPUT);
+  }
+
+  uint8_t _pin = 0;
+  QueueHandle_t _queue = nullptr;
+  esp_timer_handle_t _debounceTimer = nullptr;
+  esp_timer_handle_t _longTimer = nullptr;
+  std::atomic<bool> _armed{false};     // Debounce window open
+  bool _settling = false;              // Transition taken, waiting out the bounce
+  volatile uint32_t _edgeUs = 0;
+  volatile bool _down = false;        // Debounced level
+  uint32_t _pressMs = 0;
+  ButtonStats _stats = {};
+};
+
+ButtonInput buttonInput;
+
+#endif
@@ -0,0 +1,253 @@
+/*
+ * ESP32 Multitool - Configuration Store
+ * One schema-versioned settings image, cached in RAM, committed with debounce
+ *
+ * All persistent settings live in a single DeviceConfig struct. It is read
+ * from NVS once at boot; after that reads are plain memory accesses.
+ * Changes mark the image dirty, and tick() writes it back as one NVS blob
+ * (namespace "config", key "image") once edits have been quiet for
+ * COMMIT_DELAY_MS, or MAX_DELAY_MS after the first change at the latest.
+ * A burst of slider or settings changes therefore costs one flash write.
+ *
+ * Image = header (magic, schema version, payload size, CRC-32) + payload.
+ * Schema rules: append new fields at the end and bump SCHEMA_VERSION. An
+ * older image loads its prefix and keeps the defaults for the new fields;
+ * an image from newer firmware (after an OTA rollback) loads the fields
+ * this build knows. Version 0 is the per-key layout of older firmware
+ * ("mqtt", "leds", "otapull" namespaces and auth/user), imported once and
+ * then erased.
+ *
+ * The store is filled in setup() and afterwards only touched from the WiFi
+ * task (web handlers and its loop), so no locking is needed. Subsystems
+ * that run elsewhere get copies (LED engine, pull updater).
+ */
+
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <esp_rom_crc.h>
+
+// Forward declarations from main sketch
+extern Preferences preferences;
+
+namespace ConfigStoreConfig {
+  const char NAMESPACE[] = "config";
+  const char KEY[] = "image";
+  const uint32_t MAGIC = 0x4643544D;      // "MTCF"
+  const uint16_t SCHEMA_VERSION = 2;
+  const uint32_t COMMIT_DELAY_MS = 2000;  // Quiet time before writing
+  const uint32_t MAX_DELAY_MS = 10000;    // Upper bound while edits keep coming
+}
+
+/**
+ * Schema v2 - append only (see above)
+ */
+struct DeviceConfig {
+  char username[32];
+  char hostname[32];          // mDNS / ArduinoOTA name (applied at boot)
+  uint32_t pwmFrequency;      // 12V dimmer LEDC frequency (applied at boot)
+  MqttConfig mqtt;
+  LedStripConfig leds;
+  OtaPullSettings otaPull;
+  SleepTelemetrySettings sleep;   // v2
+};
+
+struct ConfigImageHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size;              // Payload bytes
+  uint32_t crc;               // CRC-32 of the payload
+};
+
+struct ConfigStoreStats {
+  uint16_t loadedVersion;     // Schema of the image found at boot (0 = legacy keys)
+  uint32_t commits;
+  uint32_t coalesced;         // Changes folded into a commit already pending
+  uint32_t lastCommitUs;
+  uint32_t failures;
+};
+
+class ConfigStore {
+public:
+  /**
+   * Load the image over the defaults, migrating older layouts
+   */
+  void begin(const DeviceConfig& defaults) {
+    _config = defaults;
+    if (load()) return;
+
+    // No usable image: import per-key settings from older firmware
+    _stats.loadedVersion = 0;
+    importLegacy();
+    if (commit()) {
+      clearLegacy();
+      LOG_INFO("Config: created schema v%u image (legacy keys imported where present)",
+               ConfigStoreConfig::SCHEMA_VERSION);
+    }
+  }
+
+  /**
+   * The live settings; call markDirty() after changing them
+   */
+  DeviceConfig& data() { return _config; }
+
+  void markDirty() {
+    uint32_t now = millis();
+    if (_dirty) {
+      _stats.coalesced++;
+    } else {
+      _dirty = true;
+      _firstChangeMs = now;
+    }
+    _lastChangeMs = now;
+  }
+
+  /**
+   * Commit once changes have settled; call from the WiFi task loop
+   */
+  void tick() {
+    if (!_dirty) return;
+    uint32_t now = millis();
+    if (now - _lastChangeMs >= ConfigStoreConfig::COMMIT_DELAY_MS ||
+        now - _firstChangeMs >= ConfigStoreConfig::MAX_DELAY_MS) {
+      commit();
+    }
+  }
+
+  /**
+   * Commit now if anything is pending (before a restart)
+   */
+  void flush() {
+    if (_dirty) commit();
+  }
+
+  bool pending() const { return _dirty; }
+  const ConfigStoreStats& stats() const { return _stats; }
+
+private:
+  bool load() {
+    preferences.begin(ConfigStoreConfig::NAMESPACE, true);  // Read-only
+    size_t len = preferences.getBytesLength(ConfigStoreConfig::KEY);
+    uint8_t* image = len > sizeof(ConfigImageHeader) ? (uint8_t*)malloc(len) : nullptr;
+    bool read = image != nullptr && preferences.getBytes(ConfigStoreConfig::KEY, image, len) == len;
+    preferences.end();
+    if (!read) {
+      free(image);
+      return false;
+    }
+
+    ConfigImageHeader header;
+    memcpy(&header, image, sizeof(header));
+    const uint8_t* payload = image + sizeof(header);
+    bool valid = header.magic == ConfigStoreConfig::MAGIC &&
+                 header.size == len - sizeof(header) &&
+                 header.crc == esp_rom_crc32_le(0, payload, header.size);
+    if (!valid) {
+      free(image);
+      _stats.failures++;
+      LOG_ERROR("Config: stored image is corrupt, using defaults");
+      return false;
+    }
+
+    // Shared prefix; fields beyond it keep their defaults
+    memcpy(&_config, payload, header.size < sizeof(_config) ? header.size : sizeof(_config));
+    free(image);
+    _stats.loadedVersion = header.version;
+
+    if (header.version < ConfigStoreConfig::SCHEMA_VERSION) {
+      LOG_INFO("Config: upgrading schema v%u -> v%u", header.version, ConfigStoreConfig::SCHEMA_VERSION);
+      commit();
+    } else if (header.version > ConfigStoreConfig::SCHEMA_VERSION) {
+      LOG_WARN("Config: image is schema v%u (newer firmware); fields past v%u are ignored",
+               header.version, ConfigStoreConfig::SCHEMA_VERSION);
+    }
+    return true;
+  }
+
+  bool commit() {
+    uint8_t image[sizeof(ConfigImageHeader) + sizeof(DeviceConfig)];
+    ConfigImageHeader header = {};
+    header.magic = ConfigStoreConfig::MAGIC;
+    header.version = ConfigStoreConfig::SCHEMA_VERSION;
+    header.size = sizeof(DeviceConfig);
+    header.crc = esp_rom_crc32_le(0, (const uint8_t*)&_config, sizeof(_config));
+    memcpy(image, &header, sizeof(header));
+    memcpy(image + sizeof(header), &_config, sizeof(_config));
+
+    uint32_t startUs = micros();
+    preferences.begin(ConfigStoreConfig::NAMESPACE, false);  // Read-write
+    bool ok = preferences.putBytes(ConfigStoreConfig::KEY, image, sizeof(image)) == sizeof(image);
+    preferences.end();
+    _stats.lastCommitUs = micros() - startUs;
+
+    _dirty = false;
+    if (!ok) {
+      _stats.failures++;
+      LOG_ERROR("Config: NVS write failed");
+      return false;
+    }
+    _stats.commits++;
+    return true;
+  }
+
+  /**
+   * Schema v0: one NVS key per setting, spread over several namespaces
+   * Keys that are missing keep the defaults.
+   */
+  void importLegacy() {
+    preferences.begin("auth", true);
+    preferences.getString("user", _config.username, sizeof(_config.username));
+    preferences.end();
+
+    preferences.begin("mqtt", true);
+    preferences.getString("server", _config.mqtt.server, sizeof(_config.mqtt.server));
+    _config.mqtt.port = (uint16_t)preferences.getUInt("port", _config.mqtt.port);
+    preferences.getString("client", _config.mqtt.clientId, sizeof(_config.mqtt.clientId));
+    preferences.getString("user", _config.mqtt.user, sizeof(_config.mqtt.user));
+    preferences.getString("pass", _config.mqtt.pass, sizeof(_config.mqtt.pass));
+    preferences.end();
+
+    preferences.begin("leds", true);
+    if (preferences.isKey("outputs")) {
+      _config.leds.outputs = preferences.getUChar("outputs", 0);
+      for (uint8_t i = 0; i < LED_MAX_OUTPUTS; i++) {
+        char key[8];
+        snprintf(key, sizeof(key), "pin%u", i);
+        _config.leds.output[i].pin = preferences.getUChar(key, 0);
+        snprintf(key, sizeof(key), "count%u", i);
+        _config.leds.output[i].count = preferences.getUShort(key, 0);
+      }
+    }
+    preferences.end();
+
+    preferences.begin("otapull", true);
+    _config.otaPull.enabled = preferences.getBool("enabled", _config.otaPull.enabled);
+    _config.otaPull.intervalMin = preferences.getUShort("interval", _config.otaPull.intervalMin);
+    preferences.getString("url", _config.otaPull.manifestUrl, sizeof(_config.otaPull.manifestUrl));
+    preferences.end();
+  }
+
+  void clearLegacy() {
+    static const char* namespaces[] = { "mqtt", "leds", "otapull" };
+    for (const char* ns : namespaces) {
+      preferences.begin(ns, false);
+      preferences.clear();
+      preferences.end();
+    }
+    preferences.begin("auth", false);  // Password hashes stay
+    preferences.remove("user");
+    preferences.end();
+  }
+
+  DeviceConfig _config = {};
+  bool _dirty = false;
+  uint32_t _firstChangeMs = 0;
+  uint32_t _lastChangeMs = 0;
+  ConfigStoreStats _stats = {};
+};
+
+ConfigStore configStore;
+
+#endif
@@ -0,0 +1,195 @@
+/*
+ * ESP32 Multitool - Credential Storage
+ * Salted PBKDF2-HMAC-SHA256 password hashes in NVS
+ *
+ * The web password is never stored: NVS ("auth" namespace) holds a record
+ * with the iteration count, a random salt and the derived key. A password is
+ * checked by re-deriving and comparing in constant time. The KDF is slow on
+ * purpose, so it only runs on a login or a Basic request whose header is not
+ * in web_auth.h's verifier cache - not on every request.
+ *
+ * Work factor: AUTH_KDF_ITERATIONS (default 10000; test/bench_kdf compares
+ * candidates on the host, kdf_last_ms in /api/system is the cost on the
+ * device). Each record keeps its own count; a record made with a different
+ * count is re-hashed at the next successful login.
+ *
+ * ArduinoOTA's challenge protocol is keyed with MD5(password), so the OTA
+ * password is kept as that digest (setPasswordHash) rather than plaintext.
+ *
+ * Plaintext "pass"/"otapass" entries from older firmware are migrated and
+ * removed on first boot.
+ */
+
+#ifndef CREDENTIALS_H
+#define CREDENTIALS_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <MD5Builder.h>
+#include <esp_random.h>
+#include <mbedtls/pkcs5.h>
+
+// Forward declarations from main sketch
+extern Preferences preferences;
+extern const char OTA_PASSWORD[];
+
+#ifndef AUTH_KDF_ITERATIONS
+#define AUTH_KDF_ITERATIONS 10000
+#endif
+
+namespace CredentialConfig {
+  const uint32_t KDF_ITERATIONS = AUTH_KDF_ITERATIONS;
+  const uint32_t MIN_ITERATIONS = 1000;
+  const uint8_t RECORD_VERSION = 1;
+  const uint8_t SALT_BYTES = 16;
+  const uint8_t HASH_BYTES = 32;
+  const char DEFAULT_WEB_PASSWORD[] = "changeme";
+  const uint8_t MIN_PASSWORD_LEN = 8;
+  const uint8_t MAX_PASSWORD_LEN = 63;
+}
+
+struct PasswordRecord {
+  uint8_t version;
+  uint8_t isDefault;      // Still the factory password
+  uint16_t reserved;
+  uint32_t iterations;
+  uint8_t salt[CredentialConfig::SALT_BYTES];
+  uint8_t hash[CredentialConfig::HASH_BYTES];
+};
+
+struct CredentialStats {
+  uint32_t kdfRuns;
+  uint32_t lastKdfMs;
+  uint32_t failures;
+};
+
+class CredentialStore {
+public:
+  /**
+   * Load the records, migrating plaintext entries from older firmware
+   */
+  void begin() {
+    preferences.begin("auth", false);
+    bool loaded = preferences.getBytesLength("webhash") == sizeof(_web) &&
+                  preferences.getBytes("webhash", &_web, sizeof(_web)) == sizeof(_web) &&
+                  _web.version == CredentialConfig::RECORD_VERSION;
+    if (!loaded) {
+      char legacy[CredentialConfig::MAX_PASSWORD_LEN + 1] = "";
+      preferences.getString("pass", legacy, sizeof(legacy));
+      bool migrate = legacy[0] != '\0';
+      derive(migrate ? legacy : CredentialConfig::DEFAULT_WEB_PASSWORD, CredentialConfig::KDF_ITERATIONS, _web);
+      _web.isDefault = !migrate;
+      preferences.putBytes("webhash", &_web, sizeof(_web));
+      if (migrate) {
+        preferences.remove("pass");
+        LOG_INFO("Auth: web password migrated to PBKDF2 (%lu ms)", (unsigned long)_stats.lastKdfMs);
+      }
+      memset(legacy, 0, sizeof(legacy));
+    }
+
+    _otaHash[0] = '\0';
+    preferences.getString("otamd5", _otaHash, sizeof(_otaHash));
+    if (strlen(_otaHash) != 32) {
+      char legacy[CredentialConfig::MAX_PASSWORD_LEN + 1] = "";
+      preferences.getString("otapass", legacy, sizeof(legacy));
+      if (legacy[0] != '\0') {
+        md5Hex(legacy, _otaHash);
+        preferences.putString("otamd5", _otaHash);
+        preferences.remove("otapass");
+        LOG_INFO("Auth: OTA password migrated to a digest");
+      } else {
+        md5Hex(OTA_PASSWORD, _otaHash);
+      }
+      memset(legacy, 0, sizeof(legacy));
+    }
+    preferences.end();
+
+    if (_web.isDefault) {
+      LOG_WARN("Using default password '%s' - please change it!", CredentialConfig::DEFAULT_WEB_PASSWORD);
+    }
+  }
+
+  /**
+   * Check the web password (runs the KDF)
+   */
+  bool checkPassword(const char* password) {
+    PasswordRecord candidate = _web;
+    derive(password, _web.iterations, candidate, false);
+    uint8_t diff = 0;
+    for (uint8_t i = 0; i < CredentialConfig::HASH_BYTES; i++) diff |= candidate.hash[i] ^ _web.hash[i];
+    memset(&candidate, 0, sizeof(candidate));
+    if (diff != 0) {
+      _stats.failures++;
+      return false;
+    }
+
+    // Work factor changed since this record was made: re-hash while we have the password
+    if (_web.iterations != CredentialConfig::KDF_ITERATIONS) {
+      uint8_t wasDefault = _web.isDefault;
+      derive(password, CredentialConfig::KDF_ITERATIONS, _web);
+      _web.isDefault = wasDefault;
+      save();
+    }
+    return true;
+  }
+
+  /**
+   * Replace both passwords
+   */
+  void setPasswords(const char* webPassword, const char* otaPassword) {
+    derive(webPassword, CredentialConfig::KDF_ITERATIONS, _web);
+    _web.isDefault = false;
+    md5Hex(otaPassword, _otaHash);
+    save();
+  }
+
+  const char* otaPasswordHash() const { return _otaHash; }
+  bool usingDefault() const { return _web.isDefault; }
+  uint32_t iterations() const { return _web.iterations; }
+  const CredentialStats& stats() const { return _stats; }
+
+private:
+  /**
+   * PBKDF2-HMAC-SHA256 into record.hash
+   * @param newSalt draw a fresh salt (false to reuse the record's, for checking)
+   */
+  void derive(const char* password, uint32_t iterations, PasswordRecord& record, bool newSalt = true) {
+    if (iterations < CredentialConfig::MIN_ITERATIONS) iterations = CredentialConfig::MIN_ITERATIONS;
+    if (newSalt) {
+      record = {};
+      record.version = CredentialConfig::RECORD_VERSION;
+      esp_fill_random(record.salt, sizeof(record.salt));
+    }
+    record.iterations = iterations;
+
+    uint32_t startMs = millis();
+    mbedtls_pkcs5_pbkdf2_hmac_ext(MBEDTLS_MD_SHA256, (const unsigned char*)password, strlen(password),
+                                  record.salt, sizeof(record.salt), iterations,
+                                  sizeof(record.hash), record.hash);
+    _stats.lastKdfMs = millis() - startMs;
+    _stats.kdfRuns++;
+  }
+
+  void save() {
+    preferences.begin("auth", false);
+    preferences.putBytes("webhash", &_web, sizeof(_web));
+    preferences.putString("otamd5", _otaHash);
+    preferences.end();
+  }
+
+  static void md5Hex(const char* text, char* out) {
+    MD5Builder md5;
+    md5.begin();
+    md5.add(text);
+    md5.calculate();
+    md5.getChars(out);
+  }
+
+  PasswordRecord _web = {};
+  char _otaHash[33];
+  CredentialStats _stats = {};
+};
+
+CredentialStore credentials;
+
+#endif
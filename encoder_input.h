@@ -0,0 +1,115 @@
+/*
+ * ESP32 Multitool - Encoder Input
+ * Detent deltas with velocity-based acceleration
+ *
+ * The PCNT unit keeps counting on its own; once per loop() pass the new
+ * counts are turned into whole detents and scaled by how fast the knob is
+ * turning. Each app owns its value and applies the delta with stepClamped()
+ * or stepWrapped(), so nothing rewrites the hardware count to keep it in
+ * range or to line it up with the screen being entered.
+ *
+ * Acceleration is set per app with an EncoderProfile: at slowMs per detent
+ * or slower each detent is one step, at fastMs or faster it is maxStep
+ * steps, linear in between. The interval is smoothed over a few detents and
+ * starts again from slow after a pause or a change of direction, so a
+ * single fine adjustment after a fast sweep is never multiplied.
+ */
+
+#ifndef ENCODER_INPUT_H
+#define ENCODER_INPUT_H
+
+#include <Arduino.h>
+#include <ESP32Encoder.h>
+
+namespace EncoderConfig {
+  const int32_t COUNTS_PER_DETENT = 2;    // Half-quadrature mode
+  const uint32_t PAUSE_MS = 200;          // Gap that restarts acceleration
+}
+
+struct EncoderProfile {
+  uint16_t slowMs;   // Per-detent interval at or above which steps are 1:1
+  uint16_t fastMs;   // Interval at or below which maxStep applies
+  uint8_t maxStep;   // 1 = no acceleration
+};
+
+const EncoderProfile ENCODER_LINEAR = {0, 0, 1};
+
+class EncoderInput {
+public:
+  void begin(ESP32Encoder* encoder) {
+    _encoder = encoder;
+    _lastCount = encoder->getCount();
+  }
+
+  /**
+   * Read the counter and return this pass's accelerated delta
+   */
+  int32_t poll(const EncoderProfile& profile) {
+    if (_encoder == nullptr) return 0;
+    return update(_encoder->getCount(), millis(), profile);
+  }
+
+  /**
+   * Convert a new count into a delta (separate from poll() for host tests)
+   */
+  int32_t update(int64_t count, uint32_t nowMs, const EncoderProfile& profile) {
+    _partial += (int32_t)(count - _lastCount);
+    _lastCount = count;
+    int32_t detents = _partial / EncoderConfig::COUNTS_PER_DETENT;
+    _partial -= detents * EncoderConfig::COUNTS_PER_DETENT;
+    if (detents == 0) return 0;
+
+    int8_t direction = detents > 0 ? 1 : -1;
+    uint32_t steps = (uint32_t)abs(detents);
+    uint32_t intervalMs = (nowMs - _lastDetentMs) / steps;
+    if (direction != _direction || nowMs - _lastDetentMs >= EncoderConfig::PAUSE_MS) {
+      _intervalMs = profile.slowMs;   // Fresh start: first detents are 1:1
+    } else {
+      _intervalMs = (_intervalMs * 3 + intervalMs) / 4;
+    }
+    _direction = direction;
+    _lastDetentMs = nowMs;
+
+    _multiplier = 1;
+    if (profile.maxStep > 1 && _intervalMs < profile.slowMs) {
+      if (_intervalMs <= profile.fastMs) {
+        _multiplier = profile.maxStep;
+      } else {
+        _multiplier = 1 + (profile.maxStep - 1) * (profile.slowMs - _intervalMs) /
+                              (profile.slowMs - profile.fastMs);
+      }
+    }
+    return detents * (int32_t)_multiplier;
+  }
+
+  /** Step multiplier applied to the last detents */
+  uint8_t multiplier() const { return _multiplier; }
+
+private:
+  ESP32Encoder* _encoder = nullptr;
+  int64_t _lastCount = 0;
+  int32_t _partial = 0;          // Counts short of a whole detent
+  uint32_t _lastDetentMs = 0;
+  uint32_t _intervalMs = 0;      // Smoothed ms per detent
+  int8_t _direction = 0;
+  uint8_t _multiplier = 1;
+};
+
+/**
+ * Apply a delta to a value, stopping at the ends of [lo, hi]
+ */
+int32_t stepClamped(int32_t value, int32_t delta, int32_t lo, int32_t hi) {
+  return constrain(value + delta, lo, hi);
+}
+
+/**
+ * Apply a delta to an index in [0, count), wrapping around
+ */
+int32_t stepWrapped(int32_t value, int32_t delta, int32_t count) {
+  int32_t next = (value + delta) % count;
+  return next < 0 ? next + count : next;
+}
+
+EncoderInput encoderInput;
+
+#endif
@@ -17,7 +17,7 @@
  * - Various optional peripherals (Relay, Servo, etc.)
  *
  * License: MIT (see LICENSE file)
- * Version: 2.5.0 (Fully Featured)
+ * Version: see FIRMWARE_VERSION
  */
 
 #include <Arduino.h>
@@ -26,10 +26,9 @@
 #include <Adafruit_SSD1306.h>
 #include <ESP32Encoder.h>
 #include <ESP32Servo.h>
-#include <Adafruit_NeoPixel.h>
 #include <WiFi.h>
 #include <WebServer.h>
-#include <WiFiManager.h>
+#include <DNSServer.h>
 #include <Preferences.h>
 #include <esp_task_wdt.h>
 #include <ESPmDNS.h>
@@ -37,11 +36,29 @@
 #include <esp_adc_cal.h>
 #include <driver/ledc.h>
 #include <driver/dac.h>
+#include <esp_timer.h>
 #include <PubSubClient.h>
 #include <ArduinoJson.h>
 
+#include "logger.h"
+#include "mqtt_manager.h"
+#include "mqtt_router.h"
+#include "ota_update.h"
+#include "boot_stages.h"
+#include "wifi_connection.h"
+#include "power_manager.h"
+#include "system_events.h"
+#include "button_input.h"
+#include "encoder_input.h"
+
 // --- CONFIGURATION CONSTANTS ---
 
+// Firmware version, compared against the pull-update manifest.
+// Release builds can set it from the build: -D FIRMWARE_VERSION=\"2.6.0\"
+#ifndef FIRMWARE_VERSION
+#define FIRMWARE_VERSION "2.5.0"
+#endif
+
 // Display Configuration
 #define SCREEN_WIDTH 128
 #define SCREEN_HEIGHT 64
@@ -65,7 +82,11 @@ namespace Pins {
   const uint8_t STEP3 = 4;
   const uint8_t STEP4 = 5;
 
-  // I2S Pins (reserved for future use)
+  // Tone output (Tone app and remote tones): DAC2. DAC1 is GPIO25, the encoder
+  // button, which must stay an input (it is how the Tone app is left)
+  const uint8_t TONE_DAC = 26;
+
+  // I2S Pins (reserved for future use; BCLK shares GPIO26 with TONE_DAC)
   const uint8_t I2S_BCLK = 26;
   const uint8_t I2S_LRC = 27;
   const uint8_t I2S_DOUT = 14;
@@ -73,10 +94,8 @@ namespace Pins {
 
 // Timing Constants
 namespace Timing {
-  const uint16_t DEBOUNCE_MS = 250;
   const uint16_t DISPLAY_UPDATE_MS = 100;
   const uint16_t WIFI_CLIENT_CHECK_MS = 1000;
-  const uint16_t NEOPIXEL_ANIMATION_MS = 20;
   const uint16_t WATCHDOG_TIMEOUT_MS = 30000;
 }
 
@@ -105,36 +124,40 @@ const char MQTT_CLIENT_ID[] = "ESP32_Multitool";
 const char MQTT_TOPIC_STATE[] = "esp32/multitool/state";
 const char MQTT_TOPIC_RELAY[] = "esp32/multitool/relay";
 const char MQTT_TOPIC_SENSOR[] = "esp32/multitool/sensor";
+const char MQTT_TOPIC_LOG[] = "esp32/multitool/log";
+const char MQTT_TOPIC_COMMANDS[] = "esp32/multitool/+/set";  // See mqtt_router.h
 
 // NeoPixel Configuration
-#define LED_COUNT 36
-#define LED_BRIGHTNESS 50  // 20% brightness to prevent brownout (36 LEDs draw ~720mA at 50% white)
+#define LED_COUNT 36               // Default layout; runtime layout lives in NVS (/api/neopixel/config)
+#define LED_BRIGHTNESS 255         // Full scale; the power limiter keeps dense frames in budget
+#define LED_POWER_BUDGET_MA 700    // Strip supply budget to prevent brownout (36 LEDs at full white ~2.2A)
 
 // FreeRTOS Task Configuration
 namespace TaskConfig {
   const uint16_t WIFI_TASK_STACK = 8192;  // Increased from 4096 to prevent overflow
   const uint8_t WIFI_TASK_PRIORITY = 2;   // Above Arduino loop, below lwIP (18)
   const uint8_t WIFI_TASK_CORE = 0;       // Core 0 for networking
+  const uint8_t ACTUATOR_QUEUE_DEPTH = 8; // Remote commands waiting for the loop
 }
 
 // WiFi Configuration
 namespace WiFiConfig {
+  const char AP_PASSWORD[] = "configure";  // Setup AP (see wifi_connection.h)
   const uint8_t AP_CHANNEL = 6;
-  const uint8_t MAX_CLIENTS = 4;
-  const wifi_power_t TX_POWER = WIFI_POWER_19_5dBm;
+  const uint8_t MAX_CLIENTS = 4;   // TX power is set by power_manager.h
 }
 
 // --- GLOBAL OBJECTS ---
 
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, -1);
 ESP32Encoder encoder;
-Adafruit_NeoPixel strip(LED_COUNT, Pins::NEOPIXEL, NEO_GRB + NEO_KHZ800);
 Servo myServo;
 WebServer server(80);
-WiFiManager wifiManager;
 Preferences preferences;
-WiFiClient mqttWifiClient;
-PubSubClient mqttClient(mqttWifiClient);
+MqttTransport mqttTransport;
+PubSubClient mqttClient(mqttTransport);
+MqttConnectionManager mqttManager;
+const MqttWill mqttWill = { MQTT_TOPIC_STATE, "offline", true };
 
 // --- THREAD-SAFE SHARED STATE ---
 
@@ -144,6 +167,10 @@ SemaphoreHandle_t stateMutex = nullptr;
 // Mutex for I2C bus protection (display, sensors)
 SemaphoreHandle_t i2cMutex = nullptr;
 
+// Remote actuator commands: wifiTask -> loop, and applied commands back for acknowledgement
+QueueHandle_t actuatorQueue = nullptr;
+QueueHandle_t actuatorAckQueue = nullptr;
+
 // Shared state variables (protected by stateMutex)
 struct SharedState {
   bool relayState;
@@ -151,17 +178,19 @@ struct SharedState {
   int wifiClients;
   bool wifiActive;
   char ipAddress[16];
+  uint8_t pwmPercent;   // 12V dimmer level, 0-100
+  uint8_t servoAngle;   // 0-180 degrees
 
   SharedState() : relayState(false), sensorValue(0), wifiClients(0),
-                  wifiActive(false) {
+                  wifiActive(false), pwmPercent(0), servoAngle(90) {
     strcpy(ipAddress, "0.0.0.0");
   }
 } sharedState;
 
 // --- DISPLAY STATE (accessed only by Core 1) ---
 
-bool displayAvailable = false;
-unsigned long lastButtonPress = 0;
+// Set once by the DISPLAY boot stage (core 0); loop() skips drawing until then
+volatile bool displayAvailable = false;
 
 // --- APPLICATION STATE MACHINE ---
 
@@ -197,10 +226,155 @@ const char* menuItems[] = {
 
 // --- AUTHENTICATION ---
 
-// Load credentials from NVS or use defaults
-char www_username[32] = "admin";
-char www_password[64] = "";  // Empty = no auth initially
-char ota_password[64] = "";  // OTA password
+// Passwords are kept only as hashes; the username is in the config store
+#include "credentials.h"
+
+// LED effects engine (needs SharedState for the VU meter)
+#include "neopixel_effects.h"
+
+// --- LED STRIP CONFIGURATION ---
+
+struct ReservedPin {
+  uint8_t pin;
+  const char* error;
+};
+
+// Pins the rest of the firmware drives; an LED output there would fight it
+const ReservedPin LED_RESERVED_PINS[] = {
+  {Pins::RELAY, "pin is used by the relay"},
+  {Pins::SERVO, "pin is used by the servo"},
+  {Pins::PWM_MOSFET, "pin is used by the PWM output"},
+  {Pins::STEP1, "pin is used by the stepper"},
+  {Pins::STEP2, "pin is used by the stepper"},
+  {Pins::STEP3, "pin is used by the stepper"},
+  {Pins::STEP4, "pin is used by the stepper"},
+  {Pins::ROT_A, "pin is used by the encoder"},
+  {Pins::ROT_B, "pin is used by the encoder"},
+  {Pins::ROT_SW, "pin is used by the encoder button"},
+  {Pins::TONE_DAC, "pin is used by the tone DAC"},
+  {SDA, "pin is used by the display (I2C)"},
+  {SCL, "pin is used by the display (I2C)"},
+};
+
+/**
+ * Check a strip layout before it is saved or applied
+ * Used by the API handlers and again by loadConfig() on the stored image.
+ * @return nullptr if valid, otherwise a short reason
+ */
+const char* validateLedConfig(const LedStripConfig& config) {
+  if (config.outputs == 0 || config.outputs > LED_MAX_OUTPUTS) return "bad output count";
+  for (uint8_t i = 0; i < config.outputs; i++) {
+    uint8_t pin = config.output[i].pin;
+    if (pin >= 6 && pin <= 11) return "pin is wired to the SPI flash";
+    if (pin == 1 || pin == 3) return "pin is the serial console (UART0)";
+    if (!GPIO_IS_VALID_OUTPUT_GPIO(pin)) return "pin is not an output";
+    for (const ReservedPin& reserved : LED_RESERVED_PINS) {
+      if (pin == reserved.pin) return reserved.error;
+    }
+    for (uint8_t j = 0; j < i; j++) {
+      if (config.output[j].pin == config.output[i].pin) return "duplicate pin";
+    }
+  }
+  uint32_t total = ledStripPixels(config);
+  if (total == 0 || total > LedConfig::MAX_PIXELS) return "bad pixel count";
+  return nullptr;
+}
+
+// Pull OTA updater (needs FIRMWARE_VERSION)
+#include "ota_pull.h"
+
+// Deep-sleep duty cycling for remote sensor use (settings live in the config image)
+#include "sleep_telemetry.h"
+
+// --- CONFIGURATION STORE ---
+
+// One settings image in RAM (needs MqttConfig, LedStripConfig, OtaPullSettings, SleepTelemetrySettings)
+#include "config_store.h"
+
+// Subsystem views into the live configuration
+MqttConfig& mqttConfig = configStore.data().mqtt;
+LedStripConfig& ledStripConfig = configStore.data().leds;
+
+/**
+ * Factory settings from the compile-time constants
+ */
+DeviceConfig configDefaults() {
+  DeviceConfig config = {};
+  strncpy(config.username, "admin", sizeof(config.username) - 1);
+  strncpy(config.hostname, MDNS_HOSTNAME, sizeof(config.hostname) - 1);
+  config.pwmFrequency = PWM_FREQUENCY;
+  strncpy(config.mqtt.server, MQTT_SERVER, sizeof(config.mqtt.server) - 1);
+  config.mqtt.port = MQTT_PORT;
+  strncpy(config.mqtt.clientId, MQTT_CLIENT_ID, sizeof(config.mqtt.clientId) - 1);
+  config.leds.outputs = 1;
+  config.leds.output[0].pin = Pins::NEOPIXEL;
+  config.leds.output[0].count = LED_COUNT;
+  config.otaPull.intervalMin = OtaPullConfig::DEFAULT_INTERVAL_MIN;
+  config.sleep.intervalS = SleepConfig::DEFAULT_INTERVAL_S;
+  config.sleep.batch = SleepConfig::DEFAULT_BATCH;
+  config.sleep.idleMin = SleepConfig::DEFAULT_IDLE_MIN;
+  return config;
+}
+
+/**
+ * Load the configuration image and repair anything unusable
+ */
+void loadConfig() {
+  const DeviceConfig defaults = configDefaults();
+  configStore.begin(defaults);
+  DeviceConfig& config = configStore.data();
+
+  if (validateLedConfig(config.leds) != nullptr) config.leds = defaults.leds;
+  if (config.username[0] == '\0') strcpy(config.username, defaults.username);
+  if (config.hostname[0] == '\0') strcpy(config.hostname, defaults.hostname);
+  if (config.pwmFrequency == 0) config.pwmFrequency = defaults.pwmFrequency;
+  if (config.mqtt.server[0] == '\0') strcpy(config.mqtt.server, defaults.mqtt.server);
+  if (config.mqtt.clientId[0] == '\0') strcpy(config.mqtt.clientId, defaults.mqtt.clientId);
+  if (config.mqtt.port == 0) config.mqtt.port = defaults.mqtt.port;
+  if (config.sleep.intervalS == 0) config.sleep.intervalS = defaults.sleep.intervalS;
+  if (config.sleep.batch == 0 || config.sleep.batch > SleepConfig::MAX_SAMPLES) config.sleep.batch = defaults.sleep.batch;
+  if (config.sleep.idleMin == 0) config.sleep.idleMin = defaults.sleep.idleMin;
+
+  LOG_INFO("Config: schema v%u (stored v%u)", ConfigStoreConfig::SCHEMA_VERSION, configStore.stats().loadedVersion);
+  LOG_INFO("LED layout: %u pixels on %u outputs", ledStripPixels(config.leds), config.leds.outputs);
+  LOG_INFO("MQTT broker: %s:%u%s", config.mqtt.server, config.mqtt.port,
+           strlen(config.mqtt.user) > 0 ? " (authenticated)" : "");
+}
+
+/**
+ * Persist the LED layout (debounced with other config changes)
+ */
+void saveLedConfig() {
+  configStore.markDirty();
+}
+
+/**
+ * Apply ledStripConfig to the running engine (takes effect at the next frame)
+ */
+void applyLedConfig() {
+  ledEffects.reconfigure(ledStripConfig);
+}
+
+/**
+ * Persist MQTT broker settings (debounced with other config changes)
+ */
+void saveMqttConfig() {
+  configStore.markDirty();
+}
+
+/**
+ * Apply the current mqttConfig to the live client
+ * Drops the session; the manager reconnects and onMqttConnected() resubscribes.
+ * Must run on the WiFi task (web handlers do).
+ */
+void applyMqttConfig() {
+  mqttClient.setServer(mqttConfig.server, mqttConfig.port);
+  mqttManager.reconnect();
+  LOG_INFO("MQTT reconfigured: %s:%u", mqttConfig.server, mqttConfig.port);
+}
+
+// Session tokens for the web interface (needs the credentials above)
+#include "web_auth.h"
 
 // Web interface includes (must be after variable declarations)
 #include "web_interface_dashboard.h"
@@ -208,23 +382,9 @@ char ota_password[64] = "";  // OTA password
 #include "web_interface_ota.h"
 #include "web_api_handlers.h"
 
-void loadWebCredentials() {
-  preferences.begin("auth", true);  // Read-only
-  preferences.getString("user", www_username, sizeof(www_username));
-  preferences.getString("pass", www_password, sizeof(www_password));
-  preferences.getString("otapass", ota_password, sizeof(ota_password));
-  preferences.end();
-
-  // If no password set, use default for first setup
-  if (strlen(www_password) == 0) {
-    strcpy(www_password, "changeme");
-    Serial.println(F("WARNING: Using default password 'changeme' - please change it!"));
-  }
-
-  if (strlen(ota_password) == 0) {
-    strcpy(ota_password, OTA_PASSWORD);
-  }
-}
+// MQTT feature includes (need SharedState and the MQTT topic constants)
+#include "mqtt_telemetry.h"
+#include "mqtt_discovery.h"
 
 // --- HELPER FUNCTIONS ---
 
@@ -316,45 +476,311 @@ uint8_t generateSineSample(uint16_t frequency, unsigned long sampleIndex) {
   return (uint8_t)((sine + 1.0) * 127.5);
 }
 
+// 28BYJ-48 half-step sequence (8 steps per cycle)
+const uint8_t STEPPER_HALF_STEP_SEQ[8][4] = {
+  {1, 0, 0, 0},
+  {1, 1, 0, 0},
+  {0, 1, 0, 0},
+  {0, 1, 1, 0},
+  {0, 0, 1, 0},
+  {0, 0, 1, 1},
+  {0, 0, 0, 1},
+  {1, 0, 0, 1}
+};
+
+// Coil phase shared by the Stepper app and remote moves so neither skips a step
+int stepperPhase = 0;
+
+/**
+ * Advance the stepper one half-step in the given direction (+1 / -1)
+ */
+void stepperStep(int direction) {
+  stepperPhase = (stepperPhase + (direction > 0 ? 1 : 7)) % 8;
+  digitalWrite(Pins::STEP1, STEPPER_HALF_STEP_SEQ[stepperPhase][0]);
+  digitalWrite(Pins::STEP2, STEPPER_HALF_STEP_SEQ[stepperPhase][1]);
+  digitalWrite(Pins::STEP3, STEPPER_HALF_STEP_SEQ[stepperPhase][2]);
+  digitalWrite(Pins::STEP4, STEPPER_HALF_STEP_SEQ[stepperPhase][3]);
+}
+
+/**
+ * De-energise all stepper coils
+ */
+void stepperRelease() {
+  digitalWrite(Pins::STEP1, LOW);
+  digitalWrite(Pins::STEP2, LOW);
+  digitalWrite(Pins::STEP3, LOW);
+  digitalWrite(Pins::STEP4, LOW);
+}
+
 /**
  * MQTT callback for incoming messages
+ * Runs in wifiTask. The payload is parsed in place by the router; the
+ * typed command is queued for the loop, which owns the actuators.
  */
 void mqttCallback(char* topic, byte* payload, unsigned int length) {
-  // Convert payload to null-terminated string
-  char message[length + 1];
-  memcpy(message, payload, length);
-  message[length] = '\0';
-
-  Serial.print(F("MQTT received: "));
-  Serial.print(topic);
-  Serial.print(F(" -> "));
-  Serial.println(message);
-
-  // Handle relay control commands
-  if (strcmp(topic, MQTT_TOPIC_RELAY) == 0) {
-    if (xSemaphoreTake(stateMutex, pdMS_TO_TICKS(100))) {
-      if (strcmp(message, "ON") == 0 || strcmp(message, "1") == 0) {
-        sharedState.relayState = true;
-      } else if (strcmp(message, "OFF") == 0 || strcmp(message, "0") == 0) {
-        sharedState.relayState = false;
-      }
+  ActuatorCommand cmd;
+  RouteResult result = mqttRouteMessage(topic, payload, length, cmd);
+
+  if (result == RouteResult::NOT_A_COMMAND) {
+    LOG_RATELIMITED(LogLevel::Debug, 1000, "MQTT ignored %u byte message", length);
+    return;
+  }
+  if (result != RouteResult::OK) {
+    LOG_RATELIMITED(LogLevel::Warn, 1000, "MQTT command rejected: %s", routeResultName(result));
+    return;
+  }
+
+  powerManager.noteActivity();
+  if (xQueueSend(actuatorQueue, &cmd, 0) != pdTRUE) {
+    LOG_RATELIMITED(LogLevel::Warn, 1000, "MQTT command dropped: %s queue full",
+                    ACTUATOR_NAMES[(uint8_t)cmd.device]);
+    return;
+  }
+  systemEvents.signal(EventTask::LOOP, EVENT_COMMAND);
+}
+
+/**
+ * Called by the MQTT manager once the broker has accepted the session
+ * Commands are subscribed at QoS 1, so the broker redelivers until PubSubClient
+ * has PUBACKed them.
+ */
+void onMqttConnected() {
+  mqttClient.subscribe(MQTT_TOPIC_COMMANDS, 1);
+  mqttClient.subscribe(MQTT_TOPIC_RELAY, 1);  // Legacy relay topic
+  mqttClient.publish(MQTT_TOPIC_STATE, "online", true);  // Retained message
+  discoveryPublishAll(mqttClient);  // Home Assistant entities, retained
+  telemetryResetAll();  // Refresh retained state topics on the next tick
+  sleepTelemetry.publishPending(mqttClient, TelemetryConfig::TOPIC);  // Samples from before a button wake
+}
+
+// --- REMOTE ACTUATOR COMMANDS (CORE 1) ---
+
+// Remaining half-steps of a remote stepper move (sign = direction)
+std::atomic<int32_t> stepperRemoteSteps(0);
+esp_timer_handle_t stepperTimer = nullptr;
+
+// Remote tone; a duration of 0 plays until "OFF"
+bool toneRemoteActive = false;
+unsigned long toneRemoteStartMs = 0;
+uint32_t toneRemoteDurationMs = 0;
+
+/**
+ * esp_timer callback: one half-step of a remote stepper move
+ * Stops early if the Stepper app takes over local control.
+ */
+void stepperTimerCallback(void* arg) {
+  int32_t remaining = stepperRemoteSteps.load();
+  if (remaining == 0 || currentState == APP_STEPPER) {
+    esp_timer_stop(stepperTimer);
+    stepperRemoteSteps.store(0);
+    if (currentState != APP_STEPPER) stepperRelease();
+    return;
+  }
+  stepperStep(remaining > 0 ? 1 : -1);
+  stepperRemoteSteps.store(remaining > 0 ? remaining - 1 : remaining + 1);
+}
+
+// DAC channel wired to Pins::TONE_DAC (DAC1 = GPIO25, DAC2 = GPIO26)
+static_assert(Pins::TONE_DAC != Pins::ROT_SW, "The tone DAC would drive the encoder button's pin");
+const dac_channel_t TONE_DAC_CHANNEL = Pins::TONE_DAC == 25 ? DAC_CHANNEL_1 : DAC_CHANNEL_2;
+
+void toneRemoteStop() {
+  dac_cw_generator_disable();
+  dac_output_disable(TONE_DAC_CHANNEL);
+  toneRemoteActive = false;
+}
+
+/**
+ * Apply one remote command to the hardware
+ * Devices whose app is open on the display stay under local control.
+ * @return true if applied; cmd is updated to the state actually applied
+ */
+bool applyActuatorCommand(ActuatorCommand& cmd) {
+  switch (cmd.device) {
+    case ActuatorDevice::RELAY: {
+      if (!xSemaphoreTake(stateMutex, pdMS_TO_TICKS(10))) return false;
+      bool on = cmd.value == RELAY_TOGGLE ? !sharedState.relayState : cmd.value != 0;
+      sharedState.relayState = on;
       xSemaphoreGive(stateMutex);
+      cmd.value = on ? 1 : 0;
+      return true;  // Relay output follows sharedState in loop()
+    }
+
+    case ActuatorDevice::PWM: {
+      if (currentState == APP_PWM) return false;
+      uint8_t brightness = (uint8_t)((cmd.value * 255) / 100);
+      ledcWrite(Pins::PWM_MOSFET, gammaCorrect(brightness));
+      if (xSemaphoreTake(stateMutex, pdMS_TO_TICKS(10))) {
+        sharedState.pwmPercent = (uint8_t)cmd.value;
+        xSemaphoreGive(stateMutex);
+      }
+      return true;
     }
+
+    case ActuatorDevice::SERVO:
+      if (currentState == APP_SERVO) return false;
+      if (!myServo.attached()) myServo.attach(Pins::SERVO);
+      myServo.write(cmd.value);
+      if (xSemaphoreTake(stateMutex, pdMS_TO_TICKS(10))) {
+        sharedState.servoAngle = (uint8_t)cmd.value;
+        xSemaphoreGive(stateMutex);
+      }
+      return true;
+
+    case ActuatorDevice::STEPPER: {
+      if (currentState == APP_STEPPER || stepperTimer == nullptr) return false;
+      esp_timer_stop(stepperTimer);  // A new move replaces the one in progress
+      stepperRemoteSteps.store(cmd.value);
+      if (cmd.value != 0) {
+        uint32_t stepDelayMs = map(cmd.arg, 1, 100, 20, 2);  // Same range as the Stepper app
+        esp_timer_start_periodic(stepperTimer, stepDelayMs * 1000);
+      } else {
+        stepperRelease();
+      }
+      return true;
+    }
+
+    case ActuatorDevice::NEOPIXEL: {
+      if (currentState == APP_NEOPIXEL) return false;
+      LedEffectParams params = ledEffects.params();
+      params.effect = (LedEffect)cmd.arg;
+      if (cmd.value >= 0) params.color = (uint32_t)cmd.value;
+      ledEffects.setParams(params);
+      return true;
+    }
+
+    case ActuatorDevice::TONE: {
+      if (currentState == APP_I2S) return false;
+      if (cmd.value == 0) {
+        toneRemoteStop();
+        return true;
+      }
+      // Hardware cosine generator: a clean tone with no CPU involvement.
+      // Its lowest frequency is ~130 Hz, so lower requests play at that.
+      dac_cw_config_t cw = {};
+      cw.en_ch = TONE_DAC_CHANNEL;
+      cw.scale = DAC_CW_SCALE_1;
+      cw.phase = DAC_CW_PHASE_0;
+      cw.freq = (uint32_t)cmd.value;
+      cw.offset = 0;
+      dac_cw_generator_config(&cw);
+      dac_cw_generator_enable();
+      dac_output_enable(TONE_DAC_CHANNEL);
+      toneRemoteActive = true;
+      toneRemoteStartMs = millis();
+      toneRemoteDurationMs = (uint32_t)cmd.arg;
+      return true;
+    }
+
+    default:
+      return false;
   }
 }
 
 /**
- * Check if button is pressed with debouncing
+ * Apply queued remote commands and hand them back for acknowledgement
+ * Called once per loop() pass.
+ */
+void processActuatorCommands() {
+  ActuatorCommand cmd;
+  while (xQueueReceive(actuatorQueue, &cmd, 0) == pdTRUE) {
+    const char* name = ACTUATOR_NAMES[(uint8_t)cmd.device];
+    if (!applyActuatorCommand(cmd)) {
+      LOG_WARN("Remote %s command ignored (under local control)", name);
+      continue;
+    }
+    LOG_DEBUG("Remote %s command applied: %ld", name, (long)cmd.value);
+    if (xQueueSend(actuatorAckQueue, &cmd, 0) != pdTRUE) {
+      LOG_RATELIMITED(LogLevel::Warn, 1000, "Ack queue full, %s state not acknowledged", name);
+      continue;
+    }
+    systemEvents.signal(EventTask::WIFI, EVENT_ACK);
+  }
+
+  // Timed remote tone; opening the Tone app ends it so only one tone plays
+  if (toneRemoteActive && (currentState == APP_I2S ||
+      (toneRemoteDurationMs != 0 && millis() - toneRemoteStartMs >= toneRemoteDurationMs))) {
+    toneRemoteStop();
+  } else if (toneRemoteActive && toneRemoteDurationMs != 0) {
+    systemEvents.wakeWithin(EventTask::LOOP, toneRemoteDurationMs - (millis() - toneRemoteStartMs));
+  }
+}
+
+/**
+ * Publish the state of each applied command on esp32/multitool/<device>/state
+ * Runs in wifiTask while connected.
+ */
+void publishActuatorAcks() {
+  ActuatorCommand cmd;
+  while (xQueueReceive(actuatorAckQueue, &cmd, 0) == pdTRUE) {
+    char topic[48];
+    char state[24];
+    mqttStateTopic(cmd.device, topic, sizeof(topic));
+    mqttFormatState(cmd, state, sizeof(state));
+    mqttClient.publish(topic, state, true);
+
+    // Telemetry would otherwise republish the same retained state on its next tick
+    if (cmd.device == ActuatorDevice::RELAY) telemetryMarkSent(METRIC_RELAY, cmd.value);
+    else if (cmd.device == ActuatorDevice::PWM) telemetryMarkSent(METRIC_PWM, cmd.value);
+    else if (cmd.device == ActuatorDevice::SERVO) telemetryMarkSent(METRIC_SERVO, cmd.value);
+  }
+}
+
+// Button event for the current loop() pass, and the screen its press began on
+ButtonEvent buttonEvent = {ButtonEventType::NONE, 0};
+AppState buttonPressState = MENU;
+
+/**
+ * Take one queued button event for this loop() pass
+ */
+void pollButton() {
+  if (!buttonInput.next(buttonEvent)) {
+    buttonEvent.type = ButtonEventType::NONE;
+    return;
+  }
+  powerManager.noteActivity();
+  if (buttonEvent.type == ButtonEventType::PRESS) buttonPressState = currentState;
+}
+
+/**
+ * Check for a button press (acts on the press edge, for instant actions)
  * @return true if button was pressed
  */
 bool buttonPressed() {
-  if (digitalRead(Pins::ROT_SW) == LOW) {
-    if (millis() - lastButtonPress > Timing::DEBOUNCE_MS) {
-      lastButtonPress = millis();
-      return true;
-    }
+  return buttonEvent.type == ButtonEventType::PRESS;
+}
+
+/**
+ * Check for a short click, for screens that also use a long press
+ * Only counts if the press started on the current screen.
+ */
+bool buttonClicked() {
+  return buttonEvent.type == ButtonEventType::RELEASE &&
+         buttonEvent.heldMs < ButtonConfig::LONG_PRESS_MS && buttonPressState == currentState;
+}
+
+/**
+ * Check for a long press that started on the current screen
+ */
+bool buttonLongPressed() {
+  return buttonEvent.type == ButtonEventType::LONG_PRESS && buttonPressState == currentState;
+}
+
+/**
+ * Encoder acceleration for each screen; lists and menus stay 1:1
+ */
+const EncoderProfile& encoderProfileFor(AppState state) {
+  static const EncoderProfile SERVO = {60, 12, 5};     // 0-180 deg
+  static const EncoderProfile PWM = {60, 12, 8};       // 0-255
+  static const EncoderProfile STEPPER = {60, 15, 4};   // -100 to +100
+  static const EncoderProfile TONE = {80, 10, 50};     // 100-4000 Hz
+  switch (state) {
+    case APP_SERVO: return SERVO;
+    case APP_PWM: return PWM;
+    case APP_STEPPER: return STEPPER;
+    case APP_I2S: return TONE;
+    default: return ENCODER_LINEAR;
   }
-  return false;
 }
 
 /**
@@ -376,27 +802,6 @@ void drawHeader(const char* title) {
   }
 }
 
-/**
- * Sanitize HTML input to prevent XSS
- * @param input Input string to sanitize
- * @param output Output buffer
- * @param maxLen Maximum output length
- */
-void sanitizeHTML(const char* input, char* output, size_t maxLen) {
-  size_t j = 0;
-  for (size_t i = 0; i < strlen(input) && j < maxLen - 6; i++) {
-    switch (input[i]) {
-      case '<':  strncpy(&output[j], "&lt;", maxLen - j); j += 4; break;
-      case '>':  strncpy(&output[j], "&gt;", maxLen - j); j += 4; break;
-      case '&':  strncpy(&output[j], "&amp;", maxLen - j); j += 5; break;
-      case '"':  strncpy(&output[j], "&quot;", maxLen - j); j += 6; break;
-      case '\'': strncpy(&output[j], "&#x27;", maxLen - j); j += 6; break;
-      default:   output[j++] = input[i]; break;
-    }
-  }
-  output[j] = '\0';
-}
-
 // --- WEB SERVER HANDLERS ---
 
 /**
@@ -405,9 +810,7 @@ void sanitizeHTML(const char* input, char* output, size_t maxLen) {
  */
 void handleRoot() {
   // Simple authentication check
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
-  }
+  if (!requireAuth()) return;
 
   // Get current state safely
   int currentSensor, currentClients;
@@ -482,7 +885,7 @@ void handleRoot() {
   client.print(ESP.getFreeHeap());
   client.println(F(" bytes<br>"));
   client.print(F("Hostname: "));
-  client.print(MDNS_HOSTNAME);
+  client.print(configStore.data().hostname);
   client.println(F(".local<br><br>"));
 
   client.println(F("<a href=\"/password\" style=\"color:#0f0;text-decoration:underline;\">Change Passwords</a> | "));
@@ -504,9 +907,7 @@ void handleRoot() {
  * Handle relay ON command
  */
 void handleRelayOn() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
-  }
+  if (!requireAuth()) return;
 
   // Only accept POST to prevent CSRF
   if (server.method() != HTTP_POST) {
@@ -517,6 +918,7 @@ void handleRelayOn() {
   if (xSemaphoreTake(stateMutex, pdMS_TO_TICKS(100))) {
     sharedState.relayState = true;
     xSemaphoreGive(stateMutex);
+    systemEvents.signal(EventTask::LOOP, EVENT_COMMAND);
   }
 
   server.sendHeader(F("Location"), F("/"));
@@ -527,9 +929,7 @@ void handleRelayOn() {
  * Handle relay OFF command
  */
 void handleRelayOff() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
-  }
+  if (!requireAuth()) return;
 
   if (server.method() != HTTP_POST) {
     server.send(405, F("text/plain"), F("Method Not Allowed"));
@@ -539,6 +939,7 @@ void handleRelayOff() {
   if (xSemaphoreTake(stateMutex, pdMS_TO_TICKS(100))) {
     sharedState.relayState = false;
     xSemaphoreGive(stateMutex);
+    systemEvents.signal(EventTask::LOOP, EVENT_COMMAND);
   }
 
   server.sendHeader(F("Location"), F("/"));
@@ -549,9 +950,7 @@ void handleRelayOff() {
  * Handle password change form
  */
 void handlePasswordForm() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
-  }
+  if (!requireAuth()) return;
 
   WiFiClient client = server.client();
   client.println(F("HTTP/1.1 200 OK"));
@@ -590,9 +989,7 @@ void handlePasswordForm() {
  * Handle password update
  */
 void handlePasswordUpdate() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
-  }
+  if (!requireAuth()) return;
 
   if (server.method() != HTTP_POST) {
     server.send(405, F("text/plain"), F("Method Not Allowed"));
@@ -608,29 +1005,27 @@ void handlePasswordUpdate() {
   server.arg("newpass").toCharArray(newPass, sizeof(newPass));
   server.arg("otapass").toCharArray(newOTAPass, sizeof(newOTAPass));
 
-  // Verify current password
-  if (strcmp(currentPass, www_password) != 0) {
+  // Verify current password (KDF, constant-time compare)
+  if (!credentials.checkPassword(currentPass)) {
     server.send(401, F("text/plain"), F("Current password incorrect"));
     return;
   }
 
   // Validate new password length
-  if (strlen(newPass) < 8 || strlen(newOTAPass) < 8) {
+  if (strlen(newPass) < CredentialConfig::MIN_PASSWORD_LEN || strlen(newOTAPass) < CredentialConfig::MIN_PASSWORD_LEN) {
     server.send(400, F("text/plain"), F("New passwords must be at least 8 characters"));
     return;
   }
 
-  // Save to NVS
-  preferences.begin("auth", false);  // Read-write
-  preferences.putString("pass", newPass);
-  preferences.putString("otapass", newOTAPass);
-  preferences.end();
+  // Hash and save to NVS, then end sessions opened with the old password
+  credentials.setPasswords(newPass, newOTAPass);
+  ArduinoOTA.setPasswordHash(credentials.otaPasswordHash());
+  webAuth.revokeAll();
+  memset(currentPass, 0, sizeof(currentPass));
+  memset(newPass, 0, sizeof(newPass));
+  memset(newOTAPass, 0, sizeof(newOTAPass));
 
-  // Update runtime variables
-  strcpy(www_password, newPass);
-  strcpy(ota_password, newOTAPass);
-
-  Serial.println(F("Passwords updated successfully"));
+  LOG_INFO("Passwords updated successfully");
 
   server.sendHeader(F("Location"), F("/"));
   server.send(303);
@@ -640,9 +1035,7 @@ void handlePasswordUpdate() {
  * API: Get sensor data in JSON format
  */
 void handleApiSensor() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
-  }
+  if (!requireAuth()) return;
 
   int sensorVal = 0;
   if (xSemaphoreTake(stateMutex, pdMS_TO_TICKS(100))) {
@@ -676,9 +1069,7 @@ void handleApiSensor() {
  * API: Get/Set relay state in JSON
  */
 void handleApiRelay() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
-  }
+  if (!requireAuth()) return;
 
   if (server.method() == HTTP_GET) {
     bool relayState = false;
@@ -714,6 +1105,7 @@ void handleApiRelay() {
     if (xSemaphoreTake(stateMutex, pdMS_TO_TICKS(100))) {
       sharedState.relayState = newState;
       xSemaphoreGive(stateMutex);
+      systemEvents.signal(EventTask::LOOP, EVENT_COMMAND);
     } else {
       server.send(503, F("application/json"), F("{\"error\":\"Service unavailable\"}"));
       return;
@@ -738,9 +1130,7 @@ void handleApiRelay() {
  * API: Get/Set PWM value in JSON
  */
 void handleApiPwm() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
-  }
+  if (!requireAuth()) return;
 
   static uint8_t currentPwm = 0;
 
@@ -802,9 +1192,7 @@ void handleApiPwm() {
  * API: Get/Set servo angle in JSON
  */
 void handleApiServo() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
-  }
+  if (!requireAuth()) return;
 
   static uint8_t currentAngle = 90;
 
@@ -862,9 +1250,7 @@ void handleApiServo() {
  * API: Get system information in JSON
  */
 void handleApiSystem() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
-  }
+  if (!requireAuth()) return;
 
   // Get current state
   int currentClients = 0;
@@ -904,103 +1290,331 @@ void handleApiSystem() {
   client.print(currentIP);
   client.print(F("\",\"rssi_dbm\":"));
   client.print(WiFi.RSSI());
-  client.println(F("}"));
-  client.stop();
-}
 
-/**
- * Handle settings page (MQTT and system configuration)
- */
-void handleSettings() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
+  // WiFi connection manager: attempts and time-to-reconnect
+  const WifiStats& wifiStats = wifiConnection.stats();
+  client.print(F(",\"wifi\":{\"state\":\""));
+  client.print(wifiConnection.stateName());
+  client.print(F("\",\"portal\":"));
+  client.print(wifiConnection.portalActive() ? F("true") : F("false"));
+  client.print(F(",\"attempts\":"));
+  client.print(wifiStats.attempts);
+  client.print(F(",\"failures\":"));
+  client.print(wifiStats.failures);
+  client.print(F(",\"disconnects\":"));
+  client.print(wifiStats.disconnects);
+  client.print(F(",\"backoff_ms\":"));
+  client.print(wifiConnection.backoffMs());
+  client.print(F(",\"connect_ms\":"));
+  client.print(wifiStats.lastConnectMs);
+  client.print(F(",\"reconnect_ms\":"));
+  client.print(wifiStats.lastReconnectMs);
+  client.print(F(",\"reconnect_max_ms\":"));
+  client.print(wifiStats.maxReconnectMs);
+  client.print(F(",\"portal_opens\":"));
+  client.print(wifiStats.portalOpens);
+
+  // MQTT connection manager health
+  const MqttStats& mqttStats = mqttManager.stats();
+  client.print(F("},\"mqtt\":{\"state\":\""));
+  client.print(mqttManager.stateName());
+  client.print(F("\",\"attempts\":"));
+  client.print(mqttStats.attempts);
+  client.print(F(",\"failures\":"));
+  client.print(mqttStats.failures);
+  client.print(F(",\"backoff_ms\":"));
+  client.print(mqttManager.backoffMs());
+  client.print(F(",\"reconnect_latency_ms\":"));
+  client.print(mqttStats.lastConnectLatencyMs);
+  client.print(F(",\"tick_max_us\":"));
+  client.print(mqttStats.maxTickUs);
+  client.print(F(",\"blocked_total_ms\":"));
+  client.print((unsigned long)(mqttStats.totalBlockedUs / 1000));
+  client.print(F("},\"telemetry\":{\"messages\":"));
+  client.print(telemetryStats.messages);
+  client.print(F(",\"values\":"));
+  client.print(telemetryStats.values);
+  client.print(F(",\"suppressed\":"));
+  client.print(telemetryStats.suppressed);
+
+  // Store-and-forward queue for telemetry taken while the broker was unreachable
+  const OfflineQueueStats& queueStats = telemetryOfflineQueue.stats();
+  client.print(F("},\"offline_queue\":{\"depth\":"));
+  client.print(telemetryOfflineQueue.depth());
+  client.print(F(",\"capacity\":"));
+  client.print(OfflineQueueConfig::RAM_SLOTS);
+  client.print(F(",\"spill_depth\":"));
+  client.print(telemetryOfflineQueue.spillDepth());
+  client.print(F(",\"queued\":"));
+  client.print(queueStats.queued);
+  client.print(F(",\"drained\":"));
+  client.print(queueStats.drained);
+  client.print(F(",\"dropped\":"));
+  client.print(queueStats.dropped);
+  client.print(F(",\"spilled\":"));
+  client.print(queueStats.spilled);
+  client.print(F(",\"drain_rate\":"));
+  client.print(queueStats.drainRate);
+  client.print(F(",\"drain_limit\":"));
+  client.print(OfflineQueueConfig::DRAIN_PER_SECOND);
+
+  // LED effects engine frame timing
+  const LedFrameStats& ledStats = ledEffects.stats();
+  client.print(F("},\"leds\":{\"effect\":\""));
+  client.print(ledEffectName((uint8_t)ledEffects.params().effect));
+  client.print(F("\",\"count\":"));
+  client.print(ledEffects.count());
+  client.print(F(",\"fps\":"));
+  client.print(ledStats.fps);
+  client.print(F(",\"frames\":"));
+  client.print(ledStats.frames);
+  client.print(F(",\"render_us\":"));
+  client.print(ledStats.renderUs);
+  client.print(F(",\"render_avg_us\":"));
+  client.print(ledStats.renderAvgUs);
+  client.print(F(",\"render_max_us\":"));
+  client.print(ledStats.renderMaxUs);
+  client.print(F(",\"wire_us\":"));
+  client.print(ledStats.wireUs);
+  client.print(F(",\"period_ms\":"));
+  client.print(ledStats.periodMs);
+  client.print(F(",\"estimated_ma\":"));
+  client.print(ledStats.estimatedMa);
+  client.print(F(",\"budget_ma\":"));
+  client.print(ledEffects.params().budgetMa);
+  client.print(F(",\"limited_frames\":"));
+  client.print(ledStats.limitedFrames);
+
+  // Web authentication: token vs Basic path cost
+  const WebAuthStats& authStats = webAuth.stats();
+  client.print(F("},\"auth\":{\"sessions\":"));
+  client.print(webAuth.activeSessions());
+  client.print(F(",\"token_checks\":"));
+  client.print(authStats.tokenChecks);
+  client.print(F(",\"token_avg_us\":"));
+  client.print(authStats.tokenChecks > 0 ? authStats.tokenUs / authStats.tokenChecks : 0);
+  client.print(F(",\"basic_checks\":"));
+  client.print(authStats.basicChecks);
+  client.print(F(",\"basic_avg_us\":"));
+  client.print(authStats.basicChecks > 0 ? authStats.basicUs / authStats.basicChecks : 0);
+  client.print(F(",\"basic_cache_hits\":"));
+  client.print(authStats.basicCacheHits);
+  client.print(F(",\"failures\":"));
+  client.print(authStats.failures);
+  client.print(F(",\"issued\":"));
+  client.print(authStats.issued);
+  client.print(F(",\"revoked\":"));
+  client.print(authStats.revoked);
+  client.print(F(",\"kdf_iterations\":"));
+  client.print(credentials.iterations());
+  client.print(F(",\"kdf_runs\":"));
+  client.print(credentials.stats().kdfRuns);
+  client.print(F(",\"kdf_last_ms\":"));
+  client.print(credentials.stats().lastKdfMs);
+  client.print(F(",\"default_password\":"));
+  client.print(credentials.usingDefault() ? F("true") : F("false"));
+
+  // Per-client request limiter
+  const RateLimitStats& limitStats = rateLimiter.stats();
+  client.print(F("},\"rate_limit\":{\"clients\":"));
+  client.print(rateLimiter.occupancy());
+  client.print(F(",\"evictions\":"));
+  client.print(limitStats.evictions);
+  for (uint8_t i = 0; i < (uint8_t)RouteClass::COUNT; i++) {
+    client.print(F(",\""));
+    client.print(routeClassName((RouteClass)i));
+    client.print(F("\":{\"admitted\":"));
+    client.print(limitStats.admitted[i]);
+    client.print(F(",\"limited\":"));
+    client.print(limitStats.limited[i]);
+    client.print(F("}"));
   }
 
-  WiFiClient client = server.client();
-  client.println(F("HTTP/1.1 200 OK"));
-  client.println(F("Content-Type: text/html"));
-  client.println(F("Connection: close"));
-  client.println();
-
-  client.println(F("<!DOCTYPE html><html><head><title>Settings</title>"));
-  client.println(F("<meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">"));
-  client.println(F("<style>"));
-  client.println(F("body{background:#000;color:#0f0;font-family:monospace;padding:20px;font-size:1.2rem;}"));
-  client.println(F("h1{border-bottom:2px solid #0f0;padding-bottom:10px;}"));
-  client.println(F("form{max-width:600px;margin:20px auto;border:1px solid #333;padding:20px;}"));
-  client.println(F("label{display:block;margin:15px 0 5px;}"));
-  client.println(F("input{width:100%;padding:10px;background:#111;color:#0f0;border:1px solid #0f0;font-size:1rem;}"));
-  client.println(F("button{background:#0f0;color:#000;border:none;padding:15px;margin:20px 0;width:100%;font-size:1.2rem;cursor:pointer;}"));
-  client.println(F("button:active{background:#fff;}"));
-  client.println(F(".info{color:#888;font-size:0.9rem;margin-top:5px;}"));
-  client.println(F(".back{background:#333;color:#0f0;margin-top:10px;}"));
-  client.println(F("</style></head><body>"));
-
-  client.println(F("<h1>SYSTEM SETTINGS</h1>"));
-
-  // MQTT Settings
-  client.println(F("<form method=\"POST\" action=\"/settings/update\">"));
-  client.println(F("<h2>MQTT Configuration</h2>"));
-  client.println(F("<label>MQTT Broker:</label>"));
-  client.print(F("<input type=\"text\" name=\"mqtt_broker\" value=\""));
-  client.print(MQTT_SERVER);
-  client.println(F("\">"));
-  client.println(F("<div class=\"info\">Default: broker.hivemq.com</div>"));
-
-  client.println(F("<label>MQTT Port:</label>"));
-  client.print(F("<input type=\"number\" name=\"mqtt_port\" value=\""));
-  client.print(MQTT_PORT);
-  client.println(F("\">"));
-  client.println(F("<div class=\"info\">Default: 1883</div>"));
-
-  client.println(F("<label>MQTT Client ID:</label>"));
-  client.print(F("<input type=\"text\" name=\"mqtt_client\" value=\""));
-  client.print(MQTT_CLIENT_ID);
-  client.println(F("\">"));
+  // Radio/CPU profile and estimated supply current (module only)
+  const PowerStats& powerStats = powerManager.stats();
+  client.print(F("},\"power\":{\"profile\":\""));
+  client.print(powerProfileName(powerManager.profile()));
+  client.print(F("\",\"light_sleep\":"));
+  client.print(powerManager.lightSleepActive() ? F("true") : F("false"));
+  client.print(F(",\"est_ma\":"));
+  client.print(powerManager.currentMa());
+  client.print(F(",\"avg_ma\":"));
+  client.print(powerManager.averageMa());
+  client.print(F(",\"tx_dbm\":"));
+  client.print(powerManager.txDbm(), 2);
+  client.print(F(",\"rssi_avg\":"));
+  client.print(powerManager.rssi());
+  client.print(F(",\"listen_interval\":"));
+  client.print(powerManager.listenInterval());
+  client.print(F(",\"latency_bound_ms\":"));
+  client.print(powerManager.latencyBoundMs());
+  client.print(F(",\"latency_budget_ms\":"));
+  client.print(PowerConfig::LATENCY_BUDGET_MS);
+  client.print(F(",\"max_poll_gap_ms\":"));
+  client.print(powerStats.maxPollGapMs);
+  client.print(F(",\"switches\":"));
+  client.print(powerStats.switches);
+  client.print(F(",\"tx_adjustments\":"));
+  client.print(powerStats.txAdjustments);
+  client.print(F(",\"profile_ms\":{"));
+  for (uint8_t i = 0; i < (uint8_t)PowerProfile::COUNT; i++) {
+    client.print(i == 0 ? F("\"") : F(",\""));
+    client.print(powerProfileName((PowerProfile)i));
+    client.print(F("\":"));
+    client.print(powerStats.profileMs[i]);
+  }
+  client.print(F(",\"light_sleep\":"));
+  client.print(powerStats.lightSleepMs);
+  client.print(F("}"));
+
+  // Event-driven waits: how often each task wakes, and input-to-action latency
+  const InputLatencyStats& latency = systemEvents.inputLatency();
+  client.print(F("},\"events\":{"));
+  for (uint8_t i = 0; i < (uint8_t)EventTask::COUNT; i++) {
+    const EventTaskStats& taskStats = systemEvents.stats((EventTask)i);
+    client.print(i == 0 ? F("\"") : F(",\""));
+    client.print(eventTaskName((EventTask)i));
+    client.print(F("\":{\"wakes_per_s\":"));
+    client.print(taskStats.wakesPerSec10 / 10.0f, 1);
+    client.print(F(",\"event_wakes\":"));
+    client.print(taskStats.eventWakes);
+    client.print(F(",\"deadline_wakes\":"));
+    client.print(taskStats.deadlineWakes);
+    client.print(F("}"));
+  }
+  client.print(F(",\"input_latency\":{\"count\":"));
+  client.print(latency.count);
+  client.print(F(",\"avg_us\":"));
+  client.print(latency.count ? (uint32_t)(latency.totalUs / latency.count) : 0);
+  client.print(F(",\"max_us\":"));
+  client.print(latency.maxUs);
+  client.print(F(",\"last_us\":"));
+  client.print(latency.lastUs);
+  client.print(F("}"));
+  const ButtonStats& buttonStats = buttonInput.stats();
+  client.print(F(",\"button\":{\"presses\":"));
+  client.print(buttonStats.presses);
+  client.print(F(",\"long_presses\":"));
+  client.print(buttonStats.longPresses);
+  client.print(F(",\"bounces\":"));
+  client.print(buttonStats.bounces);
+  client.print(F(",\"dropped\":"));
+  client.print(buttonStats.dropped);
+  client.print(F("}"));
+
+  // Deep-sleep duty cycle (counters survive sleep, reset at power-on)
+  const SleepStats& sleepStats = sleepTelemetry.stats();
+  client.print(F("},\"sleep\":{\"enabled\":"));
+  client.print(sleepTelemetry.enabled() ? F("true") : F("false"));
+  client.print(F(",\"pending\":"));
+  client.print(sleepTelemetry.pending());
+  client.print(F(",\"cycles\":"));
+  client.print(sleepStats.cycles);
+  client.print(F(",\"publishes\":"));
+  client.print(sleepStats.publishes);
+  client.print(F(",\"failures\":"));
+  client.print(sleepStats.failures);
+  client.print(F(",\"fast_joins\":"));
+  client.print(sleepStats.fastJoins);
+  client.print(F(",\"dropped\":"));
+  client.print(sleepStats.dropped);
+  client.print(F(",\"awake_ms\":"));
+  client.print(sleepStats.lastAwakeMs);
+  client.print(F(",\"publish_awake_ms\":"));
+  client.print(sleepStats.lastPublishAwakeMs);
+  client.print(F(",\"total_awake_ms\":"));
+  client.print(sleepStats.totalAwakeMs);
+
+  // Time-to-ready per boot stage (null while still pending)
+  client.print(F("},\"boot\":{"));
+  for (uint8_t i = 0; i < (uint8_t)BootStage::COUNT; i++) {
+    BootStage stage = (BootStage)i;
+    const BootStageTiming& timing = bootStages.timing(stage);
+    client.print(i == 0 ? F("\"") : F(",\""));
+    client.print(bootStageName(stage));
+    if (!bootStages.isReady(stage)) {
+      client.print(F("\":null"));
+      continue;
+    }
+    client.print(F("\":{\"ready_us\":"));
+    client.print(timing.readyUs);
+    client.print(F(",\"took_us\":"));
+    client.print(timing.readyUs - timing.startUs);
+    client.print(F(",\"ok\":"));
+    client.print(timing.ok ? F("true") : F("false"));
+    client.print(F("}"));
+  }
+  client.println(F("}}"));
+  client.stop();
+}
 
-  client.println(F("<div class=\"info\">"));
-  client.print(F("Status: "));
-  client.print(mqttClient.connected() ? F("Connected") : F("Disconnected"));
-  client.println(F("</div>"));
+// --- SLEEP TELEMETRY (see sleep_telemetry.h) ---
 
-  client.println(F("<button type=\"submit\">UPDATE SETTINGS</button>"));
-  client.println(F("</form>"));
+/**
+ * Timer wake in sleep telemetry mode: sample, publish once a batch is
+ * full, sleep again. Runs instead of the boot stages; does not return.
+ */
+void sleepCycle() {
+  bool relay = sleepTelemetry.restoreRelay();
+  pinMode(Pins::SENSOR_IN, INPUT);
+  bool batchReady = sleepTelemetry.addSample(constrain(analogRead(Pins::SENSOR_IN), 0, ADC_MAX_12BIT));
 
-  client.println(F("<form action=\"/\"><button class=\"back\">BACK TO MAIN</button></form>"));
-  client.println(F("</body></html>"));
-  client.stop();
+  if (batchReady) {
+    loadConfig();
+    sleepTelemetry.publishBatch(mqttConfig, configStore.data().hostname, TelemetryConfig::TOPIC);
+  }
+  sleepTelemetry.sleep(relay, true, batchReady);
 }
 
 /**
- * Handle settings update
+ * Leave the full firmware for deep sleep (WiFi task, after the idle timeout)
  */
-void handleSettingsUpdate() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
+void enterSleep() {
+  configStore.flush();
+  bool relay = false;
+  if (xSemaphoreTake(stateMutex, pdMS_TO_TICKS(100))) {
+    relay = sharedState.relayState;
+    xSemaphoreGive(stateMutex);
   }
+  LOG_INFO("Sleep: idle, entering sleep telemetry mode");
+  sleepTelemetry.sleep(relay, false, false);
+}
 
-  if (server.method() != HTTP_POST) {
-    server.send(405, F("text/plain"), F("Method Not Allowed"));
-    return;
+// --- WIFI TASK (CORE 0) ---
+
+/**
+ * Station got an IP (first connect or reconnect); runs on the WiFi task
+ */
+void onWifiConnected() {
+  IPAddress ip = WiFi.localIP();
+  LOG_INFO("WiFi connected, IP: %u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+
+  if (xSemaphoreTake(stateMutex, pdMS_TO_TICKS(100))) {
+    snprintf(sharedState.ipAddress, sizeof(sharedState.ipAddress),
+             "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
+    sharedState.wifiActive = true;
+    xSemaphoreGive(stateMutex);
   }
 
-  // For now, just acknowledge the update
-  // In a full implementation, we'd save to NVS and reconfigure MQTT
-  Serial.println(F("Settings update requested (not implemented - requires NVS storage)"));
+  // Fast join target for the next sleep-mode wake
+  sleepTelemetry.rememberAp();
 
-  server.sendHeader(F("Location"), F("/settings"));
-  server.send(303);
+  // Reachable again: keep this image (first boot after an OTA update)
+  static bool imageConfirmed = false;
+  if (!imageConfirmed) {
+    otaConfirmRunningApp();
+    imageConfirmed = true;
+  }
 }
 
-/**
- * Handle 404 errors
- */
-void handleNotFound() {
-  server.send(404, F("text/plain"), F("Not Found"));
+void onWifiDisconnected() {
+  if (xSemaphoreTake(stateMutex, pdMS_TO_TICKS(100))) {
+    strcpy(sharedState.ipAddress, "0.0.0.0");
+    sharedState.wifiActive = false;
+    xSemaphoreGive(stateMutex);
+  }
 }
 
-// --- WIFI TASK (CORE 0) ---
-
 /**
  * WiFi and web server task running on Core 0
  * Handles all network operations separate from hardware control
@@ -1008,69 +1622,90 @@ void handleNotFound() {
 void wifiTask(void* parameter) {
   // Add this task to watchdog
   esp_task_wdt_add(NULL);
+  systemEvents.attach(EventTask::WIFI);
+
+  LOG_INFO("WiFi task starting on Core 0...");
+
+  // Nothing before the NETWORK stage needs the radio, so it is done first and
+  // the web interface is complete the moment WiFi starts
+  bootStages.start(BootStage::CREDENTIALS);
 
-  Serial.println(F("WiFi task starting on Core 0..."));
+  // Load password hashes (migrates plaintext entries from older firmware)
+  credentials.begin();
+
+  // Session signing key for the web interface
+  webAuth.begin();
+  bootStages.ready(BootStage::CREDENTIALS);
+
+  // Setup web server routes - MODERN INTERFACE
+  server.on("/", HTTP_GET, limited(RouteClass::READ, []() {
+    if (!requireAuth(true)) return;
+    server.send_P(200, "text/html", DASHBOARD_HTML);
+  }));
+
+  server.on("/settings", HTTP_GET, limited(RouteClass::READ, []() {
+    if (!requireAuth(true)) return;
+    server.send_P(200, "text/html", SETTINGS_HTML);
+  }));
 
-  // Configure WiFi manager
-  wifiManager.setConfigPortalTimeout(180);  // 3 minute timeout
-  wifiManager.setAPCallback([](WiFiManager* myWiFiManager) {
-    Serial.println(F("Entered config mode"));
-    Serial.print(F("Config AP: "));
-    Serial.println(myWiFiManager->getConfigPortalSSID());
+  server.on("/ota", HTTP_GET, limited(RouteClass::READ, []() {
+    if (!requireAuth(true)) return;
+    server.send_P(200, "text/html", OTA_HTML);
+  }));
+
+  server.on("/api/system", HTTP_GET, limited(RouteClass::READ, handleApiSystem));
+
+  server.onNotFound([]() {
+    if (captivePortalRedirect()) return;
+    server.send(404, "text/plain", "Not Found");
   });
 
-  // Try to connect with saved credentials, or start config portal
-  char apName[32];
-  snprintf(apName, sizeof(apName), "ESP32-Multitool-%04X", (uint16_t)(ESP.getEfuseMac() & 0xFFFF));
+  // Register all API handlers
+  registerAPIHandlers();
 
-  if (!wifiManager.autoConnect(apName, "configure")) {
-    Serial.println(F("Failed to connect - resetting"));
-    delay(3000);
-    ESP.restart();
-  }
+  // Setup MQTT (connection is driven by mqttManager.tick() in the loop below)
+  mqttClient.setServer(mqttConfig.server, mqttConfig.port);
+  mqttClient.setCallback(mqttCallback);
+  mqttManager.begin(mqttClient, mqttTransport, mqttConfig, &mqttWill, onMqttConnected);
+  telemetryOfflineQueue.begin();
+  LOG_INFO("MQTT configured");
 
-  // Connected successfully
-  Serial.println(F("WiFi connected!"));
-  Serial.print(F("IP: "));
-  Serial.println(WiFi.localIP());
+  bootStages.start(BootStage::NETWORK);
 
-  // Update shared state
-  if (xSemaphoreTake(stateMutex, pdMS_TO_TICKS(1000))) {
-    IPAddress ip = WiFi.localIP();
-    snprintf(sharedState.ipAddress, sizeof(sharedState.ipAddress),
-             "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
-    sharedState.wifiActive = true;
-    xSemaphoreGive(stateMutex);
-  }
+  // Station reconnects and the setup portal run from the loop below; this only
+  // starts the radio, so the web server is up whether or not a network is stored.
+  // Static so the deferred logger can reference it
+  static char apName[32];
+  snprintf(apName, sizeof(apName), "ESP32-Multitool-%04X", (uint16_t)(ESP.getEfuseMac() & 0xFFFF));
+  LOG_INFO("Setup AP name: %s", apName);
 
-  // Set WiFi power
-  WiFi.setTxPower(WiFiConfig::TX_POWER);
+  const WifiPortalConfig portal = { apName, WiFiConfig::AP_PASSWORD, WiFiConfig::AP_CHANNEL,
+                                    WiFiConfig::MAX_CLIENTS };
+  WiFi.setHostname(configStore.data().hostname);
+  wifiConnection.begin(portal, onWifiConnected, onWifiDisconnected);
+  powerManager.begin();   // Before the first association: sets the listen interval
+  bootStages.ready(BootStage::NETWORK);
+
+  bootStages.start(BootStage::SERVICES);
 
   // Setup mDNS
-  if (MDNS.begin(MDNS_HOSTNAME)) {
-    Serial.print(F("mDNS started: "));
-    Serial.print(MDNS_HOSTNAME);
-    Serial.println(F(".local"));
+  if (MDNS.begin(configStore.data().hostname)) {
+    LOG_INFO("mDNS started: %s.local", configStore.data().hostname);
 
     // Add service discovery
     MDNS.addService("http", "tcp", 80);
     MDNS.addService("arduino", "tcp", 3232);  // OTA port
   } else {
-    Serial.println(F("WARNING: mDNS failed to start"));
+    LOG_WARN("mDNS failed to start");
   }
 
   // Setup OTA
-  ArduinoOTA.setHostname(MDNS_HOSTNAME);
-  ArduinoOTA.setPassword(ota_password);
+  ArduinoOTA.setHostname(configStore.data().hostname);
+  ArduinoOTA.setPasswordHash(credentials.otaPasswordHash());
 
   ArduinoOTA.onStart([]() {
-    String type;
-    if (ArduinoOTA.getCommand() == U_FLASH) {
-      type = "sketch";
-    } else {  // U_SPIFFS
-      type = "filesystem";
-    }
-    Serial.println("OTA: Starting update - " + type);
+    LOG_INFO("OTA: Starting update - %s",
+             ArduinoOTA.getCommand() == U_FLASH ? "sketch" : "filesystem");
 
     // Show on OLED if available
     if (displayAvailable && xSemaphoreTake(i2cMutex, pdMS_TO_TICKS(100))) {
@@ -1084,7 +1719,7 @@ void wifiTask(void* parameter) {
   });
 
   ArduinoOTA.onEnd([]() {
-    Serial.println(F("\nOTA: Complete!"));
+    LOG_INFO("OTA: Complete!");
     if (displayAvailable && xSemaphoreTake(i2cMutex, pdMS_TO_TICKS(100))) {
       display.clearDisplay();
       display.setCursor(0, 0);
@@ -1097,7 +1732,8 @@ void wifiTask(void* parameter) {
 
   ArduinoOTA.onProgress([](unsigned int progress, unsigned int total) {
     uint8_t percent = (progress / (total / 100));
-    Serial.printf("OTA: %u%%\r", percent);
+    powerManager.noteActivity();
+    LOG_RATELIMITED(LogLevel::Debug, 1000, "OTA: %u%%", percent);
 
     // Update OLED every 10%
     static uint8_t lastPercent = 0;
@@ -1121,12 +1757,13 @@ void wifiTask(void* parameter) {
   });
 
   ArduinoOTA.onError([](ota_error_t error) {
-    Serial.printf("OTA Error[%u]: ", error);
-    if (error == OTA_AUTH_ERROR) Serial.println(F("Auth Failed"));
-    else if (error == OTA_BEGIN_ERROR) Serial.println(F("Begin Failed"));
-    else if (error == OTA_CONNECT_ERROR) Serial.println(F("Connect Failed"));
-    else if (error == OTA_RECEIVE_ERROR) Serial.println(F("Receive Failed"));
-    else if (error == OTA_END_ERROR) Serial.println(F("End Failed"));
+    const char* reason = "Unknown";
+    if (error == OTA_AUTH_ERROR) reason = "Auth Failed";
+    else if (error == OTA_BEGIN_ERROR) reason = "Begin Failed";
+    else if (error == OTA_CONNECT_ERROR) reason = "Connect Failed";
+    else if (error == OTA_RECEIVE_ERROR) reason = "Receive Failed";
+    else if (error == OTA_END_ERROR) reason = "End Failed";
+    LOG_ERROR("OTA Error[%u]: %s", error, reason);
 
     if (displayAvailable && xSemaphoreTake(i2cMutex, pdMS_TO_TICKS(100))) {
       display.clearDisplay();
@@ -1138,88 +1775,53 @@ void wifiTask(void* parameter) {
   });
 
   ArduinoOTA.begin();
-  Serial.println(F("OTA ready"));
-
-  // Setup MQTT
-  mqttClient.setServer(MQTT_SERVER, MQTT_PORT);
-  mqttClient.setCallback(mqttCallback);
-  Serial.println(F("MQTT configured"));
-
-  // Setup web server routes - MODERN INTERFACE
-  server.on("/", HTTP_GET, []() {
-    if (!server.authenticate(www_username, www_password)) {
-      return server.requestAuthentication();
-    }
-    server.send_P(200, "text/html", DASHBOARD_HTML);
-  });
-
-  server.on("/settings", HTTP_GET, []() {
-    if (!server.authenticate(www_username, www_password)) {
-      return server.requestAuthentication();
-    }
-    server.send_P(200, "text/html", SETTINGS_HTML);
-  });
-
-  server.on("/ota", HTTP_GET, []() {
-    if (!server.authenticate(www_username, www_password)) {
-      return server.requestAuthentication();
-    }
-    server.send_P(200, "text/html", OTA_HTML);
-  });
-
-  server.onNotFound([]() {
-    server.send(404, "text/plain", "Not Found");
-  });
-
-  // Register all API handlers
-  registerAPIHandlers();
+  LOG_INFO("OTA ready");
 
   server.begin();
-  Serial.println(F("Web server started"));
+  LOG_INFO("Web server started");
+
+  bootStages.ready(BootStage::SERVICES);
 
   // Main WiFi task loop
   unsigned long lastClientCheck = 0;
-  unsigned long lastMqttPublish = 0;
 
   for (;;) {
+    // Advance station reconnects and serve the setup portal's DNS
+    wifiConnection.tick();
+
     // Handle OTA updates
     ArduinoOTA.handle();
 
     // Handle web requests
     server.handleClient();
 
-    // Handle MQTT connection and messages
-    if (!mqttClient.connected()) {
-      // Try to reconnect (non-blocking)
-      static unsigned long lastReconnectAttempt = 0;
-      if (millis() - lastReconnectAttempt > 5000) {  // Try every 5 seconds
-        lastReconnectAttempt = millis();
-        if (mqttClient.connect(MQTT_CLIENT_ID)) {
-          Serial.println(F("MQTT connected"));
-          mqttClient.subscribe(MQTT_TOPIC_RELAY);
-          mqttClient.publish(MQTT_TOPIC_STATE, "online", true);  // Retained message
-        }
-      }
-    } else {
-      mqttClient.loop();
-
-      // Publish sensor data every 5 seconds
-      if (millis() - lastMqttPublish > 5000) {
-        char payload[32];
-        int sensorVal = 0;
+    // Write settings changed by those requests once they settle
+    configStore.tick();
 
-        if (xSemaphoreTake(stateMutex, pdMS_TO_TICKS(10))) {
-          sensorVal = sharedState.sensorValue;
-          xSemaphoreGive(stateMutex);
-        }
+    // Advance the MQTT connection one non-blocking step (also runs mqttClient.loop())
+    mqttManager.tick();
 
-        snprintf(payload, sizeof(payload), "%d", sensorVal);
-        mqttClient.publish(MQTT_TOPIC_SENSOR, payload);
+    if (mqttManager.connected()) {
 
-        lastMqttPublish = millis();
+      // MQTT log sink: forward warnings and errors, a few lines per pass
+      LogLine logLine;
+      for (uint8_t i = 0; i < LogConfig::MQTT_LINES_PER_CALL && logNextMqttLine(logLine); i++) {
+        char logPayload[LogConfig::LINE_LEN + 4];
+        snprintf(logPayload, sizeof(logPayload), "%c: %s", logLevelChar(logLine.level), logLine.text);
+        mqttClient.publish(MQTT_TOPIC_LOG, logPayload);
       }
+
+      // Acknowledge remote commands the loop has applied
+      publishActuatorAcks();
+
+      // Replay telemetry stored during the last outage, rate-limited
+      telemetryDrainOffline(mqttClient);
     }
 
+    // Publish changed metrics as one batch (deadband + min/max interval per metric),
+    // or store them in the offline queue while the broker is unreachable
+    telemetryTick(mqttClient, mqttManager.connected());
+
     // Update client count periodically
     if (millis() - lastClientCheck > Timing::WIFI_CLIENT_CHECK_MS) {
       int clients = WiFi.softAPgetStationNum();
@@ -1232,38 +1834,46 @@ void wifiTask(void* parameter) {
       lastClientCheck = millis();
     }
 
+    // Pick the radio/CPU profile from recent activity; uploads and the setup AP need full speed
+    OtaPullState pullState = otaPuller.status().state;
+    bool busy = wifiConnection.portalActive() || otaSession.stats().state == OtaState::RECEIVING ||
+                pullState == OtaPullState::CHECKING || pullState == OtaPullState::DOWNLOADING;
+    powerManager.tick(rateLimiter.requests(), busy);
+
+    // Sleep telemetry mode: back to deep sleep once the full firmware has gone unused
+    if (!busy && powerManager.clocksIdle() && sleepTelemetry.sleepDue(powerManager.idleMs())) {
+      enterSleep();
+    }
+
     // Feed watchdog
     esp_task_wdt_reset();
 
-    // Yield to prevent WDT timeout
-    vTaskDelay(pdMS_TO_TICKS(10));  // Minimum 10ms delay
+    // Sleep until loop() acks a remote command or the poll interval passes; the
+    // interval grows with the power profile, within the latency budget
+    systemEvents.wait(EventTask::WIFI, powerManager.pollMs());
   }
 }
 
-// --- SETUP (RUNS ON CORE 1) ---
-
-void setup() {
-  Serial.begin(115200);
-  delay(100);
-
-  Serial.println(F("\n\n================================="));
-  Serial.println(F("ESP32 Multitool v2.5"));
-  Serial.println(F("Fully Featured Edition"));
-  Serial.println(F("=================================\n"));
+// --- BOOT STAGES (see boot_stages.h for the graph) ---
 
+/**
+ * Mutexes, queues, watchdog, GPIO and the I2C bus
+ */
+bool bootCore() {
   // Create mutexes BEFORE starting any tasks
   stateMutex = xSemaphoreCreateMutex();
   i2cMutex = xSemaphoreCreateMutex();
+  actuatorQueue = xQueueCreate(TaskConfig::ACTUATOR_QUEUE_DEPTH, sizeof(ActuatorCommand));
+  actuatorAckQueue = xQueueCreate(TaskConfig::ACTUATOR_QUEUE_DEPTH, sizeof(ActuatorCommand));
 
-  if (stateMutex == nullptr || i2cMutex == nullptr) {
-    Serial.println(F("FATAL: Failed to create mutexes!"));
+  if (stateMutex == nullptr || i2cMutex == nullptr ||
+      actuatorQueue == nullptr || actuatorAckQueue == nullptr) {
+    LOG_ERROR("FATAL: Failed to create mutexes or queues!");
     while (1) {
       delay(1000);
     }
   }
 
-  Serial.println(F("Mutexes created successfully"));
-
   // Configure watchdog timer (ESP32 core 3.x API)
   esp_task_wdt_config_t wdt_config = {
     .timeout_ms = Timing::WATCHDOG_TIMEOUT_MS,
@@ -1273,11 +1883,10 @@ void setup() {
   esp_task_wdt_init(&wdt_config);
   esp_task_wdt_add(NULL);  // Add setup/loop task
 
-  // Initialize GPIO pins
-  pinMode(Pins::RELAY, OUTPUT);
-  digitalWrite(Pins::RELAY, LOW);
+  // Initialize GPIO pins; the relay keeps its state across deep sleep
+  sharedState.relayState = sleepTelemetry.restoreRelay();
 
-  pinMode(Pins::ROT_SW, INPUT_PULLUP);
+  buttonInput.begin(Pins::ROT_SW);
   pinMode(Pins::SENSOR_IN, INPUT);
 
   pinMode(Pins::STEP1, OUTPUT);
@@ -1285,52 +1894,125 @@ void setup() {
   pinMode(Pins::STEP3, OUTPUT);
   pinMode(Pins::STEP4, OUTPUT);
 
-  Serial.println(F("GPIO initialized"));
+  // Remote stepper moves are paced by a timer so they don't depend on loop() timing
+  const esp_timer_create_args_t stepperTimerArgs = {
+    .callback = stepperTimerCallback,
+    .arg = nullptr,
+    .dispatch_method = ESP_TIMER_TASK,
+    .name = "stepper",
+    .skip_unhandled_events = true
+  };
+  esp_timer_create(&stepperTimerArgs, &stepperTimer);
 
-  // Initialize I2C with mutex protection
+  // Bus driver only; the OLED transfer happens in the DISPLAY stage
   Wire.begin();
+  return true;
+}
 
-  if (xSemaphoreTake(i2cMutex, pdMS_TO_TICKS(1000))) {
-    if (!display.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS)) {
-      Serial.println(F("WARNING: OLED init failed - continuing without display"));
-      displayAvailable = false;
-    } else {
-      Serial.println(F("OLED initialized successfully"));
-      displayAvailable = true;
+/**
+ * OLED init and splash - runs in its own task, so the ~30 ms of I2C
+ * traffic overlaps the rest of setup()
+ */
+bool bootDisplay() {
+  xSemaphoreTake(i2cMutex, portMAX_DELAY);
+  bool found = display.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS);
+  if (found) {
+    display.clearDisplay();
+    display.setTextSize(1);
+    display.setTextColor(SSD1306_WHITE);
+    display.setCursor(0, 0);
+    display.println(F("ESP32 Multitool"));
+    display.println(F("Initializing..."));
+    display.display();
+  }
+  xSemaphoreGive(i2cMutex);
 
-      display.clearDisplay();
-      display.setTextSize(1);
-      display.setTextColor(SSD1306_WHITE);
-      display.setCursor(0, 0);
-      display.println(F("ESP32 Multitool"));
-      display.println(F("Initializing..."));
-      display.display();
-    }
-    xSemaphoreGive(i2cMutex);
+  if (!found) {
+    LOG_WARN("OLED init failed - continuing without display");
+    return false;
   }
+  displayAvailable = true;
+  return true;
+}
+
+bool bootConfig() {
+  loadConfig();
+  sleepTelemetry.setSettings(configStore.data().sleep);
+  return true;
+}
 
-  // Initialize rotary encoder
+bool bootEncoder() {
   ESP32Encoder::useInternalWeakPullResistors = puType::up;
   encoder.attachHalfQuad(Pins::ROT_A, Pins::ROT_B);
-  encoder.setCount(0);
-  Serial.println(F("Encoder initialized"));
-
-  // Initialize NeoPixel
-  strip.begin();
-  strip.setBrightness(LED_BRIGHTNESS);
-  strip.clear();
-  strip.show();
-  Serial.println(F("NeoPixel initialized"));
-
-  // Initialize PWM (LEDC) for 12V dimming (ESP32 core 3.x API)
-  ledcAttach(Pins::PWM_MOSFET, PWM_FREQUENCY, PWM_RESOLUTION);
+  encoderInput.begin(&encoder);
+
+  // The PCNT unit counts on its own; these edges only wake loop()
+  attachInterrupt(digitalPinToInterrupt(Pins::ROT_A), inputEdgeISR, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(Pins::ROT_B), inputEdgeISR, CHANGE);
+
+  // Light sleep is only allowed once these can wake the chip
+  const uint8_t wakePins[] = { Pins::ROT_A, Pins::ROT_B, Pins::ROT_SW };
+  powerManager.setWakePins(wakePins, sizeof(wakePins));
+  return true;
+}
+
+/**
+ * NeoPixel effects engine (own task, RMT output); starts dark
+ */
+bool bootLeds() {
+  const LedEffectParams ledDefaults = { LedEffect::OFF, 0xFF6000, 0x0040FF, 30, LED_BRIGHTNESS,
+                                         LED_POWER_BUDGET_MA };
+  if (!ledEffects.begin(ledStripConfig, ledDefaults)) {
+    LOG_ERROR("NeoPixel effects engine failed to start");
+    return false;
+  }
+  return true;
+}
+
+/**
+ * PWM (LEDC) for 12V dimming (ESP32 core 3.x API)
+ */
+bool bootPwm() {
+  bool ok = ledcAttach(Pins::PWM_MOSFET, configStore.data().pwmFrequency, PWM_RESOLUTION);
   ledcWrite(Pins::PWM_MOSFET, 0);  // Start off
-  Serial.println(F("PWM dimming initialized"));
+  return ok;
+}
+
+// --- SETUP (RUNS ON CORE 1) ---
 
-  // Load web credentials
-  loadWebCredentials();
+void setup() {
+  Serial.begin(115200);
 
-  // Start WiFi task on Core 0
+  // Start the log drain task first so every later stage can log
+  loggerBegin();
+
+  // Sleep telemetry timer wake: a few ms of work instead of a full boot
+  if (sleepTelemetry.timerWake()) sleepCycle();
+
+  // loop() runs in this task; input ISRs and other tasks wake it from here on
+  systemEvents.attach(EventTask::LOOP);
+
+  Serial.println(F("\n\n================================="));
+  Serial.println(F("ESP32 Multitool v2.5"));
+  Serial.println(F("Fully Featured Edition"));
+  Serial.println(F("=================================\n"));
+
+  if (!bootStages.begin()) {
+    LOG_ERROR("FATAL: Failed to create boot event group!");
+    while (1) {
+      delay(1000);
+    }
+  }
+
+  bootStages.run(BootStage::CORE, bootCore);
+
+  // OLED splash on core 0 while the rest of setup() continues here
+  bootStages.spawn(BootStage::DISPLAY, bootDisplay);
+
+  bootStages.run(BootStage::CONFIG, bootConfig);
+
+  // Start WiFi task on Core 0 as soon as its settings are loaded; it runs the
+  // CREDENTIALS, NETWORK and SERVICES stages without holding up local control
   TaskHandle_t wifiTaskHandle = nullptr;
   BaseType_t result = xTaskCreatePinnedToCore(
     wifiTask,
@@ -1343,23 +2025,33 @@ void setup() {
   );
 
   if (result != pdPASS || wifiTaskHandle == nullptr) {
-    Serial.println(F("FATAL: WiFi task creation failed!"));
-    Serial.println(F("System will continue in offline mode"));
+    LOG_ERROR("FATAL: WiFi task creation failed!");
+    LOG_ERROR("System will continue in offline mode");
   } else {
-    Serial.println(F("WiFi task created successfully on Core 0"));
+    LOG_INFO("WiFi task created successfully on Core 0");
+  }
+
+  bootStages.run(BootStage::ENCODER, bootEncoder);
+  bootStages.run(BootStage::LEDS, bootLeds);
+  bootStages.run(BootStage::PWM, bootPwm);
+
+  // Pull updater polls its manifest once WiFi is up (disabled until configured)
+  if (!otaPuller.begin(configStore.data().otaPull)) {
+    LOG_ERROR("OTA pull task creation failed");
   }
 
   // Monitor heap health
   size_t freeHeap = ESP.getFreeHeap();
-  Serial.print(F("Free heap after setup: "));
-  Serial.print(freeHeap);
-  Serial.println(F(" bytes"));
+  LOG_INFO("Free heap after setup: %u bytes", freeHeap);
 
   if (freeHeap < 50000) {
-    Serial.println(F("WARNING: Low heap memory!"));
+    LOG_WARN("Low heap memory!");
   }
 
-  Serial.println(F("\nSetup complete - starting main loop\n"));
+  // loop() takes over relay, encoder and menu from here, whatever the WiFi state
+  bootStages.start(BootStage::LOCAL);
+  bootStages.ready(BootStage::LOCAL);
+  LOG_INFO("Setup complete - starting main loop");
 }
 
 // --- MAIN LOOP (CORE 1) ---
@@ -1370,6 +2062,25 @@ void loop() {
   // Feed watchdog
   esp_task_wdt_reset();
 
+  // Apply commands that arrived over MQTT
+  processActuatorCommands();
+
+  // Local input keeps the power manager in its performance profile; light
+  // sleep stops the clocks that PWM, LED effects, servo and stepper run on
+  pollButton();
+  int32_t encoderDelta = encoderInput.poll(encoderProfileFor(currentState));
+  if (encoderDelta != 0 || buttonInput.isDown()) {
+    powerManager.noteActivity();
+  }
+
+  // First pass on a screen: apps load their starting value
+  static AppState lastState = MENU;
+  bool entered = currentState != lastState;
+  lastState = currentState;
+  powerManager.setClocksIdle(currentState == MENU && sharedState.pwmPercent == 0 &&
+                             ledEffects.params().effect == LedEffect::OFF && !myServo.attached() &&
+                             stepperRemoteSteps.load() == 0 && !toneRemoteActive);
+
   // Read sensor with bounds checking
   int rawSensor = analogRead(Pins::SENSOR_IN);
   int constrainedSensor = constrain(rawSensor, 0, ADC_MAX_12BIT);
@@ -1392,23 +2103,13 @@ void loop() {
   if (currentRelayState != lastRelayState) {
     digitalWrite(Pins::RELAY, currentRelayState ? HIGH : LOW);
     lastRelayState = currentRelayState;
-    Serial.print(F("Relay: "));
-    Serial.println(currentRelayState ? F("ON") : F("OFF"));
+    LOG_INFO("Relay: %s", currentRelayState ? "ON" : "OFF");
   }
 
   // Handle UI state machine
   switch (currentState) {
     case MENU: {
-      long newPos = encoder.getCount() / 2;
-      if (newPos < 0) {
-        encoder.setCount((menuTotal - 1) * 2);
-        newPos = menuTotal - 1;
-      }
-      if (newPos >= menuTotal) {
-        encoder.setCount(0);
-        newPos = 0;
-      }
-      menuSelection = (int)newPos;
+      menuSelection = stepWrapped(menuSelection, encoderDelta, menuTotal);
 
       if (displayAvailable && xSemaphoreTake(i2cMutex, pdMS_TO_TICKS(100))) {
         display.clearDisplay();
@@ -1442,7 +2143,6 @@ void loop() {
 
       if (buttonPressed()) {
         currentState = (AppState)(menuSelection + 1);
-        encoder.setCount(0);
       }
       break;
     }
@@ -1458,48 +2158,49 @@ void loop() {
         xSemaphoreGive(i2cMutex);
       }
 
-      if (buttonPressed()) {
+      if (buttonClicked()) {
         if (xSemaphoreTake(stateMutex, pdMS_TO_TICKS(10))) {
           sharedState.relayState = !sharedState.relayState;
           xSemaphoreGive(stateMutex);
         }
       }
 
-      if (encoder.getCount() != 0) {
+      if (encoderDelta != 0 || buttonLongPressed()) {
         currentState = MENU;
-        encoder.setCount(menuSelection * 2);
       }
       break;
     }
 
     case APP_NEOPIXEL: {
-      drawHeader("NeoPixel Ring");
-
-      // Rainbow effect
-      static long pixelHue = 0;
-      static unsigned long lastPixUpdate = 0;
-
-      if (millis() - lastPixUpdate > Timing::NEOPIXEL_ANIMATION_MS) {
-        strip.rainbow(pixelHue);
-        strip.show();
-        pixelHue += 256;
-        if (pixelHue >= 5 * 65536) pixelHue = 0;
-        lastPixUpdate = millis();
+      drawHeader("NeoPixel Effects");
+
+      // Encoder picks the effect; it keeps running after the app is closed
+      if (encoderDelta != 0) {
+        int32_t effect = (int32_t)ledEffects.params().effect;
+        ledEffects.setEffect((LedEffect)stepWrapped(effect, encoderDelta, (int32_t)LedEffect::COUNT));
       }
 
       if (displayAvailable && xSemaphoreTake(i2cMutex, pdMS_TO_TICKS(100))) {
-        display.setCursor(0, 30);
-        display.println(F("Rainbow cycling"));
-        display.println(F("36 LEDs"));
+        const LedFrameStats& ledStats = ledEffects.stats();
+        display.setCursor(0, 20);
+        display.setTextSize(2);
+        display.println(ledEffectName((uint8_t)ledEffects.params().effect));
+
+        display.setTextSize(1);
+        display.setCursor(0, 40);
+        display.print(ledStats.fps);
+        display.print(F(" fps  "));
+        display.print(ledStats.renderAvgUs);
+        display.println(F(" us"));
+        display.setCursor(0, 50);
+        display.print(ledEffects.count());
+        display.println(F(" LEDs"));
         display.display();
         xSemaphoreGive(i2cMutex);
       }
 
       if (buttonPressed()) {
-        strip.clear();
-        strip.show();
         currentState = MENU;
-        encoder.setCount(menuSelection * 2);
       }
       break;
     }
@@ -1533,7 +2234,6 @@ void loop() {
 
       if (buttonPressed()) {
         currentState = MENU;
-        encoder.setCount(menuSelection * 2);
       }
       break;
     }
@@ -1576,7 +2276,6 @@ void loop() {
 
       if (buttonPressed()) {
         currentState = MENU;
-        encoder.setCount(menuSelection * 2);
       }
       break;
     }
@@ -1603,20 +2302,12 @@ void loop() {
           xSemaphoreGive(i2cMutex);
         }
         scanComplete = true;
+        scrollPosition = 0;
       }
 
       // Encoder controls scroll position
-      long newPos = encoder.getCount() / 2;
-      if (newPos < 0) {
-        encoder.setCount(0);
-        newPos = 0;
-      }
       int maxScroll = deviceCount > 4 ? deviceCount - 4 : 0;
-      if (newPos > maxScroll) {
-        encoder.setCount(maxScroll * 2);
-        newPos = maxScroll;
-      }
-      scrollPosition = (int)newPos;
+      scrollPosition = stepClamped(scrollPosition, encoderDelta, 0, maxScroll);
 
       if (displayAvailable && xSemaphoreTake(i2cMutex, pdMS_TO_TICKS(100))) {
         display.setCursor(0, 15);
@@ -1653,35 +2344,30 @@ void loop() {
       if (buttonPressed()) {
         scanComplete = false;  // Reset for next time
         currentState = MENU;
-        encoder.setCount(menuSelection * 2);
       }
       break;
     }
 
     case APP_SERVO: {
       drawHeader("Servo Control");
-      static bool servoAttached = false;
 
-      // Encoder controls angle (0-180)
-      long newPos = encoder.getCount() / 2;
-      if (newPos < 0) {
-        encoder.setCount(0);
-        newPos = 0;
-      }
-      if (newPos > 180) {
-        encoder.setCount(180 * 2);
-        newPos = 180;
-      }
-      int angle = (int)newPos;
+      // Encoder controls angle (0-180); a servo left holding keeps its angle
+      static int angle = 0;
+      if (entered) angle = myServo.attached() ? sharedState.servoAngle : 0;
+      angle = stepClamped(angle, encoderDelta, 0, 180);
 
-      // Attach servo if not already attached
-      if (!servoAttached) {
+      // Attach servo if not already attached (a remote command may have done so)
+      if (!myServo.attached()) {
         myServo.attach(Pins::SERVO);
-        servoAttached = true;
       }
 
       myServo.write(angle);
 
+      if (xSemaphoreTake(stateMutex, pdMS_TO_TICKS(10))) {
+        sharedState.servoAngle = (uint8_t)angle;
+        xSemaphoreGive(stateMutex);
+      }
+
       if (displayAvailable && xSemaphoreTake(i2cMutex, pdMS_TO_TICKS(100))) {
         display.setCursor(0, 20);
         display.setTextSize(2);
@@ -1702,11 +2388,12 @@ void loop() {
         xSemaphoreGive(i2cMutex);
       }
 
-      if (buttonPressed()) {
+      // Click releases the servo; long press leaves it holding the angle
+      if (buttonClicked()) {
         myServo.detach();
-        servoAttached = false;
         currentState = MENU;
-        encoder.setCount(menuSelection * 2);
+      } else if (buttonLongPressed()) {
+        currentState = MENU;
       }
       break;
     }
@@ -1714,22 +2401,22 @@ void loop() {
     case APP_PWM: {
       drawHeader("12V PWM Dimming");
 
-      // Encoder controls brightness (0-255)
-      long newPos = encoder.getCount() / 2;
-      if (newPos < 0) {
-        encoder.setCount(0);
-        newPos = 0;
+      // Encoder controls brightness (0-255), starting from the current output
+      static uint8_t brightness = 0;
+      if (entered && (brightness * 100) / 255 != sharedState.pwmPercent) {
+        brightness = (uint8_t)((sharedState.pwmPercent * 255) / 100);
       }
-      if (newPos > 255) {
-        encoder.setCount(255 * 2);
-        newPos = 255;
-      }
-      uint8_t brightness = (uint8_t)newPos;
+      brightness = (uint8_t)stepClamped(brightness, encoderDelta, 0, 255);
 
       // Apply gamma correction and update PWM
       uint8_t corrected = gammaCorrect(brightness);
       ledcWrite(Pins::PWM_MOSFET, corrected);
 
+      if (xSemaphoreTake(stateMutex, pdMS_TO_TICKS(10))) {
+        sharedState.pwmPercent = (uint8_t)((brightness * 100) / 255);
+        xSemaphoreGive(stateMutex);
+      }
+
       if (displayAvailable && xSemaphoreTake(i2cMutex, pdMS_TO_TICKS(100))) {
         display.setCursor(0, 20);
         display.setTextSize(2);
@@ -1752,10 +2439,16 @@ void loop() {
         xSemaphoreGive(i2cMutex);
       }
 
-      if (buttonPressed()) {
+      // Click turns the output off; long press leaves it at this level
+      if (buttonClicked()) {
         ledcWrite(Pins::PWM_MOSFET, 0);  // Turn off
+        if (xSemaphoreTake(stateMutex, pdMS_TO_TICKS(10))) {
+          sharedState.pwmPercent = 0;
+          xSemaphoreGive(stateMutex);
+        }
+        currentState = MENU;
+      } else if (buttonLongPressed()) {
         currentState = MENU;
-        encoder.setCount(menuSelection * 2);
       }
       break;
     }
@@ -1763,57 +2456,24 @@ void loop() {
     case APP_STEPPER: {
       drawHeader("Stepper Motor");
 
-      // Encoder controls speed/direction
-      long speed = encoder.getCount() / 4;  // -100 to +100
-      if (speed < -100) {
-        encoder.setCount(-100 * 4);
-        speed = -100;
-      }
-      if (speed > 100) {
-        encoder.setCount(100 * 4);
-        speed = 100;
-      }
+      // Encoder controls speed/direction (-100 to +100)
+      static long speed = 0;
+      if (entered) speed = 0;
+      speed = stepClamped(speed, encoderDelta, -100, 100);
 
       static unsigned long lastStepTime = 0;
-      static int stepPosition = 0;
-
-      // 28BYJ-48 half-step sequence (8 steps per cycle)
-      static const uint8_t halfStepSeq[8][4] = {
-        {1, 0, 0, 0},
-        {1, 1, 0, 0},
-        {0, 1, 0, 0},
-        {0, 1, 1, 0},
-        {0, 0, 1, 0},
-        {0, 0, 1, 1},
-        {0, 0, 0, 1},
-        {1, 0, 0, 1}
-      };
 
       if (speed != 0) {
         unsigned long stepDelay = map(abs((int)speed), 1, 100, 20, 2);  // 2-20ms
 
         if (millis() - lastStepTime > stepDelay) {
-          if (speed > 0) {
-            stepPosition++;
-            if (stepPosition >= 8) stepPosition = 0;
-          } else {
-            stepPosition--;
-            if (stepPosition < 0) stepPosition = 7;
-          }
-
-          digitalWrite(Pins::STEP1, halfStepSeq[stepPosition][0]);
-          digitalWrite(Pins::STEP2, halfStepSeq[stepPosition][1]);
-          digitalWrite(Pins::STEP3, halfStepSeq[stepPosition][2]);
-          digitalWrite(Pins::STEP4, halfStepSeq[stepPosition][3]);
-
+          stepperStep(speed > 0 ? 1 : -1);
           lastStepTime = millis();
         }
+        systemEvents.wakeWithin(EventTask::LOOP, stepDelay + 1);
       } else {
         // Hold position or release (optional: release to save power)
-        digitalWrite(Pins::STEP1, LOW);
-        digitalWrite(Pins::STEP2, LOW);
-        digitalWrite(Pins::STEP3, LOW);
-        digitalWrite(Pins::STEP4, LOW);
+        stepperRelease();
       }
 
       if (displayAvailable && xSemaphoreTake(i2cMutex, pdMS_TO_TICKS(100))) {
@@ -1842,12 +2502,8 @@ void loop() {
 
       if (buttonPressed()) {
         // Turn off all coils
-        digitalWrite(Pins::STEP1, LOW);
-        digitalWrite(Pins::STEP2, LOW);
-        digitalWrite(Pins::STEP3, LOW);
-        digitalWrite(Pins::STEP4, LOW);
+        stepperRelease();
         currentState = MENU;
-        encoder.setCount(menuSelection * 2);
       }
       break;
     }
@@ -1858,20 +2514,13 @@ void loop() {
       static unsigned long sampleIndex = 0;
 
       // Encoder controls frequency (100-4000 Hz)
-      long newPos = encoder.getCount() / 2;
-      if (newPos < TONE_FREQ_MIN) {
-        encoder.setCount(TONE_FREQ_MIN * 2);
-        newPos = TONE_FREQ_MIN;
-      }
-      if (newPos > TONE_FREQ_MAX) {
-        encoder.setCount(TONE_FREQ_MAX * 2);
-        newPos = TONE_FREQ_MAX;
-      }
-      uint16_t frequency = (uint16_t)newPos;
+      static uint16_t frequency = TONE_FREQ_MIN;
+      if (entered) frequency = TONE_FREQ_MIN;
+      frequency = (uint16_t)stepClamped(frequency, encoderDelta, TONE_FREQ_MIN, TONE_FREQ_MAX);
 
       // Initialize DAC on first entry
       if (!dacEnabled) {
-        dac_output_enable(DAC_CHANNEL_1);  // GPIO25
+        dac_output_enable(TONE_DAC_CHANNEL);
         dacEnabled = true;
       }
 
@@ -1881,13 +2530,14 @@ void loop() {
 
       if (micros() - lastSampleTime >= samplePeriod) {
         uint8_t sample = generateSineSample(frequency, sampleIndex);
-        dac_output_voltage(DAC_CHANNEL_1, sample);
+        dac_output_voltage(TONE_DAC_CHANNEL, sample);
         sampleIndex++;
         lastSampleTime = micros();
 
         // Prevent overflow
         if (sampleIndex > 1000000) sampleIndex = 0;
       }
+      systemEvents.wakeWithin(EventTask::LOOP, SystemEventConfig::ACTIVE_FRAME_MS);
 
       if (displayAvailable && xSemaphoreTake(i2cMutex, pdMS_TO_TICKS(100))) {
         display.setCursor(0, 20);
@@ -1897,7 +2547,8 @@ void loop() {
 
         display.setTextSize(1);
         display.setCursor(0, 40);
-        display.print(F("DAC: GPIO25"));
+        display.print(F("DAC: GPIO"));
+        display.print(Pins::TONE_DAC);
 
         display.setCursor(0, 50);
         display.print(F("Range: "));
@@ -1912,11 +2563,10 @@ void loop() {
 
       if (buttonPressed()) {
         // Disable DAC
-        dac_output_disable(DAC_CHANNEL_1);
+        dac_output_disable(TONE_DAC_CHANNEL);
         dacEnabled = false;
         sampleIndex = 0;
         currentState = MENU;
-        encoder.setCount(menuSelection * 2);
       }
       break;
     }
@@ -1937,7 +2587,6 @@ void loop() {
 
       if (buttonPressed()) {
         currentState = MENU;
-        encoder.setCount(menuSelection * 2);
       }
       break;
     }
@@ -1946,17 +2595,17 @@ void loop() {
   // Periodic heap monitoring (every 10 seconds)
   if (millis() - lastMemCheck > 10000) {
     size_t freeHeap = ESP.getFreeHeap();
-    Serial.print(F("Free heap: "));
-    Serial.print(freeHeap);
-    Serial.println(F(" bytes"));
+    LOG_DEBUG("Free heap: %u bytes", freeHeap);
 
     if (freeHeap < 30000) {
-      Serial.println(F("WARNING: Heap getting low!"));
+      LOG_WARN("Heap getting low! (%u bytes)", freeHeap);
     }
 
     lastMemCheck = millis();
   }
 
-  // Yield to scheduler
-  delay(10);
+  // Sleep until input, a command, or the next step one of the apps asked for
+  systemEvents.inputHandled();
+  if (buttonInput.pending()) systemEvents.wakeWithin(EventTask::LOOP, 0);
+  systemEvents.wait(EventTask::LOOP, SystemEventConfig::LOOP_IDLE_MS);
 }
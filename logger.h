@@ -0,0 +1,425 @@
+/*
+ * ESP32 Multitool - Logging Subsystem
+ * Levelled, rate-limited, non-blocking logging
+ *
+ * Call sites never touch the UART. Each LOG_* macro packs a pointer to the
+ * format string (string literals live in flash) plus up to six 32-bit
+ * arguments into a fixed-size binary record and pushes it into a lock-free
+ * ring buffer. A low-priority drain task formats records and fans them out
+ * to the sinks: UART, the in-RAM tail served by /api/logs, and MQTT.
+ *
+ * Because formatting is deferred, %s arguments must point at strings with
+ * static lifetime (literals, F() strings, global buffers). Never pass a
+ * stack buffer or String::c_str().
+ */
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <type_traits>
+
+// --- CONFIGURATION ---
+
+namespace LogConfig {
+  const uint8_t RING_SLOTS = 64;          // Must be a power of two
+  const uint8_t MAX_ARGS = 6;
+  const uint8_t TAIL_LINES = 32;          // Lines kept for /api/logs and MQTT
+  const uint8_t LINE_LEN = 96;
+  const uint16_t TASK_STACK = 3072;
+  const uint8_t TASK_PRIORITY = 1;        // Lowest non-idle priority
+  const uint8_t TASK_CORE = 1;            // Keep UART work off the network core
+  const uint8_t MQTT_LINES_PER_CALL = 4;  // Bound MQTT sink work per wifiTask pass
+}
+
+enum class LogLevel : uint8_t {
+  Error = 0,
+  Warn = 1,
+  Info = 2,
+  Debug = 3
+};
+
+// Records above this level are compiled out entirely
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 3
+#endif
+
+// --- RECORD FORMAT ---
+
+struct LogRecord {
+  uint32_t timestampMs;
+  const char* format;                 // Points into flash, never copied
+  uint32_t args[LogConfig::MAX_ARGS];
+  uint16_t suppressed;                // Messages dropped by this call site's rate limiter
+  LogLevel level;
+  uint8_t argCount;
+};
+
+// sequence is stored minus the slot index, so the zero-initialised ring is
+// already valid: records logged before loggerBegin() queue normally
+struct LogSlot {
+  std::atomic<uint32_t> sequence;
+  LogRecord record;
+};
+
+struct LogLine {
+  uint32_t seq;
+  uint32_t timestampMs;
+  LogLevel level;
+  char text[LogConfig::LINE_LEN];
+};
+
+// --- STATE ---
+
+static LogSlot logRing[LogConfig::RING_SLOTS];
+static std::atomic<uint32_t> logEnqueuePos(0);
+static uint32_t logDequeuePos = 0;               // Drain task only
+static std::atomic<uint32_t> logDroppedCount(0);
+static TaskHandle_t logTaskHandle = nullptr;
+
+// Runtime thresholds per sink
+LogLevel logLevelSerial = LogLevel::Info;
+LogLevel logLevelMqtt = LogLevel::Warn;
+
+// Formatted tail shared by the drain task (writer) and network task (reader)
+static LogLine logTail[LogConfig::TAIL_LINES];
+static uint32_t logTailNextSeq = 0;
+static uint32_t logMqttNextSeq = 0;              // wifiTask only
+static portMUX_TYPE logTailMux = portMUX_INITIALIZER_UNLOCKED;
+
+static const char LOG_LEVEL_CHARS[] = "EWID";
+
+// --- ARGUMENT PACKING ---
+
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, uint32_t>::type
+logArg(T value) {
+  return (uint32_t)value;
+}
+
+inline uint32_t logArg(float value) {
+  uint32_t word;
+  memcpy(&word, &value, sizeof(word));
+  return word;
+}
+
+inline uint32_t logArg(double value) {
+  return logArg((float)value);
+}
+
+inline uint32_t logArg(const char* str) {
+  return (uint32_t)(uintptr_t)str;
+}
+
+inline uint32_t logArg(const __FlashStringHelper* str) {
+  return (uint32_t)(uintptr_t)str;
+}
+
+// --- PRODUCER SIDE ---
+
+/**
+ * Push a record into the ring (bounded MPMC queue, one CAS per message)
+ * Safe to call from any task on either core. Never blocks: when the ring
+ * is full the record is counted as dropped and discarded.
+ */
+bool logEnqueue(LogLevel level, uint16_t suppressed, const char* format,
+                const uint32_t* args, uint8_t argCount) {
+  uint32_t pos = logEnqueuePos.load(std::memory_order_relaxed);
+  LogSlot* slot;
+
+  for (;;) {
+    uint32_t index = pos & (LogConfig::RING_SLOTS - 1);
+    slot = &logRing[index];
+    uint32_t seq = slot->sequence.load(std::memory_order_acquire) + index;
+    int32_t diff = (int32_t)seq - (int32_t)pos;
+
+    if (diff == 0) {
+      if (logEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      logDroppedCount.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    } else {
+      pos = logEnqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+
+  LogRecord& rec = slot->record;
+  rec.timestampMs = millis();
+  rec.format = format;
+  rec.level = level;
+  rec.suppressed = suppressed;
+  rec.argCount = argCount;
+  memcpy(rec.args, args, argCount * sizeof(uint32_t));
+  slot->sequence.store(pos + 1 - (pos & (LogConfig::RING_SLOTS - 1)), std::memory_order_release);
+
+  if (logTaskHandle != nullptr) {
+    xTaskNotifyGive(logTaskHandle);
+  }
+  return true;
+}
+
+template <typename... Args>
+void logWrite(LogLevel level, uint16_t suppressed, const char* format, Args... args) {
+  static_assert(sizeof...(Args) <= LogConfig::MAX_ARGS, "Too many log arguments");
+  if (level > logLevelSerial && level > logLevelMqtt) return;
+  const uint32_t packed[] = { logArg(args)..., 0 };
+  logEnqueue(level, suppressed, format, packed, sizeof...(Args));
+}
+
+/**
+ * Per-call-site rate limiter
+ * One instance lives in each LOG_RATELIMITED expansion. Races between
+ * cores can at worst let an extra message through, which is harmless.
+ */
+struct LogRateLimit {
+  uint32_t lastMs = 0;
+  uint16_t suppressed = 0;
+  bool primed = false;
+
+  bool allow(uint32_t intervalMs) {
+    uint32_t now = millis();
+    if (primed && now - lastMs < intervalMs) {
+      if (suppressed < 0xFFFF) suppressed++;
+      return false;
+    }
+    primed = true;
+    lastMs = now;
+    return true;
+  }
+
+  uint16_t takeSuppressed() {
+    uint16_t count = suppressed;
+    suppressed = 0;
+    return count;
+  }
+};
+
+#define LOG_AT(level, fmt, ...) \
+  do { \
+    if ((int)(level) <= LOG_COMPILE_LEVEL) logWrite(level, 0, fmt, ##__VA_ARGS__); \
+  } while (0)
+
+#define LOG_ERROR(fmt, ...) LOG_AT(LogLevel::Error, fmt, ##__VA_ARGS__)
+#define LOG_WARN(fmt, ...)  LOG_AT(LogLevel::Warn, fmt, ##__VA_ARGS__)
+#define LOG_INFO(fmt, ...)  LOG_AT(LogLevel::Info, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(fmt, ...) LOG_AT(LogLevel::Debug, fmt, ##__VA_ARGS__)
+
+// Emit at most once per intervalMs from this call site; drops are reported on the next line
+#define LOG_RATELIMITED(level, intervalMs, fmt, ...) \
+  do { \
+    static LogRateLimit logLimit_; \
+    if ((int)(level) <= LOG_COMPILE_LEVEL && logLimit_.allow(intervalMs)) { \
+      logWrite(level, logLimit_.takeSuppressed(), fmt, ##__VA_ARGS__); \
+    } \
+  } while (0)
+
+// --- CONSUMER SIDE ---
+
+/**
+ * Render a record into text
+ * Walks the format string and feeds each conversion one packed word.
+ */
+size_t logFormat(const LogRecord& rec, char* out, size_t outLen) {
+  size_t len = 0;
+  uint8_t argIndex = 0;
+  const char* p = rec.format;
+
+  while (*p != '\0' && len + 1 < outLen) {
+    if (*p != '%') {
+      out[len++] = *p++;
+      continue;
+    }
+
+    // Collect one conversion spec, dropping length modifiers (all args are 32-bit)
+    char spec[12];
+    size_t specLen = 0;
+    spec[specLen++] = *p++;
+    while (*p != '\0' && strchr("-+ #0123456789.", *p) != nullptr && specLen < sizeof(spec) - 2) {
+      spec[specLen++] = *p++;
+    }
+    while (*p == 'l' || *p == 'h' || *p == 'z') p++;
+    if (*p == '\0') break;
+
+    char conv = *p++;
+    if (conv == '%') {
+      out[len++] = '%';
+      continue;
+    }
+    spec[specLen++] = conv;
+    spec[specLen] = '\0';
+
+    uint32_t word = argIndex < rec.argCount ? rec.args[argIndex] : 0;
+    argIndex++;
+
+    int written;
+    switch (conv) {
+      case 's': {
+        const char* str = (const char*)(uintptr_t)word;
+        written = snprintf(out + len, outLen - len, spec, str != nullptr ? str : "(null)");
+        break;
+      }
+      case 'f': case 'e': case 'g': {
+        float value;
+        memcpy(&value, &word, sizeof(value));
+        written = snprintf(out + len, outLen - len, spec, (double)value);
+        break;
+      }
+      case 'd': case 'i': case 'c':
+        written = snprintf(out + len, outLen - len, spec, (int)word);
+        break;
+      default:
+        written = snprintf(out + len, outLen - len, spec, (unsigned)word);
+        break;
+    }
+    if (written < 0) break;
+    len += (size_t)written;
+    if (len >= outLen) len = outLen - 1;
+  }
+
+  if (rec.suppressed > 0 && len + 1 < outLen) {
+    int written = snprintf(out + len, outLen - len, " (+%u suppressed)", rec.suppressed);
+    if (written > 0) len += (size_t)written;
+    if (len >= outLen) len = outLen - 1;
+  }
+
+  out[len] = '\0';
+  return len;
+}
+
+static bool logDequeue(LogRecord& out) {
+  uint32_t index = logDequeuePos & (LogConfig::RING_SLOTS - 1);
+  LogSlot& slot = logRing[index];
+  if (slot.sequence.load(std::memory_order_acquire) + index != logDequeuePos + 1) {
+    return false;
+  }
+  out = slot.record;
+  slot.sequence.store(logDequeuePos + LogConfig::RING_SLOTS - index, std::memory_order_release);
+  logDequeuePos++;
+  return true;
+}
+
+static void logAppendTail(const LogRecord& rec, const char* text) {
+  portENTER_CRITICAL(&logTailMux);
+  LogLine& line = logTail[logTailNextSeq % LogConfig::TAIL_LINES];
+  line.seq = logTailNextSeq++;
+  line.timestampMs = rec.timestampMs;
+  line.level = rec.level;
+  strncpy(line.text, text, sizeof(line.text) - 1);
+  line.text[sizeof(line.text) - 1] = '\0';
+  portEXIT_CRITICAL(&logTailMux);
+}
+
+/**
+ * Drain task: formats records and writes them to the sinks
+ * Runs at the lowest priority so a slow UART only ever stalls this task.
+ */
+void logTask(void* parameter) {
+  LogRecord rec;
+  char text[LogConfig::LINE_LEN];
+
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+
+    while (logDequeue(rec)) {
+      logFormat(rec, text, sizeof(text));
+
+      if (rec.level <= logLevelSerial) {
+        Serial.printf("[%8lu] %c: %s\n", (unsigned long)rec.timestampMs,
+                      LOG_LEVEL_CHARS[(uint8_t)rec.level], text);
+      }
+      logAppendTail(rec, text);
+    }
+
+    uint32_t dropped = logDroppedCount.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0) {
+      Serial.printf("[%8lu] W: log ring overflow, %lu records dropped\n",
+                    millis(), (unsigned long)dropped);
+    }
+  }
+}
+
+/**
+ * Start the drain task
+ * Call once from setup() right after Serial.begin(). The ring needs no
+ * setup, so records logged before this are queued (up to RING_SLOTS) and
+ * flushed once the task starts.
+ */
+bool loggerBegin() {
+  BaseType_t result = xTaskCreatePinnedToCore(
+    logTask,
+    "LogTask",
+    LogConfig::TASK_STACK,
+    nullptr,
+    LogConfig::TASK_PRIORITY,
+    &logTaskHandle,
+    LogConfig::TASK_CORE
+  );
+  return result == pdPASS;
+}
+
+/**
+ * Wait (bounded) for queued records to reach the serial port
+ * For paths that end in deep sleep, where the drain task would not get
+ * another chance to run.
+ */
+void loggerFlush(uint32_t timeoutMs) {
+  uint32_t start = millis();
+  while (logDequeuePos != logEnqueuePos.load(std::memory_order_relaxed) && millis() - start < timeoutMs) {
+    delay(1);
+  }
+  delay(2);  // Last dequeued record is still being formatted
+  Serial.flush();
+}
+
+/**
+ * Copy one tail line by sequence number
+ * @return false if the line has not been written yet or was overwritten
+ */
+bool logTailRead(uint32_t seq, LogLine& out) {
+  bool found = false;
+  portENTER_CRITICAL(&logTailMux);
+  const LogLine& line = logTail[seq % LogConfig::TAIL_LINES];
+  if (seq < logTailNextSeq && line.seq == seq) {
+    out = line;
+    found = true;
+  }
+  portEXIT_CRITICAL(&logTailMux);
+  return found;
+}
+
+uint32_t logTailNext() {
+  portENTER_CRITICAL(&logTailMux);
+  uint32_t next = logTailNextSeq;
+  portEXIT_CRITICAL(&logTailMux);
+  return next;
+}
+
+uint32_t logTailOldest() {
+  uint32_t next = logTailNext();
+  return next > LogConfig::TAIL_LINES ? next - LogConfig::TAIL_LINES : 0;
+}
+
+/**
+ * Fetch the next tail line destined for the MQTT sink
+ * Called from wifiTask only; lines overwritten before they were published
+ * are skipped rather than blocking the drain task.
+ */
+bool logNextMqttLine(LogLine& out) {
+  uint32_t oldest = logTailOldest();
+  if (logMqttNextSeq < oldest) logMqttNextSeq = oldest;
+
+  while (logMqttNextSeq < logTailNext()) {
+    bool found = logTailRead(logMqttNextSeq++, out);
+    if (found && out.level <= logLevelMqtt) return true;
+  }
+  return false;
+}
+
+char logLevelChar(LogLevel level) {
+  return LOG_LEVEL_CHARS[(uint8_t)level];
+}
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * ESP32 Multitool - Home Assistant MQTT Discovery
+ * Publishes retained discovery configs so entities appear without YAML
+ *
+ * Every entity is one line in DISCOVERY_ENTITIES. The common parts of
+ * each config (base topic, unique id, availability, device block) are
+ * added here; the table only carries the component type and the
+ * entity-specific keys, written with Home Assistant's abbreviated names
+ * and "~" standing for the esp32/multitool base topic.
+ *
+ * Configs go out in one burst right after CONNACK. They are streamed with
+ * beginPublish()/endPublish(), so they don't need a larger PubSubClient
+ * buffer.
+ */
+
+#ifndef MQTT_DISCOVERY_H
+#define MQTT_DISCOVERY_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <PubSubClient.h>
+
+namespace DiscoveryConfig {
+  const char PREFIX[] = "homeassistant";
+  const char BASE_TOPIC[] = "esp32/multitool";
+  const char DEVICE_NAME[] = "ESP32 Multitool";
+  const char DEVICE_MODEL[] = "Swiss Army Multitool";
+  const char SW_VERSION[] = FIRMWARE_VERSION;
+}
+
+struct DiscoveryEntity {
+  const char* component;   // Home Assistant platform: switch, light, number, sensor, ...
+  const char* objectId;    // Unique within the device; also the entity id suffix
+  const char* name;
+  const char* fields;      // Entity-specific JSON members, without braces
+};
+
+const DiscoveryEntity DISCOVERY_ENTITIES[] = {
+  { "switch", "relay", "Relay",
+    "\"cmd_t\":\"~/relay/set\",\"stat_t\":\"~/relay/state\"" },
+  { "light", "pwm", "PWM Dimmer",
+    "\"cmd_t\":\"~/pwm/set\",\"stat_t\":\"~/pwm/state\","
+    "\"stat_val_tpl\":\"{{ 'ON' if value|int > 0 else 'OFF' }}\","
+    "\"bri_cmd_t\":\"~/pwm/set\",\"bri_stat_t\":\"~/pwm/state\",\"bri_scl\":100,"
+    "\"on_cmd_type\":\"brightness\",\"pl_off\":\"0\"" },
+  { "number", "servo", "Servo",
+    "\"cmd_t\":\"~/servo/set\",\"stat_t\":\"~/servo/state\",\"min\":0,\"max\":180,"
+    "\"mode\":\"slider\",\"unit_of_meas\":\"°\"" },
+  { "sensor", "sensor", "Sensor",
+    "\"stat_t\":\"~/sensor\",\"dev_cla\":\"voltage\",\"stat_cla\":\"measurement\","
+    "\"unit_of_meas\":\"V\",\"val_tpl\":\"{{ (value|float * 3.3 / 4095) | round(2) }}\"" },
+  { "sensor", "heap", "Free Heap",
+    "\"stat_t\":\"~/heap/state\",\"dev_cla\":\"data_size\",\"stat_cla\":\"measurement\","
+    "\"unit_of_meas\":\"B\",\"ent_cat\":\"diagnostic\"" },
+  { "sensor", "rssi", "WiFi Signal",
+    "\"stat_t\":\"~/rssi/state\",\"dev_cla\":\"signal_strength\",\"stat_cla\":\"measurement\","
+    "\"unit_of_meas\":\"dBm\",\"ent_cat\":\"diagnostic\"" },
+  { "sensor", "uptime", "Uptime",
+    "\"stat_t\":\"~/uptime/state\",\"dev_cla\":\"duration\",\"stat_cla\":\"total_increasing\","
+    "\"unit_of_meas\":\"s\",\"ent_cat\":\"diagnostic\"" }
+};
+
+const uint8_t DISCOVERY_ENTITY_COUNT = sizeof(DISCOVERY_ENTITIES) / sizeof(DISCOVERY_ENTITIES[0]);
+
+/**
+ * Node id used in discovery topics and unique ids: esp32_multitool_<mac>
+ */
+static void discoveryNodeId(char* out, size_t outLen) {
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  snprintf(out, outLen, "esp32_multitool_%02x%02x%02x", mac[3], mac[4], mac[5]);
+}
+
+/**
+ * Build one discovery config
+ * @return Payload length, or 0 if it does not fit
+ */
+size_t discoveryBuildConfig(const DiscoveryEntity& entity, const char* nodeId,
+                            char* out, size_t outLen) {
+  int written = snprintf(out, outLen,
+    "{\"~\":\"%s\",\"name\":\"%s\",\"uniq_id\":\"%s_%s\",\"obj_id\":\"%s_%s\","
+    "\"avty_t\":\"~/state\",\"pl_avail\":\"online\",\"pl_not_avail\":\"offline\",%s,"
+    "\"dev\":{\"ids\":[\"%s\"],\"name\":\"%s\",\"mdl\":\"%s\",\"mf\":\"DIY\",\"sw\":\"%s\"}}",
+    DiscoveryConfig::BASE_TOPIC, entity.name, nodeId, entity.objectId, nodeId, entity.objectId,
+    entity.fields, nodeId, DiscoveryConfig::DEVICE_NAME, DiscoveryConfig::DEVICE_MODEL,
+    DiscoveryConfig::SW_VERSION);
+  if (written < 0 || (size_t)written >= outLen) return 0;
+  return (size_t)written;
+}
+
+/**
+ * Publish every discovery config, retained, in one burst
+ * Call from the MQTT connected callback.
+ * @return Number of configs published
+ */
+uint8_t discoveryPublishAll(PubSubClient& client) {
+  char nodeId[24];
+  discoveryNodeId(nodeId, sizeof(nodeId));
+
+  static char payload[640];
+  char topic[96];
+  uint8_t published = 0;
+
+  for (uint8_t i = 0; i < DISCOVERY_ENTITY_COUNT; i++) {
+    const DiscoveryEntity& entity = DISCOVERY_ENTITIES[i];
+    size_t len = discoveryBuildConfig(entity, nodeId, payload, sizeof(payload));
+    if (len == 0) {
+      LOG_ERROR("Discovery config for %s too large", entity.objectId);
+      continue;
+    }
+    snprintf(topic, sizeof(topic), "%s/%s/%s/%s/config",
+             DiscoveryConfig::PREFIX, entity.component, nodeId, entity.objectId);
+
+    if (client.beginPublish(topic, len, true) &&
+        client.write((const uint8_t*)payload, len) == len &&
+        client.endPublish()) {
+      published++;
+    }
+  }
+
+  LOG_INFO("Home Assistant discovery: %u/%u entities published", published, DISCOVERY_ENTITY_COUNT);
+  return published;
+}
+
+#endif
@@ -0,0 +1,488 @@
+/*
+ * ESP32 Multitool - MQTT Connection Manager
+ * Non-blocking connect state machine for PubSubClient
+ *
+ * PubSubClient::connect() blocks through DNS, the TCP handshake and the
+ * CONNACK wait. This manager performs each of those steps as a separate
+ * non-blocking state, advanced one step per wifiTask pass, so the web
+ * server keeps running while the broker is slow or down:
+ *
+ *   BACKOFF -> RESOLVING -> CONNECTING -> AWAIT_CONNACK -> CONNECTED
+ *
+ * DNS uses the lwIP async resolver, TCP uses a non-blocking socket, and
+ * CONNECT/CONNACK are exchanged directly on that socket. Once the broker
+ * accepts the session, the socket is handed to PubSubClient through
+ * MqttTransport, which replays the CONNACK so PubSubClient::connect()
+ * returns immediately without touching the network.
+ */
+
+#ifndef MQTT_MANAGER_H
+#define MQTT_MANAGER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <PubSubClient.h>
+#include <atomic>
+#include <lwip/sockets.h>
+#include <lwip/dns.h>
+#include <lwip/tcpip.h>
+
+// --- CONFIGURATION ---
+
+namespace MqttTiming {
+  const uint32_t BACKOFF_MIN_MS = 1000;
+  const uint32_t BACKOFF_MAX_MS = 60000;
+  const uint32_t DNS_TIMEOUT_MS = 5000;
+  const uint32_t CONNECT_TIMEOUT_MS = 5000;
+  const uint32_t CONNACK_TIMEOUT_MS = 5000;
+  const uint32_t SEND_TIMEOUT_MS = 1000;   // Bounds socket writes once connected
+  const uint16_t KEEPALIVE_S = 15;
+}
+
+struct MqttConfig {
+  char server[64];
+  uint16_t port;
+  char clientId[32];
+  char user[32];
+  char pass[64];
+};
+
+// Last will: published by the broker if we drop off without DISCONNECT
+struct MqttWill {
+  const char* topic;
+  const char* message;
+  bool retain;
+};
+
+enum class MqttConnState : uint8_t {
+  IDLE,           // No WiFi, nothing to do
+  BACKOFF,        // Waiting before the next attempt
+  RESOLVING,      // Async DNS lookup in flight
+  CONNECTING,     // Non-blocking TCP connect in flight
+  AWAIT_CONNACK,  // CONNECT sent, waiting for the broker
+  CONNECTED
+};
+
+struct MqttStats {
+  uint32_t attempts;
+  uint32_t failures;
+  uint32_t lastConnectLatencyMs;  // Attempt start to CONNACK
+  uint32_t lastTickUs;
+  uint32_t maxTickUs;
+  uint64_t totalBlockedUs;        // Time wifiTask spent inside tick()
+  uint32_t connectedSinceMs;
+};
+
+// --- TRANSPORT ---
+
+/**
+ * WiFiClient that can replay a buffered CONNACK to PubSubClient
+ * While replaying, writes are swallowed (PubSubClient re-sends CONNECT,
+ * which the broker has already seen) and reads come from the buffer.
+ */
+class MqttTransport : public WiFiClient {
+public:
+  void adopt(int fd) {
+    WiFiClient::operator=(WiFiClient(fd));
+  }
+
+  void beginReplay(const uint8_t* bytes, uint8_t length) {
+    memcpy(_replay, bytes, length);
+    _replayLen = length;
+    _replayPos = 0;
+    _replaying = true;
+  }
+
+  void endReplay() {
+    _replaying = false;
+  }
+
+  size_t write(uint8_t b) override {
+    return _replaying ? 1 : WiFiClient::write(b);
+  }
+
+  size_t write(const uint8_t* buf, size_t size) override {
+    return _replaying ? size : WiFiClient::write(buf, size);
+  }
+
+  int available() override {
+    return _replaying ? (int)(_replayLen - _replayPos) : WiFiClient::available();
+  }
+
+  int read() override {
+    if (!_replaying) return WiFiClient::read();
+    return _replayPos < _replayLen ? _replay[_replayPos++] : -1;
+  }
+
+  int read(uint8_t* buf, size_t size) override {
+    if (!_replaying) return WiFiClient::read(buf, size);
+    size_t n = 0;
+    while (n < size && _replayPos < _replayLen) buf[n++] = _replay[_replayPos++];
+    return (int)n;
+  }
+
+private:
+  uint8_t _replay[4];
+  uint8_t _replayLen = 0;
+  uint8_t _replayPos = 0;
+  bool _replaying = false;
+};
+
+// --- PACKET HELPERS ---
+
+static size_t mqttPutString(uint8_t* buf, size_t pos, size_t cap, const char* str) {
+  size_t len = strlen(str);
+  if (pos + 2 + len > cap) return 0;
+  buf[pos++] = (uint8_t)(len >> 8);
+  buf[pos++] = (uint8_t)(len & 0xFF);
+  memcpy(buf + pos, str, len);
+  return pos + len;
+}
+
+/**
+ * Build an MQTT 3.1.1 CONNECT packet
+ * @return Packet length, or 0 if it does not fit in cap
+ */
+size_t mqttBuildConnect(uint8_t* buf, size_t cap, const MqttConfig& config,
+                        const MqttWill* will, uint16_t keepAliveS) {
+  // Variable header + payload first, leaving room for a 5-byte fixed header
+  const size_t HEADER_ROOM = 5;
+  uint8_t* body = buf + HEADER_ROOM;
+  size_t bodyCap = cap > HEADER_ROOM ? cap - HEADER_ROOM : 0;
+  size_t pos = 0;
+
+  pos = mqttPutString(body, pos, bodyCap, "MQTT");
+  if (pos == 0 || pos + 4 > bodyCap) return 0;
+
+  uint8_t flags = 0x02;  // Clean session
+  if (will != nullptr) flags |= 0x04 | (will->retain ? 0x20 : 0);
+  if (config.user[0] != '\0') {
+    flags |= 0x80;
+    if (config.pass[0] != '\0') flags |= 0x40;
+  }
+  body[pos++] = 4;  // Protocol level 3.1.1
+  body[pos++] = flags;
+  body[pos++] = (uint8_t)(keepAliveS >> 8);
+  body[pos++] = (uint8_t)(keepAliveS & 0xFF);
+
+  pos = mqttPutString(body, pos, bodyCap, config.clientId);
+  if (pos != 0 && will != nullptr) {
+    pos = mqttPutString(body, pos, bodyCap, will->topic);
+    if (pos != 0) pos = mqttPutString(body, pos, bodyCap, will->message);
+  }
+  if (pos != 0 && (flags & 0x80)) pos = mqttPutString(body, pos, bodyCap, config.user);
+  if (pos != 0 && (flags & 0x40)) pos = mqttPutString(body, pos, bodyCap, config.pass);
+  if (pos == 0) return 0;
+
+  // Encode remaining length, then slide the fixed header up against the body
+  uint8_t header[HEADER_ROOM];
+  size_t headerLen = 0;
+  header[headerLen++] = 0x10;  // CONNECT
+  size_t remaining = pos;
+  do {
+    uint8_t digit = remaining % 128;
+    remaining /= 128;
+    if (remaining > 0) digit |= 0x80;
+    header[headerLen++] = digit;
+  } while (remaining > 0 && headerLen < HEADER_ROOM);
+
+  size_t start = HEADER_ROOM - headerLen;
+  memcpy(buf + start, header, headerLen);
+  memmove(buf, buf + start, headerLen + pos);
+  return headerLen + pos;
+}
+
+// --- CONNECTION MANAGER ---
+
+// Async DNS result, written from the lwIP thread
+static std::atomic<uint32_t> mqttDnsGeneration(0);
+static std::atomic<uint8_t> mqttDnsStatus(0);   // 0 = pending, 1 = resolved, 2 = failed
+static uint32_t mqttDnsAddress = 0;
+static char mqttDnsHost[64];
+
+static void mqttDnsFound(const char* name, const ip_addr_t* addr, void* arg) {
+  if ((uint32_t)(uintptr_t)arg != mqttDnsGeneration.load()) return;  // Stale lookup
+  if (addr != nullptr && IP_IS_V4(addr)) {
+    mqttDnsAddress = ip4_addr_get_u32(ip_2_ip4(addr));
+    mqttDnsStatus.store(1);
+  } else {
+    mqttDnsStatus.store(2);
+  }
+}
+
+static void mqttDnsStart(void* arg) {
+  // Runs in the lwIP thread, where the raw DNS API must be called
+  ip_addr_t addr;
+  err_t err = dns_gethostbyname(mqttDnsHost, &addr, mqttDnsFound, arg);
+  if (err == ERR_OK) {
+    mqttDnsFound(mqttDnsHost, &addr, arg);
+  } else if (err != ERR_INPROGRESS) {
+    mqttDnsFound(mqttDnsHost, nullptr, arg);
+  }
+}
+
+class MqttConnectionManager {
+public:
+  typedef void (*ConnectedCallback)();
+
+  void begin(PubSubClient& client, MqttTransport& transport, const MqttConfig& config,
+             const MqttWill* will, ConnectedCallback onConnected) {
+    _client = &client;
+    _transport = &transport;
+    _config = &config;
+    _will = will;
+    _onConnected = onConnected;
+    _client->setKeepAlive(MqttTiming::KEEPALIVE_S);
+    _client->setSocketTimeout(1);
+    enterBackoff(0);
+  }
+
+  /**
+   * Advance the state machine by at most one non-blocking step
+   * Call every wifiTask pass, interleaved with server.handleClient().
+   */
+  void tick() {
+    uint32_t startUs = micros();
+
+    if (!WiFi.isConnected()) {
+      if (_state != MqttConnState::IDLE) {
+        if (_state == MqttConnState::CONNECTED) _transport->stop();
+        closeSocket();
+        _state = MqttConnState::IDLE;
+      }
+    } else {
+      switch (_state) {
+        case MqttConnState::IDLE:          enterBackoff(0); break;
+        case MqttConnState::BACKOFF:       tickBackoff(); break;
+        case MqttConnState::RESOLVING:     tickResolving(); break;
+        case MqttConnState::CONNECTING:    tickConnecting(); break;
+        case MqttConnState::AWAIT_CONNACK: tickAwaitConnack(); break;
+        case MqttConnState::CONNECTED:     tickConnected(); break;
+      }
+    }
+
+    uint32_t elapsedUs = micros() - startUs;
+    _stats.lastTickUs = elapsedUs;
+    if (elapsedUs > _stats.maxTickUs) _stats.maxTickUs = elapsedUs;
+    _stats.totalBlockedUs += elapsedUs;
+  }
+
+  /**
+   * Drop the current session and reconnect promptly
+   * Used when the broker configuration changes.
+   */
+  void reconnect() {
+    if (_state == MqttConnState::CONNECTED) {
+      _client->disconnect();
+    }
+    closeSocket();
+    _failures = 0;
+    enterBackoff(0);
+  }
+
+  bool connected() const { return _state == MqttConnState::CONNECTED; }
+  MqttConnState state() const { return _state; }
+  const MqttStats& stats() const { return _stats; }
+  uint32_t backoffMs() const { return _backoffMs; }
+
+  const char* stateName() const {
+    switch (_state) {
+      case MqttConnState::IDLE:          return "idle";
+      case MqttConnState::BACKOFF:       return "backoff";
+      case MqttConnState::RESOLVING:     return "resolving";
+      case MqttConnState::CONNECTING:    return "connecting";
+      case MqttConnState::AWAIT_CONNACK: return "await_connack";
+      case MqttConnState::CONNECTED:     return "connected";
+    }
+    return "unknown";
+  }
+
+private:
+  void enterBackoff(uint32_t delayMs) {
+    _state = MqttConnState::BACKOFF;
+    _backoffMs = delayMs;
+    _stateSinceMs = millis();
+  }
+
+  /**
+   * Record a failed attempt and schedule the next one
+   * Exponential backoff with equal jitter: half the window is fixed, half
+   * random, so a fleet that lost the broker together doesn't reconnect together.
+   */
+  void fail(const char* reason) {
+    closeSocket();
+    _stats.failures++;
+    if (_failures < 16) _failures++;
+
+    uint32_t window = MqttTiming::BACKOFF_MIN_MS << (_failures - 1);
+    if (window > MqttTiming::BACKOFF_MAX_MS || window == 0) window = MqttTiming::BACKOFF_MAX_MS;
+    uint32_t delayMs = window / 2 + esp_random() % (window / 2 + 1);
+
+    LOG_RATELIMITED(LogLevel::Warn, 10000, "MQTT connect failed (%s), retry in %u ms", reason, delayMs);
+    enterBackoff(delayMs);
+  }
+
+  void tickBackoff() {
+    if (millis() - _stateSinceMs < _backoffMs) return;
+
+    _stats.attempts++;
+    _attemptStartMs = millis();
+    strncpy(mqttDnsHost, _config->server, sizeof(mqttDnsHost) - 1);
+    mqttDnsHost[sizeof(mqttDnsHost) - 1] = '\0';
+    mqttDnsStatus.store(0);
+    uint32_t generation = mqttDnsGeneration.fetch_add(1) + 1;
+
+    if (tcpip_callback(mqttDnsStart, (void*)(uintptr_t)generation) != ERR_OK) {
+      fail("dns queue");
+      return;
+    }
+    _state = MqttConnState::RESOLVING;
+    _stateSinceMs = millis();
+  }
+
+  void tickResolving() {
+    uint8_t status = mqttDnsStatus.load();
+    if (status == 2) {
+      fail("dns");
+      return;
+    }
+    if (status == 0) {
+      if (millis() - _stateSinceMs > MqttTiming::DNS_TIMEOUT_MS) fail("dns timeout");
+      return;
+    }
+
+    _fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (_fd < 0) {
+      fail("socket");
+      return;
+    }
+    fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL, 0) | O_NONBLOCK);
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(_config->port);
+    addr.sin_addr.s_addr = mqttDnsAddress;
+
+    if (connect(_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+      fail("tcp");
+      return;
+    }
+    _state = MqttConnState::CONNECTING;
+    _stateSinceMs = millis();
+  }
+
+  void tickConnecting() {
+    fd_set writeSet;
+    FD_ZERO(&writeSet);
+    FD_SET(_fd, &writeSet);
+    struct timeval zero = { 0, 0 };
+
+    int ready = select(_fd + 1, nullptr, &writeSet, nullptr, &zero);
+    if (ready < 0) {
+      fail("select");
+      return;
+    }
+    if (ready == 0) {
+      if (millis() - _stateSinceMs > MqttTiming::CONNECT_TIMEOUT_MS) fail("tcp timeout");
+      return;
+    }
+
+    int sockErr = 0;
+    socklen_t len = sizeof(sockErr);
+    getsockopt(_fd, SOL_SOCKET, SO_ERROR, &sockErr, &len);
+    if (sockErr != 0) {
+      fail("tcp refused");
+      return;
+    }
+
+    uint8_t packet[256];
+    size_t packetLen = mqttBuildConnect(packet, sizeof(packet), *_config, _will, MqttTiming::KEEPALIVE_S);
+    if (packetLen == 0 || send(_fd, packet, packetLen, 0) != (ssize_t)packetLen) {
+      fail("connect packet");
+      return;
+    }
+    _connackLen = 0;
+    _state = MqttConnState::AWAIT_CONNACK;
+    _stateSinceMs = millis();
+  }
+
+  void tickAwaitConnack() {
+    ssize_t n = recv(_fd, _connack + _connackLen, sizeof(_connack) - _connackLen, MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+      fail("broker closed");
+      return;
+    }
+    if (n > 0) _connackLen += (uint8_t)n;
+
+    if (_connackLen < sizeof(_connack)) {
+      if (millis() - _stateSinceMs > MqttTiming::CONNACK_TIMEOUT_MS) fail("connack timeout");
+      return;
+    }
+    if (_connack[0] != 0x20 || _connack[1] != 0x02 || _connack[3] != 0x00) {
+      fail("connack rejected");
+      return;
+    }
+
+    // Socket back to blocking with a bounded send timeout, as WiFiClient expects
+    fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL, 0) & ~O_NONBLOCK);
+    struct timeval sendTimeout = { (time_t)(MqttTiming::SEND_TIMEOUT_MS / 1000),
+                                   (suseconds_t)((MqttTiming::SEND_TIMEOUT_MS % 1000) * 1000) };
+    setsockopt(_fd, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+    int enable = 1;
+    setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+    // Hand the live session to PubSubClient without another round trip
+    _transport->adopt(_fd);
+    _fd = -1;
+    _transport->beginReplay(_connack, sizeof(_connack));
+    bool accepted = _client->connect(_config->clientId);
+    _transport->endReplay();
+    if (!accepted) {
+      _transport->stop();
+      fail("client handoff");
+      return;
+    }
+
+    _failures = 0;
+    _stats.lastConnectLatencyMs = millis() - _attemptStartMs;
+    _stats.connectedSinceMs = millis();
+    _state = MqttConnState::CONNECTED;
+    LOG_INFO("MQTT connected in %u ms", _stats.lastConnectLatencyMs);
+
+    if (_onConnected != nullptr) _onConnected();
+  }
+
+  void tickConnected() {
+    if (!_client->loop()) {
+      LOG_WARN("MQTT connection lost (state %d)", _client->state());
+      _transport->stop();
+      fail("lost");
+    }
+  }
+
+  void closeSocket() {
+    if (_fd >= 0) {
+      close(_fd);
+      _fd = -1;
+    }
+  }
+
+  PubSubClient* _client = nullptr;
+  MqttTransport* _transport = nullptr;
+  const MqttConfig* _config = nullptr;
+  const MqttWill* _will = nullptr;
+  ConnectedCallback _onConnected = nullptr;
+
+  MqttConnState _state = MqttConnState::IDLE;
+  uint32_t _stateSinceMs = 0;
+  uint32_t _attemptStartMs = 0;
+  uint32_t _backoffMs = 0;
+  uint8_t _failures = 0;
+  int _fd = -1;
+  uint8_t _connack[4];
+  uint8_t _connackLen = 0;
+  MqttStats _stats = {};
+};
+
+#endif
@@ -0,0 +1,198 @@
+/*
+ * ESP32 Multitool - Offline Telemetry Queue
+ * Store-and-forward buffer for telemetry while the broker is unreachable
+ *
+ * Records are fixed-size snapshots (timestamp, mask of metrics that
+ * changed, metric values) kept in a RAM ring. When the ring is full the
+ * oldest record is dropped, or, with OFFLINE_QUEUE_FLASH_SPILL=1, moved to
+ * an append-only file on LittleFS. Everything in flash is older than
+ * everything in RAM, so draining flash first keeps records in order.
+ *
+ * The queue is only touched from wifiTask, so it needs no locking.
+ */
+
+#ifndef MQTT_OFFLINE_QUEUE_H
+#define MQTT_OFFLINE_QUEUE_H
+
+#include <Arduino.h>
+
+#ifndef OFFLINE_QUEUE_FLASH_SPILL
+#define OFFLINE_QUEUE_FLASH_SPILL 0  // Set to 1 in build_flags to spill to LittleFS
+#endif
+
+#if OFFLINE_QUEUE_FLASH_SPILL
+#include <LittleFS.h>
+#endif
+
+namespace OfflineQueueConfig {
+  const uint8_t MAX_VALUES = 8;             // Must be >= number of telemetry metrics
+  const uint16_t RAM_SLOTS = 128;           // ~4.5 KB
+  const uint32_t SAMPLE_INTERVAL_MS = 5000; // Changes are merged into one record per interval
+  const uint16_t DRAIN_PER_SECOND = 10;     // Replay rate after reconnect
+  const uint16_t SPILL_MAX_RECORDS = 2560;  // 100 KB file, ~3.5 h at one record per 5 s
+  // The spiffs partition is 128 KB (32 blocks of 4 KB); LittleFS keeps two
+  // superblock/root metadata blocks, the file's metadata and spare blocks
+  // for copy-on-write, so the file gets 25 blocks
+  const uint32_t SPILL_BUDGET_BYTES = 25 * 4096;
+  const char SPILL_PATH[] = "/telemetry.q";
+}
+
+struct OfflineRecord {
+  uint32_t timestampMs;   // millis() when the last value in the record was taken
+  uint32_t mask;          // Bit per metric present in this record
+  float values[OfflineQueueConfig::MAX_VALUES];
+};
+
+static_assert(OfflineQueueConfig::SPILL_MAX_RECORDS * sizeof(OfflineRecord) <= OfflineQueueConfig::SPILL_BUDGET_BYTES,
+              "Spill file does not fit the LittleFS partition");
+
+struct OfflineQueueStats {
+  uint32_t queued;        // Records accepted
+  uint32_t drained;       // Records replayed to the broker
+  uint32_t dropped;       // Records lost because the queue was full
+  uint32_t spilled;       // Records moved to flash
+  uint16_t drainRate;     // Records replayed in the last full second
+};
+
+class OfflineQueue {
+public:
+  void begin() {
+#if OFFLINE_QUEUE_FLASH_SPILL
+    _flashReady = LittleFS.begin(true);
+    if (_flashReady) {
+      LittleFS.remove(OfflineQueueConfig::SPILL_PATH);  // Timestamps from a previous boot are meaningless
+    } else {
+      LOG_WARN("Offline queue: LittleFS unavailable, RAM only");
+    }
+#endif
+  }
+
+  /**
+   * Append a record, spilling or dropping the oldest one if the ring is full
+   */
+  void push(const OfflineRecord& record) {
+    if (_count == OfflineQueueConfig::RAM_SLOTS) {
+      if (!spillOldest()) _stats.dropped++;
+      _head = (_head + 1) % OfflineQueueConfig::RAM_SLOTS;
+      _count--;
+    }
+    _ring[(_head + _count) % OfflineQueueConfig::RAM_SLOTS] = record;
+    _count++;
+    _stats.queued++;
+  }
+
+  /**
+   * Look at the oldest record without removing it
+   * @return false if the queue is empty or flash could not be read
+   */
+  bool peek(OfflineRecord& record) {
+#if OFFLINE_QUEUE_FLASH_SPILL
+    if (_spillCount > 0) {
+      File file = LittleFS.open(OfflineQueueConfig::SPILL_PATH, "r");
+      bool ok = file && file.seek(_spillReadIndex * sizeof(OfflineRecord)) &&
+                file.read((uint8_t*)&record, sizeof(record)) == sizeof(record);
+      if (file) file.close();
+      if (!ok) {
+        // Unreadable spill file: give up on it rather than stall the drain
+        _stats.dropped += _spillCount;
+        resetSpill();
+        return peek(record);
+      }
+      return true;
+    }
+#endif
+    if (_count == 0) return false;
+    record = _ring[_head];
+    return true;
+  }
+
+  /**
+   * Remove the record returned by the last peek()
+   */
+  void pop() {
+#if OFFLINE_QUEUE_FLASH_SPILL
+    if (_spillCount > 0) {
+      _spillReadIndex++;
+      _spillCount--;
+      if (_spillCount == 0) resetSpill();
+      countDrained();
+      return;
+    }
+#endif
+    if (_count == 0) return;
+    _head = (_head + 1) % OfflineQueueConfig::RAM_SLOTS;
+    _count--;
+    countDrained();
+  }
+
+  /**
+   * True when the drain rate allows another record now
+   */
+  bool drainDue() {
+    uint32_t now = millis();
+    if (now - _lastDrainMs < 1000 / OfflineQueueConfig::DRAIN_PER_SECOND) return false;
+    _lastDrainMs = now;
+    return true;
+  }
+
+  uint16_t depth() const { return _count; }
+  uint32_t spillDepth() const { return _spillCount; }
+  bool empty() const { return _count == 0 && _spillCount == 0; }
+  const OfflineQueueStats& stats() {
+    if (millis() - _rateWindowMs >= 2000) _stats.drainRate = 0;  // Drain has gone quiet
+    return _stats;
+  }
+
+private:
+  void countDrained() {
+    _stats.drained++;
+    uint32_t now = millis();
+    if (now - _rateWindowMs >= 1000) {
+      _stats.drainRate = _rateCount;
+      _rateCount = 0;
+      _rateWindowMs = now;
+    }
+    _rateCount++;
+  }
+
+  bool spillOldest() {
+#if OFFLINE_QUEUE_FLASH_SPILL
+    if (!_flashReady || _spillCount + _spillReadIndex >= OfflineQueueConfig::SPILL_MAX_RECORDS) {
+      return false;
+    }
+    File file = LittleFS.open(OfflineQueueConfig::SPILL_PATH, "a");
+    if (!file) return false;
+    bool ok = file.write((const uint8_t*)&_ring[_head], sizeof(OfflineRecord)) == sizeof(OfflineRecord);
+    file.close();
+    if (ok) {
+      _spillCount++;
+      _stats.spilled++;
+    }
+    return ok;
+#else
+    return false;
+#endif
+  }
+
+#if OFFLINE_QUEUE_FLASH_SPILL
+  void resetSpill() {
+    LittleFS.remove(OfflineQueueConfig::SPILL_PATH);
+    _spillReadIndex = 0;
+    _spillCount = 0;
+  }
+
+  bool _flashReady = false;
+  uint32_t _spillReadIndex = 0;
+#endif
+
+  OfflineRecord _ring[OfflineQueueConfig::RAM_SLOTS];
+  uint16_t _head = 0;
+  uint16_t _count = 0;
+  uint32_t _spillCount = 0;
+  uint32_t _lastDrainMs = 0;
+  uint32_t _rateWindowMs = 0;
+  uint16_t _rateCount = 0;
+  OfflineQueueStats _stats = {};
+};
+
+#endif
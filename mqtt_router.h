@@ -0,0 +1,345 @@
+/*
+ * ESP32 Multitool - MQTT Command Router
+ * Maps esp32/multitool/<device>/set messages to typed actuator commands
+ *
+ * Payloads are parsed in place from the PubSubClient buffer with explicit
+ * length bounds: nothing is copied onto the stack and nothing relies on a
+ * terminating NUL. The router is pure logic with no hardware access;
+ * applying a command and acknowledging it on <device>/state happen in the
+ * main sketch.
+ *
+ * Payload formats (case-insensitive keywords, surrounding spaces ignored):
+ *   relay     ON | OFF | 1 | 0 | TOGGLE
+ *   pwm       0-100                 (percent)
+ *   servo     0-180                 (degrees)
+ *   stepper   <steps>[,<speed>]     (signed half-steps, speed 1-100, default 50)
+ *   neopixel  #RRGGBB | <effect>[,#RRGGBB]   (colour alone selects "solid")
+ *   tone      <hz>[,<ms>] | OFF     (100-4000 Hz, duration 0 = until OFF)
+ */
+
+#ifndef MQTT_ROUTER_H
+#define MQTT_ROUTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+
+namespace RouterConfig {
+  const char TOPIC_PREFIX[] = "esp32/multitool/";
+  const char SET_SUFFIX[] = "/set";
+  const char STATE_SUFFIX[] = "/state";
+  const char LEGACY_RELAY_TOPIC[] = "esp32/multitool/relay";
+  const size_t MAX_PAYLOAD = 64;
+  const int32_t TONE_MIN_HZ = 100;
+  const int32_t TONE_MAX_HZ = 4000;
+  const int32_t STEPPER_MAX_STEPS = 100000;
+  const int32_t STEPPER_DEFAULT_SPEED = 50;
+}
+
+enum class ActuatorDevice : uint8_t {
+  RELAY,
+  PWM,
+  SERVO,
+  STEPPER,
+  NEOPIXEL,
+  TONE,
+  COUNT
+};
+
+// Indexed by ActuatorDevice; also the <device> topic segment
+static const char* const ACTUATOR_NAMES[] = {
+  "relay", "pwm", "servo", "stepper", "neopixel", "tone"
+};
+
+// Relay value used for TOGGLE; resolved against current state when applied
+const int32_t RELAY_TOGGLE = -1;
+
+// Effect names belong to the effects engine (neopixel_effects.h)
+int ledEffectFromName(const char* name, size_t len);
+const char* ledEffectName(uint8_t effect);
+const int32_t LED_EFFECT_SOLID = 1;
+
+struct ActuatorCommand {
+  ActuatorDevice device;
+  int32_t value;   // relay 0/1/RELAY_TOGGLE, percent, degrees, steps, 0xRRGGBB (-1 = keep), Hz (0 = off)
+  int32_t arg;     // stepper speed, neopixel effect, tone duration ms
+};
+
+enum class RouteResult : uint8_t {
+  OK,
+  NOT_A_COMMAND,   // Topic is not ours to handle
+  UNKNOWN_DEVICE,
+  PAYLOAD_TOO_LONG,
+  BAD_PAYLOAD
+};
+
+// --- BOUNDED PAYLOAD PARSING ---
+
+struct PayloadCursor {
+  const uint8_t* data;
+  size_t len;
+  size_t pos;
+};
+
+static void routerSkipSpaces(PayloadCursor& cur) {
+  while (cur.pos < cur.len && (cur.data[cur.pos] == ' ' || cur.data[cur.pos] == '\t' ||
+                               cur.data[cur.pos] == '\r' || cur.data[cur.pos] == '\n')) {
+    cur.pos++;
+  }
+}
+
+static bool routerAtEnd(PayloadCursor& cur) {
+  routerSkipSpaces(cur);
+  return cur.pos == cur.len;
+}
+
+static bool routerMatchWord(PayloadCursor& cur, const char* word) {
+  size_t wordLen = strlen(word);
+  if (cur.len - cur.pos < wordLen) return false;
+  for (size_t i = 0; i < wordLen; i++) {
+    char c = (char)cur.data[cur.pos + i];
+    if (c >= 'a' && c <= 'z') c -= 32;
+    if (c != word[i]) return false;
+  }
+  size_t end = cur.pos + wordLen;
+  if (end < cur.len && cur.data[end] != ' ' && cur.data[end] != ',' &&
+      cur.data[end] != '\r' && cur.data[end] != '\n' && cur.data[end] != '\t') {
+    return false;  // Prefix of a longer word
+  }
+  cur.pos = end;
+  return true;
+}
+
+static bool routerParseInt(PayloadCursor& cur, int32_t minValue, int32_t maxValue, int32_t& out) {
+  routerSkipSpaces(cur);
+  bool negative = false;
+  if (cur.pos < cur.len && (cur.data[cur.pos] == '-' || cur.data[cur.pos] == '+')) {
+    negative = cur.data[cur.pos] == '-';
+    cur.pos++;
+  }
+
+  size_t digits = 0;
+  int64_t value = 0;
+  while (cur.pos < cur.len && cur.data[cur.pos] >= '0' && cur.data[cur.pos] <= '9') {
+    value = value * 10 + (cur.data[cur.pos] - '0');
+    if (value > 0x7FFFFFFF) return false;
+    cur.pos++;
+    digits++;
+  }
+  if (digits == 0) return false;
+
+  if (negative) value = -value;
+  if (value < minValue || value > maxValue) return false;
+  out = (int32_t)value;
+  return true;
+}
+
+static bool routerParseHexColor(PayloadCursor& cur, int32_t& out) {
+  routerSkipSpaces(cur);
+  if (cur.pos < cur.len && cur.data[cur.pos] == '#') cur.pos++;
+  if (cur.len - cur.pos < 6) return false;
+
+  int32_t color = 0;
+  for (uint8_t i = 0; i < 6; i++) {
+    char c = (char)cur.data[cur.pos++];
+    int nibble;
+    if (c >= '0' && c <= '9') nibble = c - '0';
+    else if (c >= 'a' && c <= 'f') nibble = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F') nibble = c - 'A' + 10;
+    else return false;
+    color = (color << 4) | nibble;
+  }
+  out = color;
+  return true;
+}
+
+static bool routerIsHexColor(const PayloadCursor& cur) {
+  size_t pos = cur.pos;
+  if (pos < cur.len && cur.data[pos] == '#') return true;
+  size_t digits = 0;
+  while (pos < cur.len && isxdigit(cur.data[pos])) {
+    pos++;
+    digits++;
+  }
+  return digits == 6 && (pos == cur.len || cur.data[pos] == ' ' || cur.data[pos] == '\r' || cur.data[pos] == '\n');
+}
+
+// Effect name followed by an optional ",#RRGGBB"
+static bool routerParseEffect(PayloadCursor& cur, ActuatorCommand& cmd) {
+  size_t start = cur.pos;
+  while (cur.pos < cur.len && isalpha(cur.data[cur.pos])) cur.pos++;
+  int effect = ledEffectFromName((const char*)cur.data + start, cur.pos - start);
+  if (effect < 0) return false;
+  cmd.arg = effect;
+  cmd.value = -1;
+
+  routerSkipSpaces(cur);
+  if (cur.pos < cur.len && cur.data[cur.pos] == ',') {
+    cur.pos++;
+    return routerParseHexColor(cur, cmd.value);
+  }
+  return true;
+}
+
+// Optional ",<int>" suffix
+static bool routerParseOptionalArg(PayloadCursor& cur, int32_t minValue, int32_t maxValue,
+                                   int32_t defaultValue, int32_t& out) {
+  routerSkipSpaces(cur);
+  if (cur.pos == cur.len) {
+    out = defaultValue;
+    return true;
+  }
+  if (cur.data[cur.pos] != ',') return false;
+  cur.pos++;
+  return routerParseInt(cur, minValue, maxValue, out);
+}
+
+static bool routerParsePayload(ActuatorDevice device, PayloadCursor& cur, ActuatorCommand& cmd) {
+  cmd.device = device;
+  cmd.value = 0;
+  cmd.arg = 0;
+  routerSkipSpaces(cur);
+
+  switch (device) {
+    case ActuatorDevice::RELAY:
+      if (routerMatchWord(cur, "ON") || routerMatchWord(cur, "1")) cmd.value = 1;
+      else if (routerMatchWord(cur, "OFF") || routerMatchWord(cur, "0")) cmd.value = 0;
+      else if (routerMatchWord(cur, "TOGGLE")) cmd.value = RELAY_TOGGLE;
+      else return false;
+      break;
+
+    case ActuatorDevice::PWM:
+      if (!routerParseInt(cur, 0, 100, cmd.value)) return false;
+      break;
+
+    case ActuatorDevice::SERVO:
+      if (!routerParseInt(cur, 0, 180, cmd.value)) return false;
+      break;
+
+    case ActuatorDevice::STEPPER:
+      if (!routerParseInt(cur, -RouterConfig::STEPPER_MAX_STEPS, RouterConfig::STEPPER_MAX_STEPS, cmd.value)) {
+        return false;
+      }
+      if (!routerParseOptionalArg(cur, 1, 100, RouterConfig::STEPPER_DEFAULT_SPEED, cmd.arg)) return false;
+      break;
+
+    case ActuatorDevice::NEOPIXEL:
+      if (routerIsHexColor(cur)) {
+        cmd.arg = LED_EFFECT_SOLID;
+        if (!routerParseHexColor(cur, cmd.value)) return false;
+      } else if (!routerParseEffect(cur, cmd)) {
+        return false;
+      }
+      break;
+
+    case ActuatorDevice::TONE:
+      if (routerMatchWord(cur, "OFF")) {
+        cmd.value = 0;
+      } else {
+        if (!routerParseInt(cur, 0, RouterConfig::TONE_MAX_HZ, cmd.value)) return false;
+        if (cmd.value != 0 && cmd.value < RouterConfig::TONE_MIN_HZ) return false;
+        if (!routerParseOptionalArg(cur, 0, 60000, 0, cmd.arg)) return false;
+      }
+      break;
+
+    default:
+      return false;
+  }
+
+  return routerAtEnd(cur);
+}
+
+// --- ROUTING ---
+
+/**
+ * Route one incoming MQTT message
+ * @param topic NUL-terminated topic from PubSubClient
+ * @param payload Payload bytes (not NUL-terminated)
+ * @param length Payload length
+ * @param cmd Filled with the typed command when RouteResult::OK
+ */
+RouteResult mqttRouteMessage(const char* topic, const uint8_t* payload, size_t length,
+                             ActuatorCommand& cmd) {
+  ActuatorDevice device = ActuatorDevice::COUNT;
+
+  if (strcmp(topic, RouterConfig::LEGACY_RELAY_TOPIC) == 0) {
+    device = ActuatorDevice::RELAY;
+  } else {
+    const size_t prefixLen = sizeof(RouterConfig::TOPIC_PREFIX) - 1;
+    const size_t suffixLen = sizeof(RouterConfig::SET_SUFFIX) - 1;
+    size_t topicLen = strlen(topic);
+
+    if (topicLen <= prefixLen + suffixLen ||
+        strncmp(topic, RouterConfig::TOPIC_PREFIX, prefixLen) != 0 ||
+        strcmp(topic + topicLen - suffixLen, RouterConfig::SET_SUFFIX) != 0) {
+      return RouteResult::NOT_A_COMMAND;
+    }
+
+    const char* name = topic + prefixLen;
+    size_t nameLen = topicLen - prefixLen - suffixLen;
+    for (uint8_t i = 0; i < (uint8_t)ActuatorDevice::COUNT; i++) {
+      if (strlen(ACTUATOR_NAMES[i]) == nameLen && strncmp(name, ACTUATOR_NAMES[i], nameLen) == 0) {
+        device = (ActuatorDevice)i;
+        break;
+      }
+    }
+    if (device == ActuatorDevice::COUNT) return RouteResult::UNKNOWN_DEVICE;
+  }
+
+  if (length > RouterConfig::MAX_PAYLOAD) return RouteResult::PAYLOAD_TOO_LONG;
+
+  PayloadCursor cur = { payload, length, 0 };
+  return routerParsePayload(device, cur, cmd) ? RouteResult::OK : RouteResult::BAD_PAYLOAD;
+}
+
+/**
+ * Build the acknowledgement topic for a device: esp32/multitool/<device>/state
+ */
+size_t mqttStateTopic(ActuatorDevice device, char* out, size_t outLen) {
+  int written = snprintf(out, outLen, "%s%s%s", RouterConfig::TOPIC_PREFIX,
+                         ACTUATOR_NAMES[(uint8_t)device], RouterConfig::STATE_SUFFIX);
+  return written > 0 ? (size_t)written : 0;
+}
+
+/**
+ * Format the applied state of a command in the same syntax it was sent in
+ */
+size_t mqttFormatState(const ActuatorCommand& cmd, char* out, size_t outLen) {
+  int written;
+  switch (cmd.device) {
+    case ActuatorDevice::RELAY:
+      written = snprintf(out, outLen, "%s", cmd.value ? "ON" : "OFF");
+      break;
+    case ActuatorDevice::STEPPER:
+      written = snprintf(out, outLen, "%ld,%ld", (long)cmd.value, (long)cmd.arg);
+      break;
+    case ActuatorDevice::NEOPIXEL:
+      written = cmd.value < 0 ? snprintf(out, outLen, "%s", ledEffectName((uint8_t)cmd.arg))
+                              : snprintf(out, outLen, "%s,#%06lX", ledEffectName((uint8_t)cmd.arg),
+                                         (unsigned long)cmd.value);
+      break;
+    case ActuatorDevice::TONE:
+      written = cmd.value == 0 ? snprintf(out, outLen, "OFF")
+                               : snprintf(out, outLen, "%ld,%ld", (long)cmd.value, (long)cmd.arg);
+      break;
+    default:
+      written = snprintf(out, outLen, "%ld", (long)cmd.value);
+      break;
+  }
+  return written > 0 ? (size_t)written : 0;
+}
+
+const char* routeResultName(RouteResult result) {
+  switch (result) {
+    case RouteResult::OK:               return "ok";
+    case RouteResult::NOT_A_COMMAND:    return "not a command";
+    case RouteResult::UNKNOWN_DEVICE:   return "unknown device";
+    case RouteResult::PAYLOAD_TOO_LONG: return "payload too long";
+    case RouteResult::BAD_PAYLOAD:      return "bad payload";
+  }
+  return "unknown";
+}
+
+#endif
@@ -0,0 +1,260 @@
+/*
+ * ESP32 Multitool - MQTT Telemetry Publisher
+ * Change-driven, batched publishing of sensor and actuator state
+ *
+ * Every tick the publisher snapshots all metrics once and decides per
+ * metric whether it is due:
+ *   - changed by more than its deadband and minIntervalMs has passed, or
+ *   - maxIntervalMs has passed since it was last sent (heartbeat)
+ * All due metrics go out together as one compact JSON object on
+ * esp32/multitool/telemetry. Metrics with a state topic additionally
+ * publish their value there (retained for actuators), so subscribers
+ * see the current state immediately on subscribe.
+ *
+ * While the broker is unreachable, due metrics are merged into one record
+ * per OfflineQueueConfig::SAMPLE_INTERVAL_MS and stored in the offline
+ * queue. After reconnect those records are replayed on the same topic at
+ * a capped rate, with "age" (ms since the sample) added.
+ */
+
+#ifndef MQTT_TELEMETRY_H
+#define MQTT_TELEMETRY_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <PubSubClient.h>
+#include "mqtt_offline_queue.h"
+
+// Forward declarations from main sketch
+extern SemaphoreHandle_t stateMutex;
+extern SharedState sharedState;
+
+namespace TelemetryConfig {
+  const uint16_t TICK_MS = 20;
+  const char TOPIC[] = "esp32/multitool/telemetry";
+}
+
+enum TelemetryMetricId {
+  METRIC_SENSOR,
+  METRIC_RELAY,
+  METRIC_PWM,
+  METRIC_SERVO,
+  METRIC_HEAP,
+  METRIC_RSSI,
+  METRIC_UPTIME,
+  METRIC_COUNT
+};
+
+struct TelemetryMetricDef {
+  const char* key;           // JSON key in the batch message
+  const char* stateTopic;    // Per-metric topic, or nullptr for batch only
+  bool retain;               // Retain the per-metric message
+  bool onOff;                // Publish state as ON/OFF instead of a number
+  float deadband;            // Smallest change that counts as significant
+  uint32_t minIntervalMs;    // Rate cap for this metric
+  uint32_t maxIntervalMs;    // Heartbeat even without change
+};
+
+// Table order must match TelemetryMetricId
+const TelemetryMetricDef TELEMETRY_METRICS[METRIC_COUNT] = {
+  // key       state topic                        retain onOff  deadband  min ms   max ms
+  { "sensor", MQTT_TOPIC_SENSOR,                  false, false,   16.0f,    200,   60000 },
+  { "relay",  "esp32/multitool/relay/state",      true,  true,     0.5f,      0,  300000 },
+  { "pwm",    "esp32/multitool/pwm/state",        true,  false,    1.0f,    100,  300000 },
+  { "servo",  "esp32/multitool/servo/state",      true,  false,    1.0f,    100,  300000 },
+  { "heap",   "esp32/multitool/heap/state",       false, false, 4096.0f,  10000,  300000 },
+  { "rssi",   "esp32/multitool/rssi/state",       false, false,    3.0f,  10000,  300000 },
+  { "uptime", "esp32/multitool/uptime/state",     false, false,   60.0f,  60000,  300000 }
+};
+
+struct TelemetryMetricState {
+  float lastSent;
+  uint32_t lastSentMs;
+  bool sent;
+};
+
+struct TelemetryStats {
+  uint32_t messages;     // Batch messages published
+  uint32_t values;       // Metric values carried in those batches
+  uint32_t suppressed;   // Samples dropped by deadband or rate cap
+};
+
+static_assert(METRIC_COUNT <= OfflineQueueConfig::MAX_VALUES, "Offline record too small for all metrics");
+
+static TelemetryMetricState telemetryState[METRIC_COUNT];
+static uint32_t telemetryLastTickMs = 0;
+TelemetryStats telemetryStats = {};
+
+OfflineQueue telemetryOfflineQueue;
+static OfflineRecord telemetryPending = {};   // Offline changes not yet committed to the queue
+static uint32_t telemetryPendingSinceMs = 0;
+
+/**
+ * Forget what was sent so the next tick republishes everything
+ * Call after (re)connecting so retained state topics are refreshed.
+ */
+void telemetryResetAll() {
+  for (uint8_t i = 0; i < METRIC_COUNT; i++) {
+    telemetryState[i].sent = false;
+  }
+}
+
+/**
+ * Record a value published elsewhere on the metric's state topic
+ * (e.g. a command acknowledgement) so the next tick doesn't repeat it.
+ */
+void telemetryMarkSent(TelemetryMetricId id, float value) {
+  telemetryState[id].lastSent = value;
+  telemetryState[id].lastSentMs = millis();
+  telemetryState[id].sent = true;
+}
+
+/**
+ * Take one consistent sample of every metric
+ */
+static bool telemetrySample(float* values) {
+  if (!xSemaphoreTake(stateMutex, pdMS_TO_TICKS(10))) {
+    return false;
+  }
+  values[METRIC_SENSOR] = sharedState.sensorValue;
+  values[METRIC_RELAY] = sharedState.relayState ? 1.0f : 0.0f;
+  values[METRIC_PWM] = sharedState.pwmPercent;
+  values[METRIC_SERVO] = sharedState.servoAngle;
+  xSemaphoreGive(stateMutex);
+
+  values[METRIC_HEAP] = ESP.getFreeHeap();
+  values[METRIC_RSSI] = WiFi.RSSI();
+  values[METRIC_UPTIME] = millis() / 1000;
+  return true;
+}
+
+static bool telemetryIsDue(uint8_t id, float value, uint32_t now) {
+  const TelemetryMetricDef& def = TELEMETRY_METRICS[id];
+  const TelemetryMetricState& st = telemetryState[id];
+
+  if (!st.sent) return true;
+
+  uint32_t elapsed = now - st.lastSentMs;
+  if (elapsed >= def.maxIntervalMs) return true;
+  if (elapsed < def.minIntervalMs) return false;
+  return fabsf(value - st.lastSent) >= def.deadband;
+}
+
+/**
+ * Format one batch message from a mask of metrics
+ * @param ageMs Age of the sample for replayed records, 0 for live ones
+ * @return Message length, or 0 if nothing fit
+ */
+static size_t telemetryFormat(char* payload, size_t size, uint32_t timestampMs, uint32_t mask,
+                              const float* values, uint32_t ageMs) {
+  size_t len = snprintf(payload, size, "{\"t\":%lu", (unsigned long)timestampMs);
+  if (ageMs > 0) {
+    len += snprintf(payload + len, size - len, ",\"age\":%lu", (unsigned long)ageMs);
+  }
+  for (uint8_t id = 0; id < METRIC_COUNT; id++) {
+    if (!(mask & (1UL << id))) continue;
+    int written = snprintf(payload + len, size - len, ",\"%s\":%.10g", TELEMETRY_METRICS[id].key, values[id]);
+    if (written < 0 || len + written >= size - 1) return 0;
+    len += written;
+  }
+  payload[len++] = '}';
+  payload[len] = '\0';
+  return len;
+}
+
+/**
+ * Move merged offline changes into the queue
+ */
+static void telemetryCommitPending() {
+  if (telemetryPending.mask == 0) return;
+  telemetryOfflineQueue.push(telemetryPending);
+  telemetryPending.mask = 0;
+}
+
+/**
+ * Publish due metrics as one batch, or queue them while offline
+ * Call every wifiTask pass; rate-limits itself to TICK_MS.
+ * @param online True when the MQTT session is up
+ */
+void telemetryTick(PubSubClient& client, bool online) {
+  uint32_t now = millis();
+  if (now - telemetryLastTickMs < TelemetryConfig::TICK_MS) return;
+  telemetryLastTickMs = now;
+
+  float values[METRIC_COUNT];
+  if (!telemetrySample(values)) return;
+
+  uint32_t dueMask = 0;
+  uint8_t dueCount = 0;
+  for (uint8_t id = 0; id < METRIC_COUNT; id++) {
+    if (!telemetryIsDue(id, values[id], now)) {
+      if (telemetryState[id].sent && values[id] != telemetryState[id].lastSent) {
+        telemetryStats.suppressed++;
+      }
+      continue;
+    }
+    dueMask |= 1UL << id;
+    dueCount++;
+    telemetryState[id].lastSent = values[id];
+    telemetryState[id].lastSentMs = now;
+    telemetryState[id].sent = true;
+  }
+
+  if (!online) {
+    if (dueMask == 0) return;
+    if (telemetryPending.mask == 0) telemetryPendingSinceMs = now;
+    for (uint8_t id = 0; id < METRIC_COUNT; id++) {
+      if (dueMask & (1UL << id)) telemetryPending.values[id] = values[id];
+    }
+    telemetryPending.mask |= dueMask;
+    telemetryPending.timestampMs = now;
+    if (now - telemetryPendingSinceMs >= OfflineQueueConfig::SAMPLE_INTERVAL_MS) {
+      telemetryCommitPending();
+    }
+    return;
+  }
+
+  telemetryCommitPending();  // Whatever changed just before the reconnect
+  if (dueMask == 0) return;
+
+  for (uint8_t id = 0; id < METRIC_COUNT; id++) {
+    const TelemetryMetricDef& def = TELEMETRY_METRICS[id];
+    if (!(dueMask & (1UL << id)) || def.stateTopic == nullptr) continue;
+
+    char state[16];
+    if (def.onOff) {
+      strcpy(state, values[id] != 0.0f ? "ON" : "OFF");
+    } else {
+      snprintf(state, sizeof(state), "%.10g", values[id]);
+    }
+    client.publish(def.stateTopic, state, def.retain);
+  }
+
+  char payload[192];
+  size_t len = telemetryFormat(payload, sizeof(payload), now, dueMask, values, 0);
+  if (len > 0 && client.publish(TelemetryConfig::TOPIC, payload)) {
+    telemetryStats.messages++;
+    telemetryStats.values += dueCount;
+  }
+}
+
+/**
+ * Replay one queued record if the drain rate allows
+ * Call every wifiTask pass while connected.
+ */
+void telemetryDrainOffline(PubSubClient& client) {
+  if (telemetryOfflineQueue.empty() || !telemetryOfflineQueue.drainDue()) return;
+
+  OfflineRecord record;
+  if (!telemetryOfflineQueue.peek(record)) return;
+
+  char payload[208];
+  uint32_t age = millis() - record.timestampMs;
+  size_t len = telemetryFormat(payload, sizeof(payload), record.timestampMs, record.mask,
+                               record.values, age > 0 ? age : 1);
+  if (len == 0 || client.publish(TelemetryConfig::TOPIC, payload)) {
+    telemetryOfflineQueue.pop();  // Unformattable records are dropped, not retried
+  }
+}
+
+#endif
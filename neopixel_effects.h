@@ -0,0 +1,668 @@
+/*
+ * ESP32 Multitool - NeoPixel Effects Engine
+ * Animated effects rendered in their own task and sent out over RMT
+ *
+ * Each frame goes through two passes:
+ *   render  - the effect writes linear RGB into the scene buffer using
+ *             8-bit fixed-point math and precomputed hue/sine tables
+ *   output  - brightness and gamma (one LUT lookup per byte) are applied
+ *             while converting to GRB wire order in the back buffer
+ *   limit   - the frame's supply current is estimated from its duty and,
+ *             only if it exceeds the mA budget, the frame is scaled down
+ * The back buffer is then handed to the RMT TX driver, which clocks it out
+ * from interrupts (or DMA where the SoC has it) while the next frame is
+ * rendered into the other buffer. Frames go out at the start of each
+ * period; the period stretches beyond FRAME_MS when the longest output
+ * plus the latch gap needs more, so a buffer is never rewritten mid-send.
+ *
+ * The strip may be split across several outputs (LedStripConfig, stored in
+ * NVS). Effects render over all pixels as one strip; each output gets its
+ * own RMT channel and its slice of the frame, and all channels transmit at
+ * once, so refresh time follows the longest output, not the total.
+ *
+ * Effects keep running when the NeoPixel app is closed; they are changed
+ * from the app, POST /api/neopixel or esp32/multitool/neopixel/set.
+ */
+
+#ifndef NEOPIXEL_EFFECTS_H
+#define NEOPIXEL_EFFECTS_H
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <driver/rmt_tx.h>
+
+// Forward declarations from main sketch
+extern SemaphoreHandle_t stateMutex;
+extern SharedState sharedState;
+
+namespace LedConfig {
+  const uint16_t FRAME_MS = 20;                  // 50 fps, longer for long outputs
+  const uint16_t LATCH_US = 300;                 // WS2812B reset gap (>= 280 us low)
+  const uint16_t WIRE_TIMEOUT_SLACK_MS = 10;     // Beyond the wire time before a send counts as stuck
+  const uint32_t RMT_RESOLUTION_HZ = 10000000;   // 0.1 us per tick
+  const uint16_t TASK_STACK = 3072;
+  const uint8_t TASK_PRIORITY = 2;               // Above loop() so frames stay even
+  const uint8_t TASK_CORE = 1;
+  const float GAMMA = 2.6f;
+  const uint16_t MAX_PIXELS = 2048;
+  const uint16_t MA_PER_CHANNEL = 20;            // WS2812B at full duty, per colour
+  const uint16_t IDLE_MA_PER_LED = 1;            // Quiescent draw of the LED driver
+}
+
+enum class LedEffect : uint8_t {
+  OFF,
+  SOLID,
+  RAINBOW,
+  CHASE,
+  BREATHE,
+  FIRE,
+  GRADIENT,
+  VU_METER,
+  COUNT
+};
+
+// Indexed by LedEffect; used by the API, MQTT and the OLED app
+static const char* const LED_EFFECT_NAMES[] = {
+  "off", "solid", "rainbow", "chase", "breathe", "fire", "gradient", "vu"
+};
+
+const char* ledEffectName(uint8_t effect) {
+  return effect < (uint8_t)LedEffect::COUNT ? LED_EFFECT_NAMES[effect] : "unknown";
+}
+
+/**
+ * Look up an effect by name (case-insensitive, not NUL-terminated)
+ * @return Effect index, or -1 if unknown
+ */
+int ledEffectFromName(const char* name, size_t len) {
+  for (uint8_t i = 0; i < (uint8_t)LedEffect::COUNT; i++) {
+    const char* candidate = LED_EFFECT_NAMES[i];
+    if (strlen(candidate) == len && strncasecmp(name, candidate, len) == 0) return i;
+  }
+  return -1;
+}
+
+// Outputs are limited by the SoC's RMT TX channels (ESP32: 8, S3: 4, C3: 2)
+#if SOC_RMT_TX_CANDIDATES_PER_GROUP < 4
+const uint8_t LED_MAX_OUTPUTS = SOC_RMT_TX_CANDIDATES_PER_GROUP;
+#else
+const uint8_t LED_MAX_OUTPUTS = 4;
+#endif
+
+struct LedOutputConfig {
+  uint8_t pin;
+  uint16_t count;
+};
+
+struct LedStripConfig {
+  uint8_t outputs;
+  LedOutputConfig output[LED_MAX_OUTPUTS];
+};
+
+/**
+ * Total pixels across all outputs
+ */
+uint32_t ledStripPixels(const LedStripConfig& config) {
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < config.outputs && i < LED_MAX_OUTPUTS; i++) {
+    total += config.output[i].count;
+  }
+  return total;
+}
+
+struct LedEffectParams {
+  LedEffect effect;
+  uint32_t color;       // Primary colour, 0xRRGGBB
+  uint32_t color2;      // Second colour for gradient
+  uint8_t speed;        // 1-100
+  uint8_t brightness;   // Global scale, 0-255
+  uint16_t budgetMa;    // Supply current limit for the strip, 0 = unlimited
+};
+
+struct LedFrameStats {
+  uint32_t frames;
+  uint32_t renderUs;      // Render + output pass of the last frame
+  uint32_t renderMaxUs;
+  uint32_t renderAvgUs;   // Moving average over ~16 frames
+  uint32_t wireUs;        // Time the longest output takes to clock in one frame
+  uint16_t periodMs;      // Frame period: FRAME_MS, or wire time + latch gap if longer
+  uint16_t fps;           // Frames sent in the last full second
+  uint32_t estimatedMa;   // Current the last frame would have drawn unlimited
+  uint32_t limitedFrames; // Frames scaled down to stay within budget
+  uint8_t limitScale;     // Scale applied to the last frame, 255 = none
+};
+
+// --- FIXED-POINT HELPERS ---
+
+static inline uint8_t scale8(uint8_t value, uint8_t scale) {
+  return (uint8_t)(((uint16_t)value * (scale + 1)) >> 8);
+}
+
+static inline uint8_t lerp8(uint8_t a, uint8_t b, uint8_t t) {
+  return (uint8_t)(a + ((((int16_t)b - a) * t) >> 8));
+}
+
+static inline uint8_t qsub8(uint8_t a, uint8_t b) {
+  return a > b ? a - b : 0;
+}
+
+// --- POWER LIMITER ---
+
+/**
+ * Estimate the supply current of one frame in mA
+ * A WS2812 channel's current is proportional to its PWM duty, which is
+ * the byte on the wire, so this is a plain sum over the buffer.
+ */
+uint32_t ledEstimateCurrentMa(const uint8_t* wire, size_t bytes, uint16_t count) {
+  uint32_t duty = 0;
+  for (size_t i = 0; i < bytes; i++) {
+    duty += wire[i];
+  }
+  return (uint32_t)count * LedConfig::IDLE_MA_PER_LED + (duty * LedConfig::MA_PER_CHANNEL) / 255;
+}
+
+/**
+ * Scale factor (0-255) that brings an estimate within budget, 255 if it already fits
+ */
+uint8_t ledLimitScale(uint32_t estimatedMa, uint32_t budgetMa, uint16_t count) {
+  if (budgetMa == 0 || estimatedMa <= budgetMa) return 255;
+  uint32_t idleMa = (uint32_t)count * LedConfig::IDLE_MA_PER_LED;
+  if (budgetMa <= idleMa) return 0;
+  return (uint8_t)(((budgetMa - idleMa) * 255) / (estimatedMa - idleMa));
+}
+
+void ledScaleFrame(uint8_t* wire, size_t bytes, uint8_t scale) {
+  for (size_t i = 0; i < bytes; i++) {
+    wire[i] = (uint8_t)((wire[i] * (scale + 1)) >> 8);
+  }
+}
+
+// --- ENGINE ---
+
+class LedEffectsEngine {
+public:
+  /**
+   * Build lookup tables, set up outputs and start the task
+   * @return false if the task could not start; output errors are logged
+   *         and leave the engine idle until a valid reconfigure()
+   */
+  bool begin(const LedStripConfig& config, const LedEffectParams& initial) {
+    _params = initial;
+    _paramsMutex = xSemaphoreCreateMutex();
+    if (_paramsMutex == nullptr) return false;
+
+    buildTables();
+    allocate(config);
+
+    xTaskCreatePinnedToCore(taskEntry, "LedEffects", LedConfig::TASK_STACK, this,
+                            LedConfig::TASK_PRIORITY, &_task, LedConfig::TASK_CORE);
+    return _task != nullptr;
+  }
+
+  /**
+   * Switch to a new output layout
+   * Applied by the effects task between frames, so it never races a transmit.
+   */
+  void reconfigure(const LedStripConfig& config) {
+    if (xSemaphoreTake(_paramsMutex, pdMS_TO_TICKS(10))) {
+      _pendingConfig = config;
+      _reconfigurePending = true;
+      xSemaphoreGive(_paramsMutex);
+    }
+  }
+
+  void setParams(const LedEffectParams& params) {
+    if (xSemaphoreTake(_paramsMutex, pdMS_TO_TICKS(10))) {
+      _params = params;
+      xSemaphoreGive(_paramsMutex);
+    }
+  }
+
+  LedEffectParams params() {
+    LedEffectParams copy = _params;
+    if (xSemaphoreTake(_paramsMutex, pdMS_TO_TICKS(10))) {
+      copy = _params;
+      xSemaphoreGive(_paramsMutex);
+    }
+    return copy;
+  }
+
+  void setEffect(LedEffect effect) {
+    LedEffectParams p = params();
+    p.effect = effect;
+    setParams(p);
+  }
+
+  /**
+   * Render, output and limit one frame into a wire buffer of count() * 3 bytes
+   * The effects task calls this once per frame; it has no hardware access.
+   */
+  void renderFrame(const LedEffectParams& p, uint8_t* wire) {
+    render(p);
+    output(p, wire);
+    limit(p, wire);
+  }
+
+  const LedFrameStats& stats() const { return _stats; }
+  uint16_t count() const { return _count; }
+  uint8_t outputs() const { return _outputCount; }
+
+private:
+  struct LedOutput {
+    rmt_channel_handle_t channel;
+    rmt_encoder_handle_t encoder;
+    uint16_t offset;    // First pixel of this output in the frame
+    uint16_t count;
+  };
+
+  static void taskEntry(void* arg) {
+    static_cast<LedEffectsEngine*>(arg)->run();
+  }
+
+  void run() {
+    TickType_t lastWake = xTaskGetTickCount();
+    uint32_t fpsWindowMs = millis();
+    uint16_t fpsCount = 0;
+    uint8_t back = 0;
+    bool ready = false;   // _wire[back] holds a rendered frame
+
+    for (;;) {
+      vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(_count == 0 ? LedConfig::FRAME_MS : _stats.periodMs));
+      if (applyPendingConfig()) ready = false;
+      if (_count == 0) continue;
+
+      // Send at the start of the period so consecutive frames keep the latch gap
+      if (ready) {
+        if (!waitAllOutputs(pdMS_TO_TICKS(_stats.wireUs / 1000 + LedConfig::WIRE_TIMEOUT_SLACK_MS))) {
+          LOG_RATELIMITED(LogLevel::Warn, 5000, "LED effects: output still busy, frame held");
+          continue;
+        }
+
+        // Queue every output back to back; the RMT channels then run in parallel
+        rmt_transmit_config_t txConfig = {};
+        for (uint8_t i = 0; i < _outputCount; i++) {
+          const LedOutput& out = _outputs[i];
+          rmt_transmit(out.channel, out.encoder, _wire[back] + (size_t)out.offset * 3,
+                       (size_t)out.count * 3, &txConfig);
+        }
+        back ^= 1;
+
+        _stats.frames++;
+        fpsCount++;
+        if (millis() - fpsWindowMs >= 1000) {
+          _stats.fps = fpsCount;
+          fpsCount = 0;
+          fpsWindowMs = millis();
+        }
+      }
+
+      // The other buffer's send completed before the one just queued started
+      LedEffectParams p = params();
+      uint32_t startUs = micros();
+
+      renderFrame(p, _wire[back]);
+      ready = true;
+
+      uint32_t elapsedUs = micros() - startUs;
+      _stats.renderUs = elapsedUs;
+      if (elapsedUs > _stats.renderMaxUs) _stats.renderMaxUs = elapsedUs;
+      _stats.renderAvgUs = _stats.renderAvgUs - (_stats.renderAvgUs >> 4) + (elapsedUs >> 4);
+    }
+  }
+
+  /**
+   * Wait until every output has finished clocking out its frame
+   * @return false if one is still sending after timeout
+   */
+  bool waitAllOutputs(TickType_t timeout) {
+    bool done = true;
+    for (uint8_t i = 0; i < _outputCount; i++) {
+      if (rmt_tx_wait_all_done(_outputs[i].channel, timeout) != ESP_OK) done = false;
+    }
+    return done;
+  }
+
+  /**
+   * @return true if the layout changed (the frame buffers are new)
+   */
+  bool applyPendingConfig() {
+    if (!_reconfigurePending) return false;
+
+    LedStripConfig config;
+    if (!xSemaphoreTake(_paramsMutex, pdMS_TO_TICKS(10))) return false;
+    config = _pendingConfig;
+    _reconfigurePending = false;
+    xSemaphoreGive(_paramsMutex);
+
+    // Channels are torn down regardless; a stuck send is cut short by rmt_disable()
+    waitAllOutputs(pdMS_TO_TICKS(_stats.wireUs / 1000 + LedConfig::WIRE_TIMEOUT_SLACK_MS));
+    release();
+    allocate(config);
+    return true;
+  }
+
+  /**
+   * Create buffers and one RMT channel per output
+   * On failure everything is released and the engine stays idle (_count == 0).
+   */
+  bool allocate(const LedStripConfig& config) {
+    uint32_t total = ledStripPixels(config);
+    if (config.outputs == 0 || config.outputs > LED_MAX_OUTPUTS ||
+        total == 0 || total > LedConfig::MAX_PIXELS) {
+      LOG_ERROR("LED effects: invalid layout (%u outputs, %u pixels)", config.outputs, total);
+      return false;
+    }
+
+    size_t bytes = (size_t)total * 3;
+    _scene = (uint8_t*)malloc(bytes);
+    _heat = (uint8_t*)calloc(total, 1);
+    for (uint8_t i = 0; i < 2; i++) {
+      _wire[i] = (uint8_t*)heap_caps_malloc(bytes, MALLOC_CAP_DMA | MALLOC_CAP_8BIT);
+    }
+    if (_scene == nullptr || _heat == nullptr || _wire[0] == nullptr || _wire[1] == nullptr) {
+      LOG_ERROR("LED effects: out of memory for %u pixels", total);
+      release();
+      return false;
+    }
+
+    uint16_t offset = 0;
+    uint16_t longest = 0;
+    for (uint8_t i = 0; i < config.outputs; i++) {
+      const LedOutputConfig& out = config.output[i];
+      if (out.count == 0) continue;
+      if (!beginOutput(_outputs[_outputCount], out.pin, i == 0)) {
+        release();
+        return false;
+      }
+      _outputs[_outputCount].offset = offset;
+      _outputs[_outputCount].count = out.count;
+      _outputCount++;
+      offset += out.count;
+      if (out.count > longest) longest = out.count;
+    }
+
+    // WS2812: 24 bits x 1.25 us per pixel; outputs run in parallel
+    _stats.wireUs = (uint32_t)longest * 30;
+    uint32_t minPeriodMs = (_stats.wireUs + LedConfig::LATCH_US + 999) / 1000;
+    _stats.periodMs = minPeriodMs > LedConfig::FRAME_MS ? minPeriodMs : LedConfig::FRAME_MS;
+    _count = (uint16_t)total;
+    LOG_INFO("LED effects: %u pixels on %u outputs", total, _outputCount);
+    return true;
+  }
+
+  void release() {
+    _count = 0;
+    for (uint8_t i = 0; i < _outputCount; i++) {
+      rmt_disable(_outputs[i].channel);
+      rmt_del_channel(_outputs[i].channel);
+      rmt_del_encoder(_outputs[i].encoder);
+    }
+    _outputCount = 0;
+    free(_scene);
+    free(_heat);
+    heap_caps_free(_wire[0]);
+    heap_caps_free(_wire[1]);
+    _scene = nullptr;
+    _heat = nullptr;
+    _wire[0] = nullptr;
+    _wire[1] = nullptr;
+  }
+
+  bool beginOutput(LedOutput& out, uint8_t pin, bool preferDma) {
+    out.channel = nullptr;
+    out.encoder = nullptr;
+
+    rmt_tx_channel_config_t channelConfig = {};
+    channelConfig.gpio_num = (gpio_num_t)pin;
+    channelConfig.clk_src = RMT_CLK_SRC_DEFAULT;
+    channelConfig.resolution_hz = LedConfig::RMT_RESOLUTION_HZ;
+    channelConfig.trans_queue_depth = 2;
+    channelConfig.mem_block_symbols = SOC_RMT_MEM_WORDS_PER_CHANNEL;
+#if SOC_RMT_SUPPORT_DMA
+    // Only one TX channel has DMA on current SoCs; give it to the first output
+    if (preferDma) {
+      channelConfig.mem_block_symbols = 1024;
+      channelConfig.flags.with_dma = true;
+    }
+#endif
+    if (rmt_new_tx_channel(&channelConfig, &out.channel) != ESP_OK) {
+      LOG_ERROR("LED effects: no free RMT channel for GPIO%u", pin);
+      out.channel = nullptr;
+      return false;
+    }
+
+    // WS2812 bit timings at 10 MHz: 0 = 0.3 us high + 0.9 us low, 1 = 0.9 + 0.3
+    rmt_bytes_encoder_config_t encoderConfig = {};
+    encoderConfig.bit0.level0 = 1;
+    encoderConfig.bit0.duration0 = 3;
+    encoderConfig.bit0.level1 = 0;
+    encoderConfig.bit0.duration1 = 9;
+    encoderConfig.bit1.level0 = 1;
+    encoderConfig.bit1.duration0 = 9;
+    encoderConfig.bit1.level1 = 0;
+    encoderConfig.bit1.duration1 = 3;
+    encoderConfig.flags.msb_first = 1;
+    if (rmt_new_bytes_encoder(&encoderConfig, &out.encoder) != ESP_OK ||
+        rmt_enable(out.channel) != ESP_OK) {
+      LOG_ERROR("LED effects: RMT setup failed on GPIO%u", pin);
+      if (out.encoder != nullptr) rmt_del_encoder(out.encoder);
+      rmt_del_channel(out.channel);
+      return false;
+    }
+    return true;
+  }
+
+  void buildTables() {
+    for (uint16_t i = 0; i < 256; i++) {
+      _gamma[i] = (uint8_t)(powf(i / 255.0f, LedConfig::GAMMA) * 255.0f + 0.5f);
+      _sine[i] = (uint8_t)(127.5f + 127.5f * sinf(i * 2.0f * PI / 256.0f));
+
+      // Full-saturation hue wheel in six 43-step segments
+      uint8_t segment = i / 43;
+      uint8_t rise = (uint8_t)((i - segment * 43) * 6);
+      uint8_t fall = 255 - rise;
+      uint8_t* rgb = _hue[i];
+      switch (segment) {
+        case 0:  rgb[0] = 255;  rgb[1] = rise; rgb[2] = 0;    break;
+        case 1:  rgb[0] = fall; rgb[1] = 255;  rgb[2] = 0;    break;
+        case 2:  rgb[0] = 0;    rgb[1] = 255;  rgb[2] = rise; break;
+        case 3:  rgb[0] = 0;    rgb[1] = fall; rgb[2] = 255;  break;
+        case 4:  rgb[0] = rise; rgb[1] = 0;    rgb[2] = 255;  break;
+        default: rgb[0] = 255;  rgb[1] = 0;    rgb[2] = fall; break;
+      }
+    }
+  }
+
+  uint8_t random8() {
+    _rng ^= _rng << 13;
+    _rng ^= _rng >> 17;
+    _rng ^= _rng << 5;
+    return (uint8_t)_rng;
+  }
+
+  void setPixel(uint16_t i, uint8_t r, uint8_t g, uint8_t b) {
+    uint8_t* px = _scene + i * 3;
+    px[0] = r;
+    px[1] = g;
+    px[2] = b;
+  }
+
+  void setPixelScaled(uint16_t i, uint32_t color, uint8_t scale) {
+    setPixel(i, scale8(color >> 16, scale), scale8(color >> 8, scale), scale8(color, scale));
+  }
+
+  void render(const LedEffectParams& p) {
+    uint16_t step = p.speed;  // Per-frame phase advance, 1-100
+    _phase += step * 8;
+
+    switch (p.effect) {
+      case LedEffect::OFF:
+        memset(_scene, 0, (size_t)_count * 3);
+        break;
+
+      case LedEffect::SOLID:
+        for (uint16_t i = 0; i < _count; i++) setPixelScaled(i, p.color, 255);
+        break;
+
+      case LedEffect::RAINBOW: {
+        uint8_t base = _phase >> 8;
+        for (uint16_t i = 0; i < _count; i++) {
+          const uint8_t* rgb = _hue[(uint8_t)(base + (i * 256u) / _count)];
+          setPixel(i, rgb[0], rgb[1], rgb[2]);
+        }
+        break;
+      }
+
+      case LedEffect::CHASE: {
+        const uint8_t TAIL = 6;
+        uint16_t head = (uint16_t)((_phase >> 8) % _count);
+        memset(_scene, 0, (size_t)_count * 3);
+        for (uint8_t t = 0; t < TAIL && t < _count; t++) {
+          uint16_t i = (head + _count - t) % _count;
+          setPixelScaled(i, p.color, (uint8_t)(255 - t * (256 / TAIL)));
+        }
+        break;
+      }
+
+      case LedEffect::BREATHE: {
+        uint8_t level = _sine[(uint8_t)(_phase >> 9)];
+        level = level < 8 ? 8 : level;
+        for (uint16_t i = 0; i < _count; i++) setPixelScaled(i, p.color, level);
+        break;
+      }
+
+      case LedEffect::FIRE:
+        renderFire(p.speed);
+        break;
+
+      case LedEffect::GRADIENT: {
+        uint8_t offset = _phase >> 9;
+        for (uint16_t i = 0; i < _count; i++) {
+          // Triangle wave so the scrolling gradient wraps without a seam
+          uint8_t pos = (uint8_t)((i * 256u) / _count + offset);
+          uint8_t t = pos < 128 ? pos * 2 : (255 - pos) * 2;
+          setPixel(i, lerp8(p.color >> 16, p.color2 >> 16, t),
+                      lerp8(p.color >> 8, p.color2 >> 8, t),
+                      lerp8(p.color, p.color2, t));
+        }
+        break;
+      }
+
+      case LedEffect::VU_METER:
+        renderVu(p.speed);
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  // Classic "Fire2012": per-pixel heat that cools, drifts up and sparks at the base
+  void renderFire(uint8_t speed) {
+    uint32_t cooling32 = (55u * 10) / _count + 2;   // 552 for one pixel: clamp, don't wrap
+    uint8_t cooling = (uint8_t)(cooling32 > 255 ? 255 : cooling32);
+    uint8_t sparking = 50 + speed;
+
+    for (uint16_t i = 0; i < _count; i++) {
+      _heat[i] = qsub8(_heat[i], random8() % cooling);
+    }
+    for (uint16_t k = _count - 1; k >= 2; k--) {
+      _heat[k] = (uint8_t)(((uint16_t)_heat[k - 1] + _heat[k - 2] + _heat[k - 2]) / 3);
+    }
+    if (random8() < sparking) {
+      uint16_t y = random8() % (_count < 7 ? _count : 7);
+      uint16_t heat = _heat[y] + 160 + random8() % 96;
+      _heat[y] = heat > 255 ? 255 : (uint8_t)heat;
+    }
+
+    for (uint16_t i = 0; i < _count; i++) {
+      uint8_t t192 = scale8(_heat[i], 191);
+      uint8_t ramp = (uint8_t)((t192 & 0x3F) << 2);
+      if (t192 & 0x80)      setPixel(i, 255, 255, ramp);
+      else if (t192 & 0x40) setPixel(i, 255, ramp, 0);
+      else                  setPixel(i, ramp, 0, 0);
+    }
+  }
+
+  // Bar graph of the analog sensor with a falling peak marker
+  void renderVu(uint8_t speed) {
+    int sensor = 0;
+    if (xSemaphoreTake(stateMutex, pdMS_TO_TICKS(2))) {
+      sensor = sharedState.sensorValue;
+      xSemaphoreGive(stateMutex);
+    }
+
+    // Level in 8.8 fixed point pixels: jumps up, falls at a speed-dependent rate
+    uint32_t target = ((uint32_t)sensor * _count << 8) / 4096;
+    uint32_t fall = 16u + speed * 4u;
+    _vuLevel = target >= _vuLevel ? target : (_vuLevel - target > fall ? _vuLevel - fall : target);
+    if (_vuLevel >= _vuPeak) _vuPeak = _vuLevel;
+    else _vuPeak = _vuPeak > 24 ? _vuPeak - 24 : 0;
+
+    uint16_t lit = _vuLevel >> 8;
+    uint16_t peak = _vuPeak >> 8;
+    for (uint16_t i = 0; i < _count; i++) {
+      if (i < lit) {
+        uint16_t pct = (i * 100u) / _count;
+        if (pct < 60)      setPixel(i, 0, 255, 0);
+        else if (pct < 85) setPixel(i, 255, 160, 0);
+        else               setPixel(i, 255, 0, 0);
+      } else if (i == peak && peak > 0) {
+        setPixel(i, 255, 255, 255);
+      } else {
+        setPixel(i, 0, 0, 0);
+      }
+    }
+  }
+
+  // Scale the frame down only when it would exceed the current budget
+  void limit(const LedEffectParams& p, uint8_t* wire) {
+    size_t bytes = (size_t)_count * 3;
+    uint32_t estimatedMa = ledEstimateCurrentMa(wire, bytes, _count);
+    uint8_t scale = ledLimitScale(estimatedMa, p.budgetMa, _count);
+    if (scale < 255) {
+      ledScaleFrame(wire, bytes, scale);
+      _stats.limitedFrames++;
+    }
+    _stats.estimatedMa = estimatedMa;
+    _stats.limitScale = scale;
+  }
+
+  // Brightness, gamma and GRB reordering in one pass
+  void output(const LedEffectParams& p, uint8_t* wire) {
+    const uint8_t* src = _scene;
+    uint8_t bri = p.brightness;
+    for (uint16_t i = 0; i < _count; i++, src += 3, wire += 3) {
+      wire[0] = _gamma[scale8(src[1], bri)];
+      wire[1] = _gamma[scale8(src[0], bri)];
+      wire[2] = _gamma[scale8(src[2], bri)];
+    }
+  }
+
+  uint16_t _count = 0;
+  LedOutput _outputs[LED_MAX_OUTPUTS];
+  uint8_t _outputCount = 0;
+  uint8_t* _scene = nullptr;
+  uint8_t* _wire[2] = { nullptr, nullptr };
+  uint8_t* _heat = nullptr;
+
+  uint8_t _gamma[256];
+  uint8_t _sine[256];
+  uint8_t _hue[256][3];
+
+  uint32_t _phase = 0;
+  uint32_t _vuLevel = 0;
+  uint32_t _vuPeak = 0;
+  uint32_t _rng = 0x9E3779B9;
+
+  LedEffectParams _params = {};
+  SemaphoreHandle_t _paramsMutex = nullptr;
+  LedStripConfig _pendingConfig = {};
+  volatile bool _reconfigurePending = false;
+  TaskHandle_t _task = nullptr;
+  LedFrameStats _stats = {};
+};
+
+LedEffectsEngine ledEffects;
+
+#endif
@@ -0,0 +1,248 @@
+/*
+ * ESP32 Multitool - Delta OTA Patches
+ * Rebuilds a new firmware image from the running one plus a binary diff
+ *
+ * Patch format (little-endian), produced by tools/ota_tool.py diff:
+ *   0   4  magic "MTDP"
+ *   4   1  version (1), then 3 reserved bytes
+ *   8   4  old image size     12  32  old image SHA-256
+ *   44  4  new image size     48  32  new image SHA-256
+ *   80  records until the new image is complete:
+ *         u32 diffLen, u32 extraLen, i32 seek
+ *         diffLen bytes:  new = old[oldPos++] + diff (mod 256)
+ *         extraLen bytes: new = extra
+ *         oldPos += seek
+ *
+ * This is the bsdiff control/diff/extra scheme with the three streams
+ * interleaved, so it can be applied front to back as the upload arrives.
+ * Old bytes come from the running partition a block at a time; RAM use is
+ * one block plus the header. The old image is hashed before anything is
+ * written, so a patch made for other firmware is rejected up front.
+ */
+
+#ifndef OTA_DELTA_H
+#define OTA_DELTA_H
+
+#include <Arduino.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <mbedtls/sha256.h>
+
+namespace DeltaConfig {
+  const uint8_t MAGIC[4] = { 'M', 'T', 'D', 'P' };
+  const uint8_t VERSION = 1;
+  const size_t HEADER_SIZE = 80;
+  const size_t RECORD_SIZE = 12;
+  const size_t BLOCK_SIZE = 1024;   // Old-image read size
+}
+
+/**
+ * True if the buffer starts with the delta patch magic
+ */
+inline bool deltaIsPatch(const uint8_t* data, size_t len) {
+  return len >= sizeof(DeltaConfig::MAGIC) && memcmp(data, DeltaConfig::MAGIC, sizeof(DeltaConfig::MAGIC)) == 0;
+}
+
+class DeltaPatcher {
+public:
+  typedef bool (*Sink)(const uint8_t* data, size_t len, void* context);
+
+  bool begin(Sink sink, void* context) {
+    end();
+    _block = (uint8_t*)malloc(DeltaConfig::BLOCK_SIZE);
+    if (_block == nullptr) return fail("Out of memory for patcher");
+    _old = esp_ota_get_running_partition();
+    _sink = sink;
+    _context = context;
+    _stage = Stage::HEADER;
+    _need = DeltaConfig::HEADER_SIZE;
+    _have = 0;
+    _oldPos = 0;
+    _newBytes = 0;
+    _error = nullptr;
+    return true;
+  }
+
+  void end() {
+    free(_block);
+    _block = nullptr;
+  }
+
+  /**
+   * Consume patch bytes; rebuilt image bytes go to the sink
+   * @return false on a format, old-image or sink error (see error())
+   */
+  bool feed(const uint8_t* in, size_t len) {
+    while (len > 0) {
+      switch (_stage) {
+        case Stage::HEADER:
+        case Stage::RECORD: {
+          size_t take = _need - _have;
+          if (take > len) take = len;
+          memcpy(_header + _have, in, take);
+          _have += take;
+          in += take;
+          len -= take;
+          if (_have == _need && !parseHeaderOrRecord()) return false;
+          break;
+        }
+        case Stage::DIFF: {
+          size_t used = 0;
+          if (!applyDiff(in, len, used)) return false;
+          in += used;
+          len -= used;
+          break;
+        }
+        case Stage::EXTRA: {
+          size_t take = _remaining < len ? _remaining : len;
+          if (!emit(in, take)) return false;
+          in += take;
+          len -= take;
+          _remaining -= take;
+          if (_remaining == 0) finishRecord();
+          break;
+        }
+        case Stage::DONE:
+          return fail("Data after end of patch");
+        default:
+          return false;
+      }
+    }
+    return true;
+  }
+
+  bool finished() const { return _stage == Stage::DONE; }
+  const char* error() const { return _error != nullptr ? _error : "Truncated patch"; }
+  const uint8_t* newHash() const { return _newHash; }
+  uint32_t newSize() const { return _newSize; }
+
+private:
+  enum class Stage : uint8_t { HEADER, RECORD, DIFF, EXTRA, DONE, FAILED };
+
+  static uint32_t readU32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+  }
+
+  bool fail(const char* reason) {
+    _stage = Stage::FAILED;
+    _error = reason;
+    return false;
+  }
+
+  bool parseHeaderOrRecord() {
+    if (_stage == Stage::HEADER) {
+      if (!deltaIsPatch(_header, _have) || _header[4] != DeltaConfig::VERSION) {
+        return fail("Unsupported patch version");
+      }
+      _oldSize = readU32(_header + 8);
+      _newSize = readU32(_header + 44);
+      memcpy(_newHash, _header + 48, sizeof(_newHash));
+      if (_old == nullptr || _oldSize > _old->size) return fail("Patch is for a larger image");
+      if (!oldImageMatches(_header + 12)) return fail("Patch was made for different firmware");
+      LOG_INFO("Delta: patching %lu -> %lu bytes from %s",
+               (unsigned long)_oldSize, (unsigned long)_newSize, _old->label);
+      return nextRecord();
+    }
+
+    _remaining = readU32(_header);
+    _extraLen = readU32(_header + 4);
+    _seek = (int32_t)readU32(_header + 8);
+    if ((uint64_t)_newBytes + _remaining + _extraLen > _newSize) return fail("Patch overruns new image");
+    if ((uint64_t)_oldPos + _remaining > _oldSize) return fail("Patch reads past old image");
+    _stage = Stage::DIFF;
+    if (_remaining == 0) startExtra();
+    return true;
+  }
+
+  bool nextRecord() {
+    if (_newBytes == _newSize) {
+      _stage = Stage::DONE;
+      end();
+      return true;
+    }
+    _stage = Stage::RECORD;
+    _need = DeltaConfig::RECORD_SIZE;
+    _have = 0;
+    return true;
+  }
+
+  void startExtra() {
+    _remaining = _extraLen;
+    _stage = Stage::EXTRA;
+    if (_remaining == 0) finishRecord();
+  }
+
+  void finishRecord() {
+    int64_t pos = (int64_t)_oldPos + _seek;
+    if (pos < 0 || pos > (int64_t)_oldSize) {
+      fail("Patch seeks outside old image");
+      return;
+    }
+    _oldPos = (uint32_t)pos;
+    nextRecord();
+  }
+
+  /**
+   * Add diff bytes to old bytes one block at a time
+   */
+  bool applyDiff(const uint8_t* in, size_t len, size_t& used) {
+    used = 0;
+    while (used < len && _remaining > 0) {
+      size_t take = len - used;
+      if (take > _remaining) take = _remaining;
+      if (take > DeltaConfig::BLOCK_SIZE) take = DeltaConfig::BLOCK_SIZE;
+      if (esp_partition_read(_old, _oldPos, _block, take) != ESP_OK) return fail("Old image read failed");
+      for (size_t i = 0; i < take; i++) _block[i] += in[used + i];
+      if (!emit(_block, take)) return false;
+      _oldPos += take;
+      _remaining -= take;
+      used += take;
+    }
+    if (_remaining == 0) startExtra();
+    return _stage != Stage::FAILED;
+  }
+
+  bool emit(const uint8_t* data, size_t len) {
+    _newBytes += len;
+    if (!_sink(data, len, _context)) return fail("Write failed");
+    return true;
+  }
+
+  bool oldImageMatches(const uint8_t* expected) {
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    bool readOk = true;
+    for (uint32_t pos = 0; pos < _oldSize && readOk; pos += DeltaConfig::BLOCK_SIZE) {
+      size_t take = _oldSize - pos < DeltaConfig::BLOCK_SIZE ? _oldSize - pos : DeltaConfig::BLOCK_SIZE;
+      readOk = esp_partition_read(_old, pos, _block, take) == ESP_OK;
+      if (readOk) mbedtls_sha256_update(&sha, _block, take);
+    }
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    return readOk && memcmp(digest, expected, sizeof(digest)) == 0;
+  }
+
+  const esp_partition_t* _old = nullptr;
+  uint8_t* _block = nullptr;
+  Sink _sink = nullptr;
+  void* _context = nullptr;
+
+  Stage _stage = Stage::HEADER;
+  uint8_t _header[DeltaConfig::HEADER_SIZE];
+  size_t _need = 0;
+  size_t _have = 0;
+
+  uint32_t _oldSize = 0;
+  uint32_t _newSize = 0;
+  uint8_t _newHash[32];
+  uint32_t _oldPos = 0;
+  uint32_t _newBytes = 0;
+  uint32_t _remaining = 0;   // Bytes left in the current diff or extra run
+  uint32_t _extraLen = 0;
+  int32_t _seek = 0;
+  const char* _error = nullptr;
+};
+
+#endif
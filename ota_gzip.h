@@ -0,0 +1,242 @@
+/*
+ * ESP32 Multitool - Streaming gzip Inflater
+ * Decompresses .bin.gz firmware images chunk by chunk during OTA
+ *
+ * Uses the miniz inflater in ROM (tinfl), so it adds no code size. The
+ * gzip header is parsed incrementally, the deflate stream is inflated into
+ * a 32 KB circular window (the largest back-reference deflate allows), and
+ * each run of output is handed to a sink as soon as it is produced. The
+ * trailer's CRC-32 and length are checked at the end.
+ *
+ * RAM: ~11 KB decompressor state + 32 KB window, allocated only while an
+ * update is running.
+ */
+
+#ifndef OTA_GZIP_H
+#define OTA_GZIP_H
+
+#include <Arduino.h>
+#include <rom/miniz.h>
+#include <esp_rom_crc.h>
+
+namespace GzipConfig {
+  const uint8_t MAGIC0 = 0x1F;
+  const uint8_t MAGIC1 = 0x8B;
+  const uint8_t METHOD_DEFLATE = 8;
+  const uint8_t FLAG_HCRC = 0x02;
+  const uint8_t FLAG_EXTRA = 0x04;
+  const uint8_t FLAG_NAME = 0x08;
+  const uint8_t FLAG_COMMENT = 0x10;
+}
+
+/**
+ * True if the buffer starts with the gzip magic bytes
+ */
+inline bool gzipIsCompressed(const uint8_t* data, size_t len) {
+  return len >= 2 && data[0] == GzipConfig::MAGIC0 && data[1] == GzipConfig::MAGIC1;
+}
+
+class GzipInflater {
+public:
+  typedef bool (*Sink)(const uint8_t* data, size_t len, void* context);
+
+  bool begin(Sink sink, void* context) {
+    end();
+    _inflator = (tinfl_decompressor*)malloc(sizeof(tinfl_decompressor));
+    _window = (uint8_t*)malloc(TINFL_LZ_DICT_SIZE);
+    if (_inflator == nullptr || _window == nullptr) {
+      end();
+      return fail("Out of memory for inflater");
+    }
+    tinfl_init(_inflator);
+    _sink = sink;
+    _context = context;
+    _stage = Stage::HEADER;
+    _need = 10;
+    _have = 0;
+    _windowPos = 0;
+    _crc = 0;
+    _outBytes = 0;
+    _inflateUs = 0;
+    _error = nullptr;
+    return true;
+  }
+
+  void end() {
+    free(_inflator);
+    free(_window);
+    _inflator = nullptr;
+    _window = nullptr;
+  }
+
+  /**
+   * Consume compressed bytes; output goes to the sink
+   * @return false on a format, CRC or sink error (see error())
+   */
+  bool feed(const uint8_t* in, size_t len) {
+    while (len > 0) {
+      if (_stage == Stage::FAILED) return false;
+      if (_stage == Stage::DONE) return fail("Data after gzip trailer");
+
+      if (_stage == Stage::DEFLATE) {
+        size_t used = 0;
+        if (!inflate(in, len, used)) return false;
+        in += used;
+        len -= used;
+        continue;
+      }
+
+      // Optional header fields: skip a counted extra field or a NUL-terminated string
+      if (_stage == Stage::EXTRA) {
+        size_t take = _skip < len ? _skip : len;
+        in += take;
+        len -= take;
+        _skip -= take;
+        if (_skip == 0) nextHeaderField();
+        continue;
+      }
+      if (_stage == Stage::NAME || _stage == Stage::COMMENT) {
+        uint8_t c = *in++;
+        len--;
+        if (c == 0) nextHeaderField();
+        continue;
+      }
+
+      // Fixed header, extra length, header CRC and trailer: collect _need bytes
+      size_t take = _need - _have;
+      if (take > len) take = len;
+      memcpy(_buf + _have, in, take);
+      _have += take;
+      in += take;
+      len -= take;
+      if (_have == _need && !parseField()) return false;
+    }
+    return _stage != Stage::FAILED;
+  }
+
+  bool finished() const { return _stage == Stage::DONE; }
+  const char* error() const { return _error != nullptr ? _error : "Truncated gzip image"; }
+  uint32_t outBytes() const { return _outBytes; }
+  uint32_t inflateUs() const { return _inflateUs; }
+
+private:
+  enum class Stage : uint8_t { HEADER, EXTRA_LEN, EXTRA, NAME, COMMENT, HCRC, DEFLATE, TRAILER, DONE, FAILED };
+
+  bool fail(const char* reason) {
+    _stage = Stage::FAILED;
+    _error = reason;
+    return false;
+  }
+
+  void expect(Stage stage, size_t bytes) {
+    _stage = stage;
+    _need = bytes;
+    _have = 0;
+  }
+
+  bool parseField() {
+    switch (_stage) {
+      case Stage::HEADER:
+        if (_buf[0] != GzipConfig::MAGIC0 || _buf[1] != GzipConfig::MAGIC1 ||
+            _buf[2] != GzipConfig::METHOD_DEFLATE) {
+          return fail("Not a gzip/deflate image");
+        }
+        _flags = _buf[3];
+        _fieldIndex = 0;
+        nextHeaderField();
+        return true;
+      case Stage::EXTRA_LEN:
+        _skip = _buf[0] | (_buf[1] << 8);
+        if (_skip == 0) {
+          nextHeaderField();
+        } else {
+          expect(Stage::EXTRA, 0);
+        }
+        return true;
+      case Stage::HCRC:
+        nextHeaderField();
+        return true;
+      case Stage::TRAILER: {
+        uint32_t crc = _buf[0] | (_buf[1] << 8) | (_buf[2] << 16) | ((uint32_t)_buf[3] << 24);
+        uint32_t size = _buf[4] | (_buf[5] << 8) | (_buf[6] << 16) | ((uint32_t)_buf[7] << 24);
+        if (crc != _crc) return fail("gzip CRC mismatch");
+        if (size != _outBytes) return fail("gzip length mismatch");
+        _stage = Stage::DONE;
+        end();
+        return true;
+      }
+      default:
+        return fail("gzip parser error");
+    }
+  }
+
+  /**
+   * Advance to the next optional header field present in the flags
+   */
+  void nextHeaderField() {
+    static const uint8_t order[] = { GzipConfig::FLAG_EXTRA, GzipConfig::FLAG_NAME,
+                                     GzipConfig::FLAG_COMMENT, GzipConfig::FLAG_HCRC };
+    while (_fieldIndex < sizeof(order)) {
+      uint8_t flag = order[_fieldIndex++];
+      if (!(_flags & flag)) continue;
+      if (flag == GzipConfig::FLAG_EXTRA) return expect(Stage::EXTRA_LEN, 2);
+      if (flag == GzipConfig::FLAG_NAME) return expect(Stage::NAME, 0);
+      if (flag == GzipConfig::FLAG_COMMENT) return expect(Stage::COMMENT, 0);
+      return expect(Stage::HCRC, 2);
+    }
+    expect(Stage::DEFLATE, 0);
+  }
+
+  /**
+   * Inflate as much of the input as possible, flushing output to the sink
+   */
+  bool inflate(const uint8_t* in, size_t len, size_t& used) {
+    used = 0;
+    for (;;) {
+      size_t inSize = len - used;
+      size_t outSize = TINFL_LZ_DICT_SIZE - _windowPos;
+      uint32_t startUs = micros();
+      tinfl_status status = tinfl_decompress(_inflator, in + used, &inSize, _window,
+                                             _window + _windowPos, &outSize,
+                                             TINFL_FLAG_HAS_MORE_INPUT);
+      _inflateUs += micros() - startUs;
+      used += inSize;
+
+      if (outSize > 0) {
+        const uint8_t* out = _window + _windowPos;
+        _crc = esp_rom_crc32_le(_crc, out, outSize);
+        _outBytes += outSize;
+        _windowPos = (_windowPos + outSize) & (TINFL_LZ_DICT_SIZE - 1);
+        if (!_sink(out, outSize, _context)) return fail("Write failed");
+      }
+
+      if (status == TINFL_STATUS_DONE) {
+        expect(Stage::TRAILER, 8);
+        return true;
+      }
+      if (status < 0) return fail("Corrupt deflate stream");
+      if (status == TINFL_STATUS_NEEDS_MORE_INPUT) return true;  // All input consumed
+    }
+  }
+
+  tinfl_decompressor* _inflator = nullptr;
+  uint8_t* _window = nullptr;
+  size_t _windowPos = 0;
+  Sink _sink = nullptr;
+  void* _context = nullptr;
+
+  Stage _stage = Stage::HEADER;
+  uint8_t _buf[10];
+  size_t _need = 0;
+  size_t _have = 0;
+  size_t _skip = 0;
+  uint8_t _flags = 0;
+  uint8_t _fieldIndex = 0;
+
+  uint32_t _crc = 0;
+  uint32_t _outBytes = 0;
+  uint32_t _inflateUs = 0;
+  const char* _error = nullptr;
+};
+
+#endif
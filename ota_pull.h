@@ -0,0 +1,349 @@
+/*
+ * ESP32 Multitool - Pull OTA Updater
+ * Polls a version manifest on a local server and installs newer firmware
+ *
+ * The manifest is a small JSON file:
+ *   {"version": "2.6.0", "url": "firmware.bin.gz", "sha256": "<64 hex>", "size": 123456}
+ * "url" may be absolute or relative to the manifest and can point at any
+ * image /update accepts (.bin, .bin.gz, .patch). "size" is the download
+ * size and is optional.
+ *
+ * When the manifest version is newer than FIRMWARE_VERSION the image is
+ * streamed through an OtaSession (hash check, rollback) by this module's
+ * own task, so the web server stays responsive. A dropped connection is
+ * resumed with an HTTP Range request from the last byte written.
+ *
+ * Settings are part of the device configuration (config_store.h); the
+ * task works on its own copy. tools/ota_tool.py manifest and serve provide
+ * a local stand-in server.
+ */
+
+#ifndef OTA_PULL_H
+#define OTA_PULL_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <ArduinoJson.h>
+#include "ota_update.h"
+
+namespace OtaPullConfig {
+  const uint16_t TASK_STACK = 6144;
+  const uint8_t TASK_PRIORITY = 1;          // Below wifiTask; downloads are background work
+  const uint8_t TASK_CORE = 0;
+  const uint16_t DEFAULT_INTERVAL_MIN = 60;
+  const uint32_t FIRST_CHECK_MS = 30000;    // After boot, once WiFi has had time to connect
+  const uint16_t MAX_MANIFEST_BYTES = 1024;
+  const uint8_t MAX_RESUMES = 5;
+  const uint32_t STALL_TIMEOUT_MS = 15000;  // No data for this long counts as a dropped connection
+  const size_t CHUNK = 1436;                // Same granularity as web uploads
+}
+
+struct OtaPullSettings {
+  bool enabled;
+  uint16_t intervalMin;
+  char manifestUrl[128];
+};
+
+enum class OtaPullState : uint8_t {
+  IDLE,
+  CHECKING,
+  UP_TO_DATE,
+  DOWNLOADING,
+  FAILED,
+  REBOOTING
+};
+
+struct OtaPullStatus {
+  OtaPullState state;
+  char available[16];       // Version offered by the last manifest
+  uint32_t lastCheckMs;     // millis() of the last completed check, 0 = never
+  uint8_t resumes;          // Range resumes during the last download
+  char error[48];
+};
+
+/**
+ * Compare dotted versions numerically ("2.10.0" > "2.9.1")
+ * @return <0, 0 or >0 like strcmp
+ */
+int otaCompareVersions(const char* a, const char* b) {
+  for (uint8_t part = 0; part < 4; part++) {
+    char* endA;
+    char* endB;
+    unsigned long va = strtoul(a, &endA, 10);
+    unsigned long vb = strtoul(b, &endB, 10);
+    if (va != vb) return va < vb ? -1 : 1;
+    a = *endA == '.' ? endA + 1 : endA;
+    b = *endB == '.' ? endB + 1 : endB;
+  }
+  return 0;
+}
+
+const char* otaPullStateName(OtaPullState state) {
+  switch (state) {
+    case OtaPullState::CHECKING: return "checking";
+    case OtaPullState::UP_TO_DATE: return "up_to_date";
+    case OtaPullState::DOWNLOADING: return "downloading";
+    case OtaPullState::FAILED: return "failed";
+    case OtaPullState::REBOOTING: return "rebooting";
+    default: return "idle";
+  }
+}
+
+class OtaPuller {
+public:
+  /**
+   * Start the polling task with the stored settings
+   */
+  bool begin(const OtaPullSettings& settings) {
+    _mutex = xSemaphoreCreateMutex();
+    if (_mutex == nullptr) return false;
+    _settings = settings;
+    if (_settings.intervalMin == 0) _settings.intervalMin = OtaPullConfig::DEFAULT_INTERVAL_MIN;
+    xTaskCreatePinnedToCore(taskEntry, "OtaPull", OtaPullConfig::TASK_STACK, this,
+                            OtaPullConfig::TASK_PRIORITY, &_task, OtaPullConfig::TASK_CORE);
+    return _task != nullptr;
+  }
+
+  /**
+   * Check the manifest now, even if polling is disabled
+   */
+  void checkNow() {
+    if (_task != nullptr) xTaskNotify(_task, NOTIFY_CHECK, eSetBits);
+  }
+
+  OtaPullSettings settings() {
+    OtaPullSettings copy = {};
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(10))) {
+      copy = _settings;
+      xSemaphoreGive(_mutex);
+    }
+    return copy;
+  }
+
+  /**
+   * Replace the settings; the next poll uses them (the caller persists them)
+   */
+  void setSettings(const OtaPullSettings& settings) {
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(10))) {
+      _settings = settings;
+      xSemaphoreGive(_mutex);
+    }
+    if (_task != nullptr) xTaskNotify(_task, NOTIFY_SETTINGS, eSetBits);
+  }
+
+  OtaPullStatus status() {
+    OtaPullStatus copy = {};
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(10))) {
+      copy = _status;
+      xSemaphoreGive(_mutex);
+    }
+    return copy;
+  }
+
+  /**
+   * Progress of the current or last download (diagnostic snapshot)
+   */
+  const OtaStats& downloadStats() const { return _session.stats(); }
+
+private:
+  static const uint32_t NOTIFY_CHECK = 1 << 0;
+  static const uint32_t NOTIFY_SETTINGS = 1 << 1;
+
+  static void taskEntry(void* arg) {
+    static_cast<OtaPuller*>(arg)->run();
+  }
+
+  void run() {
+    uint32_t waitMs = OtaPullConfig::FIRST_CHECK_MS;
+    for (;;) {
+      uint32_t events = 0;
+      xTaskNotifyWait(0, UINT32_MAX, &events, pdMS_TO_TICKS(waitMs));
+      OtaPullSettings s = settings();
+      waitMs = (uint32_t)s.intervalMin * 60000UL;
+
+      bool forced = events & NOTIFY_CHECK;
+      if (events != 0 && !forced) continue;  // Settings changed: restart the wait
+      if ((!s.enabled && !forced) || s.manifestUrl[0] == '\0') continue;
+      if (WiFi.status() != WL_CONNECTED) continue;
+      check(s.manifestUrl);
+    }
+  }
+
+  void setState(OtaPullState state, const char* error = nullptr) {
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100))) {
+      _status.state = state;
+      if (error != nullptr) {
+        strncpy(_status.error, error, sizeof(_status.error) - 1);
+        _status.error[sizeof(_status.error) - 1] = '\0';
+      }
+      if (state != OtaPullState::CHECKING && state != OtaPullState::DOWNLOADING) {
+        _status.lastCheckMs = millis();
+      }
+      xSemaphoreGive(_mutex);
+    }
+    if (error != nullptr && error[0] != '\0') LOG_WARN("OTA pull: %s", error);
+  }
+
+  /**
+   * Fetch the manifest and install the image if it is newer
+   */
+  void check(const char* manifestUrl) {
+    setState(OtaPullState::CHECKING, "");
+
+    HTTPClient http;
+    http.setTimeout(OtaPullConfig::STALL_TIMEOUT_MS);
+    if (!http.begin(manifestUrl)) return setState(OtaPullState::FAILED, "Bad manifest URL");
+    int code = http.GET();
+    if (code != HTTP_CODE_OK || http.getSize() > OtaPullConfig::MAX_MANIFEST_BYTES) {
+      http.end();
+      return setState(OtaPullState::FAILED, code == HTTP_CODE_OK ? "Manifest too large" : "Manifest fetch failed");
+    }
+    StaticJsonDocument<512> manifest;
+    DeserializationError jsonError = deserializeJson(manifest, http.getString());
+    http.end();
+    if (jsonError) return setState(OtaPullState::FAILED, "Manifest is not valid JSON");
+
+    const char* version = manifest["version"] | "";
+    const char* imageUrl = manifest["url"] | "";
+    const char* sha256 = manifest["sha256"] | "";
+    uint32_t size = manifest["size"] | 0;
+    if (version[0] == '\0' || imageUrl[0] == '\0') return setState(OtaPullState::FAILED, "Manifest lacks version or url");
+
+    if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100))) {
+      strncpy(_status.available, version, sizeof(_status.available) - 1);
+      _status.available[sizeof(_status.available) - 1] = '\0';
+      _status.resumes = 0;
+      xSemaphoreGive(_mutex);
+    }
+
+    if (otaCompareVersions(version, FIRMWARE_VERSION) <= 0) {
+      LOG_DEBUG("OTA pull: %s is current (manifest %s)", FIRMWARE_VERSION, _status.available);
+      return setState(OtaPullState::UP_TO_DATE);
+    }
+
+    // Log member copies: the deferred logger reads %s arguments after check() returns
+    resolveUrl(manifestUrl, imageUrl, _imageUrl, sizeof(_imageUrl));
+    LOG_INFO("OTA pull: updating %s -> %s from %s", FIRMWARE_VERSION, _status.available, _imageUrl);
+
+    setState(OtaPullState::DOWNLOADING);
+    if (!download(_imageUrl, sha256, size)) return;
+
+    setState(OtaPullState::REBOOTING);
+    LOG_INFO("OTA pull: installed %s, rebooting", _status.available);
+    delay(1000);
+    ESP.restart();
+  }
+
+  /**
+   * Stream the image into the session, resuming with Range after drops
+   */
+  bool download(const char* url, const char* sha256, uint32_t size) {
+    if (!_session.begin(sha256)) {
+      setState(OtaPullState::FAILED, _session.stats().error);
+      return false;
+    }
+
+    static uint8_t buf[OtaPullConfig::CHUNK];
+    uint8_t attempt = 0;
+
+    for (;;) {
+      uint32_t offset = _session.stats().wireBytes;
+      bool complete = false;
+
+      HTTPClient http;
+      http.setTimeout(OtaPullConfig::STALL_TIMEOUT_MS);
+      http.useHTTP10(true);  // No chunked encoding, so the stream is the raw body
+      if (http.begin(url)) {
+        char range[32];
+        if (offset > 0) {
+          snprintf(range, sizeof(range), "bytes=%lu-", (unsigned long)offset);
+          http.addHeader("Range", range);
+        }
+        int code = http.GET();
+        // A server without Range support resends from byte 0; skip what we have
+        uint32_t skip = (offset > 0 && code == HTTP_CODE_OK) ? offset : 0;
+        if (code == HTTP_CODE_OK || (offset > 0 && code == HTTP_CODE_PARTIAL_CONTENT)) {
+          int remaining = http.getSize();  // -1 if unknown
+          if (size == 0 && offset == 0 && remaining > 0) size = remaining;
+
+          WiFiClient* stream = http.getStreamPtr();
+          uint32_t lastDataMs = millis();
+          while (remaining != 0 && millis() - lastDataMs < OtaPullConfig::STALL_TIMEOUT_MS) {
+            size_t available = stream->available();
+            if (available == 0) {
+              if (!stream->connected()) break;
+              vTaskDelay(pdMS_TO_TICKS(5));
+              continue;
+            }
+            size_t n = stream->readBytes(buf, available < sizeof(buf) ? available : sizeof(buf));
+            lastDataMs = millis();
+            if (remaining > 0) remaining -= n;
+
+            size_t start = 0;
+            if (skip > 0) {
+              start = skip < n ? skip : n;
+              skip -= start;
+            }
+            if (n > start && !_session.write(buf + start, n - start)) {
+              http.end();
+              setState(OtaPullState::FAILED, _session.stats().error);
+              return false;
+            }
+          }
+          complete = size > 0 ? _session.stats().wireBytes >= size : remaining <= 0;
+        } else {
+          LOG_WARN("OTA pull: HTTP %d at offset %lu", code, (unsigned long)offset);
+        }
+      }
+      http.end();
+
+      if (complete) break;
+
+      // Made progress since the last attempt: the link is alive, so keep trying
+      if (_session.stats().wireBytes > offset) attempt = 0;
+      if (++attempt > OtaPullConfig::MAX_RESUMES) {
+        _session.abort();
+        setState(OtaPullState::FAILED, "Download failed after retries");
+        return false;
+      }
+      if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(100))) {
+        _status.resumes++;
+        xSemaphoreGive(_mutex);
+      }
+      LOG_WARN("OTA pull: resuming at %lu bytes", (unsigned long)_session.stats().wireBytes);
+      vTaskDelay(pdMS_TO_TICKS(1000UL << attempt));  // 2, 4, 8 ... s
+    }
+
+    if (!_session.end()) {
+      setState(OtaPullState::FAILED, _session.stats().error);
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * Resolve a manifest-relative image URL
+   */
+  static void resolveUrl(const char* manifestUrl, const char* imageUrl, char* out, size_t outLen) {
+    if (strncmp(imageUrl, "http://", 7) == 0 || strncmp(imageUrl, "https://", 8) == 0) {
+      strncpy(out, imageUrl, outLen - 1);
+      out[outLen - 1] = '\0';
+      return;
+    }
+    const char* slash = strrchr(manifestUrl, '/');
+    size_t baseLen = slash != nullptr ? (size_t)(slash - manifestUrl) + 1 : strlen(manifestUrl);
+    snprintf(out, outLen, "%.*s%s", (int)baseLen, manifestUrl, imageUrl);
+  }
+
+  OtaPullSettings _settings = {};
+  OtaPullStatus _status = {};
+  char _imageUrl[192] = {};   // Resolved image URL of the current check
+  OtaSession _session;
+  SemaphoreHandle_t _mutex = nullptr;
+  TaskHandle_t _task = nullptr;
+};
+
+OtaPuller otaPuller;
+
+#endif
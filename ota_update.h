@@ -0,0 +1,360 @@
+/*
+ * ESP32 Multitool - Verified OTA Updates
+ * Streaming firmware writer with SHA-256 check and boot rollback
+ *
+ * Each upload chunk is hashed and written to the idle OTA slot as it
+ * arrives. The image is only activated if the digest matches the expected
+ * one, sent as an X-Firmware-SHA256 header (or ?sha256= argument); a
+ * mismatch aborts the update and the running slot stays selected.
+ *
+ * gzip-compressed images (.bin.gz) are detected by their magic bytes and
+ * inflated on the fly (ota_gzip.h); the hash always covers the
+ * decompressed image, so one digest works for both forms.
+ *
+ * Delta patches (ota_delta.h, optionally gzipped as well) are recognised the
+ * same way and rebuild the new image from the running partition. A patch
+ * carries the digest of the image it produces, which is checked even when
+ * no X-Firmware-SHA256 is given.
+ *
+ * A freshly flashed image boots in the "pending verify" state. The sketch
+ * marks it valid once WiFi and the web server are up (otaConfirmRunningApp).
+ * If the new image crashes, hangs into the watchdog or restarts before that,
+ * the bootloader falls back to the previous slot on the next boot.
+ *
+ * Web uploads and the pull updater each have their own session; the
+ * flash writer (Update) is shared, so only one session can hold it.
+ */
+
+#ifndef OTA_UPDATE_H
+#define OTA_UPDATE_H
+
+#include <Arduino.h>
+#include <Update.h>
+#include <esp_ota_ops.h>
+#include <mbedtls/sha256.h>
+#include <atomic>
+#include "ota_gzip.h"
+#include "ota_delta.h"
+
+namespace OtaConfig {
+  const char HASH_HEADER[] = "X-Firmware-SHA256";
+  const char HASH_ARG[] = "sha256";
+  const bool REQUIRE_HASH = false;   // Set true to refuse uploads without an expected digest
+}
+
+enum class OtaState : uint8_t {
+  IDLE,
+  RECEIVING,
+  SUCCESS,
+  FAILED
+};
+
+struct OtaStats {
+  OtaState state;
+  uint32_t bytes;          // Image bytes written so far / in the last update
+  uint32_t wireBytes;      // Bytes received (smaller than bytes for gzip uploads)
+  bool compressed;         // Upload was gzip-compressed
+  bool delta;              // Upload was a patch against the running image
+  uint32_t inflateKbps;    // Decompression throughput, excluding flash writes
+  uint32_t elapsedMs;      // From first to last chunk
+  uint32_t kbps;           // Average transfer rate in KB/s (received bytes)
+  bool verified;           // Digest matched an expected hash
+  char sha256[65];         // Hex digest of the received image
+  char error[48];
+};
+
+/**
+ * Keep the new image pending until otaConfirmRunningApp()
+ * Overrides the core's weak default, which marks every boot valid at once.
+ */
+extern "C" bool verifyRollbackLater() {
+  return true;
+}
+
+// Set while a session owns the Update writer
+static std::atomic<bool> otaWriterBusy(false);
+
+class OtaSession {
+public:
+  /**
+   * Start an update
+   * @param expectedHash 64 hex chars, or nullptr/empty to skip verification
+   */
+  bool begin(const char* expectedHash) {
+    _stats = {};
+    _stats.state = OtaState::RECEIVING;
+    _decodedBytes = 0;
+    _hasExpected = false;
+
+    if (expectedHash != nullptr && expectedHash[0] != '\0') {
+      if (!parseHash(expectedHash, _expectedBytes)) return fail("Expected SHA-256 is not 64 hex chars");
+      _hasExpected = true;
+    } else if (OtaConfig::REQUIRE_HASH) {
+      return fail("Missing X-Firmware-SHA256");
+    }
+
+    bool idle = false;
+    if (!otaWriterBusy.compare_exchange_strong(idle, true)) return fail("Another update is in progress");
+    _ownsWriter = true;
+
+    if (!Update.begin(UPDATE_SIZE_UNKNOWN)) return fail(Update.errorString());
+
+    mbedtls_sha256_init(&_sha);
+    mbedtls_sha256_starts(&_sha, 0);  // 0 = SHA-256, not SHA-224
+    _hashing = true;
+    _startMs = millis();
+    return true;
+  }
+
+  /**
+   * Take one uploaded chunk: inflate if gzip, then patch if delta, then flash
+   */
+  bool write(const uint8_t* data, size_t len) {
+    if (_stats.state != OtaState::RECEIVING) return false;
+
+    if (_stats.wireBytes == 0 && gzipIsCompressed(data, len)) {
+      _stats.compressed = true;
+      if (!_inflater.begin(decodedSink, this)) {
+        Update.abort();
+        return fail(_inflater.error());
+      }
+    }
+    _stats.wireBytes += len;
+
+    if (_stats.compressed) {
+      if (!_inflater.feed(data, len)) {
+        // A failed flash write already aborted and recorded its own reason
+        if (_stats.state == OtaState::RECEIVING) {
+          Update.abort();
+          fail(_inflater.error());
+        }
+        _inflater.end();
+        return false;
+      }
+      return true;
+    }
+    return writeDecoded(data, len);
+  }
+
+  /**
+   * Finish the digest and activate the image only if it matches
+   */
+  bool end() {
+    if (_stats.state != OtaState::RECEIVING) return false;
+
+    if (_stats.compressed) {
+      bool complete = _inflater.finished();
+      uint32_t inflateUs = _inflater.inflateUs();
+      _stats.inflateKbps = inflateUs > 0 ? (uint32_t)((uint64_t)_inflater.outBytes() * 1000000 / 1024 / inflateUs) : 0;
+      if (!complete) {
+        const char* reason = _inflater.error();
+        _inflater.end();
+        Update.abort();
+        return fail(reason);
+      }
+    }
+
+    if (_stats.delta) {
+      bool complete = _patcher.finished();
+      const char* reason = _patcher.error();
+      _patcher.end();
+      if (!complete) {
+        Update.abort();
+        return fail(reason);
+      }
+      if (!_hasExpected) {
+        memcpy(_expectedBytes, _patcher.newHash(), sizeof(_expectedBytes));
+        _hasExpected = true;
+      }
+    }
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&_sha, digest);
+    freeHash();
+    for (uint8_t i = 0; i < 32; i++) {
+      snprintf(_stats.sha256 + i * 2, 3, "%02x", digest[i]);
+    }
+    updateRate();
+
+    if (_hasExpected) {
+      if (memcmp(digest, _expectedBytes, sizeof(digest)) != 0) {
+        Update.abort();
+        return fail("SHA-256 mismatch");
+      }
+      _stats.verified = true;
+    }
+
+    if (!Update.end(true)) return fail(Update.errorString());
+
+    _stats.state = OtaState::SUCCESS;
+    releaseWriter();
+    LOG_INFO("OTA: %lu bytes (%lu on the wire) in %lu ms (%lu KB/s), sha256 %s%s",
+             (unsigned long)_stats.bytes, (unsigned long)_stats.wireBytes,
+             (unsigned long)_stats.elapsedMs, (unsigned long)_stats.kbps, _stats.sha256,
+             _stats.verified ? " verified" : "");
+    if (_stats.compressed) {
+      LOG_INFO("OTA: inflated at %lu KB/s", (unsigned long)_stats.inflateKbps);
+    }
+    return true;
+  }
+
+  /**
+   * Client went away mid-upload
+   */
+  void abort() {
+    if (_stats.state != OtaState::RECEIVING) return;
+    _inflater.end();
+    _patcher.end();
+    Update.abort();
+    fail("Upload aborted");
+  }
+
+  bool ok() const { return _stats.state == OtaState::SUCCESS; }
+  const OtaStats& stats() const { return _stats; }
+
+private:
+  /**
+   * Hash and flash one run of image bytes
+   */
+  bool writeImage(const uint8_t* data, size_t len) {
+    mbedtls_sha256_update(&_sha, data, len);
+    if (Update.write((uint8_t*)data, len) != len) {
+      Update.abort();
+      return fail(Update.errorString());
+    }
+    _stats.bytes += len;
+    updateRate();
+    return true;
+  }
+
+  static bool writeImageSink(const uint8_t* data, size_t len, void* context) {
+    return static_cast<OtaSession*>(context)->writeImage(data, len);
+  }
+
+  /**
+   * Upload bytes after gzip decoding: either the image itself or a patch
+   */
+  bool writeDecoded(const uint8_t* data, size_t len) {
+    if (_decodedBytes == 0 && deltaIsPatch(data, len)) {
+      _stats.delta = true;
+      if (!_patcher.begin(writeImageSink, this)) {
+        Update.abort();
+        return fail(_patcher.error());
+      }
+    }
+    _decodedBytes += len;
+
+    if (!_stats.delta) return writeImage(data, len);
+    if (!_patcher.feed(data, len)) {
+      if (_stats.state == OtaState::RECEIVING) {
+        Update.abort();
+        fail(_patcher.error());
+      }
+      _patcher.end();
+      return false;
+    }
+    return true;
+  }
+
+  static bool decodedSink(const uint8_t* data, size_t len, void* context) {
+    return static_cast<OtaSession*>(context)->writeDecoded(data, len);
+  }
+
+  void releaseWriter() {
+    if (!_ownsWriter) return;
+    _ownsWriter = false;
+    otaWriterBusy = false;
+  }
+
+  bool fail(const char* reason) {
+    freeHash();
+    releaseWriter();
+    _stats.state = OtaState::FAILED;
+    strncpy(_stats.error, reason, sizeof(_stats.error) - 1);
+    _stats.error[sizeof(_stats.error) - 1] = '\0';
+    LOG_ERROR("OTA failed after %lu bytes: %s", (unsigned long)_stats.bytes, reason);
+    return false;
+  }
+
+  void freeHash() {
+    if (!_hashing) return;
+    mbedtls_sha256_free(&_sha);
+    _hashing = false;
+  }
+
+  void updateRate() {
+    _stats.elapsedMs = millis() - _startMs;
+    // Transfer rate counts bytes received, so gzip uploads show the link speed
+    _stats.kbps = _stats.elapsedMs > 0 ? (uint32_t)((uint64_t)_stats.wireBytes * 1000 / 1024 / _stats.elapsedMs) : 0;
+  }
+
+  static bool parseHash(const char* hex, uint8_t* out) {
+    if (strlen(hex) != 64) return false;
+    for (uint8_t i = 0; i < 32; i++) {
+      char pair[3] = { hex[i * 2], hex[i * 2 + 1], '\0' };
+      if (!isxdigit((unsigned char)pair[0]) || !isxdigit((unsigned char)pair[1])) return false;
+      out[i] = (uint8_t)strtoul(pair, nullptr, 16);
+    }
+    return true;
+  }
+
+  mbedtls_sha256_context _sha;
+  bool _hashing = false;
+  bool _hasExpected = false;
+  bool _ownsWriter = false;
+  uint8_t _expectedBytes[32];
+  uint32_t _startMs = 0;
+  uint32_t _decodedBytes = 0;
+  GzipInflater _inflater;
+  DeltaPatcher _patcher;
+  OtaStats _stats = {};
+};
+
+OtaSession otaSession;
+
+/**
+ * Mark the running image good once the device is reachable again
+ * Call after WiFi and the web server are up. No-op unless this is the
+ * first boot of a new image.
+ */
+void otaConfirmRunningApp() {
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  esp_ota_img_states_t state;
+  if (esp_ota_get_state_partition(running, &state) != ESP_OK || state != ESP_OTA_IMG_PENDING_VERIFY) {
+    return;
+  }
+  if (esp_ota_mark_app_valid_cancel_rollback() == ESP_OK) {
+    LOG_INFO("OTA: new image on %s confirmed", running->label);
+  } else {
+    LOG_ERROR("OTA: could not confirm image on %s", running->label);
+  }
+}
+
+/**
+ * Human-readable OTA state of the running slot
+ */
+const char* otaRunningState() {
+  esp_ota_img_states_t state;
+  if (esp_ota_get_state_partition(esp_ota_get_running_partition(), &state) != ESP_OK) {
+    return "factory";  // No otadata entry: flashed over serial
+  }
+  switch (state) {
+    case ESP_OTA_IMG_NEW: return "new";
+    case ESP_OTA_IMG_PENDING_VERIFY: return "pending_verify";
+    case ESP_OTA_IMG_VALID: return "valid";
+    case ESP_OTA_IMG_INVALID: return "invalid";
+    case ESP_OTA_IMG_ABORTED: return "aborted";
+    default: return "undefined";
+  }
+}
+
+const char* otaStateName(OtaState state) {
+  switch (state) {
+    case OtaState::RECEIVING: return "receiving";
+    case OtaState::SUCCESS: return "success";
+    case OtaState::FAILED: return "failed";
+    default: return "idle";
+  }
+}
+
+#endif
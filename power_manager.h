@@ -0,0 +1,388 @@
+/*
+ * ESP32 Multitool - Power Manager
+ * Activity-driven radio/CPU profiles and RSSI-based TX power
+ *
+ * Three profiles, picked from how recently something needed the device:
+ *
+ *   PERFORMANCE  radio always on, 240 MHz, wifiTask polls every 10 ms
+ *   MODEM        modem sleep at each DTIM, 160 MHz, 20 ms polls
+ *   LIGHT        modem sleep at the listen interval, 80 MHz, 50 ms polls,
+ *                plus automatic light sleep where the build supports it
+ *
+ * An HTTP request, an inbound MQTT message, local input or a running
+ * update switches to PERFORMANCE at once; MODEM_AFTER_MS of quiet steps
+ * down to MODEM and LIGHT_AFTER_MS to LIGHT. The setup AP keeps the radio
+ * on (the ESP32 cannot power-save as an AP).
+ *
+ * Latency budget: the first request after a quiet spell waits for the
+ * radio's next wake plus one wifiTask poll. The listen interval is sized
+ * so that stays within POWER_LATENCY_BUDGET_MS; a profile whose bound
+ * would exceed the budget is never entered.
+ *
+ * Light sleep stops the APB clock, so it is only enabled while nothing
+ * needs it running (PWM dimmer, LED effect, servo, stepper - the caller
+ * says so) and the encoder has been idle. The encoder and button pins
+ * (setWakePins()) are armed as GPIO wake sources first, each on the level
+ * opposite to the one it rests at; if arming fails light sleep stays off.
+ * GPIO wake is level-triggered and takes over the pin's interrupt type, so
+ * the first edge puts the pins back on their CHANGE interrupts
+ * (wakeEdgeFromISR(), called from their ISRs) and the next pass re-arms
+ * them at the new levels. Remaining limits:
+ *   - the PCNT stops with the APB clock, so the edge that wakes the chip
+ *     is not counted and the first detent after a sleep can be missed
+ *   - a wake takes about a millisecond before the ISR runs
+ *   - nothing else wakes the chip early (sensor ADC, serial console); those
+ *     are seen at the next timer wake, within one LIGHT poll
+ *
+ * TX power follows the AP's signal: with RSSI well above TARGET_RSSI the
+ * link has headroom, so TX power is lowered by that margin (assuming a
+ * roughly symmetric link). It is raised again as soon as the signal drops
+ * and goes back to maximum whenever the link is lost.
+ *
+ * Average current is estimated from time spent in each profile using
+ * datasheet figures for the module alone (no LEDs, relay or servo).
+ */
+
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_wifi.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <hal/gpio_ll.h>
+
+#ifndef POWER_LATENCY_BUDGET_MS
+#define POWER_LATENCY_BUDGET_MS 350
+#endif
+
+enum class PowerProfile : uint8_t {
+  PERFORMANCE,
+  MODEM,
+  LIGHT,
+  COUNT
+};
+
+namespace PowerConfig {
+  const uint32_t LATENCY_BUDGET_MS = POWER_LATENCY_BUDGET_MS;
+  const uint32_t BEACON_MS = 102;            // 100 TU, the usual beacon interval
+  const uint32_t MODEM_AFTER_MS = 5000;
+  const uint32_t LIGHT_AFTER_MS = 60000;
+  const uint32_t TX_CHECK_MS = 5000;
+  const uint8_t MAX_WAKE_PINS = 4;
+  const int8_t TARGET_RSSI = -67;            // Comfortable margin for 802.11n MCS rates
+  const uint8_t TX_HYSTERESIS_DB = 3;
+  const uint8_t MAX_LISTEN_INTERVAL = 10;
+
+  struct ProfileSpec {
+    wifi_ps_type_t ps;
+    uint16_t pollMs;
+    uint16_t cpuMhz;
+    uint16_t estimatedMa;         // Without automatic light sleep
+    uint16_t estimatedSleepMa;    // With it (LIGHT only)
+  };
+
+  // Indexed by PowerProfile
+  const ProfileSpec PROFILES[] = {
+    { WIFI_PS_NONE, 10, 240, 120, 120 },
+    { WIFI_PS_MIN_MODEM, 20, 160, 30, 30 },
+    { WIFI_PS_MAX_MODEM, 50, 80, 20, 4 },
+  };
+
+  // Supported TX power steps, quarter-dBm, high to low
+  const wifi_power_t TX_LEVELS[] = {
+    WIFI_POWER_19_5dBm, WIFI_POWER_17dBm, WIFI_POWER_15dBm, WIFI_POWER_13dBm,
+    WIFI_POWER_11dBm, WIFI_POWER_8_5dBm, WIFI_POWER_7dBm, WIFI_POWER_5dBm, WIFI_POWER_2dBm
+  };
+  const uint8_t TX_LEVEL_COUNT = sizeof(TX_LEVELS) / sizeof(TX_LEVELS[0]);
+}
+
+struct PowerStats {
+  uint32_t profileMs[(uint8_t)PowerProfile::COUNT];   // Time spent in each profile
+  uint32_t switches;
+  uint32_t txAdjustments;
+  uint32_t lightSleepMs;         // Part of LIGHT time with automatic light sleep on
+  uint32_t maxPollGapMs;        // Longest gap between wifiTask passes
+};
+
+const char* powerProfileName(PowerProfile profile) {
+  switch (profile) {
+    case PowerProfile::PERFORMANCE: return "performance";
+    case PowerProfile::MODEM: return "modem";
+    case PowerProfile::LIGHT: return "light";
+    default: return "unknown";
+  }
+}
+
+class PowerManager {
+public:
+  /**
+   * Probe power-management support and set the listen interval
+   * Call after the WiFi stack is started and before the first association.
+   */
+  void begin() {
+    _listenInterval = (PowerConfig::LATENCY_BUDGET_MS - PowerConfig::PROFILES[(uint8_t)PowerProfile::LIGHT].pollMs) /
+                      PowerConfig::BEACON_MS;
+    if (_listenInterval > PowerConfig::MAX_LISTEN_INTERVAL) _listenInterval = PowerConfig::MAX_LISTEN_INTERVAL;
+
+    wifi_config_t config = {};
+    if (_listenInterval > 0 && esp_wifi_get_config(WIFI_IF_STA, &config) == ESP_OK) {
+      config.sta.listen_interval = _listenInterval;
+      esp_wifi_set_config(WIFI_IF_STA, &config);   // Used from the next association
+    }
+
+    // Dynamic frequency scaling needs CONFIG_PM_ENABLE; automatic light sleep also needs tickless idle
+    esp_pm_config_t pm = { 240, 80, true };
+    _dfs = esp_pm_configure(&pm) == ESP_OK;
+    _lightSleep = _dfs;
+    if (!_dfs) {
+      pm.light_sleep_enable = false;
+      _dfs = esp_pm_configure(&pm) == ESP_OK;
+    }
+
+    _txLevel = 0;
+    WiFi.setTxPower(PowerConfig::TX_LEVELS[0]);
+    _lastActivityMs = millis();
+    _lastTickMs = millis();
+    apply(PowerProfile::PERFORMANCE, false);
+    LOG_INFO("Power: budget %u ms, listen interval %u, DFS %s, auto light sleep %s",
+             PowerConfig::LATENCY_BUDGET_MS, _listenInterval, _dfs ? "on" : "off", _lightSleep ? "on" : "off");
+  }
+
+  /**
+   * Record activity from any task (MQTT command, local input, OTA chunk)
+   */
+  void noteActivity() { _lastActivityMs = millis(); }
+
+  /**
+   * Whether light sleep is safe right now (no PWM, LED effect, servo or
+   * stepper running and local UI idle); set by loop()
+   */
+  void setClocksIdle(bool idle) { _clocksIdle = idle; }
+
+  /**
+   * Pins that must wake the chip from light sleep (encoder and button)
+   * Each needs a CHANGE interrupt attached; wakeEdgeFromISR() restores it.
+   */
+  void setWakePins(const uint8_t* pins, uint8_t count) {
+    if (count > PowerConfig::MAX_WAKE_PINS) count = PowerConfig::MAX_WAKE_PINS;
+    for (uint8_t i = 0; i < count; i++) _wakePins[i] = pins[i];
+    _wakePinCount = count;
+  }
+
+  /**
+   * Call first thing in the wake pins' ISRs: a level wake fires the pin's
+   * interrupt until its type is back to any-edge
+   */
+  void IRAM_ATTR wakeEdgeFromISR() {
+    if (!_wakeArmed) return;
+    portENTER_CRITICAL_ISR(&_wakeMux);
+    restoreEdges();
+    portEXIT_CRITICAL_ISR(&_wakeMux);
+  }
+
+  /**
+   * Pick the profile and adjust TX power; call every wifiTask pass
+   * @param httpRequests monotonic count of web requests seen so far
+   * @param busy something needs full performance right now (portal, update)
+   */
+  void tick(uint32_t httpRequests, bool busy) {
+    uint32_t now = millis();
+    uint32_t gap = now - _lastTickMs;
+    _lastTickMs = now;
+    _stats.profileMs[(uint8_t)_profile] += gap;
+    if (_lightSleepActive) _stats.lightSleepMs += gap;
+    if (gap > _stats.maxPollGapMs) _stats.maxPollGapMs = gap;
+
+    if (httpRequests != _lastHttpRequests || busy) {
+      _lastHttpRequests = httpRequests;
+      _lastActivityMs = now;
+    }
+
+    uint32_t idleMs = now - _lastActivityMs;
+    PowerProfile next = PowerProfile::PERFORMANCE;
+    if (idleMs >= PowerConfig::LIGHT_AFTER_MS && allowed(PowerProfile::LIGHT)) {
+      next = PowerProfile::LIGHT;
+    } else if (idleMs >= PowerConfig::MODEM_AFTER_MS && allowed(PowerProfile::MODEM)) {
+      next = PowerProfile::MODEM;
+    }
+    bool lightSleep = next == PowerProfile::LIGHT && _lightSleep && _clocksIdle;
+    // Armed before light sleep goes on and re-armed every pass: a wake that
+    // was not activity leaves the pins at new levels. Disarmed once it is off.
+    if (lightSleep) lightSleep = armWake();
+    if (next != _profile || lightSleep != _lightSleepActive) apply(next, lightSleep);
+    if (!lightSleep) disarmWake();
+
+    if (now - _lastTxCheckMs >= PowerConfig::TX_CHECK_MS) {
+      _lastTxCheckMs = now;
+      adjustTxPower();
+    }
+  }
+
+  /**
+   * Time wifiTask should wait before its next pass
+   */
+  uint16_t pollMs() const { return PowerConfig::PROFILES[(uint8_t)_profile].pollMs; }
+
+  /**
+   * Worst-case extra latency for a request arriving now
+   */
+  uint32_t latencyBoundMs() const { return bound(_profile); }
+
+  /**
+   * Time-weighted average of the per-profile estimates since boot
+   */
+  uint32_t averageMa() const {
+    const PowerConfig::ProfileSpec& light = PowerConfig::PROFILES[(uint8_t)PowerProfile::LIGHT];
+    uint64_t charge = 0;
+    uint64_t total = 0;
+    for (uint8_t i = 0; i < (uint8_t)PowerProfile::COUNT; i++) {
+      charge += (uint64_t)_stats.profileMs[i] * PowerConfig::PROFILES[i].estimatedMa;
+      total += _stats.profileMs[i];
+    }
+    charge -= (uint64_t)_stats.lightSleepMs * (light.estimatedMa - light.estimatedSleepMa);
+    return total > 0 ? (uint32_t)(charge / total) : PowerConfig::PROFILES[0].estimatedMa;
+  }
+
+  uint32_t currentMa() const {
+    const PowerConfig::ProfileSpec& spec = PowerConfig::PROFILES[(uint8_t)_profile];
+    return _lightSleepActive ? spec.estimatedSleepMa : spec.estimatedMa;
+  }
+
+  uint32_t idleMs() const { return millis() - _lastActivityMs; }
+  bool clocksIdle() const { return _clocksIdle; }
+  PowerProfile profile() const { return _profile; }
+  bool lightSleepActive() const { return _lightSleepActive; }
+  float txDbm() const { return PowerConfig::TX_LEVELS[_txLevel] / 4.0f; }
+  int8_t rssi() const { return _rssiAvg; }
+  uint8_t listenInterval() const { return _listenInterval; }
+  const PowerStats& stats() const { return _stats; }
+
+private:
+  uint32_t bound(PowerProfile profile) const {
+    const PowerConfig::ProfileSpec& spec = PowerConfig::PROFILES[(uint8_t)profile];
+    uint32_t wakeMs = 0;
+    if (spec.ps == WIFI_PS_MIN_MODEM) wakeMs = PowerConfig::BEACON_MS;   // Assumes DTIM 1
+    if (spec.ps == WIFI_PS_MAX_MODEM) wakeMs = PowerConfig::BEACON_MS * _listenInterval;
+    return spec.pollMs + wakeMs;
+  }
+
+  bool allowed(PowerProfile profile) const {
+    if (profile == PowerProfile::LIGHT && _listenInterval == 0) return false;
+    return bound(profile) <= PowerConfig::LATENCY_BUDGET_MS;
+  }
+
+  void apply(PowerProfile profile, bool lightSleep) {
+    const PowerConfig::ProfileSpec& spec = PowerConfig::PROFILES[(uint8_t)profile];
+
+    WiFi.setSleep(spec.ps);
+    if (_dfs) {
+      esp_pm_config_t pm = { spec.cpuMhz, 80, lightSleep };
+      esp_pm_configure(&pm);
+    } else {
+      setCpuFrequencyMhz(spec.cpuMhz);
+    }
+
+    if (profile != _profile) _stats.switches++;
+    _profile = profile;
+    _lightSleepActive = lightSleep;
+    LOG_DEBUG("Power: %s profile%s", powerProfileName(profile), lightSleep ? " + light sleep" : "");
+  }
+
+  /**
+   * Arm each wake pin on the level opposite to where it is now
+   * @return false (and nothing armed) if there are no pins or the driver refuses
+   */
+  bool armWake() {
+    if (_wakePinCount == 0) return false;
+    bool ok = true;
+    portENTER_CRITICAL(&_wakeMux);
+    _wakeArmed = true;
+    for (uint8_t i = 0; i < _wakePinCount && ok; i++) {
+      gpio_num_t pin = (gpio_num_t)_wakePins[i];
+      ok = gpio_wakeup_enable(pin, gpio_get_level(pin) ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL) == ESP_OK;
+    }
+    if (!ok) restoreEdges();
+    portEXIT_CRITICAL(&_wakeMux);
+    if (ok && !_gpioWakeEnabled) {
+      _gpioWakeEnabled = esp_sleep_enable_gpio_wakeup() == ESP_OK;
+      if (!_gpioWakeEnabled) disarmWake();
+    }
+    if (!ok || !_gpioWakeEnabled) LOG_RATELIMITED(LogLevel::Warn, 60000, "Power: GPIO wake not armed, no light sleep");
+    return ok && _gpioWakeEnabled;
+  }
+
+  void disarmWake() {
+    if (!_wakeArmed) return;
+    portENTER_CRITICAL(&_wakeMux);
+    restoreEdges();
+    portEXIT_CRITICAL(&_wakeMux);
+  }
+
+  // Register writes only, so safe from an IRAM ISR while the flash cache is off
+  void IRAM_ATTR restoreEdges() {
+    for (uint8_t i = 0; i < _wakePinCount; i++) {
+      gpio_ll_wakeup_disable(&GPIO, _wakePins[i]);
+      gpio_ll_set_intr_type(&GPIO, _wakePins[i], GPIO_INTR_ANYEDGE);
+    }
+    _wakeArmed = false;
+  }
+
+  void adjustTxPower() {
+    if (!WiFi.isConnected()) {
+      _rssiAvg = 0;
+      setTxLevel(0);
+      return;
+    }
+
+    int8_t rssi = WiFi.RSSI();
+    _rssiAvg = _rssiAvg == 0 ? rssi : (int8_t)((_rssiAvg * 3 + rssi) / 4);
+
+    // Lowest step that still leaves TARGET_RSSI worth of margin; a fresh
+    // sample below the average counts at once so fades are not smoothed away
+    int headroomDb = (rssi < _rssiAvg ? rssi : _rssiAvg) - PowerConfig::TARGET_RSSI;
+    int wantQuarterDbm = PowerConfig::TX_LEVELS[0] - headroomDb * 4;
+    uint8_t level = 0;
+    while (level + 1 < PowerConfig::TX_LEVEL_COUNT && PowerConfig::TX_LEVELS[level + 1] >= wantQuarterDbm) level++;
+
+    // Raise at once; lower only past the hysteresis band
+    if (level < _txLevel ||
+        (level > _txLevel && PowerConfig::TX_LEVELS[_txLevel] - wantQuarterDbm >= PowerConfig::TX_HYSTERESIS_DB * 4)) {
+      setTxLevel(level);
+    }
+  }
+
+  void setTxLevel(uint8_t level) {
+    if (level == _txLevel) return;
+    _txLevel = level;
+    WiFi.setTxPower(PowerConfig::TX_LEVELS[level]);
+    _stats.txAdjustments++;
+    LOG_DEBUG("Power: TX %d.%d dBm (RSSI %d)", PowerConfig::TX_LEVELS[level] / 4,
+              (PowerConfig::TX_LEVELS[level] % 4) * 25, _rssiAvg);
+  }
+
+  PowerProfile _profile = PowerProfile::PERFORMANCE;
+  volatile uint32_t _lastActivityMs = 0;
+  uint32_t _lastHttpRequests = 0;
+  uint32_t _lastTickMs = 0;
+  uint32_t _lastTxCheckMs = 0;
+  uint8_t _listenInterval = 0;
+  uint8_t _txLevel = 0;
+  int8_t _rssiAvg = 0;
+  bool _dfs = false;
+  bool _lightSleep = false;         // Build supports automatic light sleep
+  bool _lightSleepActive = false;
+  volatile bool _clocksIdle = false;
+  uint8_t _wakePins[PowerConfig::MAX_WAKE_PINS] = {};
+  uint8_t _wakePinCount = 0;
+  volatile bool _wakeArmed = false;
+  bool _gpioWakeEnabled = false;
+  portMUX_TYPE _wakeMux = portMUX_INITIALIZER_UNLOCKED;
+  PowerStats _stats = {};
+};
+
+PowerManager powerManager;
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ * ESP32 Multitool - Web Request Rate Limiter
+ * Token buckets per client IP and route class
+ *
+ * Each (IP, class) pair gets a bucket in a fixed 32-entry open-addressed
+ * table - no allocation. A bucket holds up to BURST tokens and refills one
+ * token every REFILL_MS; a request takes one token or is refused with 429
+ * and a Retry-After of the time until the next token. When the probe
+ * window is full, the least recently used entry is recycled; an evicted
+ * client simply starts again with a full bucket.
+ *
+ * Route classes:
+ *   READ  - status polls and page loads (cheap)
+ *   WRITE - relay, PWM, servo, LED and settings changes (settings routes
+ *           that also answer GET charge those reads to READ)
+ *   SCAN  - I2C bus scan (holds i2cMutex for the whole scan)
+ *   OTA   - firmware uploads
+ *   AUTH  - login and password changes (each runs the password KDF)
+ *
+ * Only the web server task calls into this, so no locking is needed.
+ */
+
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <Arduino.h>
+#include <WebServer.h>
+#include <functional>
+
+// Forward declarations from main sketch
+extern WebServer server;
+
+enum class RouteClass : uint8_t {
+  READ,
+  WRITE,
+  SCAN,
+  OTA,
+  AUTH,
+  COUNT
+};
+
+namespace RateLimitConfig {
+  const uint8_t TABLE_SIZE = 32;     // Power of two
+  const uint8_t MAX_PROBE = 4;
+  const uint32_t TOKEN = 1000;       // Bucket levels are in thousandths of a token
+
+  struct ClassLimit {
+    uint8_t burst;
+    uint32_t refillMs;
+  };
+
+  // Indexed by RouteClass
+  const ClassLimit LIMITS[] = {
+    { 20, 100 },     // READ:  10/s sustained, enough for several open dashboards
+    { 20, 100 },     // WRITE: slider drags send bursts
+    { 2, 10000 },    // SCAN:  one per 10 s
+    { 2, 30000 },    // OTA:   one per 30 s
+    { 5, 5000 },     // AUTH:  one per 5 s after five quick tries
+  };
+}
+
+struct RateLimitStats {
+  uint32_t admitted[(uint8_t)RouteClass::COUNT];
+  uint32_t limited[(uint8_t)RouteClass::COUNT];
+  uint32_t evictions;
+};
+
+class RateLimiter {
+public:
+  /**
+   * Take a token for this client and class
+   * @return 0 if admitted, else seconds until a token is available
+   */
+  uint32_t admit(uint32_t ip, RouteClass cls) {
+    const RateLimitConfig::ClassLimit& limit = RateLimitConfig::LIMITS[(uint8_t)cls];
+    uint32_t now = millis();
+    Bucket& bucket = find(ip, cls, now);
+
+    uint32_t elapsed = now - bucket.lastMs;
+    uint32_t capacity = limit.burst * RateLimitConfig::TOKEN;
+    uint64_t level = bucket.level + (uint64_t)elapsed * RateLimitConfig::TOKEN / limit.refillMs;
+    bucket.level = level > capacity ? capacity : (uint32_t)level;
+    bucket.lastMs = now;
+
+    if (bucket.level >= RateLimitConfig::TOKEN) {
+      bucket.level -= RateLimitConfig::TOKEN;
+      _stats.admitted[(uint8_t)cls]++;
+      return 0;
+    }
+
+    _stats.limited[(uint8_t)cls]++;
+    uint32_t waitMs = (RateLimitConfig::TOKEN - bucket.level) * limit.refillMs / RateLimitConfig::TOKEN;
+    return (waitMs + 999) / 1000;
+  }
+
+  uint8_t occupancy() const {
+    uint8_t used = 0;
+    for (uint8_t i = 0; i < RateLimitConfig::TABLE_SIZE; i++) {
+      if (_table[i].inUse) used++;
+    }
+    return used;
+  }
+
+  /**
+   * Requests seen so far, admitted or not (activity signal)
+   */
+  uint32_t requests() const {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < (uint8_t)RouteClass::COUNT; i++) total += _stats.admitted[i] + _stats.limited[i];
+    return total;
+  }
+
+  const RateLimitStats& stats() const { return _stats; }
+
+private:
+  struct Bucket {
+    uint32_t ip;
+    uint32_t level;
+    uint32_t lastMs;
+    RouteClass cls;
+    bool inUse;
+  };
+
+  /**
+   * Existing bucket for (ip, class), or a fresh full one
+   */
+  Bucket& find(uint32_t ip, RouteClass cls, uint32_t now) {
+    uint32_t hash = (ip ^ ((uint32_t)cls << 24)) * 2654435761u;   // Knuth multiplicative
+    uint8_t start = hash >> 27;                                    // Top 5 bits: 0..31
+    uint8_t victim = start;
+
+    for (uint8_t i = 0; i < RateLimitConfig::MAX_PROBE; i++) {
+      uint8_t index = (start + i) & (RateLimitConfig::TABLE_SIZE - 1);
+      Bucket& bucket = _table[index];
+      if (bucket.inUse && bucket.ip == ip && bucket.cls == cls) return bucket;
+      if (!bucket.inUse) {
+        victim = index;
+        break;
+      }
+      if ((int32_t)(bucket.lastMs - _table[victim].lastMs) < 0) victim = index;
+    }
+
+    Bucket& bucket = _table[victim];
+    if (bucket.inUse) _stats.evictions++;
+    bucket.ip = ip;
+    bucket.cls = cls;
+    bucket.inUse = true;
+    bucket.lastMs = now;
+    bucket.level = RateLimitConfig::LIMITS[(uint8_t)cls].burst * RateLimitConfig::TOKEN;
+    return bucket;
+  }
+
+  Bucket _table[RateLimitConfig::TABLE_SIZE] = {};
+  RateLimitStats _stats = {};
+};
+
+RateLimiter rateLimiter;
+
+const char* routeClassName(RouteClass cls) {
+  switch (cls) {
+    case RouteClass::READ: return "read";
+    case RouteClass::WRITE: return "write";
+    case RouteClass::SCAN: return "scan";
+    case RouteClass::OTA: return "ota";
+    case RouteClass::AUTH: return "auth";
+    default: return "unknown";
+  }
+}
+
+/**
+ * Refuse an over-limit request
+ */
+void sendRateLimited(uint32_t retryAfterS) {
+  server.sendHeader(F("Retry-After"), String(retryAfterS));
+  server.send(429, F("application/json"), F("{\"error\":\"Too many requests\"}"));
+}
+
+/**
+ * Admit the current request or answer it with 429
+ * Use as: if (!admitRequest(RouteClass::WRITE)) return;
+ */
+bool admitRequest(RouteClass cls) {
+  uint32_t retryAfter = rateLimiter.admit((uint32_t)server.client().remoteIP(), cls);
+  if (retryAfter == 0) return true;
+  sendRateLimited(retryAfter);
+  return false;
+}
+
+/**
+ * Wrap a route handler so it runs only when the limiter admits the request
+ */
+WebServer::THandlerFunction limited(RouteClass cls, WebServer::THandlerFunction handler) {
+  return [cls, handler]() {
+    if (admitRequest(cls)) handler();
+  };
+}
+
+/**
+ * As limited(), for routes that both report and change settings:
+ * GET is charged to READ, any other method to WRITE
+ */
+WebServer::THandlerFunction limitedReadWrite(WebServer::THandlerFunction handler) {
+  return [handler]() {
+    if (admitRequest(server.method() == HTTP_GET ? RouteClass::READ : RouteClass::WRITE)) handler();
+  };
+}
+
+#endif
@@ -0,0 +1,338 @@
+/*
+ * ESP32 Multitool - Sleep Telemetry Mode
+ * Deep-sleep duty cycling for remote sensor deployments
+ *
+ * When enabled, the device spends its time in deep sleep and wakes on the
+ * RTC timer every intervalS seconds. A timer wake skips the normal boot
+ * entirely: it samples SENSOR_IN into RTC memory and goes straight back
+ * to sleep. Every batch-th wake it also brings up WiFi and MQTT, publishes
+ * the stored samples as one message and then sleeps again.
+ *
+ * RTC memory keeps, across deep sleep:
+ *   - the mode settings (so sample-only wakes never touch NVS)
+ *   - relay state (the pin is latched through sleep with a GPIO hold)
+ *   - the sample ring and cycle/awake-time counters
+ *   - BSSID and channel of the last AP, so the station joins without a
+ *     scan; if that fails the cache is dropped and a normal join follows
+ *
+ * Batch message on esp32/multitool/telemetry, oldest sample first:
+ *   {"samples":[{"sensor":1234,"age":300120},...],"relay":0,"cycles":42,
+ *    "awake_ms":38,"publish_awake_ms":1450,"dropped":0}
+ * "age" is ms before the publish, as in the offline replay. "awake_ms" is
+ * the last sample-only wake, "publish_awake_ms" the last publishing one.
+ *
+ * A button press (ROT_SW, ext0) or reset does a normal full boot. The
+ * full firmware then runs until it has been idle for idleMin minutes and
+ * goes back to sleep. Power-on clears RTC memory and the pending samples.
+ */
+
+#ifndef SLEEP_TELEMETRY_H
+#define SLEEP_TELEMETRY_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <PubSubClient.h>
+#include <esp_sleep.h>
+#include <esp_wifi.h>
+#include <driver/gpio.h>
+#include <driver/rtc_io.h>
+#include <sys/time.h>
+
+// Forward declarations from main sketch
+extern PubSubClient mqttClient;
+extern MqttTransport mqttTransport;
+extern MqttConnectionManager mqttManager;
+
+namespace SleepConfig {
+  const uint32_t RTC_MAGIC = 0x534C5054;        // "SLPT"
+  const uint8_t MAX_SAMPLES = 32;
+  const uint16_t DEFAULT_INTERVAL_S = 300;
+  const uint8_t DEFAULT_BATCH = 6;
+  const uint8_t DEFAULT_IDLE_MIN = 5;
+  const uint32_t FAST_JOIN_TIMEOUT_MS = 3000;   // Cached BSSID/channel
+  const uint32_t JOIN_TIMEOUT_MS = 10000;       // Full scan
+  const uint32_t MQTT_TIMEOUT_MS = 5000;
+  const uint32_t MIN_SLEEP_MS = 1000;
+}
+
+/**
+ * Persisted in the configuration image
+ */
+struct SleepTelemetrySettings {
+  bool enabled;
+  uint16_t intervalS;       // Wake period
+  uint8_t batch;            // Samples per publish
+  uint8_t idleMin;          // After a full boot: idle time before sleeping
+};
+
+struct SleepSample {
+  uint32_t atMs;            // RTC clock
+  uint16_t value;
+};
+
+struct SleepStats {
+  uint32_t cycles;           // Timer wakes since power-on
+  uint32_t publishes;
+  uint32_t failures;         // Batches that could not be sent (kept for the next try)
+  uint32_t fastJoins;        // Joined with the cached BSSID/channel
+  uint32_t dropped;          // Samples lost to a full ring
+  uint32_t lastAwakeMs;      // Last sample-only wake
+  uint32_t lastPublishAwakeMs;
+  uint32_t totalAwakeMs;     // All timer wakes
+};
+
+struct SleepRtcState {
+  uint32_t magic;
+  SleepTelemetrySettings settings;
+  bool relay;
+  uint8_t bssid[6];
+  uint8_t channel;           // 0 = nothing cached
+  uint8_t head;
+  uint8_t count;
+  uint8_t wakesToPublish;    // Counts down to the next publish attempt
+  SleepSample samples[SleepConfig::MAX_SAMPLES];
+  SleepStats stats;
+};
+
+RTC_DATA_ATTR SleepRtcState sleepRtc;
+
+class SleepTelemetry {
+public:
+  /**
+   * True for a timer wake in sleep mode: run the short cycle, not setup()
+   */
+  bool timerWake() const {
+    return esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER &&
+           sleepRtc.magic == SleepConfig::RTC_MAGIC && sleepRtc.settings.enabled;
+  }
+
+  /**
+   * Drive the relay to its stored state and release the sleep hold
+   * Call before anything else touches the pin.
+   */
+  bool restoreRelay() {
+    if (sleepRtc.magic != SleepConfig::RTC_MAGIC) init();
+    pinMode(Pins::RELAY, OUTPUT);
+    digitalWrite(Pins::RELAY, sleepRtc.relay ? HIGH : LOW);
+    gpio_hold_dis((gpio_num_t)Pins::RELAY);
+    return sleepRtc.relay;
+  }
+
+  /**
+   * Take the settings from the configuration (full boot and API changes)
+   */
+  void setSettings(const SleepTelemetrySettings& settings) {
+    if (sleepRtc.magic != SleepConfig::RTC_MAGIC) init();
+    sleepRtc.settings = settings;
+    if (sleepRtc.wakesToPublish == 0 || sleepRtc.wakesToPublish > settings.batch) {
+      sleepRtc.wakesToPublish = settings.batch;
+    }
+  }
+
+  /**
+   * Store one sample; true on every batch-th wake (a failed publish is
+   * retried a batch later, not on every wake)
+   */
+  bool addSample(uint16_t value) {
+    sleepRtc.stats.cycles++;
+    if (sleepRtc.count == SleepConfig::MAX_SAMPLES) {
+      sleepRtc.head = (sleepRtc.head + 1) % SleepConfig::MAX_SAMPLES;   // Drop the oldest
+      sleepRtc.count--;
+      sleepRtc.stats.dropped++;
+    }
+    uint8_t slot = (sleepRtc.head + sleepRtc.count) % SleepConfig::MAX_SAMPLES;
+    sleepRtc.samples[slot] = { clockMs(), value };
+    sleepRtc.count++;
+    if (sleepRtc.wakesToPublish > 0) sleepRtc.wakesToPublish--;
+    return sleepRtc.wakesToPublish == 0;
+  }
+
+  /**
+   * Join the stored network and the broker, then publish the batch
+   * Blocks for up to a few seconds; only for the timer-wake cycle, where
+   * nothing else is running yet.
+   */
+  bool publishBatch(const MqttConfig& config, const char* hostname, const char* topic) {
+    bool ok = joinNetwork(hostname) && connectBroker(config) && publishPending(mqttClient, topic);
+    sleepRtc.wakesToPublish = sleepRtc.settings.batch;
+    if (!ok) {
+      sleepRtc.stats.failures++;
+      LOG_WARN("Sleep: publish failed, keeping %u samples", sleepRtc.count);
+    }
+    return ok;
+  }
+
+  /**
+   * Cache the current AP for the next fast join
+   */
+  void rememberAp() {
+    const uint8_t* bssid = WiFi.BSSID();
+    if (bssid == nullptr) return;
+    if (sleepRtc.magic != SleepConfig::RTC_MAGIC) init();
+    memcpy(sleepRtc.bssid, bssid, sizeof(sleepRtc.bssid));
+    sleepRtc.channel = (uint8_t)WiFi.channel();
+  }
+
+  /**
+   * Publish the stored samples as one message and clear them
+   */
+  bool publishPending(PubSubClient& client, const char* topic) {
+    if (sleepRtc.magic != SleepConfig::RTC_MAGIC || sleepRtc.count == 0) return true;
+
+    char payload[64 + SleepConfig::MAX_SAMPLES * 40 + 160];
+    uint32_t now = clockMs();
+    size_t len = snprintf(payload, sizeof(payload), "{\"samples\":[");
+    for (uint8_t i = 0; i < sleepRtc.count; i++) {
+      const SleepSample& sample = sleepRtc.samples[(sleepRtc.head + i) % SleepConfig::MAX_SAMPLES];
+      len += snprintf(payload + len, sizeof(payload) - len, "%s{\"sensor\":%u,\"age\":%lu}", i == 0 ? "" : ",",
+                      sample.value, (unsigned long)(now - sample.atMs));
+    }
+    const SleepStats& stats = sleepRtc.stats;
+    len += snprintf(payload + len, sizeof(payload) - len,
+                    "],\"relay\":%u,\"cycles\":%lu,\"awake_ms\":%lu,\"publish_awake_ms\":%lu,\"dropped\":%lu}",
+                    sleepRtc.relay ? 1 : 0, (unsigned long)stats.cycles, (unsigned long)stats.lastAwakeMs,
+                    (unsigned long)stats.lastPublishAwakeMs, (unsigned long)stats.dropped);
+
+    bool ok = len < sizeof(payload) && client.beginPublish(topic, len, false) &&
+              client.write((const uint8_t*)payload, len) == len && client.endPublish();
+    if (ok) {
+      LOG_INFO("Sleep: published %u samples", sleepRtc.count);
+      sleepRtc.count = 0;
+      sleepRtc.head = 0;
+      sleepRtc.wakesToPublish = sleepRtc.settings.batch;
+      sleepRtc.stats.publishes++;
+    }
+    return ok;
+  }
+
+  /**
+   * Latch the relay, record awake time and enter deep sleep (no return)
+   * @param timerCycle called from the timer-wake cycle (awake time is recorded)
+   * @param networked that cycle brought up WiFi to publish
+   */
+  void sleep(bool relay, bool timerCycle, bool networked) {
+    if (sleepRtc.magic != SleepConfig::RTC_MAGIC) init();
+    uint32_t awakeMs = (uint32_t)(esp_timer_get_time() / 1000);
+    if (timerCycle) {
+      if (networked) sleepRtc.stats.lastPublishAwakeMs = awakeMs;
+      else sleepRtc.stats.lastAwakeMs = awakeMs;
+      sleepRtc.stats.totalAwakeMs += awakeMs;
+    }
+
+    if (mqttManager.connected()) mqttClient.disconnect();
+    WiFi.disconnect(true);
+
+    sleepRtc.relay = relay;
+    digitalWrite(Pins::RELAY, relay ? HIGH : LOW);
+    gpio_hold_en((gpio_num_t)Pins::RELAY);
+    gpio_deep_sleep_hold_en();
+
+    // Keep the wake period steady: this wake's time counts against it
+    uint32_t periodMs = (uint32_t)sleepRtc.settings.intervalS * 1000;
+    uint32_t sleepMs = periodMs > awakeMs + SleepConfig::MIN_SLEEP_MS ? periodMs - awakeMs : SleepConfig::MIN_SLEEP_MS;
+    esp_sleep_enable_timer_wakeup((uint64_t)sleepMs * 1000);
+
+    // Encoder button (active low) wakes into the full firmware
+    rtc_gpio_pullup_en((gpio_num_t)Pins::ROT_SW);
+    rtc_gpio_pulldown_dis((gpio_num_t)Pins::ROT_SW);
+    esp_sleep_enable_ext0_wakeup((gpio_num_t)Pins::ROT_SW, 0);
+
+    LOG_INFO("Sleep: awake %lu ms, sleeping %lu ms", (unsigned long)awakeMs, (unsigned long)sleepMs);
+    loggerFlush(100);
+    esp_deep_sleep_start();
+  }
+
+  /**
+   * After a full boot: true once the firmware has been idle long enough
+   */
+  bool sleepDue(uint32_t idleMs) const {
+    return sleepRtc.settings.enabled && idleMs >= (uint32_t)sleepRtc.settings.idleMin * 60000;
+  }
+
+  bool enabled() const { return sleepRtc.settings.enabled; }
+  uint8_t pending() const { return sleepRtc.count; }
+  const SleepStats& stats() const { return sleepRtc.stats; }
+
+private:
+  void init() {
+    memset(&sleepRtc, 0, sizeof(sleepRtc));
+    sleepRtc.magic = SleepConfig::RTC_MAGIC;
+  }
+
+  /**
+   * Station join: cached BSSID/channel first, then a normal scan
+   */
+  bool joinNetwork(const char* hostname) {
+    WiFi.persistent(false);   // The BSSID-locked join must not overwrite the stored config
+    WiFi.setHostname(hostname);
+    WiFi.mode(WIFI_STA);
+
+    wifi_config_t stored = {};
+    esp_wifi_get_config(WIFI_IF_STA, &stored);
+    if (stored.sta.ssid[0] == '\0') {
+      LOG_WARN("Sleep: no WiFi network stored");
+      return false;
+    }
+
+    // Driver fields are not NUL-terminated at full length
+    char ssid[sizeof(stored.sta.ssid) + 1] = {};
+    char password[sizeof(stored.sta.password) + 1] = {};
+    memcpy(ssid, stored.sta.ssid, sizeof(stored.sta.ssid));
+    memcpy(password, stored.sta.password, sizeof(stored.sta.password));
+
+    bool joined = false;
+    if (sleepRtc.channel != 0) {
+      WiFi.begin(ssid, password, sleepRtc.channel, sleepRtc.bssid);
+      joined = waitForLink(SleepConfig::FAST_JOIN_TIMEOUT_MS);
+      if (joined) {
+        sleepRtc.stats.fastJoins++;
+      } else {
+        LOG_WARN("Sleep: cached AP not reachable, scanning");
+        sleepRtc.channel = 0;
+        WiFi.disconnect(false);
+      }
+    }
+    if (!joined) {
+      WiFi.begin(ssid, password);   // Not WiFi.begin(): the RAM config may still carry the BSSID lock
+      joined = waitForLink(SleepConfig::JOIN_TIMEOUT_MS);
+    }
+    if (joined) rememberAp();
+    return joined;
+  }
+
+  bool connectBroker(const MqttConfig& config) {
+    // Same non-blocking connect as the WiFi task, driven to completion here
+    mqttClient.setServer(config.server, config.port);
+    mqttManager.begin(mqttClient, mqttTransport, config, nullptr, nullptr);
+    uint32_t start = millis();
+    while (!mqttManager.connected() && millis() - start < SleepConfig::MQTT_TIMEOUT_MS) {
+      mqttManager.tick();
+      delay(5);
+    }
+    return mqttManager.connected();
+  }
+
+  bool waitForLink(uint32_t timeoutMs) {
+    uint32_t start = millis();
+    while (millis() - start < timeoutMs) {
+      wl_status_t status = WiFi.status();
+      if (status == WL_CONNECTED && (uint32_t)WiFi.localIP() != 0) return true;
+      if (status == WL_CONNECT_FAILED) return false;
+      delay(10);
+    }
+    return false;
+  }
+
+  /**
+   * Milliseconds on the RTC clock, which keeps running through deep sleep
+   */
+  static uint32_t clockMs() {
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    return (uint32_t)((uint64_t)now.tv_sec * 1000 + now.tv_usec / 1000);
+  }
+};
+
+SleepTelemetry sleepTelemetry;
+
+#endif
@@ -0,0 +1,191 @@
+/*
+ * ESP32 Multitool - System Events
+ * Event-driven waits for loop() and the WiFi task
+ *
+ * Both tasks used to sleep a fixed 10 ms per pass, waking 100 times a
+ * second with nothing to do and adding up to 10 ms to every input. Each
+ * now blocks on its own FreeRTOS task notification, used as a set of
+ * event bits, until an event arrives or its next deadline passes:
+ *
+ *   loop()     EVENT_INPUT    encoder edge (GPIO ISR), debounced button event
+ *              EVENT_COMMAND  remote actuator command or web state change
+ *              deadline       next app step (stepper half-step, timed
+ *                             tone, display refresh), else LOOP_IDLE_MS
+ *   wifiTask   EVENT_ACK      loop() applied a remote command
+ *              deadline       power profile poll interval
+ *
+ * Task notifications rather than an event group: setting event-group bits
+ * from an ISR goes through the timer service task, while a notification
+ * wakes the waiting task directly.
+ *
+ * WebServer and ArduinoOTA keep their sockets private, so incoming network
+ * traffic is still picked up by the WiFi task's timed wake. The power
+ * manager sizes that interval to stay within its latency budget.
+ *
+ * Reported per task: wakeups/s (over RATE_WINDOW_MS), wakes by event vs
+ * deadline; and input latency, from the ISR timestamp of the first
+ * unhandled edge to the end of the loop() pass that acted on it.
+ */
+
+#ifndef SYSTEM_EVENTS_H
+#define SYSTEM_EVENTS_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <atomic>
+#include "power_manager.h"
+
+namespace SystemEventConfig {
+  const uint32_t LOOP_IDLE_MS = 100;      // Sensor sample / status refresh with no events
+  const uint32_t ACTIVE_FRAME_MS = 10;    // Former fixed pass, for apps that run continuously
+  const uint32_t RATE_WINDOW_MS = 5000;
+}
+
+const uint32_t EVENT_INPUT = 1 << 0;
+const uint32_t EVENT_COMMAND = 1 << 1;
+const uint32_t EVENT_ACK = 1 << 2;
+
+enum class EventTask : uint8_t {
+  LOOP,
+  WIFI,
+  COUNT
+};
+
+const char* eventTaskName(EventTask task) {
+  switch (task) {
+    case EventTask::LOOP: return "loop";
+    case EventTask::WIFI: return "wifi";
+    default: return "unknown";
+  }
+}
+
+struct EventTaskStats {
+  uint32_t wakes;
+  uint32_t eventWakes;
+  uint32_t deadlineWakes;
+  uint32_t wakesPerSec10;   // Wakeups/s x10 over the last window
+};
+
+struct InputLatencyStats {
+  uint32_t count;
+  uint32_t lastUs;
+  uint32_t maxUs;
+  uint64_t totalUs;
+};
+
+class SystemEvents {
+public:
+  /**
+   * Register the calling task as the receiver for its slot
+   */
+  void attach(EventTask task) { _tasks[(uint8_t)task].handle = xTaskGetCurrentTaskHandle(); }
+
+  /**
+   * Wake a task (any task context)
+   */
+  void signal(EventTask task, uint32_t bits) {
+    TaskHandle_t handle = _tasks[(uint8_t)task].handle;
+    if (handle != nullptr) xTaskNotify(handle, bits, eSetBits);
+  }
+
+  /**
+   * Wake loop() from a GPIO ISR and timestamp the input
+   */
+  void IRAM_ATTR signalInputFromISR() {
+    stampInput((uint32_t)esp_timer_get_time());
+    TaskHandle_t handle = _tasks[(uint8_t)EventTask::LOOP].handle;
+    if (handle == nullptr) return;
+    BaseType_t woken = pdFALSE;
+    xTaskNotifyFromISR(handle, EVENT_INPUT, eSetBits, &woken);
+    if (woken == pdTRUE) portYIELD_FROM_ISR();
+  }
+
+  /**
+   * Wake loop() for input that was filtered first (debounced button)
+   * @param edgeUs esp_timer time of the edge that started it
+   */
+  void signalInput(uint32_t edgeUs) {
+    stampInput(edgeUs);
+    signal(EventTask::LOOP, EVENT_INPUT);
+  }
+
+  /**
+   * Shorten the caller's next wait (for a step due before the default)
+   */
+  void wakeWithin(EventTask task, uint32_t ms) {
+    TaskSlot& slot = _tasks[(uint8_t)task];
+    if (ms < slot.wakeWithinMs) slot.wakeWithinMs = ms;
+  }
+
+  /**
+   * Block until an event or the deadline; call from the attached task
+   * @return the event bits received (0 = deadline)
+   */
+  uint32_t wait(EventTask task, uint32_t timeoutMs) {
+    TaskSlot& slot = _tasks[(uint8_t)task];
+    if (slot.wakeWithinMs < timeoutMs) timeoutMs = slot.wakeWithinMs;
+    slot.wakeWithinMs = UINT32_MAX;
+
+    uint32_t bits = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &bits, pdMS_TO_TICKS(timeoutMs));
+
+    EventTaskStats& stats = slot.stats;
+    stats.wakes++;
+    if (bits != 0) stats.eventWakes++;
+    else stats.deadlineWakes++;
+
+    uint32_t now = millis();
+    if (now - slot.windowStartMs >= SystemEventConfig::RATE_WINDOW_MS) {
+      stats.wakesPerSec10 = (stats.wakes - slot.windowWakes) * 10000 / (now - slot.windowStartMs);
+      slot.windowStartMs = now;
+      slot.windowWakes = stats.wakes;
+    }
+    return bits;
+  }
+
+  /**
+   * loop() has acted on pending input: record the latency since the edge
+   */
+  void inputHandled() {
+    uint32_t startUs = _inputUs.exchange(0);
+    if (startUs == 0) return;
+    uint32_t latencyUs = ((uint32_t)esp_timer_get_time() | 1) - startUs;
+    _latency.count++;
+    _latency.lastUs = latencyUs;
+    _latency.totalUs += latencyUs;
+    if (latencyUs > _latency.maxUs) _latency.maxUs = latencyUs;
+  }
+
+  const EventTaskStats& stats(EventTask task) const { return _tasks[(uint8_t)task].stats; }
+  const InputLatencyStats& inputLatency() const { return _latency; }
+
+private:
+  struct TaskSlot {
+    TaskHandle_t handle = nullptr;
+    uint32_t wakeWithinMs = UINT32_MAX;
+    uint32_t windowStartMs = 0;
+    uint32_t windowWakes = 0;
+    EventTaskStats stats = {};
+  };
+
+  void IRAM_ATTR stampInput(uint32_t us) {
+    uint32_t expected = 0;
+    _inputUs.compare_exchange_strong(expected, us | 1);
+  }
+
+  TaskSlot _tasks[(uint8_t)EventTask::COUNT];
+  std::atomic<uint32_t> _inputUs{0};   // Odd = pending (bit 0 forced on)
+  InputLatencyStats _latency = {};
+};
+
+SystemEvents systemEvents;
+
+/**
+ * GPIO ISR for the encoder pins (also their light-sleep wake)
+ */
+void IRAM_ATTR inputEdgeISR() {
+  powerManager.wakeEdgeFromISR();
+  systemEvents.signalInputFromISR();
+}
+
+#endif
@@ -0,0 +1,42 @@
+/*
+ * ESP32 Multitool - Password KDF Benchmark
+ * PBKDF2-HMAC-SHA256 at candidate AUTH_KDF_ITERATIONS on the host
+ *
+ * Same parameters as credentials.h (16-byte salt, 32-byte key), with
+ * OpenSSL in place of mbedtls. Host figures only rank the candidates; the
+ * cost on the device is reported as kdf_last_ms in /api/system.
+ */
+
+#include <openssl/evp.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include "test_support.h"
+
+const int REPS = 5;
+
+int main() {
+  const unsigned char salt[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+  const char password[] = "correct horse battery";
+  const int candidates[] = {1000, 5000, 10000, 20000, 50000, 100000};
+  unsigned char key[32];
+
+  for (int iterations : candidates) {
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < REPS; r++) {
+      CHECK(PKCS5_PBKDF2_HMAC(password, strlen(password), salt, sizeof(salt), iterations,
+                              EVP_sha256(), sizeof(key), key) == 1);
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() /
+                REPS;
+    printf("%6d iterations: %8.2f ms  (%.2f us/iteration)\n", iterations, ms, ms * 1000 / iterations);
+  }
+
+  // RFC 7914 section 11 test vector: the same KDF credentials.h calls
+  const unsigned char expected[] = {0x55, 0xac, 0x04, 0x6e, 0x56, 0xe3, 0x08, 0x9f,
+                                    0xec, 0x16, 0x91, 0xc2, 0x25, 0x44, 0xb6, 0x05};
+  unsigned char vector[64];
+  PKCS5_PBKDF2_HMAC("passwd", 6, (const unsigned char*)"salt", 4, 1, EVP_sha256(), sizeof(vector), vector);
+  CHECK(memcmp(vector, expected, sizeof(expected)) == 0);
+  return testSummary("kdf");
+}
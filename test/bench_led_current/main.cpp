@@ -0,0 +1,67 @@
+/*
+ * ESP32 Multitool - LED Current Limiter Benchmark
+ * Host timing of the per-frame estimate / scale passes at several strip
+ * lengths, and a check that a limited frame lands within its budget
+ */
+
+#include <Arduino.h>
+#include <chrono>
+
+struct SharedState { int sensorValue; };
+SemaphoreHandle_t stateMutex;
+SharedState sharedState;
+
+#include "neopixel_effects.h"
+#include "test_support.h"
+
+const uint32_t BUDGET_MA = 700;   // LED_POWER_BUDGET_MA default
+
+int main() {
+  const uint16_t lengths[] = {36, 300, 1000, 2048};
+  volatile uint32_t sink = 0;
+
+  printf("%6s %12s %12s %10s\n", "pixels", "estimate us", "+scale us", "est. mA");
+  for (uint16_t count : lengths) {
+    size_t bytes = (size_t)count * 3;
+    uint8_t* frame = (uint8_t*)malloc(bytes);
+    uint8_t* work = (uint8_t*)malloc(bytes);
+    uint32_t seed = 1;
+    for (size_t i = 0; i < bytes; i++) {
+      seed = seed * 1103515245 + 12345;
+      frame[i] = (uint8_t)(seed >> 16);
+    }
+
+    const int reps = 200000 / count + 100;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps; r++) {
+      sink += ledEstimateCurrentMa(frame, bytes, count);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps; r++) {
+      memcpy(work, frame, bytes);
+      uint32_t estimatedMa = ledEstimateCurrentMa(work, bytes, count);
+      uint8_t scale = ledLimitScale(estimatedMa, BUDGET_MA, count);
+      if (scale < 255) ledScaleFrame(work, bytes, scale);
+      sink += scale;
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    // memcpy is included in the second figure; it is small next to the passes
+    double estimateUs = std::chrono::duration<double, std::micro>(t1 - t0).count() / reps;
+    double limitUs = std::chrono::duration<double, std::micro>(t2 - t1).count() / reps;
+    uint32_t estimatedMa = ledEstimateCurrentMa(frame, bytes, count);
+    printf("%6u %12.2f %12.2f %10u\n", count, estimateUs, limitUs, estimatedMa);
+
+    // The scaled frame must come in at or under budget (unless idle draw alone exceeds it)
+    uint32_t limitedMa = ledEstimateCurrentMa(work, bytes, count);
+    if ((uint32_t)count * LedConfig::IDLE_MA_PER_LED < BUDGET_MA) CHECK(limitedMa <= BUDGET_MA);
+    free(frame);
+    free(work);
+  }
+
+  CHECK_EQ(ledLimitScale(500, 700, 36), 255);
+  CHECK_EQ(ledLimitScale(5000, 0, 36), 255);
+  CHECK_EQ(ledLimitScale(5000, 30, 36), 0);
+  (void)sink;
+  return testSummary("led_current");
+}
@@ -0,0 +1,49 @@
+/*
+ * ESP32 Multitool - LED Render Benchmark
+ * Host timing of LedEffectsEngine::renderFrame() (render + gamma/GRB
+ * output + current limit) for every effect, up to 1000 pixels over four
+ * outputs. RMT output is stubbed; only the CPU work per frame is measured.
+ */
+
+#include <Arduino.h>
+#include <chrono>
+
+struct SharedState { int sensorValue; };
+SemaphoreHandle_t stateMutex;
+SharedState sharedState = {3000};
+
+#include "neopixel_effects.h"
+#include "test_support.h"
+
+const int FRAMES = 500;
+
+static void benchLayout(uint8_t outputs, uint16_t perOutput) {
+  LedStripConfig config = {};
+  config.outputs = outputs;
+  for (uint8_t i = 0; i < outputs; i++) config.output[i] = {(uint8_t)(16 + i), perOutput};
+
+  LedEffectsEngine engine;
+  LedEffectParams params = {LedEffect::OFF, 0xFF6000, 0x0040FF, 50, 255, 700};
+  CHECK(engine.begin(config, params));
+  CHECK_EQ(engine.count(), outputs * perOutput);
+  if (engine.count() == 0) return;
+
+  uint8_t* wire = (uint8_t*)malloc((size_t)engine.count() * 3);
+  printf("%u pixels on %u output(s):\n", engine.count(), engine.outputs());
+  for (uint8_t fx = 0; fx < (uint8_t)LedEffect::COUNT; fx++) {
+    params.effect = (LedEffect)fx;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int f = 0; f < FRAMES; f++) engine.renderFrame(params, wire);
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() /
+                FRAMES;
+    printf("  %-9s %8.2f us/frame  %6u mA est.\n", ledEffectName(fx), us, engine.stats().estimatedMa);
+  }
+  free(wire);
+}
+
+int main() {
+  benchLayout(1, 36);
+  benchLayout(1, 300);
+  benchLayout(4, 250);
+  return testSummary("led_render");
+}
@@ -0,0 +1,163 @@
+/*
+ * ESP32 Multitool - Web Auth Timing Harness
+ * Per-request CPU time of the real web_auth.h paths on the host
+ *
+ * Requests go through the WebServer stub into requireAuth(), so the figures
+ * include header lookup, the cookie scan and the rate limiter exactly as
+ * the firmware runs them:
+ *   token (cookie)  mt_session cookie -> WebAuth::verify()
+ *   token (bearer)  Authorization: Bearer
+ *   basic (cached)  Authorization: Basic that already passed the KDF once
+ *   verify() only   WebAuth::verify() on a parsed token, no request handling
+ * A login (POST /api/login) runs the password KDF and is timed per call.
+ * SHA-256 and PBKDF2 come from OpenSSL through the mbedtls stubs.
+ */
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <WebServer.h>
+#include <chrono>
+#include <string>
+#include "device_config_types.h"
+
+const char OTA_PASSWORD[] = "esp32update";
+WebServer server;
+
+#include "web_auth.h"
+#include "test_support.h"
+
+const int REQUESTS = 1000000;
+const int LOGINS = 20;
+const char PASSWORD[] = "correct horse battery";
+const char BASIC[] = "Basic YWRtaW46Y29ycmVjdCBob3JzZSBiYXR0ZXJ5";   // admin:correct horse battery
+
+template <typename F>
+static double nsPer(int count, F call) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; i++) call();
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+}
+
+static void request(const char* header, const std::string& value) {
+  server.hostRequest(HTTP_GET);
+  if (header != nullptr) server.hostSetHeader(header, value.c_str());
+}
+
+/**
+ * Log in through the API handler and return the session token
+ */
+static std::string login(const char* password) {
+  server.hostRequest(HTTP_POST);
+  server.hostSetArg("plain", (std::string("{\"username\":\"admin\",\"password\":\"") + password + "\"}").c_str());
+  handleAPILogin();
+  if (server.hostStatus != 200) return "";
+  StaticJsonDocument<128> reply;
+  if (deserializeJson(reply, server.hostBody.c_str())) return "";
+  return reply["token"] | "";
+}
+
+static void testTiming(const std::string& token) {
+  int accepted = 0;
+  const std::string cookie = std::string("theme=dark; ") + WebAuthConfig::COOKIE_NAME + "=" + token;
+  const std::string bearer = "Bearer " + token;
+
+  request(WebAuthConfig::COOKIE_HEADER, cookie);
+  double cookieNs = nsPer(REQUESTS, [&] { accepted += requireAuth(); });
+
+  request(WebAuthConfig::AUTH_HEADER, bearer);
+  double bearerNs = nsPer(REQUESTS, [&] { accepted += requireAuth(); });
+
+  request(WebAuthConfig::AUTH_HEADER, BASIC);
+  accepted += requireAuth();   // Cache miss: one KDF, one AUTH token
+  double basicNs = nsPer(REQUESTS, [&] { accepted += requireAuth(); });
+
+  double verifyNs = nsPer(REQUESTS, [&] { accepted += webAuth.verify(token.c_str()); });
+
+  printf("token (cookie)  %7.0f ns/request\n", cookieNs);
+  printf("token (bearer)  %7.0f ns/request\n", bearerNs);
+  printf("basic (cached)  %7.0f ns/request\n", basicNs);
+  printf("verify() only   %7.0f ns/request\n", verifyNs);
+  CHECK_EQ(accepted, 4 * REQUESTS + 1);
+
+  const WebAuthStats& stats = webAuth.stats();
+  CHECK_EQ(stats.tokenChecks, 2 * REQUESTS);
+  CHECK_EQ(stats.basicChecks, REQUESTS + 1);
+  CHECK_EQ(stats.basicCacheHits, REQUESTS);
+  CHECK_EQ(stats.failures, 0);
+}
+
+static void testLoginCost() {
+  uint32_t runs = credentials.stats().kdfRuns;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < LOGINS; i++) CHECK(!login(PASSWORD).empty());
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / LOGINS;
+  printf("login           %7.2f ms/request (%lu KDF iterations)\n", ms, (unsigned long)credentials.iterations());
+  CHECK_EQ(credentials.stats().kdfRuns - runs, LOGINS);
+}
+
+static void testRefusals(const std::string& token) {
+  // Tampered token: 401 with a Basic challenge
+  std::string tampered = token;
+  tampered.back() = tampered.back() == '0' ? '1' : '0';
+  request(WebAuthConfig::AUTH_HEADER, "Bearer " + tampered);
+  CHECK(!requireAuth());
+  CHECK_EQ(server.hostStatus, 401);
+  CHECK(!server.hostResponseHeader("WWW-Authenticate").empty());
+
+  // Page load on Basic gets a session cookie that then works on its own
+  request(WebAuthConfig::AUTH_HEADER, BASIC);
+  CHECK(requireAuth(true));
+  std::string setCookie = server.hostResponseHeader("Set-Cookie");
+  CHECK(setCookie.compare(0, strlen(WebAuthConfig::COOKIE_NAME) + 1,
+                          std::string(WebAuthConfig::COOKIE_NAME) + "=") == 0);
+  request(WebAuthConfig::COOKIE_HEADER, setCookie.substr(0, setCookie.find(';')));
+  CHECK(requireAuth());
+
+  // Logout revokes the token it was called with
+  request(WebAuthConfig::AUTH_HEADER, "Bearer " + token);
+  handleAPILogout();
+  CHECK_EQ(server.hostStatus, 200);
+  request(WebAuthConfig::AUTH_HEADER, "Bearer " + token);
+  CHECK(!requireAuth());
+
+  // Expired after TOKEN_TTL_S
+  std::string fresh = login(PASSWORD);
+  request(WebAuthConfig::AUTH_HEADER, "Bearer " + fresh);
+  CHECK(requireAuth());
+  hostMillis += WebAuthConfig::TOKEN_TTL_S * 1000;
+  CHECK(!requireAuth());
+
+  // Wrong Basic password: 401 while AUTH tokens last, then 429
+  request(WebAuthConfig::AUTH_HEADER, "Basic YWRtaW46d3Jvbmc=");   // admin:wrong
+  int refused = 0;
+  int limited = 0;
+  for (int i = 0; i < 8; i++) {
+    CHECK(!requireAuth());
+    if (server.hostStatus == 401) refused++;
+    if (server.hostStatus == 429) limited++;
+  }
+  CHECK_EQ(refused + limited, 8);
+  CHECK(limited > 0);
+  CHECK(!server.hostResponseHeader("Retry-After").empty());
+
+  // Wrong login password
+  CHECK(login("not the password").empty());
+  CHECK_EQ(server.hostStatus, 401);
+}
+
+int main() {
+  DeviceConfig defaults = {};
+  strcpy(defaults.username, "admin");
+  configStore.begin(defaults);
+  credentials.begin();
+  credentials.setPasswords(PASSWORD, "ota password");
+  webAuth.begin();
+
+  std::string token = login(PASSWORD);
+  CHECK_EQ(token.size(), WebAuthConfig::TOKEN_HEX);
+
+  testTiming(token);
+  testLoginCost();
+  testRefusals(token);
+  return testSummary("web_auth");
+}
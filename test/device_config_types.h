@@ -0,0 +1,44 @@
+/*
+ * ESP32 Multitool - Host Test Support: DeviceConfig prerequisites
+ * config_store.h expects the sketch to have declared the structs it embeds.
+ * LedStripConfig comes from neopixel_effects.h; the others mirror
+ * mqtt_manager.h, ota_pull.h and sleep_telemetry.h, which need the network
+ * stack. Include once per program, before config_store.h.
+ */
+
+#ifndef DEVICE_CONFIG_TYPES_H
+#define DEVICE_CONFIG_TYPES_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+// Sketch globals the included headers declare extern
+struct SharedState { int sensorValue; };
+SemaphoreHandle_t stateMutex;
+SharedState sharedState;
+Preferences preferences;
+
+#include "neopixel_effects.h"   // LedStripConfig
+
+struct MqttConfig {
+  char server[64];
+  uint16_t port;
+  char clientId[32];
+  char user[32];
+  char pass[64];
+};
+
+struct OtaPullSettings {
+  bool enabled;
+  uint16_t intervalMin;
+  char manifestUrl[128];
+};
+
+struct SleepTelemetrySettings {
+  bool enabled;
+  uint16_t intervalS;
+  uint8_t batch;
+  uint8_t idleMin;
+};
+
+#endif
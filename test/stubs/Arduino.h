@@ -0,0 +1,98 @@
+/*
+ * ESP32 Multitool - Host Stub: Arduino core
+ * Just enough of Arduino.h and FreeRTOS for the headers under test.
+ * Time is a fake clock the test advances; RTOS objects are single-threaded
+ * no-ops. Functions only declared here must not be reached by a test.
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include "WString.h"
+
+#define PI 3.1415926535897932384626433832795
+#define IRAM_ATTR
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define INPUT_PULLUP 0x05
+#define OUTPUT 0x03
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+// --- Fake clock ---
+
+inline uint32_t hostMillis = 0;
+
+inline uint32_t millis() { return hostMillis; }
+inline uint32_t micros() { return hostMillis * 1000; }
+inline void delay(uint32_t ms) { hostMillis += ms; }
+
+template <typename T, typename L, typename H>
+T constrain(T value, L lo, H hi) { return value < lo ? lo : (value > hi ? hi : value); }
+
+// --- FreeRTOS ---
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef void* SemaphoreHandle_t;
+typedef void* TaskHandle_t;
+typedef void* QueueHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portMAX_DELAY 0xFFFFFFFF
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { static int mutex; return &mutex; }
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t) { return pdTRUE; }
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t) { return pdTRUE; }
+inline TickType_t xTaskGetTickCount() { return hostMillis; }
+void vTaskDelayUntil(TickType_t* previous, TickType_t increment);
+
+// Tasks are never started on the host; the handle only reports success
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t, const char*, uint32_t, void*, uint32_t,
+                                          TaskHandle_t* handle, BaseType_t) {
+  static int task;
+  if (handle != nullptr) *handle = &task;
+  return pdPASS;
+}
+
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+inline void xTaskNotifyGive(TaskHandle_t) {}
+inline uint32_t ulTaskNotifyTake(BaseType_t, TickType_t) { return 0; }
+
+// --- Serial ---
+
+struct HostSerial {
+  template <typename... Args>
+  int printf(const char* format, Args... args) { return ::printf(format, args...); }
+  void flush() { fflush(stdout); }
+};
+inline HostSerial Serial;
+
+// --- Logger (silent unless a test includes logger.h first) ---
+
+#ifndef LOGGER_H
+#define LOG_ERROR(...) ((void)0)
+#define LOG_WARN(...) ((void)0)
+#define LOG_INFO(...) ((void)0)
+#define LOG_DEBUG(...) ((void)0)
+#define LOG_RATELIMITED(...) ((void)0)
+#endif
+
+#endif
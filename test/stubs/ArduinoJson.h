@@ -0,0 +1,113 @@
+/*
+ * ESP32 Multitool - Host Stub: ArduinoJson
+ * Flat objects only: string and integer members without escapes, enough
+ * for small request bodies and replies
+ */
+
+#ifndef HOST_ARDUINOJSON_H
+#define HOST_ARDUINOJSON_H
+
+#include <Arduino.h>
+#include <ctype.h>
+#include <map>
+#include <string>
+
+struct DeserializationError {
+  bool failed;
+  explicit operator bool() const { return failed; }
+};
+
+struct JsonValue {
+  bool isString;
+  std::string text;   // Unquoted
+};
+
+class JsonMember {
+public:
+  explicit JsonMember(JsonValue* value) : _value(value) {}
+
+  const char* operator|(const char* fallback) const {
+    return _value->isString ? _value->text.c_str() : fallback;
+  }
+  long operator|(long fallback) const {
+    return !_value->isString && !_value->text.empty() ? atol(_value->text.c_str()) : fallback;
+  }
+
+  JsonMember& operator=(const char* value) {
+    *_value = {true, value};
+    return *this;
+  }
+  JsonMember& operator=(long value) {
+    *_value = {false, std::to_string(value)};
+    return *this;
+  }
+  JsonMember& operator=(unsigned long value) { return *this = (long)value; }
+  JsonMember& operator=(int value) { return *this = (long)value; }
+  JsonMember& operator=(unsigned int value) { return *this = (long)value; }
+
+private:
+  JsonValue* _value;
+};
+
+template <size_t CAPACITY>
+class StaticJsonDocument {
+public:
+  JsonMember operator[](const char* key) { return JsonMember(&_members[key]); }
+
+  std::map<std::string, JsonValue> _members;
+};
+
+/**
+ * Parse {"key":"value","n":123}; no escapes, nesting, arrays or floats
+ */
+template <size_t CAPACITY>
+DeserializationError deserializeJson(StaticJsonDocument<CAPACITY>& doc, const String& input) {
+  doc._members.clear();
+  const char* p = input.c_str();
+  auto skip = [&p]() { while (isspace((unsigned char)*p)) p++; };
+  skip();
+  if (*p++ != '{') return {true};
+  skip();
+  if (*p == '}') return {false};
+  for (;;) {
+    skip();
+    if (*p++ != '"') return {true};
+    const char* keyEnd = strchr(p, '"');
+    if (keyEnd == nullptr) return {true};
+    std::string key(p, keyEnd);
+    p = keyEnd + 1;
+    skip();
+    if (*p++ != ':') return {true};
+    skip();
+    if (*p == '"') {
+      const char* end = strchr(p + 1, '"');
+      if (end == nullptr) return {true};
+      doc._members[key] = {true, std::string(p + 1, end)};
+      p = end + 1;
+    } else {
+      const char* start = p;
+      if (*p == '-') p++;
+      if (!isdigit((unsigned char)*p)) return {true};
+      while (isdigit((unsigned char)*p)) p++;
+      doc._members[key] = {false, std::string(start, p)};
+    }
+    skip();
+    if (*p == '}') return {false};
+    if (*p++ != ',') return {true};
+  }
+}
+
+template <size_t CAPACITY>
+size_t serializeJson(const StaticJsonDocument<CAPACITY>& doc, String& output) {
+  std::string json = "{";
+  for (const auto& member : doc._members) {
+    if (json.size() > 1) json += ",";
+    json += "\"" + member.first + "\":";
+    json += member.second.isString ? "\"" + member.second.text + "\"" : member.second.text;
+  }
+  json += "}";
+  output = String(json);
+  return json.size();
+}
+
+#endif
@@ -0,0 +1,19 @@
+/*
+ * ESP32 Multitool - Host Stub: ESP32Encoder
+ * The PCNT count is a plain field the test sets
+ */
+
+#ifndef HOST_ESP32ENCODER_H
+#define HOST_ESP32ENCODER_H
+
+#include <stdint.h>
+
+class ESP32Encoder {
+public:
+  int64_t getCount() { return count; }
+  void setCount(int64_t value) { count = value; }
+
+  int64_t count = 0;
+};
+
+#endif
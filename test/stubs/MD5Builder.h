@@ -0,0 +1,27 @@
+/*
+ * ESP32 Multitool - Host Stub: MD5Builder
+ * On OpenSSL's MD5 (link -lcrypto)
+ */
+
+#ifndef HOST_MD5BUILDER_H
+#define HOST_MD5BUILDER_H
+
+#include <Arduino.h>
+#include <openssl/md5.h>
+
+class MD5Builder {
+public:
+  void begin() { MD5_Init(&_ctx); }
+  void add(const char* text) { MD5_Update(&_ctx, text, strlen(text)); }
+  void add(const uint8_t* data, size_t len) { MD5_Update(&_ctx, data, len); }
+  void calculate() { MD5_Final(_digest, &_ctx); }
+  void getChars(char* out) const {
+    for (int i = 0; i < 16; i++) snprintf(out + i * 2, 3, "%02x", _digest[i]);
+  }
+
+private:
+  MD5_CTX _ctx;
+  uint8_t _digest[16];
+};
+
+#endif
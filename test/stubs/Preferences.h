@@ -0,0 +1,109 @@
+/*
+ * ESP32 Multitool - Host Stub: Preferences (NVS)
+ * In-memory namespaces of raw key blobs that outlive any one Preferences
+ * object, so a test "reboots" by constructing the code under test again.
+ * Writes through a read-only handle fail as they do on the device.
+ */
+
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef std::map<std::string, std::vector<uint8_t>> NvsNamespace;
+
+class Preferences {
+public:
+  /** Whole flash contents, by namespace then key (tests may edit it directly) */
+  static std::map<std::string, NvsNamespace>& flash() {
+    static std::map<std::string, NvsNamespace> store;
+    return store;
+  }
+
+  /** Successful writes since start (putX, remove and clear) */
+  static uint32_t& writes() {
+    static uint32_t count = 0;
+    return count;
+  }
+
+  bool begin(const char* name, bool readOnly = false) {
+    _ns = &flash()[name];
+    _readOnly = readOnly;
+    return true;
+  }
+  void end() { _ns = nullptr; }
+
+  bool isKey(const char* key) { return find(key) != nullptr; }
+  size_t getBytesLength(const char* key) {
+    const std::vector<uint8_t>* value = find(key);
+    return value != nullptr ? value->size() : 0;
+  }
+  size_t getBytes(const char* key, void* buf, size_t maxLen) {
+    const std::vector<uint8_t>* value = find(key);
+    if (value == nullptr || value->size() > maxLen) return 0;
+    memcpy(buf, value->data(), value->size());
+    return value->size();
+  }
+  size_t getString(const char* key, char* buf, size_t maxLen) {
+    const std::vector<uint8_t>* value = find(key);
+    if (value == nullptr || value->size() >= maxLen) return 0;
+    memcpy(buf, value->data(), value->size());
+    buf[value->size()] = '\0';
+    return value->size() + 1;
+  }
+  uint8_t getUChar(const char* key, uint8_t defaultValue = 0) { return getNumber(key, defaultValue); }
+  uint16_t getUShort(const char* key, uint16_t defaultValue = 0) { return getNumber(key, defaultValue); }
+  uint32_t getUInt(const char* key, uint32_t defaultValue = 0) { return getNumber(key, defaultValue); }
+  bool getBool(const char* key, bool defaultValue = false) { return getNumber<uint8_t>(key, defaultValue); }
+
+  size_t putBytes(const char* key, const void* data, size_t len) { return put(key, data, len); }
+  size_t putString(const char* key, const char* value) { return put(key, value, strlen(value)); }
+  size_t putUChar(const char* key, uint8_t value) { return put(key, &value, sizeof(value)); }
+  size_t putUShort(const char* key, uint16_t value) { return put(key, &value, sizeof(value)); }
+  size_t putUInt(const char* key, uint32_t value) { return put(key, &value, sizeof(value)); }
+  size_t putBool(const char* key, bool value) { return putUChar(key, value ? 1 : 0); }
+
+  bool remove(const char* key) {
+    if (_ns == nullptr || _readOnly || _ns->erase(key) == 0) return false;
+    writes()++;
+    return true;
+  }
+  bool clear() {
+    if (_ns == nullptr || _readOnly) return false;
+    _ns->clear();
+    writes()++;
+    return true;
+  }
+
+private:
+  const std::vector<uint8_t>* find(const char* key) const {
+    if (_ns == nullptr) return nullptr;
+    auto it = _ns->find(key);
+    return it != _ns->end() ? &it->second : nullptr;
+  }
+
+  template <typename T>
+  T getNumber(const char* key, T defaultValue) {
+    const std::vector<uint8_t>* value = find(key);
+    if (value == nullptr || value->size() != sizeof(T)) return defaultValue;
+    T result;
+    memcpy(&result, value->data(), sizeof(T));
+    return result;
+  }
+
+  size_t put(const char* key, const void* data, size_t len) {
+    if (_ns == nullptr || _readOnly) return 0;
+    const uint8_t* bytes = (const uint8_t*)data;
+    (*_ns)[key].assign(bytes, bytes + len);
+    writes()++;
+    return len;
+  }
+
+  NvsNamespace* _ns = nullptr;
+  bool _readOnly = true;
+};
+
+#endif
@@ -0,0 +1,44 @@
+/*
+ * ESP32 Multitool - Host Stub: Arduino String
+ * The subset of String the headers under test use, over std::string
+ */
+
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+class __FlashStringHelper;
+#define F(str) (reinterpret_cast<const __FlashStringHelper*>(str))
+
+class String {
+public:
+  String() {}
+  String(const char* str) : _s(str != nullptr ? str : "") {}
+  String(const __FlashStringHelper* str) : _s(reinterpret_cast<const char*>(str)) {}
+  String(const std::string& str) : _s(str) {}
+  explicit String(int value) : _s(std::to_string(value)) {}
+  explicit String(unsigned int value) : _s(std::to_string(value)) {}
+  explicit String(long value) : _s(std::to_string(value)) {}
+  explicit String(unsigned long value) : _s(std::to_string(value)) {}
+
+  const char* c_str() const { return _s.c_str(); }
+  unsigned int length() const { return (unsigned int)_s.size(); }
+  bool startsWith(const char* prefix) const { return _s.compare(0, strlen(prefix), prefix) == 0; }
+  long toInt() const { return atol(_s.c_str()); }
+
+  String& operator+=(const String& other) { _s += other._s; return *this; }
+  String& operator+=(const char* other) { _s += other; return *this; }
+  String& operator+=(char c) { _s += c; return *this; }
+  bool operator==(const String& other) const { return _s == other._s; }
+  bool operator==(const char* other) const { return _s == other; }
+  bool operator!=(const String& other) const { return _s != other._s; }
+
+private:
+  std::string _s;
+};
+
+#endif
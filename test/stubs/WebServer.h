@@ -0,0 +1,97 @@
+/*
+ * ESP32 Multitool - Host Stub: WebServer
+ * One request at a time: the test sets the method, headers, args and
+ * client IP, calls a handler, then reads back the response it produced.
+ */
+
+#ifndef HOST_WEBSERVER_H
+#define HOST_WEBSERVER_H
+
+#include <Arduino.h>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
+
+class IPAddress {
+public:
+  IPAddress(uint32_t address = 0) : _address(address) {}
+  operator uint32_t() const { return _address; }
+
+private:
+  uint32_t _address;
+};
+
+class WiFiClient {
+public:
+  explicit WiFiClient(uint32_t ip = 0) : _ip(ip) {}
+  IPAddress remoteIP() const { return IPAddress(_ip); }
+
+private:
+  uint32_t _ip;
+};
+
+class WebServer {
+public:
+  typedef std::function<void()> THandlerFunction;
+
+  // --- Request, as the test sets it ---
+
+  void hostRequest(HTTPMethod method, uint32_t ip = 0x0A000002) {
+    _method = method;
+    _ip = ip;
+    _headers.clear();
+    _args.clear();
+    hostStatus = 0;
+    hostBody.clear();
+    hostHeaders.clear();
+  }
+  void hostSetHeader(const char* name, const String& value) { _headers[name] = value.c_str(); }
+  void hostSetArg(const char* name, const String& value) { _args[name] = value.c_str(); }
+
+  HTTPMethod method() const { return _method; }
+  WiFiClient client() const { return WiFiClient(_ip); }
+  String header(const char* name) const { return lookup(_headers, name); }
+  bool hasHeader(const char* name) const { return _headers.count(name) != 0; }
+  String arg(const char* name) const { return lookup(_args, name); }
+  bool hasArg(const char* name) const { return _args.count(name) != 0; }
+
+  // --- Response, as the test reads it ---
+
+  int hostStatus = 0;
+  std::string hostBody;
+  std::vector<std::pair<std::string, std::string>> hostHeaders;
+
+  void send(int code, const String& contentType = String(), const String& content = String()) {
+    hostStatus = code;
+    hostBody = content.c_str();
+  }
+  void sendHeader(const String& name, const String& value, bool first = false) {
+    hostHeaders.emplace_back(name.c_str(), value.c_str());
+  }
+  void requestAuthentication() {
+    sendHeader("WWW-Authenticate", "Basic realm=\"Login Required\"");
+    send(401);
+  }
+  std::string hostResponseHeader(const char* name) const {
+    for (const auto& header : hostHeaders) {
+      if (header.first == name) return header.second;
+    }
+    return "";
+  }
+
+private:
+  static String lookup(const std::map<std::string, std::string>& map, const char* name) {
+    auto it = map.find(name);
+    return it != map.end() ? String(it->second) : String();
+  }
+
+  HTTPMethod _method = HTTP_GET;
+  uint32_t _ip = 0;
+  std::map<std::string, std::string> _headers;
+  std::map<std::string, std::string> _args;
+};
+
+#endif
@@ -0,0 +1,62 @@
+/*
+ * ESP32 Multitool - Host Stub: RMT TX driver
+ * Channels are created and accepted but nothing is transmitted.
+ */
+
+#ifndef HOST_RMT_TX_H
+#define HOST_RMT_TX_H
+
+#include <Arduino.h>
+
+#define SOC_RMT_TX_CANDIDATES_PER_GROUP 8
+#define SOC_RMT_MEM_WORDS_PER_CHANNEL 64
+#define SOC_RMT_SUPPORT_DMA 1
+#define RMT_CLK_SRC_DEFAULT 0
+
+typedef int gpio_num_t;
+typedef struct HostRmtChannel* rmt_channel_handle_t;
+typedef struct HostRmtEncoder* rmt_encoder_handle_t;
+
+typedef struct {
+  gpio_num_t gpio_num;
+  int clk_src;
+  uint32_t resolution_hz;
+  size_t mem_block_symbols;
+  size_t trans_queue_depth;
+  struct { uint32_t with_dma : 1; } flags;
+} rmt_tx_channel_config_t;
+
+typedef struct {
+  uint16_t duration0 : 15;
+  uint16_t level0 : 1;
+  uint16_t duration1 : 15;
+  uint16_t level1 : 1;
+} rmt_symbol_word_t;
+
+typedef struct {
+  rmt_symbol_word_t bit0;
+  rmt_symbol_word_t bit1;
+  struct { uint32_t msb_first : 1; } flags;
+} rmt_bytes_encoder_config_t;
+
+typedef struct {
+  int loop_count;
+} rmt_transmit_config_t;
+
+inline esp_err_t rmt_new_tx_channel(const rmt_tx_channel_config_t*, rmt_channel_handle_t* channel) {
+  *channel = (rmt_channel_handle_t)malloc(1);
+  return ESP_OK;
+}
+inline esp_err_t rmt_new_bytes_encoder(const rmt_bytes_encoder_config_t*, rmt_encoder_handle_t* encoder) {
+  *encoder = (rmt_encoder_handle_t)malloc(1);
+  return ESP_OK;
+}
+inline esp_err_t rmt_enable(rmt_channel_handle_t) { return ESP_OK; }
+inline esp_err_t rmt_disable(rmt_channel_handle_t) { return ESP_OK; }
+inline esp_err_t rmt_del_channel(rmt_channel_handle_t channel) { free(channel); return ESP_OK; }
+inline esp_err_t rmt_del_encoder(rmt_encoder_handle_t encoder) { free(encoder); return ESP_OK; }
+inline esp_err_t rmt_transmit(rmt_channel_handle_t, rmt_encoder_handle_t, const void*, size_t,
+                              const rmt_transmit_config_t*) { return ESP_OK; }
+inline esp_err_t rmt_tx_wait_all_done(rmt_channel_handle_t, int) { return ESP_OK; }
+
+#endif
@@ -0,0 +1,15 @@
+/*
+ * ESP32 Multitool - Host Stub: OTA operations
+ * The running partition is whatever the test points hostRunningPartition at.
+ */
+
+#ifndef HOST_ESP_OTA_OPS_H
+#define HOST_ESP_OTA_OPS_H
+
+#include <esp_partition.h>
+
+inline const esp_partition_t* hostRunningPartition = nullptr;
+
+inline const esp_partition_t* esp_ota_get_running_partition() { return hostRunningPartition; }
+
+#endif
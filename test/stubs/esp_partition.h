@@ -0,0 +1,28 @@
+/*
+ * ESP32 Multitool - Host Stub: flash partitions
+ * A partition is a window onto a host buffer the test owns.
+ */
+
+#ifndef HOST_ESP_PARTITION_H
+#define HOST_ESP_PARTITION_H
+
+#include <Arduino.h>
+
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_SIZE 0x104
+
+typedef struct {
+  uint32_t address;
+  uint32_t size;
+  char label[17];
+  const uint8_t* hostData;   // Host only: partition contents
+} esp_partition_t;
+
+inline esp_err_t esp_partition_read(const esp_partition_t* partition, size_t offset, void* dst, size_t size) {
+  if (partition == nullptr || dst == nullptr) return ESP_ERR_INVALID_ARG;
+  if (offset > partition->size || size > partition->size - offset) return ESP_ERR_INVALID_SIZE;
+  memcpy(dst, partition->hostData + offset, size);
+  return ESP_OK;
+}
+
+#endif
@@ -0,0 +1,26 @@
+/*
+ * ESP32 Multitool - Host Stub: hardware RNG
+ * Deterministic xorshift, so host runs repeat
+ */
+
+#ifndef HOST_ESP_RANDOM_H
+#define HOST_ESP_RANDOM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+inline uint32_t hostRandomState = 0x2545F491;
+
+inline uint32_t esp_random() {
+  hostRandomState ^= hostRandomState << 13;
+  hostRandomState ^= hostRandomState >> 17;
+  hostRandomState ^= hostRandomState << 5;
+  return hostRandomState;
+}
+
+inline void esp_fill_random(void* buf, size_t len) {
+  uint8_t* out = (uint8_t*)buf;
+  for (size_t i = 0; i < len; i++) out[i] = (uint8_t)esp_random();
+}
+
+#endif
@@ -0,0 +1,13 @@
+/*
+ * ESP32 Multitool - Host Stub: high-resolution timer
+ * Follows the fake clock in Arduino.h
+ */
+
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+#include <Arduino.h>
+
+inline int64_t esp_timer_get_time() { return (int64_t)hostMillis * 1000; }
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * ESP32 Multitool - Host Stub: mbedTLS base64
+ * Decoder with mbedTLS's return codes (padding required, no whitespace)
+ */
+
+#ifndef HOST_MBEDTLS_BASE64_H
+#define HOST_MBEDTLS_BASE64_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL -0x002A
+#define MBEDTLS_ERR_BASE64_INVALID_CHARACTER -0x002C
+
+inline int hostBase64Value(unsigned char c) {
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+') return 62;
+  if (c == '/') return 63;
+  return -1;
+}
+
+inline int mbedtls_base64_decode(unsigned char* dst, size_t dlen, size_t* olen, const unsigned char* src, size_t slen) {
+  if (slen % 4 != 0) return MBEDTLS_ERR_BASE64_INVALID_CHARACTER;
+  size_t pad = 0;
+  if (slen > 0 && src[slen - 1] == '=') pad++;
+  if (slen > 1 && src[slen - 2] == '=') pad++;
+  size_t need = slen / 4 * 3 - pad;
+  *olen = need;
+  if (dst == nullptr || dlen < need) return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+
+  size_t out = 0;
+  for (size_t i = 0; i < slen; i += 4) {
+    uint32_t word = 0;
+    for (size_t j = 0; j < 4; j++) {
+      int value = src[i + j] == '=' && i + j >= slen - pad ? 0 : hostBase64Value(src[i + j]);
+      if (value < 0) return MBEDTLS_ERR_BASE64_INVALID_CHARACTER;
+      word = (word << 6) | (uint32_t)value;
+    }
+    for (int shift = 16; shift >= 0 && out < need; shift -= 8) dst[out++] = (uint8_t)(word >> shift);
+  }
+  return 0;
+}
+
+#endif
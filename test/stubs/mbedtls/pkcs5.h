@@ -0,0 +1,21 @@
+/*
+ * ESP32 Multitool - Host Stub: mbedTLS PBKDF2
+ * On OpenSSL's PKCS5_PBKDF2_HMAC (link -lcrypto)
+ */
+
+#ifndef HOST_MBEDTLS_PKCS5_H
+#define HOST_MBEDTLS_PKCS5_H
+
+#include <openssl/evp.h>
+
+typedef enum { MBEDTLS_MD_NONE = 0, MBEDTLS_MD_SHA256 = 9 } mbedtls_md_type_t;
+
+inline int mbedtls_pkcs5_pbkdf2_hmac_ext(mbedtls_md_type_t md, const unsigned char* password, size_t passwordLen,
+                                         const unsigned char* salt, size_t saltLen, unsigned int iterations,
+                                         uint32_t keyLen, unsigned char* output) {
+  if (md != MBEDTLS_MD_SHA256) return -1;
+  return PKCS5_PBKDF2_HMAC((const char*)password, (int)passwordLen, salt, (int)saltLen, (int)iterations,
+                           EVP_sha256(), (int)keyLen, output) == 1 ? 0 : -1;
+}
+
+#endif
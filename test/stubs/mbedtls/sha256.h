@@ -0,0 +1,24 @@
+/*
+ * ESP32 Multitool - Host Stub: mbedTLS SHA-256
+ * The mbedTLS 3 calls the firmware uses, on OpenSSL's SHA256 (link -lcrypto)
+ */
+
+#ifndef HOST_MBEDTLS_SHA256_H
+#define HOST_MBEDTLS_SHA256_H
+
+#include <openssl/sha.h>
+
+typedef SHA256_CTX mbedtls_sha256_context;
+
+inline void mbedtls_sha256_init(mbedtls_sha256_context* ctx) { SHA256_Init(ctx); }
+inline void mbedtls_sha256_free(mbedtls_sha256_context*) {}
+inline void mbedtls_sha256_clone(mbedtls_sha256_context* dst, const mbedtls_sha256_context* src) { *dst = *src; }
+inline int mbedtls_sha256_starts(mbedtls_sha256_context* ctx, int is224) { return is224 ? -1 : (SHA256_Init(ctx) ? 0 : -1); }
+inline int mbedtls_sha256_update(mbedtls_sha256_context* ctx, const unsigned char* input, size_t len) {
+  return SHA256_Update(ctx, input, len) ? 0 : -1;
+}
+inline int mbedtls_sha256_finish(mbedtls_sha256_context* ctx, unsigned char output[32]) {
+  return SHA256_Final(output, ctx) ? 0 : -1;
+}
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * ESP32 Multitool - Host Stub: ROM miniz inflater
+ * tinfl_decompress() on top of zlib's raw inflate (link -lz). zlib keeps its
+ * own window, so back-references never read the caller's circular buffer;
+ * output sizes and status codes follow tinfl. zlib's state lives in an
+ * arena inside the decompressor, so free() on it releases everything, as
+ * with the ROM version.
+ */
+
+#ifndef HOST_MINIZ_H
+#define HOST_MINIZ_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <zlib.h>
+
+typedef unsigned char mz_uint8;
+typedef uint32_t mz_uint32;
+
+#define TINFL_LZ_DICT_SIZE 32768
+
+enum {
+  TINFL_FLAG_PARSE_ZLIB_HEADER = 1,
+  TINFL_FLAG_HAS_MORE_INPUT = 2,
+  TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4
+};
+
+typedef enum {
+  TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS = -4,
+  TINFL_STATUS_BAD_PARAM = -3,
+  TINFL_STATUS_ADLER32_MISMATCH = -2,
+  TINFL_STATUS_FAILED = -1,
+  TINFL_STATUS_DONE = 0,
+  TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+  TINFL_STATUS_HAS_MORE_OUTPUT = 2
+} tinfl_status;
+
+typedef struct {
+  z_stream stream;
+  bool ready;
+  size_t arenaUsed;
+  alignas(16) uint8_t arena[48 * 1024];   // inflate state + 32 KB window
+} tinfl_decompressor;
+
+inline voidpf hostTinflAlloc(voidpf opaque, uInt items, uInt size) {
+  tinfl_decompressor* r = (tinfl_decompressor*)opaque;
+  size_t bytes = ((size_t)items * size + 15) & ~(size_t)15;
+  if (r->arenaUsed + bytes > sizeof(r->arena)) return Z_NULL;
+  voidpf ptr = r->arena + r->arenaUsed;
+  r->arenaUsed += bytes;
+  return ptr;
+}
+
+inline void hostTinflFree(voidpf, voidpf) {}
+
+inline void tinfl_init(tinfl_decompressor* r) {
+  r->stream = z_stream();
+  r->stream.zalloc = hostTinflAlloc;
+  r->stream.zfree = hostTinflFree;
+  r->stream.opaque = r;
+  r->arenaUsed = 0;
+  r->ready = inflateInit2(&r->stream, -15) == Z_OK;
+}
+
+inline tinfl_status tinfl_decompress(tinfl_decompressor* r, const mz_uint8* in, size_t* inSize,
+                                     mz_uint8* outStart, mz_uint8* outNext, size_t* outSize,
+                                     const mz_uint32 flags) {
+  if (!r->ready || (flags & TINFL_FLAG_PARSE_ZLIB_HEADER)) return TINFL_STATUS_BAD_PARAM;
+  r->stream.next_in = (Bytef*)in;
+  r->stream.avail_in = (uInt)*inSize;
+  r->stream.next_out = outNext;
+  r->stream.avail_out = (uInt)*outSize;
+  int result = inflate(&r->stream, Z_NO_FLUSH);
+  *inSize -= r->stream.avail_in;
+  *outSize -= r->stream.avail_out;
+
+  if (result == Z_STREAM_END) return TINFL_STATUS_DONE;
+  if (result != Z_OK && result != Z_BUF_ERROR) return TINFL_STATUS_FAILED;
+  if (r->stream.avail_out == 0) return TINFL_STATUS_HAS_MORE_OUTPUT;
+  if (r->stream.avail_in == 0) {
+    return (flags & TINFL_FLAG_HAS_MORE_INPUT) ? TINFL_STATUS_NEEDS_MORE_INPUT
+                                               : TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS;
+  }
+  return TINFL_STATUS_HAS_MORE_OUTPUT;
+}
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * ESP32 Multitool - Config Store Test
+ * config_store.h against the in-memory Preferences stub: legacy import,
+ * debounced commits, older/newer schema images and a corrupt image
+ */
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <stddef.h>
+#include <vector>
+#include "device_config_types.h"
+#include "config_store.h"
+#include "test_support.h"
+
+static DeviceConfig defaults() {
+  DeviceConfig config = {};
+  strcpy(config.username, "admin");
+  strcpy(config.hostname, "esp32-multitool");
+  config.pwmFrequency = 5000;
+  strcpy(config.mqtt.server, "broker.hivemq.com");
+  config.mqtt.port = 1883;
+  strcpy(config.mqtt.clientId, "ESP32_Multitool");
+  config.leds.outputs = 1;
+  config.leds.output[0] = {5, 36};
+  config.otaPull.intervalMin = 60;
+  config.sleep = {false, 300, 6, 10};
+  return config;
+}
+
+static std::vector<uint8_t>& storedImage() {
+  return Preferences::flash()[ConfigStoreConfig::NAMESPACE][ConfigStoreConfig::KEY];
+}
+
+/**
+ * Store an image as some other firmware would have written it
+ */
+static void writeImage(uint16_t version, const void* payload, uint16_t size) {
+  ConfigImageHeader header = {ConfigStoreConfig::MAGIC, version, size,
+                              esp_rom_crc32_le(0, (const uint8_t*)payload, size)};
+  std::vector<uint8_t>& image = storedImage();
+  image.resize(sizeof(header) + size);
+  memcpy(image.data(), &header, sizeof(header));
+  memcpy(image.data() + sizeof(header), payload, size);
+}
+
+static bool hasKey(const char* ns, const char* key) {
+  auto it = Preferences::flash().find(ns);
+  return it != Preferences::flash().end() && it->second.count(key) != 0;
+}
+
+static void testLegacyImport() {
+  // Per-key layout of firmware before the config store
+  Preferences p;
+  p.begin("mqtt", false);
+  p.putString("server", "10.0.0.2");
+  p.putUInt("port", 8883);
+  p.end();
+  p.begin("leds", false);
+  p.putUChar("outputs", 2);
+  p.putUChar("pin0", 15);
+  p.putUShort("count0", 300);
+  p.putUChar("pin1", 16);
+  p.putUShort("count1", 200);
+  p.end();
+  p.begin("otapull", false);
+  p.putString("url", "http://10.0.0.2/manifest.json");
+  p.putBool("enabled", true);
+  p.end();
+  p.begin("auth", false);
+  p.putString("user", "operator");
+  p.putBytes("webhash", "hash", 4);
+  p.end();
+
+  ConfigStore store;
+  store.begin(defaults());
+  const DeviceConfig& c = store.data();
+  CHECK(strcmp(c.username, "operator") == 0);
+  CHECK(strcmp(c.mqtt.server, "10.0.0.2") == 0);
+  CHECK_EQ(c.mqtt.port, 8883);
+  CHECK(strcmp(c.mqtt.clientId, "ESP32_Multitool") == 0);   // Missing key keeps the default
+  CHECK_EQ(c.leds.outputs, 2);
+  CHECK_EQ(c.leds.output[0].pin, 15);
+  CHECK_EQ(c.leds.output[1].count, 200);
+  CHECK(c.otaPull.enabled);
+  CHECK_EQ(c.otaPull.intervalMin, 60);
+  CHECK_EQ(c.sleep.intervalS, 300);
+  CHECK_EQ(store.stats().loadedVersion, 0);
+  CHECK_EQ(store.stats().commits, 1);
+
+  // Imported keys are erased; password hashes stay
+  CHECK(!hasKey("mqtt", "server"));
+  CHECK(!hasKey("leds", "pin0"));
+  CHECK(!hasKey("auth", "user"));
+  CHECK(hasKey("auth", "webhash"));
+  CHECK_EQ(storedImage().size(), sizeof(ConfigImageHeader) + sizeof(DeviceConfig));
+}
+
+static void testReloadAndDebounce() {
+  uint32_t writesBefore = Preferences::writes();
+  ConfigStore store;
+  store.begin(defaults());
+  CHECK_EQ(store.stats().loadedVersion, ConfigStoreConfig::SCHEMA_VERSION);
+  CHECK(strcmp(store.data().mqtt.server, "10.0.0.2") == 0);
+  CHECK_EQ(Preferences::writes(), writesBefore);   // A current image is not rewritten
+
+  // 20 edits 100 ms apart: one commit, COMMIT_DELAY_MS after the last
+  for (int i = 0; i < 20; i++) {
+    store.data().pwmFrequency = 1000 + i;
+    store.markDirty();
+    hostMillis += 100;
+    store.tick();
+  }
+  CHECK_EQ(store.stats().commits, 0);
+  CHECK(store.pending());
+  hostMillis += ConfigStoreConfig::COMMIT_DELAY_MS - 100;
+  store.tick();
+  CHECK_EQ(store.stats().commits, 1);
+  CHECK_EQ(store.stats().coalesced, 19);
+  CHECK(!store.pending());
+
+  // Edits that never pause still commit every MAX_DELAY_MS
+  for (int i = 0; i < 120; i++) {
+    store.data().pwmFrequency = 2000 + i;
+    store.markDirty();
+    hostMillis += 500;
+    store.tick();
+  }
+  CHECK_EQ(store.stats().commits, 1 + 120 * 500 / ConfigStoreConfig::MAX_DELAY_MS);
+  store.flush();
+  CHECK(!store.pending());
+
+  ConfigStore rebooted;
+  rebooted.begin(defaults());
+  CHECK_EQ(rebooted.data().pwmFrequency, 2119);
+}
+
+static void testOlderSchema() {
+  // v1 image: everything before the sleep settings
+  DeviceConfig old = defaults();
+  strcpy(old.hostname, "bench-1");
+  old.sleep = {true, 1, 1, 1};   // Not in a v1 image: must not be read
+  writeImage(1, &old, offsetof(DeviceConfig, sleep));
+
+  ConfigStore store;
+  store.begin(defaults());
+  CHECK(strcmp(store.data().hostname, "bench-1") == 0);
+  CHECK(!store.data().sleep.enabled);
+  CHECK_EQ(store.data().sleep.intervalS, 300);
+  CHECK_EQ(store.stats().loadedVersion, 1);
+  CHECK_EQ(store.stats().commits, 1);   // Rewritten as the current schema
+  ConfigImageHeader header;
+  memcpy(&header, storedImage().data(), sizeof(header));
+  CHECK_EQ(header.version, ConfigStoreConfig::SCHEMA_VERSION);
+  CHECK_EQ(header.size, sizeof(DeviceConfig));
+}
+
+static void testNewerSchema() {
+  // Image from newer firmware after a rollback: a longer payload
+  DeviceConfig newer = defaults();
+  strcpy(newer.hostname, "from-v3");
+  std::vector<uint8_t> payload(sizeof(newer) + 16, 0xAB);
+  memcpy(payload.data(), &newer, sizeof(newer));
+  writeImage(ConfigStoreConfig::SCHEMA_VERSION + 1, payload.data(), payload.size());
+
+  uint32_t writesBefore = Preferences::writes();
+  ConfigStore store;
+  store.begin(defaults());
+  CHECK(strcmp(store.data().hostname, "from-v3") == 0);
+  CHECK_EQ(store.stats().loadedVersion, ConfigStoreConfig::SCHEMA_VERSION + 1);
+  CHECK_EQ(Preferences::writes(), writesBefore);   // Left for the newer firmware
+  CHECK_EQ(storedImage().size(), sizeof(ConfigImageHeader) + payload.size());
+}
+
+static void testCorruptImage() {
+  DeviceConfig config = defaults();
+  strcpy(config.hostname, "bench-2");
+  writeImage(ConfigStoreConfig::SCHEMA_VERSION, &config, sizeof(config));
+  storedImage()[sizeof(ConfigImageHeader) + 40] ^= 0x01;
+
+  ConfigStore store;
+  store.begin(defaults());
+  CHECK_EQ(store.stats().failures, 1);
+  CHECK(strcmp(store.data().hostname, "esp32-multitool") == 0);
+  CHECK_EQ(store.stats().commits, 1);   // Fresh image over the corrupt one
+
+  ConfigStore rebooted;
+  rebooted.begin(defaults());
+  CHECK_EQ(rebooted.stats().failures, 0);
+  CHECK_EQ(rebooted.stats().loadedVersion, ConfigStoreConfig::SCHEMA_VERSION);
+}
+
+int main() {
+  testLegacyImport();
+  testReloadAndDebounce();
+  testOlderSchema();
+  testNewerSchema();
+  testCorruptImage();
+  return testSummary("config_store");
+}
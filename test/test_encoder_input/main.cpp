@@ -0,0 +1,143 @@
+/*
+ * ESP32 Multitool - Encoder Input Test
+ * Plays detent traces (time, direction) through EncoderInput the way
+ * loop() reads it, and checks the acceleration per app profile
+ */
+
+#include <Arduino.h>
+#include <algorithm>
+#include <vector>
+#include "encoder_input.h"
+#include "test_support.h"
+
+// Same profiles as encoderProfileFor() in the sketch
+const EncoderProfile SERVO = {60, 12, 5};
+const EncoderProfile PWM = {60, 12, 8};
+const EncoderProfile TONE = {80, 10, 50};
+
+const uint32_t PASS_MS = 25;   // One loop() pass with a display redraw
+
+struct Detent {
+  uint32_t ms;
+  int8_t direction;
+};
+
+typedef std::vector<Detent> Trace;
+
+struct Played {
+  int32_t value;
+  int detentsToTarget;   // Detents turned when value first reached the target, 0 = never
+  uint8_t maxMultiplier;
+};
+
+/**
+ * Feed a trace to a fresh EncoderInput: loop() wakes on an edge, or at the
+ * end of the pass in progress, and reads every count that arrived by then
+ */
+static Played play(const Trace& trace, const EncoderProfile& profile, int32_t value, int32_t lo,
+                   int32_t hi, int32_t target = INT32_MAX) {
+  ESP32Encoder counter;
+  EncoderInput input;
+  input.begin(&counter);
+  Played result = {value, 0, 1};
+  size_t next = 0;
+  uint32_t busyUntil = 0;
+
+  while (next < trace.size()) {
+    hostMillis = std::max(trace[next].ms, busyUntil);
+    while (next < trace.size() && trace[next].ms <= hostMillis) {
+      counter.count += trace[next].direction * EncoderConfig::COUNTS_PER_DETENT;
+      next++;
+    }
+    result.value = stepClamped(result.value, input.poll(profile), lo, hi);
+    result.maxMultiplier = std::max(result.maxMultiplier, input.multiplier());
+    busyUntil = hostMillis + PASS_MS;
+    if (result.detentsToTarget == 0 && result.value >= target) result.detentsToTarget = (int)next;
+  }
+  return result;
+}
+
+static Trace spin(uint32_t startMs, int detents, uint32_t msPerDetent, int8_t direction) {
+  Trace trace;
+  for (int i = 0; i < detents; i++) trace.push_back({startMs + i * msPerDetent, direction});
+  return trace;
+}
+
+static Trace join(Trace a, const Trace& b) {
+  a.insert(a.end(), b.begin(), b.end());
+  return a;
+}
+
+static void testFullRangeSweeps() {
+  // 100-4000 Hz took 3900 detents without acceleration
+  const uint32_t intervals[] = {150, 60, 40, 25, 15, 8};
+  for (uint32_t ms : intervals) {
+    Played tone = play(spin(1000, 4000, ms, 1), TONE, 100, 100, 4000, 4000);
+    printf("  tone 100-4000 Hz at %3u ms/detent: %4d detents\n", ms, tone.detentsToTarget);
+    if (ms >= TONE.slowMs) CHECK_EQ(tone.detentsToTarget, 3900);
+    else CHECK(tone.detentsToTarget > 0 && tone.detentsToTarget < 3900);
+  }
+  CHECK(play(spin(1000, 4000, 15, 1), TONE, 100, 100, 4000, 4000).detentsToTarget <= 100);
+
+  Played pwm = play(spin(1000, 400, 15, 1), PWM, 0, 0, 255, 255);
+  Played servo = play(spin(1000, 400, 15, 1), SERVO, 0, 0, 180, 180);
+  printf("  pwm 0-255: %d detents, servo 0-180: %d detents (at 15 ms)\n", pwm.detentsToTarget,
+         servo.detentsToTarget);
+  CHECK(pwm.detentsToTarget > 0 && pwm.detentsToTarget <= 60);
+  CHECK(servo.detentsToTarget > 0 && servo.detentsToTarget <= 60);
+  CHECK(pwm.maxMultiplier > 1 && pwm.maxMultiplier <= PWM.maxStep);
+}
+
+static void testFineAdjustment() {
+  Trace sweep = spin(1000, 40, 12, 1);
+  int32_t swept = play(sweep, TONE, 100, 100, 4000).value;
+  CHECK(swept > 100 + 40);
+
+  // Pause, then one detent back: exactly one step
+  Trace back = join(sweep, spin(sweep.back().ms + 400, 1, 0, -1));
+  CHECK_EQ(swept - play(back, TONE, 100, 100, 4000).value, 1);
+
+  // Reverse straight away: a change of direction also starts at 1:1
+  Trace reverse = join(sweep, spin(sweep.back().ms + 12, 1, 0, -1));
+  CHECK_EQ(swept - play(reverse, TONE, 100, 100, 4000).value, 1);
+
+  // Slow turning never accelerates, even on the steepest profile
+  Played slow = play(spin(1000, 20, 100, 1), TONE, 1000, 100, 4000);
+  CHECK_EQ(slow.value, 1020);
+  CHECK_EQ(slow.maxMultiplier, 1);
+}
+
+static void testPartialDetents() {
+  // Contact jitter around a detent: half-detent counts never make a step
+  EncoderInput input;
+  int32_t total = 0;
+  int64_t count = 0;
+  for (int i = 0; i < 50; i++) {
+    count += (i & 1) ? -1 : 1;
+    total += input.update(count, 1000 + i * 5, TONE);
+  }
+  CHECK_EQ(total, 0);
+
+  // Two halves read in separate passes make one detent
+  EncoderInput halves;
+  CHECK_EQ(halves.update(1, 1000, ENCODER_LINEAR), 0);
+  CHECK_EQ(halves.update(2, 1005, ENCODER_LINEAR), 1);
+}
+
+static void testMenuWrap() {
+  // Menus use the linear profile: speed does not matter, the index wraps
+  Played menu = play(spin(1000, 13, 5, -1), ENCODER_LINEAR, 0, -1000, 1000);
+  CHECK_EQ(menu.value, -13);
+  CHECK_EQ(stepWrapped(0, menu.value, 10), 7);
+  CHECK_EQ(stepWrapped(9, 1, 10), 0);
+  CHECK_EQ(stepClamped(178, 5, 0, 180), 180);
+  CHECK_EQ(stepClamped(2, -5, 0, 180), 0);
+}
+
+int main() {
+  testFullRangeSweeps();
+  testFineAdjustment();
+  testPartialDetents();
+  testMenuWrap();
+  return testSummary("encoder_input");
+}
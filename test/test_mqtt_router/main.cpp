@@ -0,0 +1,132 @@
+/*
+ * ESP32 Multitool - MQTT Router Replay Test
+ * Replays recorded topic/payload pairs through mqttRouteMessage() and
+ * checks the typed command and the <device>/state acknowledgement
+ */
+
+#include <strings.h>
+#include "mqtt_router.h"
+#include "test_support.h"
+
+// Same table as neopixel_effects.h, which needs the RMT driver
+static const char* const EFFECT_NAMES[] = {
+  "off", "solid", "rainbow", "chase", "breathe", "fire", "gradient", "vu"
+};
+const uint8_t EFFECT_COUNT = sizeof(EFFECT_NAMES) / sizeof(EFFECT_NAMES[0]);
+
+const char* ledEffectName(uint8_t effect) {
+  return effect < EFFECT_COUNT ? EFFECT_NAMES[effect] : "unknown";
+}
+
+int ledEffectFromName(const char* name, size_t len) {
+  for (uint8_t i = 0; i < EFFECT_COUNT; i++) {
+    if (strlen(EFFECT_NAMES[i]) == len && strncasecmp(name, EFFECT_NAMES[i], len) == 0) return i;
+  }
+  return -1;
+}
+
+struct Recorded {
+  const char* topic;
+  const char* payload;
+  RouteResult result;
+  ActuatorDevice device;
+  int32_t value;
+  int32_t arg;
+  const char* state;   // Acknowledgement payload when OK
+};
+
+// Recorded topic/payload pairs and the command each must produce
+static const Recorded RECORDED[] = {
+  {"esp32/multitool/relay", "ON", RouteResult::OK, ActuatorDevice::RELAY, 1, 0, "ON"},
+  {"esp32/multitool/relay", "off", RouteResult::OK, ActuatorDevice::RELAY, 0, 0, "OFF"},
+  {"esp32/multitool/relay/set", "1", RouteResult::OK, ActuatorDevice::RELAY, 1, 0, "ON"},
+  {"esp32/multitool/relay/set", "toggle", RouteResult::OK, ActuatorDevice::RELAY, RELAY_TOGGLE, 0, "ON"},
+  {"esp32/multitool/relay/set", "ONX", RouteResult::BAD_PAYLOAD},
+  {"esp32/multitool/pwm/set", " 55 ", RouteResult::OK, ActuatorDevice::PWM, 55, 0, "55"},
+  {"esp32/multitool/pwm/set", "101", RouteResult::BAD_PAYLOAD},
+  {"esp32/multitool/pwm/set", "", RouteResult::BAD_PAYLOAD},
+  {"esp32/multitool/servo/set", "180", RouteResult::OK, ActuatorDevice::SERVO, 180, 0, "180"},
+  {"esp32/multitool/servo/set", "-1", RouteResult::BAD_PAYLOAD},
+  {"esp32/multitool/stepper/set", "-400,80", RouteResult::OK, ActuatorDevice::STEPPER, -400, 80, "-400,80"},
+  {"esp32/multitool/stepper/set", "200", RouteResult::OK, ActuatorDevice::STEPPER, 200, 50, "200,50"},
+  {"esp32/multitool/stepper/set", "200,", RouteResult::BAD_PAYLOAD},
+  {"esp32/multitool/stepper/set", "200,0", RouteResult::BAD_PAYLOAD},
+  {"esp32/multitool/neopixel/set", "#ff8000", RouteResult::OK, ActuatorDevice::NEOPIXEL, 0xFF8000, 1, "solid,#FF8000"},
+  {"esp32/multitool/neopixel/set", "Rainbow", RouteResult::OK, ActuatorDevice::NEOPIXEL, -1, 2, "rainbow"},
+  {"esp32/multitool/neopixel/set", "chase,#0000ff", RouteResult::OK, ActuatorDevice::NEOPIXEL, 0x0000FF, 3, "chase,#0000FF"},
+  {"esp32/multitool/neopixel/set", "off", RouteResult::OK, ActuatorDevice::NEOPIXEL, -1, 0, "off"},
+  {"esp32/multitool/neopixel/set", "#ff80", RouteResult::BAD_PAYLOAD},
+  {"esp32/multitool/neopixel/set", "sparkle", RouteResult::BAD_PAYLOAD},
+  {"esp32/multitool/tone/set", "440,500", RouteResult::OK, ActuatorDevice::TONE, 440, 500, "440,500"},
+  {"esp32/multitool/tone/set", "1000", RouteResult::OK, ActuatorDevice::TONE, 1000, 0, "1000,0"},
+  {"esp32/multitool/tone/set", "OFF", RouteResult::OK, ActuatorDevice::TONE, 0, 0, "OFF"},
+  {"esp32/multitool/tone/set", "50", RouteResult::BAD_PAYLOAD},
+  {"esp32/multitool/tone/set", "99999999999", RouteResult::BAD_PAYLOAD},
+  {"esp32/multitool/foo/set", "1", RouteResult::UNKNOWN_DEVICE},
+  {"esp32/multitool/Relay/set", "1", RouteResult::UNKNOWN_DEVICE},
+  {"esp32/multitool/telemetry", "{}", RouteResult::NOT_A_COMMAND},
+  {"esp32/multitool/relay/state", "ON", RouteResult::NOT_A_COMMAND},
+  {"esp32/multitool/set", "1", RouteResult::NOT_A_COMMAND},
+  {"homeassistant/status", "online", RouteResult::NOT_A_COMMAND},
+};
+
+static void testRecorded() {
+  for (const Recorded& rec : RECORDED) {
+    ActuatorCommand cmd;
+    RouteResult result = mqttRouteMessage(rec.topic, (const uint8_t*)rec.payload,
+                                          strlen(rec.payload), cmd);
+    if (result != rec.result) {
+      fprintf(stderr, "%s \"%s\": %s, expected %s\n", rec.topic, rec.payload,
+              routeResultName(result), routeResultName(rec.result));
+      testFailures++;
+      continue;
+    }
+    if (result != RouteResult::OK) continue;
+
+    CHECK_EQ(cmd.device, rec.device);
+    CHECK_EQ(cmd.value, rec.value);
+    CHECK_EQ(cmd.arg, rec.arg);
+
+    // Toggle is acknowledged with the resolved level
+    if (cmd.device == ActuatorDevice::RELAY && cmd.value == RELAY_TOGGLE) cmd.value = 1;
+    char topic[48];
+    char state[32];
+    mqttStateTopic(cmd.device, topic, sizeof(topic));
+    mqttFormatState(cmd, state, sizeof(state));
+    CHECK(strncmp(topic, "esp32/multitool/", 16) == 0);
+    CHECK(strcmp(topic + strlen(topic) - 6, "/state") == 0);
+    if (strcmp(state, rec.state) != 0) {
+      fprintf(stderr, "%s \"%s\": state \"%s\", expected \"%s\"\n", rec.topic, rec.payload,
+              state, rec.state);
+      testFailures++;
+    }
+  }
+}
+
+static void testBounds() {
+  ActuatorCommand cmd;
+
+  // Payload is not NUL-terminated: only the given length is parsed
+  const uint8_t digits[] = {'5', '0', '9', '9'};
+  CHECK(mqttRouteMessage("esp32/multitool/pwm/set", digits, 2, cmd) == RouteResult::OK);
+  CHECK_EQ(cmd.value, 50);
+
+  static uint8_t oversized[1000];
+  memset(oversized, '1', sizeof(oversized));
+  CHECK(mqttRouteMessage("esp32/multitool/pwm/set", oversized, sizeof(oversized), cmd) ==
+        RouteResult::PAYLOAD_TOO_LONG);
+  CHECK(mqttRouteMessage("esp32/multitool/pwm/set", oversized, RouterConfig::MAX_PAYLOAD, cmd) ==
+        RouteResult::BAD_PAYLOAD);
+
+  // State never overruns a short buffer
+  char small[4];
+  cmd = {ActuatorDevice::STEPPER, -100000, 100};
+  mqttFormatState(cmd, small, sizeof(small));
+  CHECK_EQ(strlen(small), 3);
+}
+
+int main() {
+  testRecorded();
+  testBounds();
+  return testSummary("mqtt_router");
+}
@@ -0,0 +1,270 @@
+/*
+ * ESP32 Multitool - Delta OTA Test
+ * Builds patches with tools/ota_tool.py diff and applies them through
+ * DeltaPatcher in upload-sized and odd chunks, plus damaged patches.
+ * Run from test/ (make -C test); scratch files go to build/ota_delta/.
+ */
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include "ota_delta.h"
+#include "test_support.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+const char* const WORK_DIR = "build/ota_delta";
+const uint32_t SLOT_SIZE = 0x20000;        // Running partition, larger than the image
+const size_t CHUNKS[] = { 1, 7, 64, 1436, 0 };   // 0 = whole patch in one feed()
+
+// --- FIXTURES ---
+
+static Bytes randomImage(size_t len, uint32_t seed) {
+  Bytes image(len);
+  for (size_t i = 0; i < len; i++) {
+    seed = seed * 1664525 + 1013904223;
+    image[i] = (uint8_t)(seed >> 24);
+  }
+  image[0] = 0xE9;   // App image magic, as the tool expects of real firmware
+  return image;
+}
+
+/**
+ * The next release: relocated constants, an inserted function, a removed
+ * one and a longer tail
+ */
+static Bytes nextRelease(const Bytes& old) {
+  Bytes image(old.begin(), old.begin() + 12000);
+  for (size_t i = 200; i < image.size(); i += 997) image[i] ^= 0x40;
+  Bytes inserted = randomImage(600, 7);
+  image.insert(image.end(), inserted.begin(), inserted.end());
+  image.insert(image.end(), old.begin() + 12000, old.begin() + 30000);
+  image.insert(image.end(), old.begin() + 30900, old.end());
+  Bytes tail = randomImage(2048, 9);
+  image.insert(image.end(), tail.begin(), tail.end());
+  return image;
+}
+
+static bool writeFile(const std::string& path, const Bytes& data) {
+  FILE* f = fopen(path.c_str(), "wb");
+  if (f == nullptr) return false;
+  bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+  return fclose(f) == 0 && ok;
+}
+
+static Bytes readFile(const std::string& path) {
+  Bytes data;
+  FILE* f = fopen(path.c_str(), "rb");
+  if (f == nullptr) return data;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+  fclose(f);
+  return data;
+}
+
+/**
+ * Run the host tool on old -> new and return the uncompressed patch
+ */
+static Bytes makePatch(const char* name, const Bytes& old, const Bytes& next) {
+  std::string base = std::string(WORK_DIR) + "/" + name;
+  if (!writeFile(base + ".old.bin", old) || !writeFile(base + ".new.bin", next)) return Bytes();
+  std::string command = "python3 ../tools/ota_tool.py diff --no-gzip " + base + ".old.bin " +
+                        base + ".new.bin -o " + base + ".patch > /dev/null";
+  if (system(command.c_str()) != 0) return Bytes();
+  return readFile(base + ".patch");
+}
+
+// --- RUNNING THE PATCHER ---
+
+struct Slot {
+  Bytes data;
+  esp_partition_t partition;
+};
+
+static void flashRunning(Slot& slot, const Bytes& image) {
+  slot.data.assign(SLOT_SIZE, 0xFF);
+  std::copy(image.begin(), image.end(), slot.data.begin());
+  slot.partition = {};
+  slot.partition.address = 0x10000;
+  slot.partition.size = SLOT_SIZE;
+  strcpy(slot.partition.label, "app0");
+  slot.partition.hostData = slot.data.data();
+  hostRunningPartition = &slot.partition;
+}
+
+static bool appendSink(const uint8_t* data, size_t len, void* context) {
+  Bytes* out = static_cast<Bytes*>(context);
+  out->insert(out->end(), data, data + len);
+  return true;
+}
+
+struct Applied {
+  bool fed;          // Every feed() returned true
+  bool finished;
+  std::string error;
+  Bytes image;
+  uint32_t newSize;
+  bool hashOk;       // newHash() matches the rebuilt image
+};
+
+static Applied apply(const Bytes& patch, size_t chunk) {
+  Applied result = {};
+  DeltaPatcher patcher;
+  result.fed = patcher.begin(appendSink, &result.image);
+  if (chunk == 0) chunk = patch.size();
+  for (size_t pos = 0; pos < patch.size() && result.fed; pos += chunk) {
+    size_t take = patch.size() - pos < chunk ? patch.size() - pos : chunk;
+    result.fed = patcher.feed(patch.data() + pos, take);
+  }
+  patcher.end();
+  result.finished = patcher.finished();
+  result.error = patcher.error();
+  result.newSize = patcher.newSize();
+
+  uint8_t digest[32];
+  mbedtls_sha256_context sha;
+  mbedtls_sha256_init(&sha);
+  mbedtls_sha256_starts(&sha, 0);
+  mbedtls_sha256_update(&sha, result.image.data(), result.image.size());
+  mbedtls_sha256_finish(&sha, digest);
+  result.hashOk = result.finished && memcmp(digest, patcher.newHash(), sizeof(digest)) == 0;
+  return result;
+}
+
+static void putU32(Bytes& data, size_t offset, uint32_t value) {
+  for (int i = 0; i < 4; i++) data[offset + i] = (uint8_t)(value >> (8 * i));
+}
+
+// --- TESTS ---
+
+static void testRoundTrips(const Bytes& old, Slot& slot) {
+  struct Case {
+    const char* name;
+    Bytes image;
+  };
+  const Case cases[] = {
+    { "release", nextRelease(old) },
+    { "same", old },
+    { "shrink", Bytes(old.begin(), old.begin() + old.size() / 2) },
+    { "unrelated", randomImage(20000, 1234) },
+  };
+
+  for (const Case& c : cases) {
+    Bytes patch = makePatch(c.name, old, c.image);
+    CHECK(patch.size() > DeltaConfig::HEADER_SIZE);
+    CHECK(deltaIsPatch(patch.data(), patch.size()));
+    flashRunning(slot, old);
+
+    for (size_t chunk : CHUNKS) {
+      Applied result = apply(patch, chunk);
+      if (!result.fed || !result.finished || result.image != c.image) {
+        fprintf(stderr, "  %s at %zu-byte chunks: %s\n", c.name, chunk, result.error.c_str());
+      }
+      CHECK(result.fed);
+      CHECK(result.finished);
+      CHECK(result.image == c.image);
+      CHECK_EQ(result.newSize, c.image.size());
+      CHECK(result.hashOk);
+    }
+    printf("  %-9s %6zu -> %6zu bytes, patch %6zu bytes\n", c.name, old.size(), c.image.size(), patch.size());
+  }
+}
+
+static void testDamagedPatches(const Bytes& old, Slot& slot) {
+  const Bytes next = nextRelease(old);
+  const Bytes patch = makePatch("release", old, next);
+  const size_t firstRecord = DeltaConfig::HEADER_SIZE;
+  flashRunning(slot, old);
+
+  for (size_t chunk : CHUNKS) {
+    // Upload cut short, in the header and in the last record
+    Applied cut = apply(Bytes(patch.begin(), patch.begin() + 40), chunk);
+    CHECK(cut.fed && !cut.finished);
+    CHECK(cut.error == "Truncated patch");
+    cut = apply(Bytes(patch.begin(), patch.end() - 1), chunk);
+    CHECK(cut.fed && !cut.finished);
+    CHECK(cut.error == "Truncated patch");
+    CHECK(cut.image.size() == next.size() - 1);
+
+    // A record claiming more bytes than the new image has
+    Bytes overrun = patch;
+    putU32(overrun, firstRecord, (uint32_t)next.size() + 1);
+    Applied result = apply(overrun, chunk);
+    CHECK(!result.fed);
+    CHECK(result.error == "Patch overruns new image");
+    CHECK(result.image.empty());
+
+    // Diff bytes that would read past the old image (the new image is longer)
+    Bytes pastOld = patch;
+    putU32(pastOld, firstRecord, (uint32_t)old.size() + 1);
+    putU32(pastOld, firstRecord + 4, 0);
+    result = apply(pastOld, chunk);
+    CHECK(!result.fed);
+    CHECK(result.error == "Patch reads past old image");
+
+    // A seek beyond the end of the old image
+    Bytes seek = patch;
+    putU32(seek, firstRecord, 0);
+    putU32(seek, firstRecord + 4, 0);
+    putU32(seek, firstRecord + 8, (uint32_t)old.size() + 1);
+    result = apply(seek, chunk);
+    CHECK(!result.fed);
+    CHECK(result.error == "Patch seeks outside old image");
+
+    // Extra bytes after the last record
+    Bytes trailing = patch;
+    trailing.push_back(0);
+    result = apply(trailing, chunk);
+    CHECK(!result.fed);
+    CHECK(result.error == "Data after end of patch");
+    CHECK(result.image == next);
+
+    // Unknown format version
+    Bytes version = patch;
+    version[4] = 2;
+    result = apply(version, chunk);
+    CHECK(!result.fed);
+    CHECK(result.error == "Unsupported patch version");
+  }
+}
+
+static void testWrongBase(const Bytes& old, Slot& slot) {
+  const Bytes next = nextRelease(old);
+  const Bytes patch = makePatch("release", old, next);
+
+  // Same size, one byte different: only the hash can tell
+  Bytes other = old;
+  other[old.size() / 2] ^= 1;
+  flashRunning(slot, other);
+  for (size_t chunk : CHUNKS) {
+    Applied result = apply(patch, chunk);
+    CHECK(!result.fed);
+    CHECK(result.error == "Patch was made for different firmware");
+    CHECK(result.image.empty());
+  }
+
+  // A slot smaller than the image the patch expects
+  flashRunning(slot, old);
+  slot.partition.size = (uint32_t)old.size() - 1;
+  Applied result = apply(patch, 0);
+  CHECK(!result.fed);
+  CHECK(result.error == "Patch is for a larger image");
+
+  // No running partition at all
+  hostRunningPartition = nullptr;
+  result = apply(patch, 0);
+  CHECK(!result.fed);
+  CHECK(result.error == "Patch is for a larger image");
+}
+
+int main() {
+  if (system((std::string("mkdir -p ") + WORK_DIR).c_str()) != 0) return 1;
+  const Bytes old = randomImage(48 * 1024, 42);
+  Slot slot;
+
+  testRoundTrips(old, slot);
+  testDamagedPatches(old, slot);
+  testWrongBase(old, slot);
+  return testSummary("ota_delta");
+}
@@ -0,0 +1,255 @@
+/*
+ * ESP32 Multitool - gzip OTA Test
+ * Compresses a synthetic image with tools/ota_tool.py compress, adds the
+ * optional gzip header fields other tools write, and inflates the result
+ * through GzipInflater in 1-byte, odd and upload-sized chunks, plus
+ * damaged and truncated files.
+ * Run from test/ (make -C test); scratch files go to build/ota_gzip/.
+ */
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include "ota_gzip.h"
+#include "test_support.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+const char* const WORK_DIR = "build/ota_gzip";
+const size_t CHUNKS[] = { 1, 3, 1435, 1436, 0 };   // 0 = whole file in one feed()
+
+// --- FIXTURES ---
+
+/**
+ * Firmware-like data: random runs mixed with copies from up to 32 KB back,
+ * long enough for the inflater's window to wrap several times
+ */
+static Bytes makeImage(size_t len) {
+  Bytes image;
+  uint32_t seed = 42;
+  auto next = [&seed]() {
+    seed = seed * 1664525 + 1013904223;
+    return seed >> 8;
+  };
+  image.push_back(0xE9);
+  while (image.size() < len) {
+    if (image.size() < 1024 || next() % 3 == 0) {
+      for (int i = 0; i < 48; i++) image.push_back((uint8_t)next());
+    } else {
+      size_t distance = 1 + next() % (image.size() < 32768 ? image.size() : 32768);
+      size_t run = 16 + next() % 240;
+      size_t from = image.size() - distance;
+      for (size_t i = 0; i < run; i++) image.push_back(image[from + i]);
+    }
+  }
+  image.resize(len);
+  return image;
+}
+
+static bool writeFile(const std::string& path, const Bytes& data) {
+  FILE* f = fopen(path.c_str(), "wb");
+  if (f == nullptr) return false;
+  bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+  return fclose(f) == 0 && ok;
+}
+
+static Bytes readFile(const std::string& path) {
+  Bytes data;
+  FILE* f = fopen(path.c_str(), "rb");
+  if (f == nullptr) return data;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+  fclose(f);
+  return data;
+}
+
+/**
+ * Run the host tool on an image and return the .bin.gz
+ */
+static Bytes compress(const char* name, const Bytes& image) {
+  std::string base = std::string(WORK_DIR) + "/" + name;
+  if (!writeFile(base + ".bin", image)) return Bytes();
+  std::string command = "python3 ../tools/ota_tool.py compress " + base + ".bin -o " + base + ".bin.gz > /dev/null";
+  if (system(command.c_str()) != 0) return Bytes();
+  return readFile(base + ".bin.gz");
+}
+
+/**
+ * Rewrite the tool's plain 10-byte header with the optional fields set
+ * FEXTRA, FNAME, FCOMMENT and FHCRC are written in RFC 1952 order.
+ */
+static Bytes withHeaderFields(const Bytes& gz, uint8_t flags) {
+  Bytes out(gz.begin(), gz.begin() + 10);
+  out[3] = flags;
+  if (flags & GzipConfig::FLAG_EXTRA) {
+    const uint8_t extra[] = { 'A', 'p', 5, 0, 'x', 'y', 'z', 'z', 'y' };
+    out.push_back(sizeof(extra));
+    out.push_back(0);
+    out.insert(out.end(), extra, extra + sizeof(extra));
+  }
+  if (flags & GzipConfig::FLAG_NAME) {
+    const char name[] = "esp32_swiss_army.ino.bin";
+    out.insert(out.end(), name, name + sizeof(name));
+  }
+  if (flags & GzipConfig::FLAG_COMMENT) {
+    const char comment[] = "release build, gzip -9";
+    out.insert(out.end(), comment, comment + sizeof(comment));
+  }
+  if (flags & GzipConfig::FLAG_HCRC) {
+    uint32_t crc = esp_rom_crc32_le(0, out.data(), out.size());
+    out.push_back((uint8_t)crc);
+    out.push_back((uint8_t)(crc >> 8));
+  }
+  out.insert(out.end(), gz.begin() + 10, gz.end());
+  return out;
+}
+
+// --- RUNNING THE INFLATER ---
+
+static bool appendSink(const uint8_t* data, size_t len, void* context) {
+  Bytes* out = static_cast<Bytes*>(context);
+  out->insert(out->end(), data, data + len);
+  return true;
+}
+
+struct Inflated {
+  bool fed;          // Every feed() returned true
+  bool finished;
+  std::string error;
+  Bytes image;
+  uint32_t outBytes;
+};
+
+static Inflated inflateChunks(const Bytes& gz, size_t chunk) {
+  Inflated result = {};
+  GzipInflater inflater;
+  result.fed = inflater.begin(appendSink, &result.image);
+  if (chunk == 0) chunk = gz.size();
+  for (size_t pos = 0; pos < gz.size() && result.fed; pos += chunk) {
+    size_t take = gz.size() - pos < chunk ? gz.size() - pos : chunk;
+    result.fed = inflater.feed(gz.data() + pos, take);
+  }
+  inflater.end();
+  result.finished = inflater.finished();
+  result.error = inflater.error();
+  result.outBytes = inflater.outBytes();
+  return result;
+}
+
+// --- TESTS ---
+
+static void testHeaders(const Bytes& image, const Bytes& gz) {
+  struct Case {
+    const char* name;
+    uint8_t flags;
+  };
+  const Case cases[] = {
+    { "plain (tool)", 0 },
+    { "FNAME", GzipConfig::FLAG_NAME },
+    { "FNAME+FCOMMENT", GzipConfig::FLAG_NAME | GzipConfig::FLAG_COMMENT },
+    { "FEXTRA", GzipConfig::FLAG_EXTRA },
+    { "FHCRC", GzipConfig::FLAG_HCRC },
+    { "all fields", GzipConfig::FLAG_EXTRA | GzipConfig::FLAG_NAME | GzipConfig::FLAG_COMMENT | GzipConfig::FLAG_HCRC },
+  };
+
+  CHECK(gzipIsCompressed(gz.data(), gz.size()));
+  CHECK_EQ(gz[3], 0);   // The tool writes no optional fields
+
+  for (const Case& c : cases) {
+    Bytes file = withHeaderFields(gz, c.flags);
+    for (size_t chunk : CHUNKS) {
+      Inflated result = inflateChunks(file, chunk);
+      if (!result.fed || !result.finished || result.image != image) {
+        fprintf(stderr, "  %s at %zu-byte chunks: %s\n", c.name, chunk, result.error.c_str());
+      }
+      CHECK(result.fed);
+      CHECK(result.finished);
+      CHECK(result.image == image);
+      CHECK_EQ(result.outBytes, image.size());
+    }
+  }
+  printf("  %zu byte image -> %zu bytes gzip, 6 header variants x 5 chunk sizes\n", image.size(), gz.size());
+}
+
+static void testDamaged(const Bytes& image, const Bytes& gz) {
+  const size_t trailer = gz.size() - 8;
+
+  for (size_t chunk : CHUNKS) {
+    // Trailer CRC and length
+    Bytes crc = gz;
+    crc[trailer] ^= 0x01;
+    Inflated result = inflateChunks(crc, chunk);
+    CHECK(!result.fed && !result.finished);
+    CHECK(result.error == "gzip CRC mismatch");
+    CHECK(result.image == image);   // Caught only at the end; the OTA slot is never activated
+
+    Bytes length = gz;
+    length[trailer + 4] ^= 0x01;
+    result = inflateChunks(length, chunk);
+    CHECK(!result.fed);
+    CHECK(result.error == "gzip length mismatch");
+
+    // A flipped bit inside the deflate stream
+    Bytes body = gz;
+    body[10 + (trailer - 10) / 2] ^= 0x10;
+    result = inflateChunks(body, chunk);
+    CHECK(!result.fed && !result.finished);
+    CHECK(result.error == "Corrupt deflate stream" || result.error == "gzip CRC mismatch" ||
+          result.error == "gzip length mismatch");
+
+    // Upload cut short: in the header, in the deflate stream and in the trailer
+    const size_t cuts[] = { 5, gz.size() / 2, gz.size() - 3 };
+    for (size_t cut : cuts) {
+      result = inflateChunks(Bytes(gz.begin(), gz.begin() + cut), chunk);
+      CHECK(result.fed && !result.finished);
+      CHECK(result.error == "Truncated gzip image");
+    }
+    result = inflateChunks(Bytes(gz.begin(), gz.end() - 3), chunk);
+    CHECK(result.image == image);
+
+    // A name field that never ends
+    Bytes name = withHeaderFields(gz, GzipConfig::FLAG_NAME);
+    name.resize(12);
+    result = inflateChunks(name, chunk);
+    CHECK(result.fed && !result.finished);
+
+    // Bytes after the trailer
+    Bytes trailing = gz;
+    trailing.push_back(0x1F);
+    result = inflateChunks(trailing, chunk);
+    CHECK(!result.fed);
+    CHECK(result.error == "Data after gzip trailer");
+    CHECK(result.image == image);
+  }
+
+  // Not gzip at all, or not deflate
+  Inflated result = inflateChunks(image, 1436);
+  CHECK(!result.fed);
+  CHECK(result.error == "Not a gzip/deflate image");
+  Bytes method = gz;
+  method[2] = 7;
+  result = inflateChunks(method, 1436);
+  CHECK(!result.fed);
+  CHECK(result.error == "Not a gzip/deflate image");
+}
+
+static void testSinkFailure(const Bytes& gz) {
+  GzipInflater inflater;
+  CHECK(inflater.begin([](const uint8_t*, size_t, void*) { return false; }, nullptr));
+  CHECK(!inflater.feed(gz.data(), gz.size()));
+  CHECK(strcmp(inflater.error(), "Write failed") == 0);
+  inflater.end();
+}
+
+int main() {
+  if (system((std::string("mkdir -p ") + WORK_DIR).c_str()) != 0) return 1;
+  const Bytes image = makeImage(200 * 1024);
+  const Bytes gz = compress("image", image);
+  CHECK(gz.size() > 18 && gz.size() < image.size());
+
+  testHeaders(image, gz);
+  testDamaged(image, gz);
+  testSinkFailure(gz);
+  return testSummary("ota_gzip");
+}
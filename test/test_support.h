@@ -0,0 +1,38 @@
+/*
+ * ESP32 Multitool - Host Test Support
+ * Minimal check macros for the programs under test/
+ */
+
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+#include <stdio.h>
+
+inline int testFailures = 0;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { \
+    fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+    testFailures++; \
+  } \
+} while (0)
+
+#define CHECK_EQ(actual, expected) do { \
+  long long a_ = (long long)(actual), e_ = (long long)(expected); \
+  if (a_ != e_) { \
+    fprintf(stderr, "%s:%d: CHECK_EQ failed: %s = %lld, expected %lld\n", \
+            __FILE__, __LINE__, #actual, a_, e_); \
+    testFailures++; \
+  } \
+} while (0)
+
+/**
+ * Print the result line and return the process exit code
+ */
+inline int testSummary(const char* name) {
+  if (testFailures == 0) printf("%s: ok\n", name);
+  else printf("%s: %d check(s) failed\n", name, testFailures);
+  return testFailures == 0 ? 0 : 1;
+}
+
+#endif
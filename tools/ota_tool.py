@@ -0,0 +1,480 @@
+#!/usr/bin/env python3
+"""
+ESP32 Multitool - OTA image tool
+
+  compress   firmware.bin [-o firmware.bin.gz]    gzip an image for /update
+  verify     firmware.bin.gz [--sha256 HEX]       inflate like the device does and check it
+  diff       old.bin new.bin [-o new.patch]       delta patch against the running image
+  apply      old.bin new.patch [-o out.bin]       rebuild the image the way the device does
+  upload     HOST firmware.bin[.gz] -u USER -p PASS   POST to /update with the image SHA-256
+  manifest   firmware.bin[.gz|.patch] --version V   write manifest.json for pull updates
+  serve      [DIR] [--port 8000] [--drop-after N]   local update server with Range support
+
+The SHA-256 always refers to the uncompressed image, which is what the
+device hashes while it writes the OTA slot. Patches are gzipped by default
+and carry the old and new image digests in their header (see ota_delta.h).
+"""
+
+import argparse
+import base64
+import gzip
+import hashlib
+import http.server
+import io
+import os
+import json
+import struct
+import sys
+import time
+import urllib.error
+import urllib.request
+import zlib
+
+IMAGE_MAGIC = 0xE9          # First byte of every ESP32 app image
+UPLOAD_CHUNK = 1436         # HTTP_UPLOAD_BUFLEN on the device
+WINDOW_BITS = 15            # 32 KB window, same as the on-device inflater
+
+DELTA_MAGIC = b"MTDP"
+DELTA_VERSION = 1
+DELTA_HEADER = struct.Struct("<4sB3xI32sI32s")   # 80 bytes
+DELTA_RECORD = struct.Struct("<IIi")             # diffLen, extraLen, seek
+DELTA_BLOCK = 1024          # Old-image read size on the device
+MATCH_KEY = 16              # Shortest exact match worth a record
+INDEX_STEP = 4              # Old image is indexed every INDEX_STEP bytes
+
+
+def read(path):
+    with open(path, "rb") as f:
+        return f.read()
+
+
+def image_of(data):
+    """Return the uncompressed image for a .bin, .bin.gz or patch payload."""
+    if data[:2] == b"\x1f\x8b":
+        data = inflate_streaming(data)
+    if data[:4] == DELTA_MAGIC:
+        # The header carries the rebuilt image's digest; the image itself is not needed
+        return None
+    return data
+
+
+def inflate_streaming(data):
+    """Inflate in upload-sized chunks with a 32 KB window, as the device does."""
+    inflater = zlib.decompressobj(16 + WINDOW_BITS)
+    out = bytearray()
+    for i in range(0, len(data), UPLOAD_CHUNK):
+        out += inflater.decompress(data[i:i + UPLOAD_CHUNK])
+    out += inflater.flush()
+    if not inflater.eof:
+        raise ValueError("truncated gzip stream")
+    if inflater.unused_data:
+        raise ValueError("data after gzip trailer")
+    return bytes(out)
+
+
+def gzip_bytes(data):
+    buf = io.BytesIO()
+    # No file name and mtime 0 keep the output reproducible
+    with gzip.GzipFile(fileobj=buf, mode="wb", compresslevel=9, mtime=0, filename="") as gz:
+        gz.write(data)
+    return buf.getvalue()
+
+
+def match_length(a, ai, b, bi, limit):
+    """Length of the common run of a[ai:] and b[bi:], compared 256 bytes at a time."""
+    n = 0
+    while n < limit:
+        step = min(256, limit - n)
+        if a[ai + n:ai + n + step] == b[bi + n:bi + n + step]:
+            n += step
+            continue
+        while n < limit and a[ai + n] == b[bi + n]:
+            n += 1
+        break
+    return n
+
+
+def extend_approximate(old, op, new, np_, limit):
+    """bsdiff forward extension: keep going while at least half the bytes still match."""
+    score = best = best_len = 0
+    i = 0
+    while i < limit and i - best_len < 256:
+        if old[op + i] == new[np_ + i]:
+            score += 1
+        i += 1
+        if score * 2 - i > best * 2 - best_len:
+            best, best_len = score, i
+    return best_len
+
+
+def make_patch(old, new):
+    """Build an uncompressed patch: header, then (diff, extra, seek) records."""
+    index = {}
+    for i in range(0, len(old) - MATCH_KEY + 1, INDEX_STEP):
+        index.setdefault(old[i:i + MATCH_KEY], i)
+
+    records = []
+    cur_new = cur_old = cur_len = 0     # Current diff region
+    j = 0
+    while j <= len(new) - MATCH_KEY:
+        p = index.get(new[j:j + MATCH_KEY])
+        # Prefer continuing at the old offset implied by the current region
+        predicted = cur_old + (j - cur_new)
+        if predicted + MATCH_KEY <= len(old) and old[predicted:predicted + MATCH_KEY] == new[j:j + MATCH_KEY]:
+            p = predicted
+        if p is None:
+            j += 1
+            continue
+
+        # Grow backwards into bytes that would otherwise be extra
+        region_end = cur_new + cur_len
+        while j > region_end and p > 0 and new[j - 1] == old[p - 1]:
+            j -= 1
+            p -= 1
+
+        length = match_length(new, j, old, p, min(len(new) - j, len(old) - p))
+        length += extend_approximate(old, p + length, new, j + length,
+                                     min(len(new) - j, len(old) - p) - length)
+
+        if j == region_end and p == cur_old + cur_len:
+            cur_len += length       # Contiguous with the current region
+        else:
+            records.append((cur_new, cur_old, cur_len, region_end, j, p - (cur_old + cur_len)))
+            cur_new, cur_old, cur_len = j, p, length
+        j = cur_new + cur_len
+    records.append((cur_new, cur_old, cur_len, cur_new + cur_len, len(new), 0))
+
+    out = bytearray(DELTA_HEADER.pack(DELTA_MAGIC, DELTA_VERSION, len(old), hashlib.sha256(old).digest(),
+                                      len(new), hashlib.sha256(new).digest()))
+    for new_start, old_start, diff_len, extra_start, extra_end, seek in records:
+        out += DELTA_RECORD.pack(diff_len, extra_end - extra_start, seek)
+        out += bytes((new[new_start + k] - old[old_start + k]) & 0xFF for k in range(diff_len))
+        out += new[extra_start:extra_end]
+    return bytes(out)
+
+
+class ChunkReader:
+    """Feeds a (possibly gzipped) patch in upload-sized chunks, like the device sees it."""
+
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+        self.buf = bytearray()
+        self.inflater = zlib.decompressobj(16 + WINDOW_BITS) if data[:2] == b"\x1f\x8b" else None
+
+    def read(self, n):
+        while len(self.buf) < n and self.pos < len(self.data):
+            chunk = self.data[self.pos:self.pos + UPLOAD_CHUNK]
+            self.pos += len(chunk)
+            self.buf += self.inflater.decompress(chunk) if self.inflater else chunk
+        if len(self.buf) < n:
+            raise ValueError("truncated patch")
+        out = bytes(self.buf[:n])
+        del self.buf[:n]
+        return out
+
+    def at_end(self):
+        return not self.buf and self.pos >= len(self.data)
+
+
+def apply_patch(old_file, patch, out):
+    """Apply a patch front to back, reading the old image one block at a time."""
+    reader = ChunkReader(patch)
+    magic, version, old_size, old_hash, new_size, new_hash = DELTA_HEADER.unpack(reader.read(DELTA_HEADER.size))
+    if magic != DELTA_MAGIC or version != DELTA_VERSION:
+        raise ValueError("not a version 1 patch")
+
+    sha = hashlib.sha256()
+    old_file.seek(0)
+    remaining = old_size
+    while remaining:
+        block = old_file.read(min(DELTA_BLOCK, remaining))
+        if not block:
+            raise ValueError("old image shorter than the patch expects")
+        sha.update(block)
+        remaining -= len(block)
+    if sha.digest() != old_hash:
+        raise ValueError("patch was made for different firmware")
+
+    new_sha = hashlib.sha256()
+    old_pos = written = 0
+    while written < new_size:
+        diff_len, extra_len, seek = DELTA_RECORD.unpack(reader.read(DELTA_RECORD.size))
+        if written + diff_len + extra_len > new_size or old_pos + diff_len > old_size:
+            raise ValueError("patch overruns an image")
+        while diff_len:
+            take = min(DELTA_BLOCK, diff_len)
+            old_file.seek(old_pos)
+            block = old_file.read(take)
+            diff = reader.read(take)
+            chunk = bytes((o + d) & 0xFF for o, d in zip(block, diff))
+            out.write(chunk)
+            new_sha.update(chunk)
+            old_pos += take
+            written += take
+            diff_len -= take
+        if extra_len:
+            chunk = reader.read(extra_len)
+            out.write(chunk)
+            new_sha.update(chunk)
+            written += extra_len
+        old_pos += seek
+        if not 0 <= old_pos <= old_size:
+            raise ValueError("patch seeks outside the old image")
+    if not reader.at_end():
+        raise ValueError("data after end of patch")
+    if new_sha.digest() != new_hash:
+        raise ValueError("rebuilt image sha256 mismatch")
+    return new_size, new_hash.hex()
+
+
+def cmd_diff(args):
+    old, new = read(args.old), read(args.new)
+    start = time.perf_counter()
+    raw = make_patch(old, new)
+    patch = raw if args.no_gzip else gzip_bytes(raw)
+    elapsed = time.perf_counter() - start
+
+    out = args.output or args.new + ".patch"
+    with open(out, "wb") as f:
+        f.write(patch)
+    print(f"{out}: {len(patch)} bytes ({100.0 * len(patch) / len(new):.1f}% of the {len(new)} byte image, "
+          f"{len(raw)} uncompressed), built in {elapsed:.1f} s")
+    print(f"sha256 {hashlib.sha256(new).hexdigest()}")
+    return 0
+
+
+def cmd_apply(args):
+    patch = read(args.patch)
+    out_path = args.output or args.patch + ".bin"
+    start = time.perf_counter()
+    try:
+        with open(args.old, "rb") as old_file, open(out_path, "wb") as out:
+            size, digest = apply_patch(old_file, patch, out)
+    except (ValueError, zlib.error, struct.error) as e:
+        print(f"FAIL: {e}")
+        return 1
+    elapsed = time.perf_counter() - start
+    print(f"{out_path}: {size} bytes rebuilt from {len(patch)} byte patch in {elapsed * 1000:.0f} ms "
+          f"({size / 1024 / elapsed:.0f} KB/s on this host)")
+    print(f"sha256 {digest}")
+    print("OK")
+    return 0
+
+
+def cmd_manifest(args):
+    data = read(args.image)
+    image = image_of(data)
+    if image is None:
+        # Digest of the image the patch rebuilds, from its header
+        header = DELTA_HEADER.unpack(inflate_streaming(data)[:DELTA_HEADER.size] if data[:2] == b"\x1f\x8b"
+                                     else data[:DELTA_HEADER.size])
+        digest = header[5].hex()
+    else:
+        digest = hashlib.sha256(image).hexdigest()
+
+    manifest = {
+        "version": args.version,
+        "url": args.url or os.path.basename(args.image),
+        "sha256": digest,
+        "size": len(data),
+    }
+    out = args.output or os.path.join(os.path.dirname(args.image) or ".", "manifest.json")
+    with open(out, "w") as f:
+        json.dump(manifest, f, indent=2)
+        f.write("\n")
+    print(f"{out}: {json.dumps(manifest)}")
+    return 0
+
+
+class UpdateServerHandler(http.server.SimpleHTTPRequestHandler):
+    """Static file server with single-range GETs and optional mid-transfer drops."""
+
+    drop_after = 0      # Close the connection after this many body bytes (0 = never)
+    ranges = True
+
+    def send_head(self):
+        path = self.translate_path(self.path)
+        if os.path.isdir(path) or not os.path.exists(path):
+            return super().send_head()
+
+        size = os.path.getsize(path)
+        start = 0
+        range_header = self.headers.get("Range")
+        if self.ranges and range_header and range_header.startswith("bytes="):
+            start = int(range_header[6:].split("-")[0] or 0)
+            if start >= size:
+                self.send_error(416)
+                return None
+            self.send_response(206)
+            self.send_header("Content-Range", f"bytes {start}-{size - 1}/{size}")
+        else:
+            self.send_response(200)
+        self.send_header("Content-Type", self.guess_type(path))
+        self.send_header("Content-Length", str(size - start))
+        self.send_header("Accept-Ranges", "bytes" if self.ranges else "none")
+        self.end_headers()
+
+        f = open(path, "rb")
+        f.seek(start)
+        return f
+
+    def copyfile(self, source, outputfile):
+        if not self.drop_after:
+            return super().copyfile(source, outputfile)
+        outputfile.write(source.read(self.drop_after))
+        self.log_message("dropping connection after %d bytes", self.drop_after)
+        self.close_connection = True
+
+
+def cmd_serve(args):
+    os.chdir(args.dir)
+    UpdateServerHandler.drop_after = args.drop_after
+    UpdateServerHandler.ranges = not args.no_range
+    server = http.server.ThreadingHTTPServer(("", args.port), UpdateServerHandler)
+    print(f"Serving {os.getcwd()} on port {args.port}"
+          f"{f', dropping after {args.drop_after} bytes' if args.drop_after else ''}"
+          f"{', Range disabled' if args.no_range else ''}")
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+def cmd_compress(args):
+    image = read(args.image)
+    if not image or image[0] != IMAGE_MAGIC:
+        print(f"warning: {args.image} does not start with 0x{IMAGE_MAGIC:02X}", file=sys.stderr)
+
+    packed = gzip_bytes(image)
+
+    out = args.output or args.image + ".gz"
+    with open(out, "wb") as f:
+        f.write(packed)
+
+    print(f"{args.image}: {len(image)} bytes -> {out}: {len(packed)} bytes "
+          f"({100.0 * len(packed) / len(image):.1f}%)")
+    print(f"sha256 {hashlib.sha256(image).hexdigest()}")
+    return 0
+
+
+def cmd_verify(args):
+    data = read(args.image)
+    start = time.perf_counter()
+    try:
+        image = image_of(data)
+    except (ValueError, zlib.error, OSError) as e:
+        print(f"FAIL: {e}")
+        return 1
+    elapsed = time.perf_counter() - start
+    if image is None:
+        print("FAIL: this is a delta patch, check it with 'apply'")
+        return 1
+
+    digest = hashlib.sha256(image).hexdigest()
+    if image is not data:
+        print(f"{len(data)} bytes -> {len(image)} bytes image, inflated in {elapsed * 1000:.1f} ms")
+    else:
+        print(f"{len(image)} bytes image (uncompressed)")
+    print(f"sha256 {digest}")
+    if not image or image[0] != IMAGE_MAGIC:
+        print(f"FAIL: image does not start with 0x{IMAGE_MAGIC:02X}")
+        return 1
+    if args.sha256 and args.sha256.lower() != digest:
+        print("FAIL: sha256 mismatch")
+        return 1
+    print("OK")
+    return 0
+
+
+def cmd_upload(args):
+    data = read(args.image)
+    image = image_of(data)
+    # Patches carry their own digest, which the device checks
+    digest = hashlib.sha256(image).hexdigest() if image is not None else None
+
+    boundary = "----multitool" + hashlib.sha256(data).hexdigest()[:16]
+    body = (f"--{boundary}\r\nContent-Disposition: form-data; name=\"firmware\"; "
+            f"filename=\"firmware.bin\"\r\nContent-Type: application/octet-stream\r\n\r\n").encode()
+    body += data + f"\r\n--{boundary}--\r\n".encode()
+
+    request = urllib.request.Request(f"http://{args.host}/update", data=body, method="POST")
+    request.add_header("Content-Type", f"multipart/form-data; boundary={boundary}")
+    if digest:
+        request.add_header("X-Firmware-SHA256", digest)
+    token = base64.b64encode(f"{args.user}:{args.password}".encode()).decode()
+    request.add_header("Authorization", f"Basic {token}")
+
+    start = time.perf_counter()
+    try:
+        with urllib.request.urlopen(request, timeout=args.timeout) as response:
+            status, text = response.status, response.read().decode(errors="replace")
+    except urllib.error.HTTPError as e:
+        status, text = e.code, e.read().decode(errors="replace")
+    elapsed = time.perf_counter() - start
+
+    print(f"HTTP {status}: {len(data)} bytes in {elapsed:.1f} s "
+          f"({len(data) / 1024 / elapsed:.1f} KB/s from this host)")
+    try:
+        print(json.dumps(json.loads(text), indent=2))
+    except ValueError:
+        print(text)
+    return 0 if status == 200 else 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description="ESP32 Multitool OTA image tool")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    p = sub.add_parser("compress", help="gzip a firmware image")
+    p.add_argument("image")
+    p.add_argument("-o", "--output")
+    p.set_defaults(func=cmd_compress)
+
+    p = sub.add_parser("verify", help="check a .bin or .bin.gz the way the device will")
+    p.add_argument("image")
+    p.add_argument("--sha256", help="expected digest of the uncompressed image")
+    p.set_defaults(func=cmd_verify)
+
+    p = sub.add_parser("diff", help="build a delta patch from the running image to a new one")
+    p.add_argument("old", help="image currently on the device")
+    p.add_argument("new")
+    p.add_argument("-o", "--output")
+    p.add_argument("--no-gzip", action="store_true", help="leave the patch uncompressed")
+    p.set_defaults(func=cmd_diff)
+
+    p = sub.add_parser("apply", help="apply a patch like the device does (bounded memory, chunked)")
+    p.add_argument("old")
+    p.add_argument("patch")
+    p.add_argument("-o", "--output")
+    p.set_defaults(func=cmd_apply)
+
+    p = sub.add_parser("upload", help="upload to /update with the expected SHA-256")
+    p.add_argument("host", help="IP or esp32-multitool.local")
+    p.add_argument("image")
+    p.add_argument("-u", "--user", default="admin")
+    p.add_argument("-p", "--password", required=True)
+    p.add_argument("--timeout", type=float, default=300)
+    p.set_defaults(func=cmd_upload)
+
+    p = sub.add_parser("manifest", help="write a pull-update manifest for an image")
+    p.add_argument("image")
+    p.add_argument("--version", required=True, help="version of the new firmware, e.g. 2.6.0")
+    p.add_argument("--url", help="image URL in the manifest (default: file name, relative)")
+    p.add_argument("-o", "--output")
+    p.set_defaults(func=cmd_manifest)
+
+    p = sub.add_parser("serve", help="serve a directory as a local update server")
+    p.add_argument("dir", nargs="?", default=".")
+    p.add_argument("--port", type=int, default=8000)
+    p.add_argument("--drop-after", type=int, default=0, help="cut every transfer after N bytes to test resume")
+    p.add_argument("--no-range", action="store_true", help="ignore Range headers (full resend on resume)")
+    p.set_defaults(func=cmd_serve)
+
+    args = parser.parse_args()
+    return args.func(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -9,12 +9,10 @@
 #include <WebServer.h>
 #include <ArduinoJson.h>
 #include <Update.h>
+#include "rate_limiter.h"
 
 // Forward declarations from main sketch
 extern WebServer server;
-extern char www_username[];
-extern char www_password[];
-extern char ota_password[];
 extern SemaphoreHandle_t stateMutex;
 extern SharedState sharedState;
 extern Preferences preferences;
@@ -26,19 +24,13 @@ struct I2CDevice {
 };
 std::vector<I2CDevice> i2cDevices;
 
-// Servo and PWM state
-int currentServoAngle = 90;
-int currentPWMValue = 0;
-
 /**
  * API: Get system status
  * GET /api/status
  * Returns: JSON with relay, sensor, WiFi, heap info
  */
 void handleAPIStatus() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
-  }
+  if (!requireAuth()) return;
 
   StaticJsonDocument<512> doc;
 
@@ -48,14 +40,14 @@ void handleAPIStatus() {
     doc["sensor"] = sharedState.sensorValue;
     doc["clients"] = sharedState.wifiClients;
     doc["ip"] = sharedState.ipAddress;
+    doc["pwm"] = sharedState.pwmPercent;
+    doc["servo"] = sharedState.servoAngle;
     xSemaphoreGive(stateMutex);
   }
 
   doc["heap"] = ESP.getFreeHeap();
   doc["uptime"] = millis();
   doc["rssi"] = WiFi.RSSI();
-  doc["pwm"] = currentPWMValue;
-  doc["servo"] = currentServoAngle;
 
   String response;
   serializeJson(doc, response);
@@ -68,9 +60,7 @@ void handleAPIStatus() {
  * Body: {"state": true/false}
  */
 void handleAPIRelay() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
-  }
+  if (!requireAuth()) return;
 
   if (server.method() != HTTP_POST) {
     server.send(405, F("text/plain"), F("Method Not Allowed"));
@@ -90,6 +80,7 @@ void handleAPIRelay() {
   if (xSemaphoreTake(stateMutex, pdMS_TO_TICKS(100))) {
     sharedState.relayState = state;
     xSemaphoreGive(stateMutex);
+    systemEvents.signal(EventTask::LOOP, EVENT_COMMAND);
   }
 
   server.send(200, F("application/json"), F("{\"status\":\"ok\"}"));
@@ -101,9 +92,7 @@ void handleAPIRelay() {
  * Body: {"value": 0-100}
  */
 void handleAPIPWM() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
-  }
+  if (!requireAuth()) return;
 
   if (server.method() != HTTP_POST) {
     server.send(405, F("text/plain"), F("Method Not Allowed"));
@@ -120,7 +109,6 @@ void handleAPIPWM() {
 
   int value = doc["value"] | 0;
   value = constrain(value, 0, 100);
-  currentPWMValue = value;
 
   // Convert 0-100% to 0-255 PWM value with gamma correction
   extern uint8_t gammaCorrect(uint8_t brightness);
@@ -130,6 +118,11 @@ void handleAPIPWM() {
   extern const uint8_t PWM_MOSFET;
   ledcWrite(Pins::PWM_MOSFET, corrected);
 
+  if (xSemaphoreTake(stateMutex, pdMS_TO_TICKS(100))) {
+    sharedState.pwmPercent = (uint8_t)value;
+    xSemaphoreGive(stateMutex);
+  }
+
   server.send(200, F("application/json"), F("{\"status\":\"ok\"}"));
 }
 
@@ -139,9 +132,7 @@ void handleAPIPWM() {
  * Body: {"angle": 0-180}
  */
 void handleAPIServo() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
-  }
+  if (!requireAuth()) return;
 
   if (server.method() != HTTP_POST) {
     server.send(405, F("text/plain"), F("Method Not Allowed"));
@@ -158,30 +149,192 @@ void handleAPIServo() {
 
   int angle = doc["angle"] | 90;
   angle = constrain(angle, 0, 180);
-  currentServoAngle = angle;
 
   extern Servo myServo;
 
-  static bool servoAttached = false;
-  if (!servoAttached) {
+  if (!myServo.attached()) {
     myServo.attach(Pins::SERVO);
-    servoAttached = true;
   }
 
   myServo.write(angle);
 
+  if (xSemaphoreTake(stateMutex, pdMS_TO_TICKS(100))) {
+    sharedState.servoAngle = (uint8_t)angle;
+    xSemaphoreGive(stateMutex);
+  }
+
   server.send(200, F("application/json"), F("{\"status\":\"ok\"}"));
 }
 
+/**
+ * Parse "#RRGGBB" / "RRGGBB"
+ * @return Colour, or -1 if malformed
+ */
+static int32_t parseHexColor(const char* text) {
+  if (text == nullptr) return -1;
+  if (*text == '#') text++;
+  if (strlen(text) != 6) return -1;
+  char* end;
+  long color = strtol(text, &end, 16);
+  return *end == '\0' ? (int32_t)color : -1;
+}
+
+/**
+ * API: NeoPixel effects
+ * GET /api/neopixel - current effect, parameters and frame timing
+ * POST /api/neopixel
+ * Body: {"effect": "rainbow", "color": "#FF6000", "color2": "#0040FF", "speed": 1-100,
+ *        "brightness": 0-255, "budget_ma": 0-10000 (0 = no limit)}
+ * All fields are optional; omitted ones keep their current value.
+ */
+void handleAPINeopixel() {
+  if (!requireAuth()) return;
+
+  LedEffectParams params = ledEffects.params();
+
+  if (server.method() == HTTP_POST) {
+    StaticJsonDocument<256> body;
+    if (deserializeJson(body, server.arg("plain"))) {
+      server.send(400, F("application/json"), F("{\"error\":\"Invalid JSON\"}"));
+      return;
+    }
+
+    if (body.containsKey("effect")) {
+      const char* name = body["effect"] | "";
+      int effect = ledEffectFromName(name, strlen(name));
+      if (effect < 0) {
+        server.send(400, F("application/json"), F("{\"error\":\"Unknown effect\"}"));
+        return;
+      }
+      params.effect = (LedEffect)effect;
+    }
+    const char* colorKeys[] = { "color", "color2" };
+    uint32_t* colorFields[] = { &params.color, &params.color2 };
+    for (uint8_t i = 0; i < 2; i++) {
+      if (!body.containsKey(colorKeys[i])) continue;
+      int32_t color = parseHexColor(body[colorKeys[i]]);
+      if (color < 0) {
+        server.send(400, F("application/json"), F("{\"error\":\"Colour must be #RRGGBB\"}"));
+        return;
+      }
+      *colorFields[i] = (uint32_t)color;
+    }
+    if (body.containsKey("speed")) params.speed = constrain((int)body["speed"], 1, 100);
+    if (body.containsKey("brightness")) params.brightness = constrain((int)body["brightness"], 0, 255);
+    if (body.containsKey("budget_ma")) params.budgetMa = constrain((long)body["budget_ma"], 0L, 10000L);
+
+    ledEffects.setParams(params);
+  } else if (server.method() != HTTP_GET) {
+    server.send(405, F("text/plain"), F("Method Not Allowed"));
+    return;
+  }
+
+  StaticJsonDocument<512> doc;
+  char color[8];
+  char color2[8];
+  snprintf(color, sizeof(color), "#%06lX", (unsigned long)params.color);
+  snprintf(color2, sizeof(color2), "#%06lX", (unsigned long)params.color2);
+
+  doc["effect"] = ledEffectName((uint8_t)params.effect);
+  doc["color"] = color;
+  doc["color2"] = color2;
+  doc["speed"] = params.speed;
+  doc["brightness"] = params.brightness;
+  doc["budget_ma"] = params.budgetMa;
+  doc["count"] = ledEffects.count();
+
+  JsonArray effects = doc.createNestedArray("effects");
+  for (uint8_t i = 0; i < (uint8_t)LedEffect::COUNT; i++) {
+    effects.add(LED_EFFECT_NAMES[i]);
+  }
+
+  const LedFrameStats& stats = ledEffects.stats();
+  JsonObject frame = doc.createNestedObject("frame");
+  frame["fps"] = stats.fps;
+  frame["render_us"] = stats.renderUs;
+  frame["render_avg_us"] = stats.renderAvgUs;
+  frame["render_max_us"] = stats.renderMaxUs;
+  frame["wire_us"] = stats.wireUs;
+  frame["period_ms"] = stats.periodMs;
+  frame["estimated_ma"] = stats.estimatedMa;
+  frame["limit_scale"] = stats.limitScale;
+  frame["limited_frames"] = stats.limitedFrames;
+
+  String response;
+  serializeJson(doc, response);
+  server.send(200, F("application/json"), response);
+}
+
+/**
+ * API: LED strip layout
+ * GET /api/neopixel/config - outputs and pixel counts
+ * POST /api/neopixel/config
+ * Body: {"outputs": [{"pin": 15, "count": 300}, {"pin": 16, "count": 300}]}
+ * Saved to NVS and applied live at the next frame.
+ */
+void handleAPINeopixelConfig() {
+  if (!requireAuth()) return;
+
+  if (server.method() == HTTP_POST) {
+    StaticJsonDocument<512> body;
+    if (deserializeJson(body, server.arg("plain"))) {
+      server.send(400, F("application/json"), F("{\"error\":\"Invalid JSON\"}"));
+      return;
+    }
+
+    JsonArray outputs = body["outputs"];
+    LedStripConfig config = {};
+    size_t outputCount = outputs.isNull() ? 0 : outputs.size();
+    config.outputs = outputCount > LED_MAX_OUTPUTS ? LED_MAX_OUTPUTS + 1 : outputCount;  // Too many fails validation
+    for (uint8_t i = 0; i < config.outputs && i < LED_MAX_OUTPUTS; i++) {
+      config.output[i].pin = constrain((int)outputs[i]["pin"], 0, 255);
+      config.output[i].count = constrain((long)outputs[i]["count"], 0L, 65535L);
+    }
+
+    extern const char* validateLedConfig(const LedStripConfig& config);
+    const char* error = validateLedConfig(config);
+    if (error != nullptr) {
+      StaticJsonDocument<96> err;
+      err["error"] = error;
+      String response;
+      serializeJson(err, response);
+      server.send(400, F("application/json"), response);
+      return;
+    }
+
+    extern void saveLedConfig();
+    extern void applyLedConfig();
+    ledStripConfig = config;
+    saveLedConfig();
+    applyLedConfig();
+  } else if (server.method() != HTTP_GET) {
+    server.send(405, F("text/plain"), F("Method Not Allowed"));
+    return;
+  }
+
+  StaticJsonDocument<384> doc;
+  JsonArray outputs = doc.createNestedArray("outputs");
+  for (uint8_t i = 0; i < ledStripConfig.outputs; i++) {
+    JsonObject out = outputs.createNestedObject();
+    out["pin"] = ledStripConfig.output[i].pin;
+    out["count"] = ledStripConfig.output[i].count;
+  }
+  doc["pixels"] = ledStripPixels(ledStripConfig);
+  doc["max_outputs"] = LED_MAX_OUTPUTS;
+  doc["max_pixels"] = LedConfig::MAX_PIXELS;
+
+  String response;
+  serializeJson(doc, response);
+  server.send(200, F("application/json"), response);
+}
+
 /**
  * API: I2C Bus Scanner
  * GET /api/i2c/scan
  * Returns: JSON array of detected devices
  */
 void handleAPIi2cScan() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
-  }
+  if (!requireAuth()) return;
 
   i2cDevices.clear();
 
@@ -219,9 +372,7 @@ void handleAPIi2cScan() {
  * Body: {"current":"...", "newpass":"...", "otapass":"..."}
  */
 void handleAPIPassword() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
-  }
+  if (!requireAuth()) return;
 
   if (server.method() != HTTP_POST) {
     server.send(405, F("text/plain"), F("Method Not Allowed"));
@@ -236,43 +387,56 @@ void handleAPIPassword() {
     return;
   }
 
-  const char* current = doc["current"];
-  const char* newPass = doc["newpass"];
-  const char* otaPass = doc["otapass"];
+  const char* current = doc["current"] | "";
+  const char* newPass = doc["newpass"] | "";
+  const char* otaPass = doc["otapass"] | "";
 
-  // Verify current password
-  if (strcmp(current, www_password) != 0) {
+  // Verify current password (KDF, constant-time compare)
+  if (!credentials.checkPassword(current)) {
     server.send(401, F("text/plain"), F("Current password incorrect"));
     return;
   }
 
   // Validate length
-  if (strlen(newPass) < 8 || strlen(otaPass) < 8) {
-    server.send(400, F("text/plain"), F("Passwords must be at least 8 characters"));
+  if (strlen(newPass) < CredentialConfig::MIN_PASSWORD_LEN || strlen(otaPass) < CredentialConfig::MIN_PASSWORD_LEN ||
+      strlen(newPass) > CredentialConfig::MAX_PASSWORD_LEN || strlen(otaPass) > CredentialConfig::MAX_PASSWORD_LEN) {
+    server.send(400, F("text/plain"), F("Passwords must be 8-63 characters"));
     return;
   }
 
-  // Save to NVS
-  preferences.begin("auth", false);
-  preferences.putString("pass", newPass);
-  preferences.putString("otapass", otaPass);
-  preferences.end();
-
-  // Update runtime
-  strcpy(www_password, newPass);
-  strcpy(ota_password, otaPass);
+  // Hash and save to NVS, then end sessions opened with the old password
+  credentials.setPasswords(newPass, otaPass);
+  ArduinoOTA.setPasswordHash(credentials.otaPasswordHash());
+  webAuth.revokeAll();
 
   server.send(200, F("application/json"), F("{\"status\":\"ok\"}"));
 }
 
 /**
  * API: MQTT Configuration
+ * GET /api/mqtt - current settings (password omitted)
  * POST /api/mqtt
  * Body: {"server":"...", "port":1883, "client":"...", "user":"...", "pass":"..."}
+ * Omitting "pass" keeps the stored password. Applied immediately.
  */
 void handleAPIMQTT() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
+  if (!requireAuth()) return;
+
+  extern MqttConnectionManager mqttManager;
+
+  if (server.method() == HTTP_GET) {
+    StaticJsonDocument<384> doc;
+    doc["server"] = mqttConfig.server;
+    doc["port"] = mqttConfig.port;
+    doc["client"] = mqttConfig.clientId;
+    doc["user"] = mqttConfig.user;
+    doc["has_pass"] = strlen(mqttConfig.pass) > 0;
+    doc["state"] = mqttManager.stateName();
+
+    String response;
+    serializeJson(doc, response);
+    server.send(200, F("application/json"), response);
+    return;
   }
 
   if (server.method() != HTTP_POST) {
@@ -288,14 +452,30 @@ void handleAPIMQTT() {
     return;
   }
 
-  // Save MQTT config to NVS
-  preferences.begin("mqtt", false);
-  preferences.putString("server", doc["server"] | "broker.hivemq.com");
-  preferences.putUInt("port", doc["port"] | 1883);
-  preferences.putString("client", doc["client"] | "ESP32_Multitool");
-  preferences.putString("user", doc["user"] | "");
-  preferences.putString("pass", doc["pass"] | "");
-  preferences.end();
+  const char* host = doc["server"] | "";
+  uint32_t port = doc["port"] | 1883;
+  if (strlen(host) == 0 || strlen(host) >= sizeof(mqttConfig.server)) {
+    server.send(400, F("text/plain"), F("Invalid broker host"));
+    return;
+  }
+  if (port < 1 || port > 65535) {
+    server.send(400, F("text/plain"), F("Invalid broker port"));
+    return;
+  }
+
+  strncpy(mqttConfig.server, host, sizeof(mqttConfig.server) - 1);
+  mqttConfig.port = (uint16_t)port;
+  strncpy(mqttConfig.clientId, doc["client"] | "ESP32_Multitool", sizeof(mqttConfig.clientId) - 1);
+  strncpy(mqttConfig.user, doc["user"] | "", sizeof(mqttConfig.user) - 1);
+  if (doc.containsKey("pass")) {
+    strncpy(mqttConfig.pass, doc["pass"] | "", sizeof(mqttConfig.pass) - 1);
+  }
+
+  // Persist, then drop the session so the manager reconnects and resubscribes
+  extern void saveMqttConfig();
+  extern void applyMqttConfig();
+  saveMqttConfig();
+  applyMqttConfig();
 
   server.send(200, F("application/json"), F("{\"status\":\"ok\"}"));
 }
@@ -305,9 +485,7 @@ void handleAPIMQTT() {
  * GET /api/network
  */
 void handleAPINetwork() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
-  }
+  if (!requireAuth()) return;
 
   StaticJsonDocument<256> doc;
   doc["ssid"] = WiFi.SSID();
@@ -315,28 +493,436 @@ void handleAPINetwork() {
   doc["mac"] = WiFi.macAddress();
   doc["rssi"] = WiFi.RSSI();
   doc["channel"] = WiFi.channel();
+  doc["state"] = wifiConnection.stateName();
+  doc["portal"] = wifiConnection.portalActive();
 
   String response;
   serializeJson(doc, response);
   server.send(200, F("application/json"), response);
 }
 
+/**
+ * API: WiFi station setup
+ * GET /api/wifi - connection state plus the last scan's networks
+ * POST /api/wifi
+ * Body: {"ssid":"...", "password":"..."}
+ * Joins the network in the background (no reboot); poll GET for the result.
+ */
+void handleAPIWiFi() {
+  if (!requireAuth()) return;
+
+  if (server.method() == HTTP_GET) {
+    DynamicJsonDocument doc(2048);
+    doc["state"] = wifiConnection.stateName();
+    doc["portal"] = wifiConnection.portalActive();
+    doc["ssid"] = WiFi.SSID();
+
+    int16_t found = WiFi.scanComplete();
+    doc["scanning"] = found == WIFI_SCAN_RUNNING || wifiConnection.scanPending();
+    JsonArray networks = doc.createNestedArray("networks");
+    for (int16_t i = 0; i < found && i < 16; i++) {
+      JsonObject net = networks.createNestedObject();
+      net["ssid"] = WiFi.SSID(i);
+      net["rssi"] = WiFi.RSSI(i);
+      net["channel"] = WiFi.channel(i);
+      net["secure"] = WiFi.encryptionType(i) != WIFI_AUTH_OPEN;
+    }
+
+    String response;
+    serializeJson(doc, response);
+    server.send(200, F("application/json"), response);
+    return;
+  }
+
+  if (server.method() != HTTP_POST) {
+    server.send(405, F("text/plain"), F("Method Not Allowed"));
+    return;
+  }
+
+  StaticJsonDocument<256> doc;
+  if (deserializeJson(doc, server.arg("plain"))) {
+    server.send(400, F("text/plain"), F("Invalid JSON"));
+    return;
+  }
+
+  const char* ssid = doc["ssid"] | "";
+  const char* password = doc["password"] | "";
+  size_t passLen = strlen(password);
+  if (strlen(ssid) == 0 || strlen(ssid) > 32) {
+    server.send(400, F("text/plain"), F("SSID must be 1-32 characters"));
+    return;
+  }
+  if (passLen != 0 && (passLen < 8 || passLen > 63)) {
+    server.send(400, F("text/plain"), F("Password must be empty or 8-63 characters"));
+    return;
+  }
+
+  // Answer first: joining may move the radio off the setup AP's channel
+  server.send(200, F("application/json"), F("{\"status\":\"connecting\"}"));
+  wifiConnection.setCredentials(ssid, password);
+}
+
+/**
+ * API: Scan for networks (results via GET /api/wifi)
+ * POST /api/wifi/scan
+ */
+void handleAPIWiFiScan() {
+  if (!requireAuth()) return;
+
+  wifiConnection.requestScan();
+  server.send(202, F("application/json"), F("{\"status\":\"scanning\"}"));
+}
+
+/**
+ * Append an OTA session's progress to a JSON document
+ */
+void addOtaStats(JsonObject ota, const OtaStats& stats) {
+  ota["state"] = otaStateName(stats.state);
+  ota["bytes"] = stats.bytes;
+  ota["elapsed_ms"] = stats.elapsedMs;
+  ota["kbps"] = stats.kbps;
+  ota["compressed"] = stats.compressed;
+  ota["delta"] = stats.delta;
+  if (stats.compressed || stats.delta) {
+    ota["wire_bytes"] = stats.wireBytes;
+    ota["inflate_kbps"] = stats.inflateKbps;
+  }
+  ota["verified"] = stats.verified;
+  if (stats.sha256[0] != '\0') ota["sha256"] = stats.sha256;
+  if (stats.error[0] != '\0') ota["error"] = stats.error;
+}
+
 /**
  * API: Firmware information
  * GET /api/firmware
  */
 void handleAPIFirmware() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
-  }
+  if (!requireAuth()) return;
 
-  StaticJsonDocument<256> doc;
-  doc["version"] = "2.0.0";
+  StaticJsonDocument<640> doc;
+  doc["version"] = FIRMWARE_VERSION;
   doc["buildDate"] = __DATE__ " " __TIME__;
   doc["sketchSize"] = ESP.getSketchSize();
   doc["freeSpace"] = ESP.getFreeSketchSpace();
   doc["sdkVersion"] = ESP.getSdkVersion();
   doc["cpuFreq"] = ESP.getCpuFreqMHz();
+  doc["partition"] = esp_ota_get_running_partition()->label;
+  doc["imageState"] = otaRunningState();
+  addOtaStats(doc.createNestedObject("lastUpdate"), otaSession.stats());
+
+  String response;
+  serializeJson(doc, response);
+  server.send(200, F("application/json"), response);
+}
+
+/**
+ * API: Pull OTA settings and status
+ * GET /api/ota/pull
+ * POST /api/ota/pull
+ * Body: {"enabled": true, "url": "http://192.168.1.10:8000/manifest.json",
+ *        "interval_min": 60, "check": true}
+ * All fields are optional; "check" fetches the manifest now.
+ */
+void handleAPIOtaPull() {
+  if (!requireAuth()) return;
+
+  if (server.method() == HTTP_POST) {
+    StaticJsonDocument<384> body;
+    if (deserializeJson(body, server.arg("plain"))) {
+      server.send(400, F("application/json"), F("{\"error\":\"Invalid JSON\"}"));
+      return;
+    }
+
+    OtaPullSettings settings = otaPuller.settings();
+    bool changed = false;
+    if (body.containsKey("url")) {
+      const char* url = body["url"] | "";
+      if (strlen(url) >= sizeof(settings.manifestUrl) ||
+          (url[0] != '\0' && strncmp(url, "http://", 7) != 0 && strncmp(url, "https://", 8) != 0)) {
+        server.send(400, F("application/json"), F("{\"error\":\"url must be http(s) and under 128 chars\"}"));
+        return;
+      }
+      strcpy(settings.manifestUrl, url);
+      changed = true;
+    }
+    if (body.containsKey("enabled")) {
+      settings.enabled = body["enabled"];
+      changed = true;
+    }
+    if (body.containsKey("interval_min")) {
+      settings.intervalMin = constrain((long)body["interval_min"], 1L, 10080L);
+      changed = true;
+    }
+    if (changed) {
+      otaPuller.setSettings(settings);
+      configStore.data().otaPull = settings;
+      configStore.markDirty();
+    }
+    if (body["check"] | false) otaPuller.checkNow();
+  } else if (server.method() != HTTP_GET) {
+    server.send(405, F("text/plain"), F("Method Not Allowed"));
+    return;
+  }
+
+  OtaPullSettings settings = otaPuller.settings();
+  OtaPullStatus status = otaPuller.status();
+
+  StaticJsonDocument<768> doc;
+  doc["current"] = FIRMWARE_VERSION;
+  doc["enabled"] = settings.enabled;
+  doc["url"] = settings.manifestUrl;
+  doc["interval_min"] = settings.intervalMin;
+  doc["state"] = otaPullStateName(status.state);
+  if (status.available[0] != '\0') doc["available"] = status.available;
+  if (status.lastCheckMs != 0) doc["last_check_s"] = (millis() - status.lastCheckMs) / 1000;
+  doc["resumes"] = status.resumes;
+  if (status.error[0] != '\0') doc["error"] = status.error;
+  if (otaPuller.downloadStats().state != OtaState::IDLE) {
+    addOtaStats(doc.createNestedObject("download"), otaPuller.downloadStats());
+  }
+
+  String response;
+  serializeJson(doc, response);
+  server.send(200, F("application/json"), response);
+}
+
+/**
+ * Current configuration as JSON (MQTT password omitted)
+ */
+void addConfigJson(JsonObject doc) {
+  const DeviceConfig& config = configStore.data();
+  doc["schema"] = ConfigStoreConfig::SCHEMA_VERSION;
+  doc["username"] = config.username;
+  doc["hostname"] = config.hostname;
+  doc["pwm_frequency"] = config.pwmFrequency;
+
+  JsonObject mqtt = doc.createNestedObject("mqtt");
+  mqtt["server"] = config.mqtt.server;
+  mqtt["port"] = config.mqtt.port;
+  mqtt["client"] = config.mqtt.clientId;
+  mqtt["user"] = config.mqtt.user;
+  mqtt["has_pass"] = config.mqtt.pass[0] != '\0';
+
+  JsonArray outputs = doc.createNestedObject("leds").createNestedArray("outputs");
+  for (uint8_t i = 0; i < config.leds.outputs; i++) {
+    JsonObject out = outputs.createNestedObject();
+    out["pin"] = config.leds.output[i].pin;
+    out["count"] = config.leds.output[i].count;
+  }
+
+  JsonObject pull = doc.createNestedObject("ota_pull");
+  pull["enabled"] = config.otaPull.enabled;
+  pull["interval_min"] = config.otaPull.intervalMin;
+  pull["url"] = config.otaPull.manifestUrl;
+
+  JsonObject sleep = doc.createNestedObject("sleep");
+  sleep["enabled"] = config.sleep.enabled;
+  sleep["interval_s"] = config.sleep.intervalS;
+  sleep["batch"] = config.sleep.batch;
+  sleep["idle_min"] = config.sleep.idleMin;
+
+  const ConfigStoreStats& stats = configStore.stats();
+  JsonObject store = doc.createNestedObject("store");
+  store["loaded_version"] = stats.loadedVersion;
+  store["pending"] = configStore.pending();
+  store["commits"] = stats.commits;
+  store["coalesced"] = stats.coalesced;
+  store["last_commit_us"] = stats.lastCommitUs;
+  store["failures"] = stats.failures;
+}
+
+/**
+ * Copy a JSON string into a fixed field if present
+ * @return false if present but empty or too long
+ */
+bool patchString(JsonVariant value, char* field, size_t size, bool allowEmpty = false) {
+  if (value.isNull()) return true;
+  const char* text = value | "";
+  size_t len = strlen(text);
+  if (len >= size || (len == 0 && !allowEmpty)) return false;
+  strcpy(field, text);
+  return true;
+}
+
+bool validHostname(const char* name) {
+  size_t len = strlen(name);
+  if (len == 0 || name[0] == '-' || name[len - 1] == '-') return false;
+  for (size_t i = 0; i < len; i++) {
+    char c = name[i];
+    if (!(isdigit((unsigned char)c) || (c >= 'a' && c <= 'z') || c == '-')) return false;
+  }
+  return true;
+}
+
+/**
+ * API: Device configuration
+ * GET /api/config - all settings plus store counters
+ * PATCH /api/config (or POST) - partial update, e.g.
+ *   {"hostname":"bench-1", "mqtt":{"port":8883}, "ota_pull":{"enabled":true},
+ *    "sleep":{"enabled":true, "interval_s":300, "batch":6, "idle_min":5}}
+ * The whole patch is validated before anything changes. MQTT, LED, pull and
+ * sleep settings apply at once; hostname and PWM frequency at the next boot.
+ * Changes reach flash in one debounced commit.
+ */
+void handleAPIConfig() {
+  if (!requireAuth()) return;
+
+  bool restartRequired = false;
+  if (server.method() == HTTP_PATCH || server.method() == HTTP_POST) {
+    StaticJsonDocument<1024> body;
+    if (deserializeJson(body, server.arg("plain")) || !body.is<JsonObject>()) {
+      server.send(400, F("application/json"), F("{\"error\":\"Invalid JSON\"}"));
+      return;
+    }
+
+    DeviceConfig next = configStore.data();
+    const char* error = nullptr;
+
+    if (!patchString(body["username"], next.username, sizeof(next.username))) error = "bad username";
+    if (!patchString(body["hostname"], next.hostname, sizeof(next.hostname)) || !validHostname(next.hostname)) {
+      error = "hostname must be 1-31 chars of a-z, 0-9 and -";
+    }
+    if (body.containsKey("pwm_frequency")) {
+      long hz = body["pwm_frequency"] | 0L;
+      if (hz < 100 || hz > 40000) error = "pwm_frequency must be 100-40000";
+      else next.pwmFrequency = hz;
+    }
+
+    JsonObject mqtt = body["mqtt"];
+    if (!mqtt.isNull()) {
+      if (!patchString(mqtt["server"], next.mqtt.server, sizeof(next.mqtt.server)) ||
+          !patchString(mqtt["client"], next.mqtt.clientId, sizeof(next.mqtt.clientId)) ||
+          !patchString(mqtt["user"], next.mqtt.user, sizeof(next.mqtt.user), true) ||
+          !patchString(mqtt["pass"], next.mqtt.pass, sizeof(next.mqtt.pass), true)) {
+        error = "bad mqtt field";
+      }
+      if (mqtt.containsKey("port")) {
+        long port = mqtt["port"] | 0L;
+        if (port < 1 || port > 65535) error = "bad mqtt port";
+        else next.mqtt.port = port;
+      }
+    }
+
+    JsonArray outputs = body["leds"]["outputs"];
+    if (!outputs.isNull()) {
+      next.leds = {};
+      next.leds.outputs = outputs.size() > LED_MAX_OUTPUTS ? LED_MAX_OUTPUTS + 1 : outputs.size();
+      for (uint8_t i = 0; i < next.leds.outputs && i < LED_MAX_OUTPUTS; i++) {
+        next.leds.output[i].pin = constrain((int)outputs[i]["pin"], 0, 255);
+        next.leds.output[i].count = constrain((long)outputs[i]["count"], 0L, 65535L);
+      }
+      extern const char* validateLedConfig(const LedStripConfig& config);
+      const char* ledError = validateLedConfig(next.leds);
+      if (ledError != nullptr) error = ledError;
+    }
+
+    JsonObject pull = body["ota_pull"];
+    if (!pull.isNull()) {
+      if (pull.containsKey("enabled")) next.otaPull.enabled = pull["enabled"];
+      if (pull.containsKey("interval_min")) {
+        next.otaPull.intervalMin = constrain((long)pull["interval_min"], 1L, 10080L);
+      }
+      const char* url = next.otaPull.manifestUrl;
+      if (!patchString(pull["url"], next.otaPull.manifestUrl, sizeof(next.otaPull.manifestUrl), true) ||
+          (url[0] != '\0' && strncmp(url, "http://", 7) != 0 && strncmp(url, "https://", 8) != 0)) {
+        error = "ota_pull url must be http(s) and under 128 chars";
+      }
+    }
+
+    JsonObject sleep = body["sleep"];
+    if (!sleep.isNull()) {
+      if (sleep.containsKey("enabled")) next.sleep.enabled = sleep["enabled"];
+      if (sleep.containsKey("interval_s")) {
+        long seconds = sleep["interval_s"] | 0L;
+        if (seconds < 10 || seconds > 65535) error = "sleep interval_s must be 10-65535";
+        else next.sleep.intervalS = seconds;
+      }
+      if (sleep.containsKey("batch")) {
+        long batch = sleep["batch"] | 0L;
+        if (batch < 1 || batch > SleepConfig::MAX_SAMPLES) error = "sleep batch must be 1-32";
+        else next.sleep.batch = batch;
+      }
+      if (sleep.containsKey("idle_min")) {
+        long minutes = sleep["idle_min"] | 0L;
+        if (minutes < 1 || minutes > 255) error = "sleep idle_min must be 1-255";
+        else next.sleep.idleMin = minutes;
+      }
+    }
+
+    if (error != nullptr) {
+      StaticJsonDocument<128> err;
+      err["error"] = error;
+      String response;
+      serializeJson(err, response);
+      server.send(400, F("application/json"), response);
+      return;
+    }
+
+    // Apply only what changed
+    DeviceConfig& live = configStore.data();
+    bool mqttChanged = memcmp(&next.mqtt, &live.mqtt, sizeof(next.mqtt)) != 0;
+    bool ledsChanged = memcmp(&next.leds, &live.leds, sizeof(next.leds)) != 0;
+    bool pullChanged = memcmp(&next.otaPull, &live.otaPull, sizeof(next.otaPull)) != 0;
+    bool sleepChanged = memcmp(&next.sleep, &live.sleep, sizeof(next.sleep)) != 0;
+    bool userChanged = strcmp(next.username, live.username) != 0;
+    restartRequired = strcmp(next.hostname, live.hostname) != 0 || next.pwmFrequency != live.pwmFrequency;
+
+    if (memcmp(&next, &live, sizeof(next)) != 0) {
+      live = next;
+      configStore.markDirty();
+    }
+
+    extern void applyMqttConfig();
+    extern void applyLedConfig();
+    if (mqttChanged) applyMqttConfig();
+    if (ledsChanged) applyLedConfig();
+    if (pullChanged) otaPuller.setSettings(live.otaPull);
+    if (sleepChanged) sleepTelemetry.setSettings(live.sleep);
+    if (userChanged) webAuth.revokeAll();  // Cached Basic header carries the old name
+  } else if (server.method() != HTTP_GET) {
+    server.send(405, F("text/plain"), F("Method Not Allowed"));
+    return;
+  }
+
+  StaticJsonDocument<1024> doc;
+  addConfigJson(doc.to<JsonObject>());
+  if (restartRequired) doc["restart_required"] = true;
+
+  String response;
+  serializeJson(doc, response);
+  server.send(200, F("application/json"), response);
+}
+
+/**
+ * API: Recent log lines
+ * GET /api/logs?since=<seq>
+ * Returns: JSON with lines from seq onward and the cursor for the next poll
+ */
+void handleAPILogs() {
+  if (!requireAuth()) return;
+
+  uint32_t next = logTailNext();
+  uint32_t since = logTailOldest();
+  if (server.hasArg("since")) {
+    uint32_t requested = strtoul(server.arg("since").c_str(), nullptr, 10);
+    // A cursor from before a reboot is ahead of us - restart from the oldest line
+    if (requested > since && requested <= next) since = requested;
+  }
+
+  DynamicJsonDocument doc(LogConfig::TAIL_LINES * (LogConfig::LINE_LEN + 48) + 128);
+  doc["next"] = next;
+  JsonArray lines = doc.createNestedArray("lines");
+
+  LogLine line;
+  for (uint32_t seq = since; seq < next; seq++) {
+    if (!logTailRead(seq, line)) continue;
+    JsonObject entry = lines.createNestedObject();
+    entry["seq"] = line.seq;
+    entry["t"] = line.timestampMs;
+    char level[2] = { logLevelChar(line.level), '\0' };
+    entry["level"] = level;
+    entry["msg"] = line.text;
+  }
 
   String response;
   serializeJson(doc, response);
@@ -348,22 +934,18 @@ void handleAPIFirmware() {
  * POST /api/wifi/reset
  */
 void handleAPIWiFiReset() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
-  }
+  if (!requireAuth()) return;
 
   if (server.method() != HTTP_POST) {
     server.send(405, F("text/plain"), F("Method Not Allowed"));
     return;
   }
 
-  server.send(200, F("application/json"), F("{\"status\":\"resetting\"}"));
+  server.send(200, F("application/json"), F("{\"status\":\"portal\"}"));
 
-  delay(1000);
-
-  extern WiFiManager wifiManager;
-  wifiManager.resetSettings();
-  ESP.restart();
+  // Forget the network and open the setup AP; local control and the web
+  // server keep running
+  wifiConnection.forget();
 }
 
 /**
@@ -371,9 +953,7 @@ void handleAPIWiFiReset() {
  * POST /api/reboot
  */
 void handleAPIReboot() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
-  }
+  if (!requireAuth()) return;
 
   if (server.method() != HTTP_POST) {
     server.send(405, F("text/plain"), F("Method Not Allowed"));
@@ -382,6 +962,7 @@ void handleAPIReboot() {
 
   server.send(200, F("application/json"), F("{\"status\":\"rebooting\"}"));
 
+  configStore.flush();
   delay(1000);
   ESP.restart();
 }
@@ -389,38 +970,55 @@ void handleAPIReboot() {
 /**
  * OTA Update handler
  * POST /update
+ * Body: raw .bin, gzip-compressed .bin.gz or a delta .patch (detected from the first bytes)
+ * Optional expected digest of the uncompressed image: X-Firmware-SHA256 header
+ * or ?sha256= (64 hex chars)
  */
-void handleOTAUpdate() {
-  if (!server.authenticate(www_username, www_password)) {
-    return server.requestAuthentication();
-  }
+// Non-zero when the limiter refused the current upload (seconds to wait)
+uint32_t otaRetryAfter = 0;
 
+void handleOTAUpdate() {
   HTTPUpload& upload = server.upload();
 
+  // Admission is decided once per upload; refused uploads are drained unread
   if (upload.status == UPLOAD_FILE_START) {
-    Serial.printf("Update: %s\n", upload.filename.c_str());
+    otaRetryAfter = rateLimiter.admit((uint32_t)server.client().remoteIP(), RouteClass::OTA);
+  }
+  if (otaRetryAfter != 0) return;
 
-    if (!Update.begin(UPDATE_SIZE_UNKNOWN)) {
-      Update.printError(Serial);
-    }
+  if (!requireAuth()) return;
+
+  if (upload.status == UPLOAD_FILE_START) {
+    String expected = server.header(OtaConfig::HASH_HEADER);
+    if (expected.length() == 0) expected = server.arg(OtaConfig::HASH_ARG);
+    LOG_INFO("Update: upload started%s", expected.length() > 0 ? " (SHA-256 expected)" : "");
+    otaSession.begin(expected.c_str());
   } else if (upload.status == UPLOAD_FILE_WRITE) {
-    if (Update.write(upload.buf, upload.currentSize) != upload.currentSize) {
-      Update.printError(Serial);
-    }
+    otaSession.write(upload.buf, upload.currentSize);
   } else if (upload.status == UPLOAD_FILE_END) {
-    if (Update.end(true)) {
-      Serial.printf("Update Success: %u bytes\n", upload.totalSize);
-    } else {
-      Update.printError(Serial);
-    }
+    otaSession.end();
+  } else if (upload.status == UPLOAD_FILE_ABORTED) {
+    otaSession.abort();
   }
 }
 
 void handleOTAUpdateDone() {
-  if (Update.hasError()) {
-    server.send(500, F("text/plain"), F("Update Failed"));
+  if (otaRetryAfter != 0) {
+    sendRateLimited(otaRetryAfter);
+    return;
+  }
+  if (!requireAuth()) return;
+
+  StaticJsonDocument<384> doc;
+  addOtaStats(doc.to<JsonObject>(), otaSession.stats());
+  String response;
+  serializeJson(doc, response);
+
+  if (!otaSession.ok()) {
+    server.send(500, F("application/json"), response);
   } else {
-    server.send(200, F("text/plain"), F("Update OK - Rebooting..."));
+    server.send(200, F("application/json"), response);
+    configStore.flush();
     delay(1000);
     ESP.restart();
   }
@@ -431,23 +1029,37 @@ void handleOTAUpdateDone() {
  * Call this from setup() after server.begin()
  */
 void registerAPIHandlers() {
-  // API endpoints
-  server.on("/api/status", HTTP_GET, handleAPIStatus);
-  server.on("/api/relay", HTTP_POST, handleAPIRelay);
-  server.on("/api/pwm", HTTP_POST, handleAPIPWM);
-  server.on("/api/servo", HTTP_POST, handleAPIServo);
-  server.on("/api/i2c/scan", HTTP_GET, handleAPIi2cScan);
-  server.on("/api/password", HTTP_POST, handleAPIPassword);
-  server.on("/api/mqtt", HTTP_POST, handleAPIMQTT);
-  server.on("/api/network", HTTP_GET, handleAPINetwork);
-  server.on("/api/firmware", HTTP_GET, handleAPIFirmware);
-  server.on("/api/wifi/reset", HTTP_POST, handleAPIWiFiReset);
-  server.on("/api/reboot", HTTP_POST, handleAPIReboot);
+  // API endpoints, each behind the per-client limiter for its route class
+  server.on("/api/login", HTTP_POST, limited(RouteClass::AUTH, handleAPILogin));
+  server.on("/api/logout", HTTP_POST, limited(RouteClass::WRITE, handleAPILogout));
+  server.on("/api/status", HTTP_GET, limited(RouteClass::READ, handleAPIStatus));
+  server.on("/api/relay", HTTP_POST, limited(RouteClass::WRITE, handleAPIRelay));
+  server.on("/api/pwm", HTTP_POST, limited(RouteClass::WRITE, handleAPIPWM));
+  server.on("/api/servo", HTTP_POST, limited(RouteClass::WRITE, handleAPIServo));
+  server.on("/api/neopixel", HTTP_ANY, limitedReadWrite(handleAPINeopixel));
+  server.on("/api/neopixel/config", HTTP_ANY, limitedReadWrite(handleAPINeopixelConfig));
+  server.on("/api/i2c/scan", HTTP_GET, limited(RouteClass::SCAN, handleAPIi2cScan));
+  server.on("/api/password", HTTP_POST, limited(RouteClass::AUTH, handleAPIPassword));
+  server.on("/api/mqtt", HTTP_ANY, limitedReadWrite(handleAPIMQTT));
+  server.on("/api/network", HTTP_GET, limited(RouteClass::READ, handleAPINetwork));
+  server.on("/api/firmware", HTTP_GET, limited(RouteClass::READ, handleAPIFirmware));
+  server.on("/api/ota/pull", HTTP_ANY, limitedReadWrite(handleAPIOtaPull));
+  server.on("/api/config", HTTP_ANY, limitedReadWrite(handleAPIConfig));
+  server.on("/api/logs", HTTP_GET, limited(RouteClass::READ, handleAPILogs));
+  server.on("/api/wifi", HTTP_ANY, limitedReadWrite(handleAPIWiFi));
+  server.on("/api/wifi/scan", HTTP_POST, limited(RouteClass::SCAN, handleAPIWiFiScan));
+  server.on("/api/wifi/reset", HTTP_POST, limited(RouteClass::WRITE, handleAPIWiFiReset));
+  server.on("/api/reboot", HTTP_POST, limited(RouteClass::WRITE, handleAPIReboot));
+
+  // Headers the server keeps for handlers: the session cookie and the OTA
+  // digest (Authorization is always collected)
+  static const char* headers[] = { WebAuthConfig::COOKIE_HEADER, OtaConfig::HASH_HEADER };
+  server.collectHeaders(headers, 2);
 
   // OTA update endpoint
   server.on("/update", HTTP_POST, handleOTAUpdateDone, handleOTAUpdate);
 
-  Serial.println(F("API handlers registered"));
+  LOG_INFO("API handlers registered");
 }
 
 #endif
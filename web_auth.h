@@ -0,0 +1,435 @@
+/*
+ * ESP32 Multitool - Web Session Tokens
+ * HMAC-signed session tokens so requests skip HTTP Basic auth
+ *
+ * Token (48 hex chars): session id (4 bytes) | expiry (4 bytes, uptime
+ * seconds) | first 16 bytes of HMAC-SHA256(id | expiry) under a random key
+ * drawn at boot, so tokens cannot be forged or guessed.
+ *
+ * Sessions live in a small slot table that keeps each token as issued; the
+ * low bits of the id name the slot. Checking a request is a hex decode, one
+ * slot lookup and a constant-time compare - no base64 decoding, no password
+ * compare and no hashing per request. Clearing a slot revokes that token,
+ * clearing all of them (password change) revokes every token. A reboot draws
+ * a new key and empties the table.
+ *
+ * Clients send the token as the mt_session cookie or as
+ * "Authorization: Bearer <token>". HTTP Basic still works as a fallback;
+ * page loads that pass Basic get a session cookie, so the dashboard's
+ * polling requests then take the token path.
+ *
+ * Basic credentials are checked against the PBKDF2 record (credentials.h).
+ * A keyed hash of the last Authorization header that passed is cached, so
+ * a client that keeps sending Basic pays for the KDF once, not per request.
+ * A header that misses the cache takes an AUTH rate-limit token like a
+ * login does, so Basic on a cheap route cannot be used to guess passwords.
+ *
+ * Only the web server task calls into this, so no locking is needed.
+ */
+
+#ifndef WEB_AUTH_H
+#define WEB_AUTH_H
+
+#include <Arduino.h>
+#include <WebServer.h>
+#include <esp_random.h>
+#include <esp_timer.h>
+#include <mbedtls/sha256.h>
+#include <mbedtls/base64.h>
+#include "credentials.h"
+#include "config_store.h"
+#include "rate_limiter.h"
+
+// Forward declarations from main sketch
+extern WebServer server;
+
+namespace WebAuthConfig {
+  const char COOKIE_NAME[] = "mt_session";
+  const char COOKIE_HEADER[] = "Cookie";
+  const char AUTH_HEADER[] = "Authorization";
+  const uint32_t TOKEN_TTL_S = 12 * 3600;
+  const uint8_t MAX_SESSIONS = 8;          // Power of two: id low bits pick the slot
+  const uint8_t MAC_BYTES = 16;            // Truncated HMAC-SHA256
+  const uint8_t TOKEN_BYTES = 8 + MAC_BYTES;
+  const uint8_t TOKEN_HEX = TOKEN_BYTES * 2;
+}
+
+struct WebAuthStats {
+  uint32_t tokenChecks;     // Requests accepted on a session token
+  uint32_t tokenUs;         // Total time spent on those checks
+  uint32_t basicChecks;     // Requests accepted on HTTP Basic
+  uint32_t basicUs;
+  uint32_t basicCacheHits;  // Basic requests that skipped the KDF
+  uint32_t failures;        // Requests that got a 401 (or a 429 on a Basic cache miss)
+  uint32_t issued;
+  uint32_t revoked;
+};
+
+/**
+ * Compare two strings in time that depends only on the length of b
+ * b is the stored secret; a is whatever the client sent.
+ */
+inline bool authEquals(const char* a, const char* b) {
+  size_t lenA = strlen(a);
+  size_t lenB = strlen(b);
+  uint8_t diff = lenA != lenB;
+  for (size_t i = 0; i < lenB; i++) {
+    diff |= (uint8_t)(b[i] ^ (i < lenA ? a[i] : 0));
+  }
+  return diff == 0;
+}
+
+class WebAuth {
+public:
+  /**
+   * Draw the signing key and precompute the HMAC pad states
+   */
+  void begin() {
+    uint8_t key[64];
+    esp_fill_random(key, sizeof(key));
+    uint8_t pad[64];
+
+    for (uint8_t i = 0; i < sizeof(pad); i++) pad[i] = key[i] ^ 0x36;
+    mbedtls_sha256_init(&_inner);
+    mbedtls_sha256_starts(&_inner, 0);
+    mbedtls_sha256_update(&_inner, pad, sizeof(pad));
+
+    for (uint8_t i = 0; i < sizeof(pad); i++) pad[i] = key[i] ^ 0x5c;
+    mbedtls_sha256_init(&_outer);
+    mbedtls_sha256_starts(&_outer, 0);
+    mbedtls_sha256_update(&_outer, pad, sizeof(pad));
+
+    memset(key, 0, sizeof(key));
+    memset(pad, 0, sizeof(pad));
+    revokeAll();
+    _stats = {};
+  }
+
+  /**
+   * Start a session
+   * @param token receives TOKEN_HEX chars plus terminator
+   */
+  void issue(char* token) {
+    uint32_t now = nowSeconds();
+
+    // Reuse an expired slot, else evict the one closest to expiry
+    uint8_t slot = 0;
+    for (uint8_t i = 0; i < WebAuthConfig::MAX_SESSIONS; i++) {
+      if (_slots[i].id == 0 || (int32_t)(_slots[i].expires - now) <= 0) {
+        slot = i;
+        break;
+      }
+      if ((int32_t)(_slots[i].expires - _slots[slot].expires) < 0) slot = i;
+    }
+
+    uint32_t id;
+    do {
+      id = (esp_random() & ~(uint32_t)(WebAuthConfig::MAX_SESSIONS - 1)) | slot;
+    } while (id == slot);  // Id 0 marks a free slot
+    _slots[slot].id = id;
+    _slots[slot].expires = now + WebAuthConfig::TOKEN_TTL_S;
+
+    uint8_t* raw = _slots[slot].token;
+    putU32(raw, id);
+    putU32(raw + 4, _slots[slot].expires);
+    uint8_t mac[32];
+    hmac(raw, 8, mac);
+    memcpy(raw + 8, mac, WebAuthConfig::MAC_BYTES);
+    for (uint8_t i = 0; i < WebAuthConfig::TOKEN_BYTES; i++) {
+      snprintf(token + i * 2, 3, "%02x", raw[i]);
+    }
+    _stats.issued++;
+  }
+
+  /**
+   * Check a token against its slot; O(1), constant-time compare
+   */
+  bool verify(const char* token) const {
+    uint8_t raw[WebAuthConfig::TOKEN_BYTES];
+    if (!parseToken(token, raw)) return false;
+
+    const Slot& slot = _slots[raw[0] & (WebAuthConfig::MAX_SESSIONS - 1)];
+    if (slot.id == 0) return false;
+    uint8_t diff = 0;
+    for (uint8_t i = 0; i < sizeof(raw); i++) diff |= raw[i] ^ slot.token[i];
+    return diff == 0 && (int32_t)(slot.expires - nowSeconds()) > 0;
+  }
+
+  /**
+   * End the session a token belongs to
+   */
+  bool revoke(const char* token) {
+    if (!verify(token)) return false;
+    uint8_t raw[WebAuthConfig::TOKEN_BYTES];
+    parseToken(token, raw);
+    _slots[raw[0] & (WebAuthConfig::MAX_SESSIONS - 1)] = {};
+    _stats.revoked++;
+    return true;
+  }
+
+  /**
+   * End every session and forget the cached Basic header (password changed)
+   */
+  void revokeAll() {
+    for (uint8_t i = 0; i < WebAuthConfig::MAX_SESSIONS; i++) {
+      if (_slots[i].id != 0) _stats.revoked++;
+      _slots[i] = {};
+    }
+    _basicCached = false;
+  }
+
+  /**
+   * True if this Basic credential string already passed the KDF
+   */
+  bool basicCached(const char* credentials) const {
+    if (!_basicCached) return false;
+    uint8_t digest[32];
+    hmac((const uint8_t*)credentials, strlen(credentials), digest);
+    uint8_t diff = 0;
+    for (uint8_t i = 0; i < sizeof(digest); i++) diff |= digest[i] ^ _basicVerifier[i];
+    return diff == 0;
+  }
+
+  void cacheBasic(const char* credentials) {
+    hmac((const uint8_t*)credentials, strlen(credentials), _basicVerifier);
+    _basicCached = true;
+  }
+
+  uint8_t activeSessions() const {
+    uint32_t now = nowSeconds();
+    uint8_t active = 0;
+    for (uint8_t i = 0; i < WebAuthConfig::MAX_SESSIONS; i++) {
+      if (_slots[i].id != 0 && (int32_t)(_slots[i].expires - now) > 0) active++;
+    }
+    return active;
+  }
+
+  WebAuthStats& stats() { return _stats; }
+
+private:
+  struct Slot {
+    uint32_t id;
+    uint32_t expires;
+    uint8_t token[WebAuthConfig::TOKEN_BYTES];  // As issued: id | expiry | MAC
+  };
+
+  static uint32_t nowSeconds() {
+    return (uint32_t)(esp_timer_get_time() / 1000000);
+  }
+
+  static void putU32(uint8_t* p, uint32_t v) {
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+  }
+
+  static bool parseToken(const char* token, uint8_t* raw) {
+    for (uint8_t i = 0; i < WebAuthConfig::TOKEN_BYTES; i++) {
+      uint8_t byte = 0;
+      for (uint8_t j = 0; j < 2; j++) {
+        char c = token[i * 2 + j];
+        byte <<= 4;
+        if (c >= '0' && c <= '9') byte |= c - '0';
+        else if (c >= 'a' && c <= 'f') byte |= c - 'a' + 10;
+        else return false;
+      }
+      raw[i] = byte;
+    }
+    return true;
+  }
+
+  /**
+   * HMAC-SHA256 under the boot key
+   * The key's inner and outer pad states were hashed once in begin().
+   */
+  void hmac(const uint8_t* data, size_t len, uint8_t* mac) const {
+    uint8_t digest[32];
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_clone(&ctx, &_inner);
+    mbedtls_sha256_update(&ctx, data, len);
+    mbedtls_sha256_finish(&ctx, digest);
+    mbedtls_sha256_clone(&ctx, &_outer);
+    mbedtls_sha256_update(&ctx, digest, sizeof(digest));
+    mbedtls_sha256_finish(&ctx, mac);
+    mbedtls_sha256_free(&ctx);
+  }
+
+  mbedtls_sha256_context _inner;
+  mbedtls_sha256_context _outer;
+  Slot _slots[WebAuthConfig::MAX_SESSIONS] = {};
+  uint8_t _basicVerifier[32];
+  bool _basicCached = false;
+  WebAuthStats _stats = {};
+};
+
+WebAuth webAuth;
+
+/**
+ * Find a session token in the request: cookie first, then bearer header
+ * @param token receives TOKEN_HEX chars plus terminator
+ */
+bool requestToken(char* token) {
+  String cookie = server.header(WebAuthConfig::COOKIE_HEADER);
+  const char* p = cookie.c_str();
+  size_t nameLen = strlen(WebAuthConfig::COOKIE_NAME);
+  while ((p = strstr(p, WebAuthConfig::COOKIE_NAME)) != nullptr) {
+    bool atStart = p == cookie.c_str() || p[-1] == ' ' || p[-1] == ';';
+    p += nameLen;
+    if (atStart && *p == '=') {
+      strncpy(token, p + 1, WebAuthConfig::TOKEN_HEX);
+      token[WebAuthConfig::TOKEN_HEX] = '\0';
+      return strlen(token) == WebAuthConfig::TOKEN_HEX;
+    }
+  }
+
+  String auth = server.header(WebAuthConfig::AUTH_HEADER);
+  if (auth.startsWith("Bearer ") && auth.length() == 7 + WebAuthConfig::TOKEN_HEX) {
+    strcpy(token, auth.c_str() + 7);
+    return true;
+  }
+  return false;
+}
+
+/**
+ * Check user and password; both are always evaluated so timing does not
+ * reveal which one was wrong
+ */
+bool checkCredentials(const char* user, const char* password) {
+  bool userOk = authEquals(user, configStore.data().username);
+  bool passOk = credentials.checkPassword(password);
+  return userOk & passOk;
+}
+
+enum class BasicAuthResult : uint8_t {
+  OK,
+  REFUSED,   // Missing or wrong credentials
+  LIMITED    // KDF needed but the client is over its AUTH rate; 429 sent
+};
+
+/**
+ * Check an "Authorization: Basic" header against the password record
+ */
+BasicAuthResult checkBasicAuth() {
+  String auth = server.header(WebAuthConfig::AUTH_HEADER);
+  if (!auth.startsWith("Basic ")) return BasicAuthResult::REFUSED;
+  const char* encoded = auth.c_str() + 6;
+  if (webAuth.basicCached(encoded)) {
+    webAuth.stats().basicCacheHits++;
+    return BasicAuthResult::OK;
+  }
+
+  // Cache miss: the KDF runs, so charge it to the AUTH bucket like a login
+  uint32_t retryAfter = rateLimiter.admit((uint32_t)server.client().remoteIP(), RouteClass::AUTH);
+  if (retryAfter != 0) {
+    sendRateLimited(retryAfter);
+    return BasicAuthResult::LIMITED;
+  }
+
+  char decoded[sizeof(DeviceConfig::username) + CredentialConfig::MAX_PASSWORD_LEN + 2];
+  size_t len = 0;
+  if (mbedtls_base64_decode((unsigned char*)decoded, sizeof(decoded) - 1, &len,
+                            (const unsigned char*)encoded, strlen(encoded)) != 0) {
+    return BasicAuthResult::REFUSED;
+  }
+  decoded[len] = '\0';
+  char* colon = strchr(decoded, ':');
+  if (colon == nullptr) return BasicAuthResult::REFUSED;
+  *colon = '\0';
+
+  bool ok = checkCredentials(decoded, colon + 1);
+  memset(decoded, 0, sizeof(decoded));
+  if (!ok) return BasicAuthResult::REFUSED;
+  webAuth.cacheBasic(encoded);
+  return BasicAuthResult::OK;
+}
+
+/**
+ * Hand the client a session cookie (also used by /api/login)
+ */
+void sendSessionCookie(const char* token) {
+  char cookie[128];
+  snprintf(cookie, sizeof(cookie), "%s=%s; Path=/; Max-Age=%lu; HttpOnly; SameSite=Strict",
+           WebAuthConfig::COOKIE_NAME, token, (unsigned long)WebAuthConfig::TOKEN_TTL_S);
+  server.sendHeader(F("Set-Cookie"), cookie);
+}
+
+/**
+ * Authenticate the current request, sending a 401 (or 429) if it fails
+ * Use as: if (!requireAuth()) return;
+ * @param issueSession on a Basic login, also set a session cookie (page loads)
+ */
+bool requireAuth(bool issueSession = false) {
+  WebAuthStats& stats = webAuth.stats();
+  uint32_t startUs = micros();
+
+  char token[WebAuthConfig::TOKEN_HEX + 1];
+  if (requestToken(token) && webAuth.verify(token)) {
+    stats.tokenChecks++;
+    stats.tokenUs += micros() - startUs;
+    return true;
+  }
+
+  BasicAuthResult basic = checkBasicAuth();
+  if (basic == BasicAuthResult::OK) {
+    stats.basicChecks++;
+    stats.basicUs += micros() - startUs;
+    if (issueSession) {
+      webAuth.issue(token);
+      sendSessionCookie(token);
+    }
+    return true;
+  }
+
+  stats.failures++;
+  if (basic == BasicAuthResult::REFUSED) server.requestAuthentication();
+  return false;
+}
+
+/**
+ * API: Exchange credentials for a session token
+ * POST /api/login
+ * Body: {"username":"...", "password":"..."}
+ * Returns: {"token":"...", "expires_in":s} and sets the session cookie
+ */
+void handleAPILogin() {
+  StaticJsonDocument<256> doc;
+  if (deserializeJson(doc, server.arg("plain"))) {
+    server.send(400, F("text/plain"), F("Invalid JSON"));
+    return;
+  }
+
+  const char* user = doc["username"] | "";
+  const char* pass = doc["password"] | "";
+  if (!checkCredentials(user, pass)) {
+    webAuth.stats().failures++;
+    server.send(401, F("application/json"), F("{\"error\":\"Invalid credentials\"}"));
+    return;
+  }
+
+  char token[WebAuthConfig::TOKEN_HEX + 1];
+  webAuth.issue(token);
+  sendSessionCookie(token);
+
+  StaticJsonDocument<128> response;
+  response["token"] = token;
+  response["expires_in"] = WebAuthConfig::TOKEN_TTL_S;
+  String json;
+  serializeJson(response, json);
+  server.send(200, F("application/json"), json);
+}
+
+/**
+ * API: End the session the request was made with
+ * POST /api/logout
+ */
+void handleAPILogout() {
+  char token[WebAuthConfig::TOKEN_HEX + 1];
+  if (requestToken(token)) webAuth.revoke(token);
+
+  char cookie[96];
+  snprintf(cookie, sizeof(cookie), "%s=; Path=/; Max-Age=0; HttpOnly; SameSite=Strict",
+           WebAuthConfig::COOKIE_NAME);
+  server.sendHeader(F("Set-Cookie"), cookie);
+  server.send(200, F("application/json"), F("{\"status\":\"ok\"}"));
+}
+
+#endif
@@ -194,6 +194,21 @@ border-color:var(--danger);
 background:rgba(255,0,0,0.1);
 color:var(--danger)
 }
+.hash-input{
+width:100%;
+padding:0.5rem;
+background:var(--bg-secondary);
+border:1px solid var(--border);
+color:var(--text);
+font-family:'Courier New',monospace;
+font-size:0.8rem
+}
+.transfer-rate{
+text-align:center;
+color:var(--text-dim);
+font-size:0.9rem;
+display:none
+}
 .info-row{
 display:flex;
 justify-content:space-between;
@@ -233,7 +248,7 @@ border-top:1px solid var(--border)
 <div class="card-title">📦 Current Firmware</div>
 <div class="info-row">
 <span class="info-label">Version:</span>
-<span>v2.0.0</span>
+<span id="version">Loading...</span>
 </div>
 <div class="info-row">
 <span class="info-label">Build Date:</span>
@@ -247,6 +262,14 @@ border-top:1px solid var(--border)
 <span class="info-label">Free Space:</span>
 <span id="free-space">Loading...</span>
 </div>
+<div class="info-row">
+<span class="info-label">Partition:</span>
+<span id="partition">Loading...</span>
+</div>
+<div class="info-row">
+<span class="info-label">Last Update:</span>
+<span id="last-update">-</span>
+</div>
 </div>
 
 <!-- Upload Form -->
@@ -254,18 +277,21 @@ border-top:1px solid var(--border)
 <div class="card-title">📤 Upload New Firmware</div>
 <form id="upload-form">
 <div class="file-input-wrapper">
-<input type="file" id="file-input" accept=".bin" onchange="handleFileSelect(event)">
+<input type="file" id="file-input" accept=".bin,.gz,.patch" onchange="handleFileSelect(event)">
 <label for="file-input" class="file-input-label">
-<span>📁 CLICK TO SELECT .BIN FILE</span>
+<span>📁 CLICK TO SELECT .BIN, .BIN.GZ OR .PATCH FILE</span>
 </label>
 </div>
 <div id="file-info" class="file-info"></div>
+<label for="hash-input" class="info-label">Expected SHA-256 (optional, verified before the image is activated):</label>
+<input type="text" id="hash-input" class="hash-input" maxlength="64" placeholder="64 hex characters" autocomplete="off">
 <button type="submit" id="upload-btn" class="btn">🚀 START UPDATE</button>
 </form>
 <div id="progress-container" class="progress-container">
 <div id="progress-bar" class="progress-bar"></div>
 <div id="progress-text" class="progress-text">0%</div>
 </div>
+<div id="transfer-rate" class="transfer-rate"></div>
 <div id="status-message" class="status-message"></div>
 </div>
 </div>
@@ -281,9 +307,16 @@ async function loadFirmwareInfo(){
 try{
 const res=await fetch('/api/firmware');
 const data=await res.json();
+document.getElementById('version').textContent='v'+(data.version||'?');
 document.getElementById('build-date').textContent=data.buildDate||'Unknown';
 document.getElementById('sketch-size').textContent=formatBytes(data.sketchSize||0);
 document.getElementById('free-space').textContent=formatBytes(data.freeSpace||0);
+document.getElementById('partition').textContent=(data.partition||'?')+' ('+(data.imageState||'?')+')';
+const last=data.lastUpdate;
+if(last&&last.state!=='idle'){
+document.getElementById('last-update').textContent=
+last.state+(last.error?' - '+last.error:'')+', '+formatBytes(last.bytes)+' at '+last.kbps+' KB/s';
+}
 }catch(e){
 console.error('Failed to load firmware info',e);
 }
@@ -298,8 +331,10 @@ return(bytes/1048576).toFixed(1)+' MB';
 function handleFileSelect(e){
 const file=e.target.files[0];
 if(!file)return;
-if(!file.name.endsWith('.bin')){
-alert('Please select a .bin firmware file');
+const compressed=file.name.endsWith('.bin.gz');
+const patch=file.name.endsWith('.patch');
+if(!file.name.endsWith('.bin')&&!compressed&&!patch){
+alert('Please select a .bin, .bin.gz or .patch firmware file');
 return;
 }
 selectedFile=file;
@@ -307,6 +342,33 @@ document.getElementById('file-info').innerHTML=
 '<strong>Selected:</strong> '+file.name+' ('+formatBytes(file.size)+')';
 document.getElementById('file-info').style.display='block';
 document.getElementById('upload-btn').style.display='block';
+// crypto.subtle only exists in secure contexts; over plain HTTP paste the hash instead
+// The device hashes the uncompressed image, so inflate .gz files first
+document.getElementById('hash-input').value='';
+// Patches carry the digest of the image they produce
+if(!patch&&window.crypto&&crypto.subtle&&(!compressed||window.DecompressionStream)){
+const image=compressed
+?new Response(file.stream().pipeThrough(new DecompressionStream('gzip'))).arrayBuffer()
+:file.arrayBuffer();
+image.then(function(buf){return crypto.subtle.digest('SHA-256',buf);}).then(function(digest){
+document.getElementById('hash-input').value=
+Array.from(new Uint8Array(digest)).map(function(b){return b.toString(16).padStart(2,'0');}).join('');
+});
+}
+}
+
+function showResult(xhr){
+try{
+const r=JSON.parse(xhr.responseText);
+return r.state==='success'
+?formatBytes(r.bytes)+' in '+(r.elapsed_ms/1000).toFixed(1)+' s ('+r.kbps+' KB/s)'
++(r.delta?', rebuilt from '+formatBytes(r.wire_bytes)+' patch':'')
++(r.compressed&&!r.delta?', '+formatBytes(r.wire_bytes)+' gzip, inflated at '+r.inflate_kbps+' KB/s':'')
++(r.verified?', SHA-256 verified':'')
+:(r.error||'unknown error');
+}catch(e){
+return xhr.responseText;
+}
 }
 
 document.getElementById('upload-form').onsubmit=async function(e){
@@ -320,7 +382,15 @@ const progressContainer=document.getElementById('progress-container');
 const progressBar=document.getElementById('progress-bar');
 const progressText=document.getElementById('progress-text');
 const statusMessage=document.getElementById('status-message');
+const transferRate=document.getElementById('transfer-rate');
+const expectedHash=document.getElementById('hash-input').value.trim().toLowerCase();
+if(expectedHash&&!/^[0-9a-f]{64}$/.test(expectedHash)){
+alert('SHA-256 must be 64 hex characters');
+return;
+}
 uploadBtn.disabled=true;
+transferRate.style.display='block';
+const startTime=performance.now();
 progressContainer.style.display='block';
 statusMessage.style.display='none';
 const formData=new FormData();
@@ -332,12 +402,15 @@ if(e.lengthComputable){
 const percentComplete=(e.loaded/e.total)*100;
 progressBar.style.width=percentComplete+'%';
 progressText.textContent=Math.round(percentComplete)+'%';
+const seconds=(performance.now()-startTime)/1000;
+if(seconds>0)transferRate.textContent=(e.loaded/1024/seconds).toFixed(1)+' KB/s';
 }
 });
 xhr.addEventListener('load',function(){
 if(xhr.status===200){
 progressBar.style.width='100%';
 progressText.textContent='100%';
+transferRate.textContent=showResult(xhr);
 statusMessage.textContent='✓ UPDATE SUCCESSFUL - REBOOTING...';
 statusMessage.className='status-message status-success';
 statusMessage.style.display='block';
@@ -345,7 +418,7 @@ setTimeout(function(){
 window.location.href='/';
 },10000);
 }else{
-statusMessage.textContent='✗ UPDATE FAILED: '+xhr.responseText;
+statusMessage.textContent='✗ UPDATE FAILED: '+showResult(xhr);
 statusMessage.className='status-message status-error';
 statusMessage.style.display='block';
 uploadBtn.disabled=false;
@@ -358,6 +431,7 @@ statusMessage.style.display='block';
 uploadBtn.disabled=false;
 });
 xhr.open('POST','/update');
+if(expectedHash)xhr.setRequestHeader('X-Firmware-SHA256',expectedHash);
 xhr.send(formData);
 }catch(e){
 statusMessage.textContent='✗ ERROR: '+e.message;
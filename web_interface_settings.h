@@ -229,7 +229,9 @@ h1{font-size:1.2rem}
 <div class="form-group">
 <label>Password (optional)</label>
 <input type="password" id="mqtt-pass">
+<div class="help-text" id="mqtt-pass-help">Leave blank to keep the current password</div>
 </div>
+<div class="help-text">Status: <span id="mqtt-state">-</span></div>
 <button type="submit" class="btn">SAVE MQTT SETTINGS</button>
 </form>
 </div>
@@ -237,11 +239,22 @@ h1{font-size:1.2rem}
 <!-- Network Settings -->
 <div class="card">
 <div class="card-title">🌐 Network</div>
+<form id="wifi-form" onsubmit="return joinWiFi(event)">
 <div class="form-group">
 <label>WiFi SSID</label>
-<input type="text" id="wifi-ssid" readonly>
+<input type="text" id="wifi-ssid" list="wifi-networks" maxlength="32" required>
+<datalist id="wifi-networks"></datalist>
 </div>
 <div class="form-group">
+<label>WiFi Password</label>
+<input type="password" id="wifi-pass" maxlength="63">
+<div class="help-text">Leave blank for an open network</div>
+</div>
+<div class="help-text">Status: <span id="wifi-state">-</span></div>
+<button type="button" class="btn btn-secondary" onclick="scanWiFi()">SCAN</button>
+<button type="submit" class="btn">CONNECT</button>
+</form>
+<div class="form-group">
 <label>IP Address</label>
 <input type="text" id="wifi-ip" readonly>
 </div>
@@ -258,7 +271,7 @@ h1{font-size:1.2rem}
 <button class="btn btn-secondary" onclick="resetWiFi()">RESET WIFI SETTINGS</button>
 <button class="btn btn-danger" onclick="rebootDevice()">REBOOT DEVICE</button>
 <div class="help-text" style="margin-top:1rem">
-Warning: Resetting WiFi will restart the device in configuration mode
+Resetting WiFi forgets the network and opens the setup AP (no reboot)
 </div>
 </div>
 </div>
@@ -305,9 +318,10 @@ const config={
 server:document.getElementById('mqtt-server').value,
 port:parseInt(document.getElementById('mqtt-port').value),
 client:document.getElementById('mqtt-client').value,
-user:document.getElementById('mqtt-user').value,
-pass:document.getElementById('mqtt-pass').value
+user:document.getElementById('mqtt-user').value
 };
+const pass=document.getElementById('mqtt-pass').value;
+if(pass)config.pass=pass;
 try{
 const res=await fetch('/api/mqtt',{
 method:'POST',
@@ -315,7 +329,9 @@ headers:{'Content-Type':'application/json'},
 body:JSON.stringify(config)
 });
 if(res.ok){
-showAlert('MQTT settings saved','success');
+showAlert('MQTT settings saved - reconnecting','success');
+document.getElementById('mqtt-pass').value='';
+setTimeout(loadMQTTConfig,3000);
 }else{
 showAlert('Failed to save MQTT settings','error');
 }
@@ -325,26 +341,88 @@ showAlert('Error: '+e.message,'error');
 return false;
 }
 
+async function loadMQTTConfig(){
+try{
+const res=await fetch('/api/mqtt');
+const data=await res.json();
+document.getElementById('mqtt-server').value=data.server||'';
+document.getElementById('mqtt-port').value=data.port||1883;
+document.getElementById('mqtt-client').value=data.client||'';
+document.getElementById('mqtt-user').value=data.user||'';
+document.getElementById('mqtt-state').textContent=data.state||'-';
+}catch(e){
+showAlert('Failed to load MQTT settings','error');
+}
+}
+
 async function loadNetworkInfo(){
 try{
 const res=await fetch('/api/network');
 const data=await res.json();
-document.getElementById('wifi-ssid').value=data.ssid||'N/A';
+if(document.activeElement.id!=='wifi-ssid')document.getElementById('wifi-ssid').value=data.ssid||'';
 document.getElementById('wifi-ip').value=data.ip||'N/A';
 document.getElementById('wifi-mac').value=data.mac||'N/A';
+document.getElementById('wifi-state').textContent=data.state+(data.portal?' (setup AP open)':'');
 }catch(e){
 showAlert('Failed to load network info','error');
 }
 }
 
+async function scanWiFi(){
+try{
+await fetch('/api/wifi/scan',{method:'POST'});
+for(let i=0;i<10;i++){
+await new Promise(r=>setTimeout(r,1500));
+const data=await (await fetch('/api/wifi')).json();
+if(data.scanning)continue;
+const list=document.getElementById('wifi-networks');
+list.innerHTML='';
+data.networks.forEach(n=>{
+const opt=document.createElement('option');
+opt.value=n.ssid;
+opt.label=n.rssi+' dBm'+(n.secure?'':' (open)');
+list.appendChild(opt);
+});
+showAlert('Found '+data.networks.length+' networks','success');
+return;
+}
+showAlert('Scan timed out','error');
+}catch(e){
+showAlert('Error: '+e.message,'error');
+}
+}
+
+async function joinWiFi(e){
+e.preventDefault();
+const ssid=document.getElementById('wifi-ssid').value;
+const password=document.getElementById('wifi-pass').value;
+try{
+const res=await fetch('/api/wifi',{
+method:'POST',
+headers:{'Content-Type':'application/json'},
+body:JSON.stringify({ssid,password})
+});
+if(res.ok){
+showAlert('Connecting to '+ssid+'...','success');
+document.getElementById('wifi-pass').value='';
+setTimeout(loadNetworkInfo,5000);
+}else{
+showAlert('Failed: '+(await res.text()),'error');
+}
+}catch(e){
+showAlert('Error: '+e.message,'error');
+}
+return false;
+}
+
 async function resetWiFi(){
-if(!confirm('Reset WiFi settings? Device will reboot in configuration mode.')){
+if(!confirm('Forget the WiFi network? The device opens its setup AP.')){
 return;
 }
 try{
 await fetch('/api/wifi/reset',{method:'POST'});
-showAlert('WiFi reset. Device rebooting...','success');
-setTimeout(()=>{window.location.href='/'},3000);
+showAlert('WiFi forgotten - join the ESP32-Multitool AP to set it up again','success');
+setTimeout(loadNetworkInfo,2000);
 }catch(e){
 showAlert('Error: '+e.message,'error');
 }
@@ -363,7 +441,10 @@ showAlert('Error: '+e.message,'error');
 }
 }
 
-window.onload=loadNetworkInfo;
+window.onload=function(){
+loadNetworkInfo();
+loadMQTTConfig();
+};
 </script>
 </body>
 </html>
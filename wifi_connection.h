@@ -0,0 +1,318 @@
+/*
+ * ESP32 Multitool - WiFi Connection Manager
+ * Non-blocking station reconnects and a captive setup portal
+ *
+ * Replaces WiFiManager::autoConnect(), which blocked the WiFi task for up
+ * to three minutes and rebooted when it gave up. The manager is advanced
+ * one step per wifiTask pass, so the web server, MQTT and OTA keep running
+ * whatever the link is doing:
+ *
+ *   UNCONFIGURED                    (no stored network: portal only)
+ *   BACKOFF -> CONNECTING -> CONNECTED
+ *      ^            |            |
+ *      +--- fail ---+---- lost --+
+ *
+ * Failed attempts back off exponentially with jitter and never reboot.
+ * The Arduino core's own auto-reconnect is disabled so retries are paced
+ * here and counted in the stats.
+ *
+ * Portal: the setup AP runs in AP+STA mode next to the station, served by
+ * the normal web server (settings page, /api/wifi) with a DNS catch-all so
+ * phones pop up their captive-portal sheet. It opens when no network is
+ * stored or after PORTAL_AFTER_MS offline, and closes once the station has
+ * been connected for PORTAL_CLOSE_MS with no AP clients. While the station
+ * retries, the radio follows it across channels, so AP clients may see
+ * short stalls during an attempt.
+ *
+ * Credentials are stored by the WiFi driver in its own NVS namespace, as
+ * WiFiManager did, so devices provisioned by older firmware reconnect
+ * without setup.
+ */
+
+#ifndef WIFI_CONNECTION_H
+#define WIFI_CONNECTION_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WebServer.h>
+#include <DNSServer.h>
+#include <esp_wifi.h>
+#include <esp_random.h>
+
+// Forward declarations from main sketch
+extern WebServer server;
+
+namespace WifiTiming {
+  const uint32_t CONNECT_TIMEOUT_MS = 15000;   // Association + DHCP
+  const uint32_t BACKOFF_MIN_MS = 1000;
+  const uint32_t BACKOFF_MAX_MS = 30000;       // Bounds the wait after the router returns
+  const uint32_t PORTAL_AFTER_MS = 60000;      // Offline this long: open the setup AP
+  const uint32_t PORTAL_CLOSE_MS = 120000;     // Connected this long, no AP clients: close it
+  const uint8_t DNS_PORT = 53;
+}
+
+struct WifiPortalConfig {
+  const char* apName;
+  const char* apPassword;
+  uint8_t channel;          // Used while the station is not connected
+  uint8_t maxClients;
+};
+
+enum class WifiConnState : uint8_t {
+  UNCONFIGURED,   // No stored network
+  BACKOFF,        // Waiting before the next attempt
+  CONNECTING,     // Association / DHCP in flight
+  CONNECTED
+};
+
+struct WifiStats {
+  uint32_t attempts;
+  uint32_t failures;
+  uint32_t disconnects;
+  uint32_t lastConnectMs;       // Attempt start to IP
+  uint32_t lastReconnectMs;     // Link lost to IP again
+  uint32_t maxReconnectMs;
+  uint32_t portalOpens;
+  uint32_t connectedSinceMs;
+};
+
+class WifiConnectionManager {
+public:
+  typedef void (*LinkCallback)();
+
+  /**
+   * Start the station (and the portal if nothing is stored); returns at once
+   */
+  void begin(const WifiPortalConfig& portal, LinkCallback onConnected, LinkCallback onDisconnected) {
+    _portal = portal;
+    _onConnected = onConnected;
+    _onDisconnected = onDisconnected;
+
+    WiFi.persistent(true);
+    WiFi.setAutoReconnect(false);
+    WiFi.mode(WIFI_STA);
+
+    wifi_config_t stored = {};
+    esp_wifi_get_config(WIFI_IF_STA, &stored);
+    _offlineSinceMs = millis();
+    if (stored.sta.ssid[0] == '\0') {
+      LOG_WARN("WiFi: no network stored - open http://192.168.4.1 on AP %s", _portal.apName);
+      _state = WifiConnState::UNCONFIGURED;
+      openPortal();
+    } else {
+      enterBackoff(0);
+    }
+  }
+
+  /**
+   * Advance by at most one non-blocking step; call every wifiTask pass
+   */
+  void tick() {
+    switch (_state) {
+      case WifiConnState::UNCONFIGURED: break;
+      case WifiConnState::BACKOFF:      tickBackoff(); break;
+      case WifiConnState::CONNECTING:   tickConnecting(); break;
+      case WifiConnState::CONNECTED:    tickConnected(); break;
+    }
+
+    // Deferred scan: the driver refuses to scan during an association
+    if (_scanRequested && _state != WifiConnState::CONNECTING && WiFi.scanComplete() != WIFI_SCAN_RUNNING) {
+      _scanRequested = false;
+      WiFi.scanNetworks(true);
+    }
+
+    uint32_t now = millis();
+    if (!_portalActive && _state != WifiConnState::CONNECTED &&
+        now - _offlineSinceMs >= WifiTiming::PORTAL_AFTER_MS) {
+      LOG_WARN("WiFi: offline for %u s, opening setup AP", (now - _offlineSinceMs) / 1000);
+      openPortal();
+    } else if (_portalActive && _state == WifiConnState::CONNECTED &&
+               now - _stats.connectedSinceMs >= WifiTiming::PORTAL_CLOSE_MS &&
+               WiFi.softAPgetStationNum() == 0) {
+      closePortal();
+    }
+
+    if (_portalActive) _dns.processNextRequest();
+  }
+
+  /**
+   * Store a network and connect to it; the portal stays up until it succeeds
+   */
+  void setCredentials(const char* ssid, const char* password) {
+    if (_state == WifiConnState::CONNECTED) {
+      _offlineSinceMs = millis();
+      if (_onDisconnected != nullptr) _onDisconnected();
+    }
+    _lostAtMs = 0;   // Deliberate switch, not an outage
+    WiFi.disconnect(false);
+    WiFi.begin(ssid, password);   // Persisted by the driver
+    _failures = 0;
+    startAttempt();
+    LOG_INFO("WiFi: joining new network");
+  }
+
+  /**
+   * Erase the stored network and fall back to the portal (no reboot)
+   */
+  void forget() {
+    bool wasConnected = _state == WifiConnState::CONNECTED;
+    WiFi.disconnect(false, true);
+    _state = WifiConnState::UNCONFIGURED;
+    _offlineSinceMs = millis();
+    _lostAtMs = 0;
+    if (wasConnected && _onDisconnected != nullptr) _onDisconnected();
+    openPortal();
+  }
+
+  /**
+   * Ask for a network scan (results via WiFi.scanComplete()/SSID(i)/...)
+   */
+  void requestScan() { _scanRequested = true; }
+  bool scanPending() const { return _scanRequested; }
+
+  bool connected() const { return _state == WifiConnState::CONNECTED; }
+  bool portalActive() const { return _portalActive; }
+  WifiConnState state() const { return _state; }
+  uint32_t backoffMs() const { return _backoffMs; }
+  const WifiStats& stats() const { return _stats; }
+
+  const char* stateName() const {
+    switch (_state) {
+      case WifiConnState::UNCONFIGURED: return "unconfigured";
+      case WifiConnState::BACKOFF:      return "backoff";
+      case WifiConnState::CONNECTING:   return "connecting";
+      case WifiConnState::CONNECTED:    return "connected";
+    }
+    return "unknown";
+  }
+
+private:
+  void enterBackoff(uint32_t delayMs) {
+    _state = WifiConnState::BACKOFF;
+    _backoffMs = delayMs;
+    _stateSinceMs = millis();
+  }
+
+  void startAttempt() {
+    _stats.attempts++;
+    _state = WifiConnState::CONNECTING;
+    _stateSinceMs = millis();
+  }
+
+  /**
+   * Exponential backoff with equal jitter, as in the MQTT manager
+   */
+  void fail(const char* reason) {
+    WiFi.disconnect(false);
+    _stats.failures++;
+    if (_failures < 16) _failures++;
+
+    uint32_t window = WifiTiming::BACKOFF_MIN_MS << (_failures - 1);
+    if (window > WifiTiming::BACKOFF_MAX_MS || window == 0) window = WifiTiming::BACKOFF_MAX_MS;
+    uint32_t delayMs = window / 2 + esp_random() % (window / 2 + 1);
+
+    LOG_RATELIMITED(LogLevel::Warn, 10000, "WiFi connect failed (%s), retry in %u ms", reason, delayMs);
+    enterBackoff(delayMs);
+  }
+
+  void tickBackoff() {
+    if (millis() - _stateSinceMs < _backoffMs) return;
+    if (WiFi.scanComplete() == WIFI_SCAN_RUNNING) return;   // Let a portal scan finish
+    WiFi.begin();   // Stored network
+    startAttempt();
+  }
+
+  void tickConnecting() {
+    wl_status_t status = WiFi.status();
+    if (status == WL_CONNECTED && (uint32_t)WiFi.localIP() != 0) {
+      linkUp();
+      return;
+    }
+    if (status == WL_NO_SSID_AVAIL) {
+      fail("network not found");
+    } else if (status == WL_CONNECT_FAILED) {
+      fail("rejected");
+    } else if (millis() - _stateSinceMs > WifiTiming::CONNECT_TIMEOUT_MS) {
+      fail("timeout");
+    }
+  }
+
+  void tickConnected() {
+    if (WiFi.status() == WL_CONNECTED) return;
+
+    _stats.disconnects++;
+    _lostAtMs = millis();
+    _offlineSinceMs = _lostAtMs;
+    _failures = 0;
+    LOG_WARN("WiFi: link lost, reconnecting");
+    if (_onDisconnected != nullptr) _onDisconnected();
+    enterBackoff(0);
+  }
+
+  void linkUp() {
+    uint32_t now = millis();
+    _failures = 0;
+    _stats.lastConnectMs = now - _stateSinceMs;
+    if (_lostAtMs != 0) {
+      _stats.lastReconnectMs = now - _lostAtMs;
+      if (_stats.lastReconnectMs > _stats.maxReconnectMs) _stats.maxReconnectMs = _stats.lastReconnectMs;
+      _lostAtMs = 0;
+      LOG_INFO("WiFi: reconnected in %u ms", _stats.lastReconnectMs);
+    }
+    _stats.connectedSinceMs = now;
+    _state = WifiConnState::CONNECTED;
+    if (_onConnected != nullptr) _onConnected();
+  }
+
+  void openPortal() {
+    if (_portalActive) return;
+    WiFi.mode(WIFI_AP_STA);
+    WiFi.softAP(_portal.apName, _portal.apPassword, _portal.channel, 0, _portal.maxClients);
+    _dns.start(WifiTiming::DNS_PORT, "*", WiFi.softAPIP());
+    _portalActive = true;
+    _stats.portalOpens++;
+    LOG_INFO("WiFi: setup AP %s open", _portal.apName);
+  }
+
+  void closePortal() {
+    _dns.stop();
+    WiFi.softAPdisconnect(true);
+    WiFi.mode(WIFI_STA);
+    _portalActive = false;
+    LOG_INFO("WiFi: setup AP closed");
+  }
+
+  WifiPortalConfig _portal = {};
+  LinkCallback _onConnected = nullptr;
+  LinkCallback _onDisconnected = nullptr;
+  DNSServer _dns;
+
+  WifiConnState _state = WifiConnState::UNCONFIGURED;
+  uint32_t _stateSinceMs = 0;
+  uint32_t _backoffMs = 0;
+  uint32_t _offlineSinceMs = 0;
+  uint32_t _lostAtMs = 0;
+  uint8_t _failures = 0;
+  bool _portalActive = false;
+  bool _scanRequested = false;
+  WifiStats _stats = {};
+};
+
+WifiConnectionManager wifiConnection;
+
+/**
+ * Send captive-portal probes (any host that isn't this device) to setup
+ * Use from onNotFound: if (captivePortalRedirect()) return;
+ */
+bool captivePortalRedirect() {
+  if (!wifiConnection.portalActive()) return false;
+  String host = server.hostHeader();
+  String apIP = WiFi.softAPIP().toString();
+  if (host == apIP || host == WiFi.localIP().toString() || host.endsWith(".local")) return false;
+
+  server.sendHeader(F("Location"), String(F("http://")) + apIP + F("/settings"));
+  server.send(302, F("text/plain"), F(""));
+  return true;
+}
+
+#endif